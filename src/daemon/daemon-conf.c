@@ -88,6 +88,9 @@ static const pa_daemon_conf default_conf = {
     .remixing_produce_lfe = false,
     .remixing_consume_lfe = false,
     .lfe_crossover_freq = 0,
+    .native_io_threads = 0,
+    .io_thread_cpus = NULL,
+    .rtpoll_backend = PA_RTPOLL_BACKEND_POLL,
     .config_file = NULL,
     .use_pid_file = true,
     .system_instance = false,
@@ -179,6 +182,7 @@ void pa_daemon_conf_free(pa_daemon_conf *c) {
     pa_xfree(c->script_commands);
     pa_xfree(c->dl_search_path);
     pa_xfree(c->default_script_file);
+    pa_xfree(c->io_thread_cpus);
 
     if (c->log_target)
         pa_log_target_free(c->log_target);
@@ -498,6 +502,42 @@ static int parse_rtprio(pa_config_parser_state *state) {
     return 0;
 }
 
+static int parse_io_thread_cpus(pa_config_parser_state *state) {
+    pa_daemon_conf *c;
+    char *effective;
+
+    pa_assert(state);
+
+    c = state->data;
+
+    if (!(effective = pa_cpu_list_effective(state->rvalue))) {
+        pa_log("[%s:%u] Invalid or unusable CPU list '%s'.", state->filename, state->lineno, state->rvalue);
+        return -1;
+    }
+
+    pa_xfree(effective);
+    pa_xfree(c->io_thread_cpus);
+    c->io_thread_cpus = pa_xstrdup(state->rvalue);
+    return 0;
+}
+
+static int parse_rtpoll_backend(pa_config_parser_state *state) {
+    pa_daemon_conf *c;
+    pa_rtpoll_backend_t b;
+
+    pa_assert(state);
+
+    c = state->data;
+
+    if ((b = pa_parse_rtpoll_backend(state->rvalue)) < 0 || !pa_rtpoll_backend_supported(b)) {
+        pa_log("[%s:%u] Invalid or unsupported rtpoll backend '%s'.", state->filename, state->lineno, state->rvalue);
+        return -1;
+    }
+
+    c->rtpoll_backend = b;
+    return 0;
+}
+
 static int parse_disable_lfe_remix(pa_config_parser_state *state) {
     pa_daemon_conf *c;
     int k;
@@ -587,6 +627,9 @@ int pa_daemon_conf_load(pa_daemon_conf *c, const char *filename) {
         { "exit-idle-time",             pa_config_parse_int,      &c->exit_idle_time, NULL },
         { "scache-idle-time",           pa_config_parse_int,      &c->scache_idle_time, NULL },
         { "realtime-priority",          parse_rtprio,             c, NULL },
+        { "native-io-threads",          pa_config_parse_unsigned, &c->native_io_threads, NULL },
+        { "io-thread-cpus",             parse_io_thread_cpus,     c, NULL },
+        { "rtpoll-backend",             parse_rtpoll_backend,     c, NULL },
         { "dl-search-path",             pa_config_parse_string,   &c->dl_search_path, NULL },
         { "default-script-file",        pa_config_parse_string,   &c->default_script_file, NULL },
         { "log-target",                 parse_log_target,         c, NULL },
@@ -786,6 +829,9 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "nice-level = %i\n", c->nice_level);
     pa_strbuf_printf(s, "realtime-scheduling = %s\n", pa_yes_no(c->realtime_scheduling));
     pa_strbuf_printf(s, "realtime-priority = %i\n", c->realtime_priority);
+    pa_strbuf_printf(s, "native-io-threads = %u\n", c->native_io_threads);
+    pa_strbuf_printf(s, "io-thread-cpus = %s\n", pa_strempty(c->io_thread_cpus));
+    pa_strbuf_printf(s, "rtpoll-backend = %s\n", pa_rtpoll_backend_to_string(c->rtpoll_backend));
     pa_strbuf_printf(s, "allow-module-loading = %s\n", pa_yes_no(!c->disallow_module_loading));
     pa_strbuf_printf(s, "allow-exit = %s\n", pa_yes_no(!c->disallow_exit));
     pa_strbuf_printf(s, "use-pid-file = %s\n", pa_yes_no(c->use_pid_file));
@@ -28,6 +28,7 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/core.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/rtpoll.h>
 
 #ifdef HAVE_SYS_RESOURCE_H
 #include <sys/resource.h>
@@ -133,6 +134,9 @@ typedef struct pa_daemon_conf {
     unsigned deferred_volume_safety_margin_usec;
     int deferred_volume_extra_delay_usec;
     unsigned lfe_crossover_freq;
+    unsigned native_io_threads;
+    char *io_thread_cpus;
+    pa_rtpoll_backend_t rtpoll_backend;
     pa_sample_spec default_sample_spec;
     uint32_t alternate_sample_rate;
     pa_channel_map default_channel_map;
@@ -1031,6 +1031,9 @@ int main(int argc, char *argv[]) {
 
     pa_memtrap_install();
 
+    pa_rtpoll_set_default_backend(conf->rtpoll_backend);
+    pa_log_debug("Using the %s rtpoll backend for IO threads.", pa_rtpoll_backend_to_string(conf->rtpoll_backend));
+
     pa_assert_se(mainloop = pa_mainloop_new());
 
     if (!(c = pa_core_new(pa_mainloop_get_api(mainloop), !conf->disable_shm,
@@ -1048,6 +1051,8 @@ int main(int argc, char *argv[]) {
     c->deferred_volume_safety_margin_usec = conf->deferred_volume_safety_margin_usec;
     c->deferred_volume_extra_delay_usec = conf->deferred_volume_extra_delay_usec;
     c->lfe_crossover_freq = conf->lfe_crossover_freq;
+    c->native_io_threads = conf->native_io_threads;
+    c->io_thread_cpus = pa_xstrdup(conf->io_thread_cpus);
     c->exit_idle_time = conf->exit_idle_time;
     c->scache_idle_time = conf->scache_idle_time;
     c->resample_method = conf->resample_method;
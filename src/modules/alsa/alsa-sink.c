@@ -149,8 +149,9 @@ struct userdata {
 
     char *device_name;  /* name of the PCM device */
     char *control_device; /* name of the control device */
+    char *thread_cpus; /* CPUs the IO thread is restricted to */
 
-    bool use_mmap:1, use_tsched:1, deferred_volume:1, fixed_latency_range:1;
+    bool use_mmap:1, use_tsched:1, deferred_volume:1, fixed_latency_range:1, batch_writes:1;
 
     bool first, after_rewind;
 
@@ -174,7 +175,8 @@ struct userdata {
 };
 
 enum {
-    SINK_MESSAGE_SYNC_MIXER = PA_SINK_MESSAGE_MAX
+    SINK_MESSAGE_SYNC_MIXER = PA_SINK_MESSAGE_MAX,
+    SINK_MESSAGE_SET_THREAD_CPUS
 };
 
 static void userdata_free(struct userdata *u);
@@ -874,8 +876,16 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
 
 /*         pa_log_debug("%lu frames to write", (unsigned long) frames); */
 
-            if (u->memchunk.length <= 0)
-                pa_sink_render(u->sink, n_bytes, &u->memchunk);
+            /* In batch mode we mix everything that fits into the buffer
+             * into a single block, so that it can be handed to the device
+             * in one snd_pcm_writei() call instead of one per chunk that
+             * pa_sink_render() happens to return. */
+            if (u->memchunk.length <= 0) {
+                if (u->batch_writes)
+                    pa_sink_render_full(u->sink, PA_MIN(n_bytes, (size_t) u->frames_per_block * u->frame_size), &u->memchunk);
+                else
+                    pa_sink_render(u->sink, n_bytes, &u->memchunk);
+            }
 
             pa_assert(u->memchunk.length > 0);
 
@@ -1029,6 +1039,8 @@ static int build_pollfd(struct userdata *u) {
 
 /* Called from IO context */
 static void suspend(struct userdata *u) {
+    pa_smoother_quality q;
+
     pa_assert(u);
 
     /* Handle may have been invalidated due to a device failure.
@@ -1038,6 +1050,10 @@ static void suspend(struct userdata *u) {
 
     pa_smoother_pause(u->smoother, pa_rtclock_now());
 
+    pa_smoother_get_quality(u->smoother, &q);
+    pa_log_debug("Clock estimate after %u updates: rate %0.6f (+-%0.6f), error %llu usec, jitter %llu usec",
+                 q.n_updates, q.rate, q.rate_error, (unsigned long long) q.error, (unsigned long long) q.jitter);
+
     /* Close PCM device */
     close_pcm(u);
 
@@ -1310,6 +1326,9 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
             sync_mixer(u, port);
             return 0;
         }
+
+        case SINK_MESSAGE_SET_THREAD_CPUS:
+            return pa_thread_set_cpu_affinity(u->thread_cpus);
     }
 
     return pa_sink_process_msg(o, code, data, offset, chunk);
@@ -1901,14 +1920,18 @@ static void thread_func(void *userdata) {
         /* Render some data and write it to the dsp */
         if (PA_SINK_IS_OPENED(u->sink->thread_info.state)) {
             int work_done;
-            pa_usec_t sleep_usec = 0;
+            pa_usec_t sleep_usec = 0, start;
             bool on_timeout = pa_rtpoll_timer_elapsed(u->rtpoll);
 
+            start = pa_rtclock_now();
+
             if (u->use_mmap)
                 work_done = mmap_write(u, &sleep_usec, revents & POLLOUT, on_timeout);
             else
                 work_done = unix_write(u, &sleep_usec, revents & POLLOUT, on_timeout);
 
+            pa_io_stats_add(&u->sink->thread_info.io_stats, PA_IO_STAGE_DEVICE, pa_rtclock_now() - start);
+
             if (work_done < 0)
                 goto fail;
 
@@ -2229,7 +2252,7 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
     struct userdata *u = NULL;
     const char *dev_id = NULL, *key, *mod_name;
     pa_sample_spec ss;
-    char *thread_name = NULL;
+    char *thread_name = NULL, *thread_cpus = NULL;
     uint32_t alternate_sample_rate;
     pa_channel_map map;
     uint32_t nfrags, frag_size, buffer_size, tsched_size, tsched_watermark, rewind_safeguard;
@@ -2242,6 +2265,9 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
     bool deferred_volume = false;
     bool set_formats = false;
     bool fixed_latency_range = false;
+    bool batch_writes = false;
+    const char *smoother_name;
+    pa_smoother_algorithm_t smoother_algorithm = PA_SMOOTHER_INTERPOLATE;
     bool b;
     bool d;
     bool avoid_resampling;
@@ -2338,6 +2364,23 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "batch_writes", &batch_writes) < 0) {
+        pa_log("Failed to parse batch_writes argument.");
+        goto fail;
+    }
+
+    if ((smoother_name = pa_modargs_get_value(ma, "smoother", NULL))) {
+        if ((smoother_algorithm = pa_parse_smoother_algorithm(smoother_name)) < 0) {
+            pa_log("Invalid smoother '%s'.", smoother_name);
+            goto fail;
+        }
+    }
+
+    if (pa_modargs_get_thread_cpus(ma, m->core->io_thread_cpus, &thread_cpus) < 0) {
+        pa_log("Failed to parse thread_cpus argument, or none of its CPUs is usable.");
+        goto fail;
+    }
+
     use_tsched = pa_alsa_may_tsched(use_tsched);
 
     u = pa_xnew0(struct userdata, 1);
@@ -2353,6 +2396,8 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
     u->initial_info.rewind_safeguard = (size_t) rewind_safeguard;
     u->deferred_volume = deferred_volume;
     u->fixed_latency_range = fixed_latency_range;
+    u->batch_writes = batch_writes;
+    u->thread_cpus = thread_cpus;
     u->first = true;
     u->rewind_safeguard = rewind_safeguard;
     u->rtpoll = pa_rtpoll_new();
@@ -2370,6 +2415,7 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
             5,
             pa_rtclock_now(),
             true);
+    pa_smoother_set_algorithm(u->smoother, smoother_algorithm);
     u->smoother_interval = SMOOTHER_MIN_INTERVAL;
 
     /* use ucm */
@@ -2472,6 +2518,8 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
 
     if (u->use_mmap)
         pa_log_info("Successfully enabled mmap() mode.");
+    else if (u->batch_writes)
+        pa_log_info("Writing to the device in batches.");
 
     if (u->use_tsched) {
         pa_log_info("Successfully enabled timer-based scheduling mode.");
@@ -2654,6 +2702,11 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
     pa_xfree(thread_name);
     thread_name = NULL;
 
+    /* Only advertise the CPUs once the IO thread actually runs on them */
+    if (u->thread_cpus &&
+        pa_asyncmsgq_send(u->thread_mq.inq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_SET_THREAD_CPUS, NULL, 0, NULL) >= 0)
+        pa_proplist_sets(u->sink->proplist, PA_PROP_DEVICE_IO_THREAD_CPUS, u->thread_cpus);
+
     /* Get initial mixer settings */
     if (volume_is_set) {
         if (u->sink->set_volume)
@@ -2789,6 +2842,7 @@ static void userdata_free(struct userdata *u) {
 
     pa_xfree(u->device_name);
     pa_xfree(u->control_device);
+    pa_xfree(u->thread_cpus);
     pa_xfree(u->paths_dir);
     pa_xfree(u);
 }
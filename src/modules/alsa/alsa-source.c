@@ -133,6 +133,7 @@ struct userdata {
 
     char *device_name;  /* name of the PCM device */
     char *control_device; /* name of the control device */
+    char *thread_cpus; /* CPUs the IO thread is restricted to */
 
     bool use_mmap:1, use_tsched:1, deferred_volume:1, fixed_latency_range:1;
 
@@ -155,7 +156,8 @@ struct userdata {
 };
 
 enum {
-    SOURCE_MESSAGE_SYNC_MIXER = PA_SOURCE_MESSAGE_MAX
+    SOURCE_MESSAGE_SYNC_MIXER = PA_SOURCE_MESSAGE_MAX,
+    SOURCE_MESSAGE_SET_THREAD_CPUS
 };
 
 static void userdata_free(struct userdata *u);
@@ -462,8 +464,14 @@ static void reset_vars(struct userdata *u) {
 
 /* Called from IO context */
 static void close_pcm(struct userdata *u) {
+    pa_smoother_quality q;
+
     pa_smoother_pause(u->smoother, pa_rtclock_now());
 
+    pa_smoother_get_quality(u->smoother, &q);
+    pa_log_debug("Clock estimate after %u updates: rate %0.6f (+-%0.6f), error %llu usec, jitter %llu usec",
+                 q.n_updates, q.rate, q.rate_error, (unsigned long long) q.error, (unsigned long long) q.jitter);
+
     /* Let's suspend */
     snd_pcm_close(u->pcm_handle);
     u->pcm_handle = NULL;
@@ -1181,6 +1189,9 @@ static int source_process_msg(pa_msgobject *o, int code, void *data, int64_t off
             sync_mixer(u, port);
             return 0;
         }
+
+        case SOURCE_MESSAGE_SET_THREAD_CPUS:
+            return pa_thread_set_cpu_affinity(u->thread_cpus);
     }
 
     return pa_source_process_msg(o, code, data, offset, chunk);
@@ -1630,7 +1641,7 @@ static void thread_func(void *userdata) {
         /* Read some data and pass it to the sources */
         if (PA_SOURCE_IS_OPENED(u->source->thread_info.state)) {
             int work_done;
-            pa_usec_t sleep_usec = 0;
+            pa_usec_t sleep_usec = 0, start;
             bool on_timeout = pa_rtpoll_timer_elapsed(u->rtpoll);
 
             if (u->first) {
@@ -1642,11 +1653,15 @@ static void thread_func(void *userdata) {
                 u->first = false;
             }
 
+            start = pa_rtclock_now();
+
             if (u->use_mmap)
                 work_done = mmap_read(u, &sleep_usec, revents & POLLIN, on_timeout);
             else
                 work_done = unix_read(u, &sleep_usec, revents & POLLIN, on_timeout);
 
+            pa_io_stats_add(&u->source->thread_info.io_stats, PA_IO_STAGE_DEVICE, pa_rtclock_now() - start);
+
             if (work_done < 0)
                 goto fail;
 
@@ -1935,7 +1950,7 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
     struct userdata *u = NULL;
     const char *dev_id = NULL, *key, *mod_name;
     pa_sample_spec ss;
-    char *thread_name = NULL;
+    char *thread_name = NULL, *thread_cpus = NULL;
     uint32_t alternate_sample_rate;
     pa_channel_map map;
     uint32_t nfrags, frag_size, buffer_size, tsched_size, tsched_watermark;
@@ -1947,6 +1962,8 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
     bool namereg_fail = false;
     bool deferred_volume = false;
     bool fixed_latency_range = false;
+    const char *smoother_name;
+    pa_smoother_algorithm_t smoother_algorithm = PA_SMOOTHER_INTERPOLATE;
     bool b;
     bool d;
     bool avoid_resampling;
@@ -2037,6 +2054,18 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
         goto fail;
     }
 
+    if ((smoother_name = pa_modargs_get_value(ma, "smoother", NULL))) {
+        if ((smoother_algorithm = pa_parse_smoother_algorithm(smoother_name)) < 0) {
+            pa_log("Invalid smoother '%s'.", smoother_name);
+            goto fail;
+        }
+    }
+
+    if (pa_modargs_get_thread_cpus(ma, m->core->io_thread_cpus, &thread_cpus) < 0) {
+        pa_log("Failed to parse thread_cpus argument, or none of its CPUs is usable.");
+        goto fail;
+    }
+
     use_tsched = pa_alsa_may_tsched(use_tsched);
 
     u = pa_xnew0(struct userdata, 1);
@@ -2051,6 +2080,7 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
     u->initial_info.tsched_watermark = (size_t) tsched_watermark;
     u->deferred_volume = deferred_volume;
     u->fixed_latency_range = fixed_latency_range;
+    u->thread_cpus = thread_cpus;
     u->first = true;
     u->rtpoll = pa_rtpoll_new();
 
@@ -2067,6 +2097,7 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
             5,
             pa_rtclock_now(),
             true);
+    pa_smoother_set_algorithm(u->smoother, smoother_algorithm);
     u->smoother_interval = SMOOTHER_MIN_INTERVAL;
 
     /* use ucm */
@@ -2329,6 +2360,11 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
     pa_xfree(thread_name);
     thread_name = NULL;
 
+    /* Only advertise the CPUs once the IO thread actually runs on them */
+    if (u->thread_cpus &&
+        pa_asyncmsgq_send(u->thread_mq.inq, PA_MSGOBJECT(u->source), SOURCE_MESSAGE_SET_THREAD_CPUS, NULL, 0, NULL) >= 0)
+        pa_proplist_sets(u->source->proplist, PA_PROP_DEVICE_IO_THREAD_CPUS, u->thread_cpus);
+
     /* Get initial mixer settings */
     if (volume_is_set) {
         if (u->source->set_volume)
@@ -2426,6 +2462,7 @@ static void userdata_free(struct userdata *u) {
 
     pa_xfree(u->device_name);
     pa_xfree(u->control_device);
+    pa_xfree(u->thread_cpus);
     pa_xfree(u->paths_dir);
     pa_xfree(u);
 }
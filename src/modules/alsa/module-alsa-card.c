@@ -63,6 +63,8 @@ PA_MODULE_USAGE(
         "tsched_buffer_watermark=<lower fill watermark> "
         "profile=<profile name> "
         "fixed_latency_range=<disable latency range changes on underrun?> "
+        "batch_writes=<mix and write whole buffers at once when not using mmap?> "
+        "smoother=<clock smoothing algorithm: interpolate or kalman> "
         "ignore_dB=<ignore dB information from the device?> "
         "deferred_volume=<Synchronize software and hardware volume changes to avoid momentary jumps?> "
         "profile_set=<profile set configuration file> "
@@ -70,6 +72,7 @@ PA_MODULE_USAGE(
         "use_ucm=<load use case manager> "
         "avoid_resampling=<use stream original sample rate if possible?> "
         "control=<name of mixer control> "
+        "thread_cpus=<CPUs to run the IO threads on> "
 );
 
 static const char* const valid_modargs[] = {
@@ -91,6 +94,8 @@ static const char* const valid_modargs[] = {
     "tsched_buffer_size",
     "tsched_buffer_watermark",
     "fixed_latency_range",
+    "batch_writes",
+    "smoother",
     "profile",
     "ignore_dB",
     "deferred_volume",
@@ -99,6 +104,7 @@ static const char* const valid_modargs[] = {
     "use_ucm",
     "avoid_resampling",
     "control",
+    "thread_cpus",
     NULL
 };
 
@@ -57,7 +57,10 @@ PA_MODULE_USAGE(
         "deferred_volume=<Synchronize software and hardware volume changes to avoid momentary jumps?> "
         "deferred_volume_safety_margin=<usec adjustment depending on volume direction> "
         "deferred_volume_extra_delay=<usec adjustment to HW volume changes> "
-        "fixed_latency_range=<disable latency range changes on underrun?>");
+        "fixed_latency_range=<disable latency range changes on underrun?> "
+        "batch_writes=<mix and write whole buffers at once when not using mmap?> "
+        "smoother=<clock smoothing algorithm: interpolate or kalman> "
+        "thread_cpus=<CPUs to run the IO thread on>");
 
 static const char* const valid_modargs[] = {
     "name",
@@ -84,6 +87,9 @@ static const char* const valid_modargs[] = {
     "deferred_volume_safety_margin",
     "deferred_volume_extra_delay",
     "fixed_latency_range",
+    "batch_writes",
+    "smoother",
+    "thread_cpus",
     NULL
 };
 
@@ -55,7 +55,8 @@ PA_MODULE_DESCRIPTION("BlueZ 5 Bluetooth audio sink and source");
 PA_MODULE_VERSION(PACKAGE_VERSION);
 PA_MODULE_LOAD_ONCE(false);
 PA_MODULE_USAGE("path=<device object path>"
-                "autodetect_mtu=<boolean>");
+                "autodetect_mtu=<boolean> "
+                "thread_cpus=<CPUs to run the IO thread on>");
 
 #define FIXED_LATENCY_PLAYBACK_A2DP (25 * PA_USEC_PER_MSEC)
 #define FIXED_LATENCY_PLAYBACK_SCO  (25 * PA_USEC_PER_MSEC)
@@ -67,6 +68,7 @@ PA_MODULE_USAGE("path=<device object path>"
 static const char* const valid_modargs[] = {
     "path",
     "autodetect_mtu",
+    "thread_cpus",
     NULL
 };
 
@@ -79,10 +81,12 @@ enum {
 
 enum {
     PA_SOURCE_MESSAGE_SETUP_STREAM = PA_SOURCE_MESSAGE_MAX,
+    PA_SOURCE_MESSAGE_SET_THREAD_CPUS,
 };
 
 enum {
     PA_SINK_MESSAGE_SETUP_STREAM = PA_SINK_MESSAGE_MAX,
+    PA_SINK_MESSAGE_SET_THREAD_CPUS,
 };
 
 typedef struct bluetooth_msg {
@@ -119,6 +123,7 @@ struct userdata {
     pa_rtpoll *rtpoll;
     pa_rtpoll_item *rtpoll_item;
     bluetooth_msg *msg;
+    char *thread_cpus;
 
     int stream_fd;
     int stream_write_type;
@@ -901,6 +906,9 @@ static int source_process_msg(pa_msgobject *o, int code, void *data, int64_t off
                 setup_stream(u);
             return 0;
 
+        case PA_SOURCE_MESSAGE_SET_THREAD_CPUS:
+            return pa_thread_set_cpu_affinity(u->thread_cpus);
+
     }
 
     return pa_source_process_msg(o, code, data, offset, chunk);
@@ -1088,6 +1096,9 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
             else
                 setup_stream(u);
             return 0;
+
+        case PA_SINK_MESSAGE_SET_THREAD_CPUS:
+            return pa_thread_set_cpu_affinity(u->thread_cpus);
     }
 
     return pa_sink_process_msg(o, code, data, offset, chunk);
@@ -1596,6 +1607,29 @@ finish:
     pa_log_debug("IO thread shutting down");
 }
 
+/* Run from main thread */
+static void set_thread_cpus(struct userdata *u) {
+    int r;
+
+    /* The sink and the source share the IO thread, ask it through either of
+     * them. Only advertise the CPUs once the thread actually runs on them. */
+    if (u->sink)
+        r = pa_asyncmsgq_send(u->thread_mq.inq, PA_MSGOBJECT(u->sink), PA_SINK_MESSAGE_SET_THREAD_CPUS, NULL, 0, NULL);
+    else if (u->source)
+        r = pa_asyncmsgq_send(u->thread_mq.inq, PA_MSGOBJECT(u->source), PA_SOURCE_MESSAGE_SET_THREAD_CPUS, NULL, 0, NULL);
+    else
+        return;
+
+    if (r < 0)
+        return;
+
+    if (u->sink)
+        pa_proplist_sets(u->sink->proplist, PA_PROP_DEVICE_IO_THREAD_CPUS, u->thread_cpus);
+
+    if (u->source)
+        pa_proplist_sets(u->source->proplist, PA_PROP_DEVICE_IO_THREAD_CPUS, u->thread_cpus);
+}
+
 /* Run from main thread */
 static int start_thread(struct userdata *u) {
     pa_assert(u);
@@ -1615,6 +1649,9 @@ static int start_thread(struct userdata *u) {
         return -1;
     }
 
+    if (u->thread_cpus)
+        set_thread_cpus(u);
+
     if (u->sink) {
         pa_sink_set_asyncmsgq(u->sink, u->thread_mq.inq);
         pa_sink_set_rtpoll(u->sink, u->rtpoll);
@@ -2299,6 +2336,11 @@ int pa__init(pa_module* m) {
 
     u->device->autodetect_mtu = autodetect_mtu;
 
+    if (pa_modargs_get_thread_cpus(ma, u->core->io_thread_cpus, &u->thread_cpus) < 0) {
+        pa_log("Invalid thread_cpus parameter, or none of its CPUs is usable");
+        goto fail_free_modargs;
+    }
+
     pa_modargs_free(ma);
 
     u->device_connection_changed_slot =
@@ -2393,6 +2435,7 @@ void pa__done(pa_module *m) {
 
     pa_xfree(u->output_port_name);
     pa_xfree(u->input_port_name);
+    pa_xfree(u->thread_cpus);
 
     pa_xfree(u);
 }
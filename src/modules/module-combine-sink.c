@@ -59,7 +59,9 @@ PA_MODULE_USAGE(
         "format=<sample format> "
         "rate=<sample rate> "
         "channels=<number of channels> "
-        "channel_map=<channel map>");
+        "channel_map=<channel map> "
+        "smoother=<clock smoothing algorithm: interpolate or kalman> "
+        "thread_cpus=<CPUs to run the IO thread on>");
 
 #define DEFAULT_SINK_NAME "combined"
 
@@ -79,6 +81,8 @@ static const char* const valid_modargs[] = {
     "rate",
     "channels",
     "channel_map",
+    "smoother",
+    "thread_cpus",
     NULL
 };
 
@@ -133,6 +137,7 @@ struct userdata {
     pa_thread *thread;
     pa_thread_mq thread_mq;
     pa_rtpoll *rtpoll;
+    char *thread_cpus;
 
     pa_time_event *time_event;
     pa_usec_t adjust_time;
@@ -168,7 +173,8 @@ enum {
     SINK_MESSAGE_NEED,
     SINK_MESSAGE_UPDATE_LATENCY,
     SINK_MESSAGE_UPDATE_MAX_REQUEST,
-    SINK_MESSAGE_UPDATE_LATENCY_RANGE
+    SINK_MESSAGE_UPDATE_LATENCY_RANGE,
+    SINK_MESSAGE_SET_THREAD_CPUS
 };
 
 enum {
@@ -937,6 +943,9 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
             update_latency_range(u);
             break;
 
+        case SINK_MESSAGE_SET_THREAD_CPUS:
+            return pa_thread_set_cpu_affinity(u->thread_cpus);
+
 }
 
     return pa_sink_process_msg(o, code, data, offset, chunk);
@@ -1286,7 +1295,7 @@ static pa_hook_result_t sink_state_changed_hook_cb(pa_core *c, pa_sink *s, struc
 int pa__init(pa_module*m) {
     struct userdata *u;
     pa_modargs *ma = NULL;
-    const char *slaves, *rm;
+    const char *slaves, *rm, *sm;
     int resample_method = PA_RESAMPLER_TRIVIAL;
     pa_sample_spec ss;
     pa_channel_map map;
@@ -1321,6 +1330,12 @@ int pa__init(pa_module*m) {
     }
 
     u->resample_method = resample_method;
+
+    if (pa_modargs_get_thread_cpus(ma, m->core->io_thread_cpus, &u->thread_cpus) < 0) {
+        pa_log("invalid thread_cpus, or none of its CPUs is usable");
+        goto fail;
+    }
+
     u->outputs = pa_idxset_new(NULL, NULL);
     u->thread_info.smoother = pa_smoother_new(
             PA_USEC_PER_SEC,
@@ -1331,6 +1346,17 @@ int pa__init(pa_module*m) {
             pa_rtclock_now(),
             true);
 
+    if ((sm = pa_modargs_get_value(ma, "smoother", NULL))) {
+        pa_smoother_algorithm_t smoother_algorithm;
+
+        if ((smoother_algorithm = pa_parse_smoother_algorithm(sm)) < 0) {
+            pa_log("invalid smoother '%s'", sm);
+            goto fail;
+        }
+
+        pa_smoother_set_algorithm(u->thread_info.smoother, smoother_algorithm);
+    }
+
     adjust_time_sec = DEFAULT_ADJUST_TIME_USEC / PA_USEC_PER_SEC;
     if (pa_modargs_get_value_u32(ma, "adjust_time", &adjust_time_sec) < 0) {
         pa_log("Failed to parse adjust_time value");
@@ -1510,6 +1536,11 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    /* Only advertise the CPUs once the IO thread actually runs on them */
+    if (u->thread_cpus &&
+        pa_asyncmsgq_send(u->thread_mq.inq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_SET_THREAD_CPUS, NULL, 0, NULL) >= 0)
+        pa_proplist_sets(u->sink->proplist, PA_PROP_DEVICE_IO_THREAD_CPUS, u->thread_cpus);
+
     /* Activate the sink and the sink inputs */
     pa_sink_put(u->sink);
 
@@ -1577,5 +1608,6 @@ void pa__done(pa_module*m) {
     if (u->thread_info.smoother)
         pa_smoother_free(u->thread_info.smoother);
 
+    pa_xfree(u->thread_cpus);
     pa_xfree(u);
 }
@@ -94,9 +94,11 @@
 #  define MODULE_ARGUMENTS_COMMON "cookie", "auth-cookie", "auth-cookie-enabled", "auth-anonymous",
 
 #  if defined(HAVE_CREDS) && !defined(USE_TCP_SOCKETS)
-#    define MODULE_ARGUMENTS MODULE_ARGUMENTS_COMMON "auth-group", "auth-group-enable", "srbchannel",
+#    define MODULE_ARGUMENTS MODULE_ARGUMENTS_COMMON "auth-group", "auth-group-enable", "srbchannel", "srbchannel-spin-usec", "srbchannel-io-thread",
 #    define AUTH_USAGE "auth-group=<system group to allow access> auth-group-enable=<enable auth by UNIX group?> "
-#    define SRB_USAGE "srbchannel=<enable shared ringbuffer communication channel?> "
+#    define SRB_USAGE "srbchannel=<enable shared ringbuffer communication channel?> " \
+                      "srbchannel-spin-usec=<max. time to busy-wait for the client before sleeping, up to 500 usec> " \
+                      "srbchannel-io-thread=<read stream data from the srbchannel in the sink's IO thread?> "
 #  elif defined(USE_TCP_SOCKETS)
 #    define MODULE_ARGUMENTS MODULE_ARGUMENTS_COMMON "auth-ip-acl",
 #    define AUTH_USAGE "auth-ip-acl=<IP address ACL to allow access> "
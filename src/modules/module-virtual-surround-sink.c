@@ -38,6 +38,7 @@
 #include <pulsecore/ltdl-helper.h>
 #include <pulsecore/sound-file.h>
 #include <pulsecore/resampler.h>
+#include <pulsecore/filter/convolver.h>
 
 #include <math.h>
 
@@ -63,6 +64,14 @@ PA_MODULE_USAGE(
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 #define DEFAULT_AUTOLOADED false
 
+/* Upper bound for the impulse response length, in frames */
+#define MAX_HRIR_SAMPLES 8192
+
+/* Bounds for the convolution partition size, in frames. The partition size
+ * is also the latency the convolution adds. */
+#define MIN_BLOCK_SIZE 64
+#define MAX_BLOCK_SIZE 256
+
 struct userdata {
     pa_module *module;
 
@@ -86,8 +95,7 @@ struct userdata {
     unsigned hrir_samples;
     float *hrir_data;
 
-    float *input_buffer;
-    int input_buffer_offset;
+    pa_convolver *convolver;
 
     bool autoloaded;
 };
@@ -131,7 +139,10 @@ static int sink_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t of
                 pa_sink_get_latency_within_thread(u->sink_input->sink, true) +
 
                 /* Add the latency internal to our sink input on top */
-                pa_bytes_to_usec(pa_memblockq_get_length(u->sink_input->thread_info.render_memblockq), &u->sink_input->sink->sample_spec);
+                pa_bytes_to_usec(pa_memblockq_get_length(u->sink_input->thread_info.render_memblockq), &u->sink_input->sink->sample_spec) +
+
+                /* And the delay of the convolution */
+                pa_bytes_to_usec(pa_convolver_get_latency(u->convolver) * u->fs, &u->sink_input->sample_spec);
 
             return 0;
     }
@@ -240,9 +251,7 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     unsigned n;
     pa_memchunk tchunk;
 
-    unsigned j, k, l;
-    float sum_right, sum_left;
-    float current_sample;
+    unsigned l;
 
     pa_sink_input_assert_ref(i);
     pa_assert(chunk);
@@ -278,29 +287,11 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     src = pa_memblock_acquire_chunk(&tchunk);
     dst = pa_memblock_acquire(chunk->memblock);
 
-    for (l = 0; l < n; l++) {
-        memcpy(((char*) u->input_buffer) + u->input_buffer_offset * u->sink_fs, ((char *) src) + l * u->sink_fs, u->sink_fs);
+    /* fold the input with the impulse responses */
+    pa_convolver_process(u->convolver, src, dst, n);
 
-        sum_right = 0;
-        sum_left = 0;
-
-        /* fold the input buffer with the impulse response */
-        for (j = 0; j < u->hrir_samples; j++) {
-            for (k = 0; k < u->channels; k++) {
-                current_sample = u->input_buffer[((u->input_buffer_offset + j) % u->hrir_samples) * u->channels + k];
-
-                sum_left += current_sample * u->hrir_data[j * u->hrir_channels + u->mapping_left[k]];
-                sum_right += current_sample * u->hrir_data[j * u->hrir_channels + u->mapping_right[k]];
-            }
-        }
-
-        dst[2 * l] = PA_CLAMP_UNLIKELY(sum_left, -1.0f, 1.0f);
-        dst[2 * l + 1] = PA_CLAMP_UNLIKELY(sum_right, -1.0f, 1.0f);
-
-        u->input_buffer_offset--;
-        if (u->input_buffer_offset < 0)
-            u->input_buffer_offset += u->hrir_samples;
-    }
+    for (l = 0; l < 2 * n; l++)
+        dst[l] = PA_CLAMP_UNLIKELY(dst[l], -1.0f, 1.0f);
 
     pa_memblock_release(tchunk.memblock);
     pa_memblock_release(chunk->memblock);
@@ -329,17 +320,40 @@ static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
         amount = PA_MIN(u->sink->thread_info.rewind_nbytes * u->sink_fs / u->fs, max_rewrite);
         u->sink->thread_info.rewind_nbytes = 0;
 
-        if (amount > 0) {
+        if (amount > 0)
             pa_memblockq_seek(u->memblockq, - (int64_t) amount, PA_SEEK_RELATIVE, true);
-
-            /* Reset the input buffer */
-            memset(u->input_buffer, 0, u->hrir_samples * u->sink_fs);
-            u->input_buffer_offset = 0;
-        }
     }
 
     pa_sink_process_rewind(u->sink, amount);
-    pa_memblockq_rewind(u->memblockq, nbytes * u->sink_fs / u->fs);
+
+    if (nbytes > 0) {
+        size_t history = pa_convolver_get_history(u->convolver) * u->sink_fs;
+
+        /* The convolver still holds the input up to the old read index.
+         * Rebuild its state from the input preceding the new one, which the
+         * memblockq keeps around for us. Anything we rewrote starts at or
+         * after the new read index, so this is what was played before. */
+        pa_memblockq_rewind(u->memblockq, nbytes * u->sink_fs / u->fs + history);
+        pa_convolver_reset(u->convolver);
+
+        while (history > 0) {
+            pa_memchunk tchunk;
+            float *src;
+            size_t n;
+
+            pa_assert_se(pa_memblockq_peek(u->memblockq, &tchunk) >= 0);
+            n = PA_MIN(tchunk.length, history) / u->sink_fs;
+            pa_assert(n > 0);
+
+            src = pa_memblock_acquire_chunk(&tchunk);
+            pa_convolver_process(u->convolver, src, NULL, (unsigned) n);
+            pa_memblock_release(tchunk.memblock);
+            pa_memblock_unref(tchunk.memblock);
+
+            pa_memblockq_drop(u->memblockq, n * u->sink_fs);
+            history -= n * u->sink_fs;
+        }
+    }
 }
 
 /* Called from I/O thread context */
@@ -351,7 +365,8 @@ static void sink_input_update_max_rewind_cb(pa_sink_input *i, size_t nbytes) {
 
     /* FIXME: Too small max_rewind:
      * https://bugs.freedesktop.org/show_bug.cgi?id=53709 */
-    pa_memblockq_set_maxrewind(u->memblockq, nbytes * u->sink_fs / u->fs);
+    /* Keep enough input for the convolver to be refilled after a rewind */
+    pa_memblockq_set_maxrewind(u->memblockq, nbytes * u->sink_fs / u->fs + pa_convolver_get_history(u->convolver) * u->sink_fs);
     pa_sink_set_max_rewind_within_thread(u->sink, nbytes * u->sink_fs / u->fs);
 }
 
@@ -600,6 +615,7 @@ int pa__init(pa_module*m) {
 
     const char *hrir_file;
     unsigned i, j, found_channel_left, found_channel_right;
+    unsigned block_size;
     float *hrir_data;
 
     pa_sample_spec hrir_ss;
@@ -794,9 +810,9 @@ int pa__init(pa_module*m) {
                                  PA_RESAMPLER_SRC_SINC_BEST_QUALITY, PA_RESAMPLER_NO_REMAP);
 
     u->hrir_samples = hrir_temp_chunk.length / pa_frame_size(&hrir_temp_ss) * hrir_ss.rate / hrir_temp_ss.rate;
-    if (u->hrir_samples > 64) {
-        u->hrir_samples = 64;
-        pa_log("The (resampled) hrir contains more than 64 samples. Only the first 64 samples will be used to limit processor usage.");
+    if (u->hrir_samples > MAX_HRIR_SAMPLES) {
+        u->hrir_samples = MAX_HRIR_SAMPLES;
+        pa_log("The (resampled) hrir contains more than %u samples. Only the first %u samples will be used.", MAX_HRIR_SAMPLES, MAX_HRIR_SAMPLES);
     }
 
     hrir_total_length = u->hrir_samples * pa_frame_size(&hrir_ss);
@@ -818,10 +834,10 @@ int pa__init(pa_module*m) {
             hrir_data = (float *) pa_memblock_acquire(hrir_temp_chunk_resampled.memblock);
 
             if (hrir_total_length - hrir_copied_length >= hrir_temp_chunk_resampled.length) {
-                memcpy(u->hrir_data + hrir_copied_length, hrir_data, hrir_temp_chunk_resampled.length);
+                memcpy((char *) u->hrir_data + hrir_copied_length, hrir_data, hrir_temp_chunk_resampled.length);
                 hrir_copied_length += hrir_temp_chunk_resampled.length;
             } else {
-                memcpy(u->hrir_data + hrir_copied_length, hrir_data, hrir_total_length - hrir_copied_length);
+                memcpy((char *) u->hrir_data + hrir_copied_length, hrir_data, hrir_total_length - hrir_copied_length);
                 hrir_copied_length = hrir_total_length;
             }
 
@@ -872,8 +888,18 @@ int pa__init(pa_module*m) {
         }
     }
 
-    u->input_buffer = pa_xmalloc0(u->hrir_samples * u->sink_fs);
-    u->input_buffer_offset = 0;
+    /* Partitions as long as the impulse response, within limits: shorter
+     * ones waste time in the frequency domain delay line, longer ones add
+     * latency */
+    block_size = MIN_BLOCK_SIZE;
+    while (block_size < u->hrir_samples && block_size < MAX_BLOCK_SIZE)
+        block_size <<= 1;
+
+    u->convolver = pa_convolver_new(block_size, u->hrir_samples, u->channels, 2);
+    for (i = 0; i < u->channels; i++) {
+        pa_convolver_set_filter(u->convolver, i, 0, u->hrir_data + u->mapping_left[i], u->hrir_samples, u->hrir_channels);
+        pa_convolver_set_filter(u->convolver, i, 1, u->hrir_data + u->mapping_right[i], u->hrir_samples, u->hrir_channels);
+    }
 
     /* The order here is important. The input must be put first,
      * otherwise streams might attach to the sink before the sink
@@ -940,8 +966,8 @@ void pa__done(pa_module*m) {
     if (u->hrir_data)
         pa_xfree(u->hrir_data);
 
-    if (u->input_buffer)
-        pa_xfree(u->input_buffer);
+    if (u->convolver)
+        pa_convolver_free(u->convolver);
 
     if (u->mapping_left)
         pa_xfree(u->mapping_left);
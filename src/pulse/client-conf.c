@@ -35,6 +35,7 @@
 #include <pulsecore/conf-parser.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/authkey.h>
+#include <pulsecore/srbchannel.h>
 
 #include "client-conf.h"
 
@@ -67,6 +68,8 @@ static const pa_client_conf default_conf = {
     .disable_shm = false,
     .disable_memfd = false,
     .shm_size = 0,
+    .srbchannel_spin_usec = 0,
+    .write_ring = false,
     .auto_connect_localhost = false,
     .auto_connect_display = false
 };
@@ -94,6 +97,24 @@ void pa_client_conf_free(pa_client_conf *c) {
     pa_xfree(c);
 }
 
+static int parse_srbchannel_spin(pa_config_parser_state *state) {
+    unsigned *spin;
+
+    pa_assert(state);
+
+    spin = state->data;
+
+    if (pa_config_parse_unsigned(state) < 0)
+        return -1;
+
+    if (*spin > PA_SRBCHANNEL_SPIN_MAX_USEC) {
+        pa_log_warn(_("[%s:%u] srbchannel-spin-usec is limited to %u usec."), state->filename, state->lineno, PA_SRBCHANNEL_SPIN_MAX_USEC);
+        *spin = PA_SRBCHANNEL_SPIN_MAX_USEC;
+    }
+
+    return 0;
+}
+
 static void load_env(pa_client_conf *c) {
     char *e;
 
@@ -144,6 +165,8 @@ void pa_client_conf_load(pa_client_conf *c, bool load_from_x11, bool load_from_e
         { "enable-shm",             pa_config_parse_not_bool, &c->disable_shm, NULL },
         { "enable-memfd",           pa_config_parse_not_bool, &c->disable_memfd, NULL },
         { "shm-size-bytes",         pa_config_parse_size,     &c->shm_size, NULL },
+        { "srbchannel-spin-usec",   parse_srbchannel_spin,    &c->srbchannel_spin_usec, NULL },
+        { "enable-write-ring",      pa_config_parse_bool,     &c->write_ring, NULL },
         { "auto-connect-localhost", pa_config_parse_bool,     &c->auto_connect_localhost, NULL },
         { "auto-connect-display",   pa_config_parse_bool,     &c->auto_connect_display, NULL },
         { NULL,                     NULL,                     NULL, NULL },
@@ -112,6 +112,9 @@ static void reset_callbacks(pa_context *c) {
     c->subscribe_callback = NULL;
     c->subscribe_userdata = NULL;
 
+    c->subscribe_delta_callback = NULL;
+    c->subscribe_delta_userdata = NULL;
+
     c->event_callback = NULL;
     c->event_userdata = NULL;
 
@@ -225,6 +228,11 @@ static void context_unlink(pa_context *c) {
         c->pstream = NULL;
     }
 
+    c->timing_slots = NULL;
+    c->n_timing_slots = 0;
+
+    pa_context_drop_write_ring_pending(c);
+
     if (c->srb_template.memblock) {
         pa_memblock_unref(c->srb_template.memblock);
         c->srb_template.memblock = NULL;
@@ -359,6 +367,8 @@ static void pstream_packet_callback(pa_pstream *p, pa_packet *packet, pa_cmsg_an
 static void handle_srbchannel_memblock(pa_context *c, pa_memblock *memblock) {
     pa_srbchannel *sr;
     pa_tagstruct *t;
+    void *aux;
+    size_t length;
 
     pa_assert(c);
 
@@ -387,6 +397,14 @@ static void handle_srbchannel_memblock(pa_context *c, pa_memblock *memblock) {
         return;
     }
 
+    pa_srbchannel_set_spin(sr, c->conf->srbchannel_spin_usec);
+
+    /* The server publishes stream timing info in the auxiliary area */
+    if (c->version >= 34 && (aux = pa_srbchannel_get_aux(sr, &length))) {
+        c->timing_slots = aux;
+        c->n_timing_slots = length / sizeof(pa_timing_page_slot);
+    }
+
     /* Ack the enable command */
     t = pa_tagstruct_new();
     pa_tagstruct_putu32(t, PA_COMMAND_ENABLE_SRBCHANNEL);
@@ -397,6 +415,13 @@ static void handle_srbchannel_memblock(pa_context *c, pa_memblock *memblock) {
     pa_pstream_set_srbchannel(c->pstream, sr);
 }
 
+void pa_context_drop_write_ring_pending(pa_context *c) {
+    pa_assert(c);
+
+    while (c->n_write_ring_pending > 0)
+        pa_memblock_unref(c->write_ring_pending[--c->n_write_ring_pending]);
+}
+
 static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
     pa_context *c = userdata;
     pa_stream *s;
@@ -415,6 +440,28 @@ static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t o
         return;
     }
 
+    /* A block of a write ring, the ENABLE_WRITE_RING reply follows */
+    if (channel == PA_WRITE_RING_CHANNEL) {
+
+        /* Blocks for a stream that went away in the meantime */
+        if (offset == 0)
+            pa_context_drop_write_ring_pending(c);
+
+        if (c->version < 34 ||
+            !chunk->memblock ||
+            chunk->index != 0 ||
+            pa_memblock_is_read_only(chunk->memblock) ||
+            pa_memblock_get_length(chunk->memblock) <= PA_WRITE_RING_HEADER_SIZE ||
+            offset != c->n_write_ring_pending ||
+            c->n_write_ring_pending >= PA_WRITE_RING_BLOCKS_MAX)
+            pa_context_fail(c, PA_ERR_PROTOCOL);
+        else
+            c->write_ring_pending[c->n_write_ring_pending++] = pa_memblock_ref(chunk->memblock);
+
+        pa_context_unref(c);
+        return;
+    }
+
     if ((s = pa_hashmap_get(c->record_streams, PA_UINT32_TO_PTR(channel)))) {
 
         if (chunk->memblock) {
@@ -473,6 +520,24 @@ int pa_context_handle_error(pa_context *c, uint32_t command, pa_tagstruct *t, bo
     return 0;
 }
 
+static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+
+static void send_client_name(pa_context *c) {
+    pa_tagstruct *t;
+    uint32_t tag;
+
+    t = pa_tagstruct_command(c, PA_COMMAND_SET_CLIENT_NAME, &tag);
+
+    if (c->version >= 13) {
+        pa_init_proplist(c->proplist);
+        pa_tagstruct_put_proplist(t, c->proplist);
+    } else
+        pa_tagstruct_puts(t, pa_proplist_gets(c->proplist, PA_PROP_APPLICATION_NAME));
+
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, setup_complete_callback, c, NULL);
+}
+
 static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_context *c = userdata;
 
@@ -489,7 +554,6 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
 
     switch(c->state) {
         case PA_CONTEXT_AUTHORIZING: {
-            pa_tagstruct *reply;
             bool shm_on_remote = false;
             bool memfd_on_remote = false;
 
@@ -523,6 +587,17 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
 
             pa_log_debug("Protocol version: remote %u, local %u", c->version, PA_PROTOCOL_VERSION);
 
+            /* Whatever we sent ahead of this reply assumed a server that is
+             * at least as new as we are. The client name is encoded the same
+             * way for everything since version 13, stream creation requests
+             * are not. */
+            if (c->pipelined &&
+                (c->version < 13 || (c->pipelined_stream_sent && c->version < PA_PROTOCOL_VERSION))) {
+                pa_log_debug("Server too old for pipelined connection setup.");
+                pa_context_fail(c, PA_ERR_VERSION);
+                goto finish;
+            }
+
             /* Enable shared memory support if possible */
             if (c->do_shm)
                 if (c->version < 10 || (c->version >= 13 && !shm_on_remote))
@@ -564,16 +639,10 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
             pa_log_debug("Memfd possible: %s", pa_yes_no(c->memfd_on_local));
             pa_log_debug("Negotiated SHM type: %s", pa_mem_type_to_string(c->shm_type));
 
-            reply = pa_tagstruct_command(c, PA_COMMAND_SET_CLIENT_NAME, &tag);
-
-            if (c->version >= 13) {
-                pa_init_proplist(c->proplist);
-                pa_tagstruct_put_proplist(reply, c->proplist);
-            } else
-                pa_tagstruct_puts(reply, pa_proplist_gets(c->proplist, PA_PROP_APPLICATION_NAME));
-
-            pa_pstream_send_tagstruct(c->pstream, reply);
-            pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, setup_complete_callback, c, NULL);
+            /* In pipelined mode the client name already went out right
+             * behind the AUTH request, its reply is next in line. */
+            if (!c->pipelined)
+                send_client_name(c);
 
             pa_context_set_state(c, PA_CONTEXT_SETTING_NAME);
             break;
@@ -655,6 +724,15 @@ static void setup_context(pa_context *c, pa_iochannel *io) {
 
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, setup_complete_callback, c, NULL);
 
+    if (c->pipelined) {
+        /* The server handles commands in order, so anything queued
+         * behind AUTH is processed once the client is authorized. Until
+         * the reply tells us better, speak our own protocol version. */
+        c->version = PA_PROTOCOL_VERSION;
+        c->pipelined_stream_sent = false;
+        send_client_name(c);
+    }
+
     pa_context_set_state(c, PA_CONTEXT_AUTHORIZING);
 
     pa_context_unref(c);
@@ -977,7 +1055,7 @@ int pa_context_connect(
 
     PA_CHECK_VALIDITY(c, !pa_detect_fork(), PA_ERR_FORKED);
     PA_CHECK_VALIDITY(c, c->state == PA_CONTEXT_UNCONNECTED, PA_ERR_BADSTATE);
-    PA_CHECK_VALIDITY(c, !(flags & ~(PA_CONTEXT_NOAUTOSPAWN|PA_CONTEXT_NOFAIL)), PA_ERR_INVALID);
+    PA_CHECK_VALIDITY(c, !(flags & ~(PA_CONTEXT_NOAUTOSPAWN|PA_CONTEXT_NOFAIL|PA_CONTEXT_PIPELINED)), PA_ERR_INVALID);
     PA_CHECK_VALIDITY(c, !server || *server, PA_ERR_INVALID);
 
     if (server)
@@ -988,6 +1066,7 @@ int pa_context_connect(
     pa_context_ref(c);
 
     c->no_fail = !!(flags & PA_CONTEXT_NOFAIL);
+    c->pipelined = !!(flags & PA_CONTEXT_PIPELINED);
     c->server_specified = !!server;
     pa_assert(!c->server_list);
 
@@ -1528,6 +1607,9 @@ static void pa_command_disable_srbchannel(pa_pdispatch *pd, uint32_t command, ui
 
     pa_pstream_set_srbchannel(c->pstream, NULL);
 
+    c->timing_slots = NULL;
+    c->n_timing_slots = 0;
+
     c->srb_template.readfd = -1;
     c->srb_template.writefd = -1;
     if (c->srb_template.memblock) {
@@ -117,16 +117,25 @@ typedef enum pa_context_flags {
     /**< Flag to pass when no specific options are needed (used to avoid casting)  \since 0.9.19 */
     PA_CONTEXT_NOAUTOSPAWN = 0x0001U,
     /**< Disabled autospawning of the PulseAudio daemon if required */
-    PA_CONTEXT_NOFAIL = 0x0002U
+    PA_CONTEXT_NOFAIL = 0x0002U,
     /**< Don't fail if the daemon is not available when pa_context_connect() is
      * called, instead enter PA_CONTEXT_CONNECTING state and wait for the daemon
      * to appear.  \since 0.9.15 */
+    PA_CONTEXT_PIPELINED = 0x0004U
+    /**< Don't wait for the server to answer the authentication request
+     * before sending the client name, and allow streams to be connected as
+     * soon as the context has entered PA_CONTEXT_AUTHORIZING, so that their
+     * creation requests travel in the same round trip. Requests sent that
+     * early are encoded for the protocol version of this library; if the
+     * server turns out to be older the context fails with PA_ERR_VERSION and
+     * the application should connect again without this flag.  \since 14.0 */
 } pa_context_flags_t;
 
 /** \cond fulldocs */
 /* Allow clients to check with #ifdef for those flags */
 #define PA_CONTEXT_NOAUTOSPAWN PA_CONTEXT_NOAUTOSPAWN
 #define PA_CONTEXT_NOFAIL PA_CONTEXT_NOFAIL
+#define PA_CONTEXT_PIPELINED PA_CONTEXT_PIPELINED
 /** \endcond */
 
 /** Direction bitfield - while we currently do not expose anything bidirectional,
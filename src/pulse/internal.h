@@ -77,6 +77,14 @@ struct pa_context {
     pa_srbchannel_template srb_template;
     uint32_t srb_setup_tag;
 
+    /* Timing page in the srbchannel's auxiliary area, NULL if none */
+    pa_timing_page_slot *timing_slots;
+    unsigned n_timing_slots;
+
+    /* Write ring blocks received ahead of the ENABLE_WRITE_RING reply */
+    pa_memblock *write_ring_pending[PA_WRITE_RING_BLOCKS_MAX];
+    unsigned n_write_ring_pending;
+
     pa_hashmap *record_streams, *playback_streams;
     PA_LLIST_HEAD(pa_stream, streams);
     PA_LLIST_HEAD(pa_operation, operations);
@@ -91,6 +99,8 @@ struct pa_context {
     void *state_userdata;
     pa_context_subscribe_cb_t subscribe_callback;
     void *subscribe_userdata;
+    pa_context_subscribe_delta_cb_t subscribe_delta_callback;
+    void *subscribe_delta_userdata;
     pa_context_event_cb_t event_callback;
     void *event_userdata;
 
@@ -101,6 +111,8 @@ struct pa_context {
     bool memfd_on_local:1;
     bool server_specified:1;
     bool no_fail:1;
+    bool pipelined:1;
+    bool pipelined_stream_sent:1;
     bool do_autospawn:1;
     bool use_rtclock:1;
     bool filter_added:1;
@@ -183,8 +195,18 @@ struct pa_stream {
     /* playback */
     pa_memblock *write_memblock;
     void *write_data;
+    size_t write_length;
     int64_t latest_underrun_at_index;
 
+    /* Server owned blocks pa_stream_begin_write() hands out, if the server
+     * gave us any. write_ring_used is set while write_memblock is one of
+     * them. */
+    pa_memblock **write_ring;
+    uint8_t **write_ring_data;
+    unsigned n_write_ring, write_ring_current;
+    size_t write_ring_index;
+    bool write_ring_used:1;
+
     /* recording */
     pa_memchunk peek_memchunk;
     void *peek_data;
@@ -208,6 +230,11 @@ struct pa_stream {
     pa_time_event *auto_timing_update_event;
     pa_usec_t auto_timing_interval_usec;
 
+    /* Our slot in the context's timing page or PA_INVALID_INDEX, and the
+     * timestamp of the last timing info read from it */
+    uint32_t timing_slot;
+    pa_usec_t timing_page_timestamp;
+
     pa_smoother *smoother;
 
     /* Callbacks */
@@ -277,6 +304,7 @@ void pa_context_fail(pa_context *c, int error);
 int pa_context_set_error(const pa_context *c, int error);
 void pa_context_set_state(pa_context *c, pa_context_state_t st);
 int pa_context_handle_error(pa_context *c, uint32_t command, pa_tagstruct *t, bool fail);
+void pa_context_drop_write_ring_pending(pa_context *c);
 pa_operation* pa_context_send_simple_command(pa_context *c, uint32_t command, void (*internal_callback)(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata), void (*cb)(void), void *userdata);
 
 void pa_stream_set_state(pa_stream *s, pa_stream_state_t st);
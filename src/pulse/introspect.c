@@ -133,144 +133,157 @@ pa_operation* pa_context_get_server_info(pa_context *c, pa_server_info_cb_t cb,
 
 /*** Sink Info ***/
 
-static void context_get_sink_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
-    pa_operation *o = userdata;
-    int eol = 1;
-    pa_sink_info i;
+static void sink_info_free(pa_sink_info *i) {
     uint32_t j;
 
-    pa_assert(pd);
-    pa_assert(o);
-    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+    if (i->formats) {
+        for (j = 0; j < i->n_formats; j++)
+            pa_format_info_free(i->formats[j]);
+        pa_xfree(i->formats);
+    }
+    if (i->ports) {
+        pa_xfree(i->ports[0]);
+        pa_xfree(i->ports);
+    }
+    if (i->proplist)
+        pa_proplist_free(i->proplist);
+}
 
-    /* For safety in case someone use fail: outside the while loop below */
-    pa_zero(i);
+/* Parses one sink entry. Entries omitted via the fields mask are left
+ * empty. On failure the caller still has to call sink_info_free(). */
+static int sink_info_parse(pa_context *c, pa_tagstruct *t, uint32_t fields, pa_sink_info *i) {
+    bool mute;
+    uint32_t flags;
+    uint32_t state;
+    uint32_t j;
+    const char *ap = NULL;
+
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+    i->base_volume = PA_VOLUME_NORM;
+    i->n_volume_steps = PA_VOLUME_NORM+1;
+    mute = false;
+    state = PA_SINK_INVALID_STATE;
+    i->card = PA_INVALID_INDEX;
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_gets(t, &i->description) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i->sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i->channel_map) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_get_cvolume(t, &i->volume) < 0 ||
+        pa_tagstruct_get_boolean(t, &mute) < 0 ||
+        pa_tagstruct_getu32(t, &i->monitor_source) < 0 ||
+        pa_tagstruct_gets(t, &i->monitor_source_name) < 0 ||
+        pa_tagstruct_get_usec(t, &i->latency) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        pa_tagstruct_getu32(t, &flags) < 0 ||
+        (c->version >= 13 &&
+         (((fields & PA_SNAPSHOT_PROPLISTS) && pa_tagstruct_get_proplist(t, i->proplist) < 0) ||
+          pa_tagstruct_get_usec(t, &i->configured_latency) < 0)) ||
+        (c->version >= 15 &&
+         (pa_tagstruct_get_volume(t, &i->base_volume) < 0 ||
+          pa_tagstruct_getu32(t, &state) < 0 ||
+          pa_tagstruct_getu32(t, &i->n_volume_steps) < 0 ||
+          pa_tagstruct_getu32(t, &i->card) < 0)) ||
+        (c->version >= 16 && (fields & PA_SNAPSHOT_PORTS) &&
+         (pa_tagstruct_getu32(t, &i->n_ports)))) {
+
+        return -1;
+    }
 
-    if (!o->context)
-        goto finish;
+    if (c->version >= 16 && (fields & PA_SNAPSHOT_PORTS)) {
+        if (i->n_ports > 0) {
+            i->ports = pa_xnew(pa_sink_port_info*, i->n_ports+1);
+            i->ports[0] = pa_xnew(pa_sink_port_info, i->n_ports);
 
-    if (command != PA_COMMAND_REPLY) {
-        if (pa_context_handle_error(o->context, command, t, false) < 0)
-            goto finish;
+            for (j = 0; j < i->n_ports; j++) {
+                i->ports[j] = &i->ports[0][j];
 
-        eol = -1;
-    } else {
+                if (pa_tagstruct_gets(t, &i->ports[j]->name) < 0 ||
+                    pa_tagstruct_gets(t, &i->ports[j]->description) < 0 ||
+                    pa_tagstruct_getu32(t, &i->ports[j]->priority) < 0) {
 
-        while (!pa_tagstruct_eof(t)) {
-            bool mute;
-            uint32_t flags;
-            uint32_t state;
-            const char *ap = NULL;
+                    return -1;
+                }
 
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.base_volume = PA_VOLUME_NORM;
-            i.n_volume_steps = PA_VOLUME_NORM+1;
-            mute = false;
-            state = PA_SINK_INVALID_STATE;
-            i.card = PA_INVALID_INDEX;
+                i->ports[j]->available = PA_PORT_AVAILABLE_UNKNOWN;
+                if (c->version >= 24) {
+                    uint32_t av;
+                    if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
+                        return -1;
+                    i->ports[j]->available = av;
+                }
+            }
 
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_gets(t, &i.description) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                pa_tagstruct_get_boolean(t, &mute) < 0 ||
-                pa_tagstruct_getu32(t, &i.monitor_source) < 0 ||
-                pa_tagstruct_gets(t, &i.monitor_source_name) < 0 ||
-                pa_tagstruct_get_usec(t, &i.latency) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                pa_tagstruct_getu32(t, &flags) < 0 ||
-                (o->context->version >= 13 &&
-                 (pa_tagstruct_get_proplist(t, i.proplist) < 0 ||
-                  pa_tagstruct_get_usec(t, &i.configured_latency) < 0)) ||
-                (o->context->version >= 15 &&
-                 (pa_tagstruct_get_volume(t, &i.base_volume) < 0 ||
-                  pa_tagstruct_getu32(t, &state) < 0 ||
-                  pa_tagstruct_getu32(t, &i.n_volume_steps) < 0 ||
-                  pa_tagstruct_getu32(t, &i.card) < 0)) ||
-                (o->context->version >= 16 &&
-                 (pa_tagstruct_getu32(t, &i.n_ports)))) {
+            i->ports[j] = NULL;
+        }
 
-                goto fail;
-            }
+        if (pa_tagstruct_gets(t, &ap) < 0)
+            return -1;
 
-            if (o->context->version >= 16) {
-                if (i.n_ports > 0) {
-                    i.ports = pa_xnew(pa_sink_port_info*, i.n_ports+1);
-                    i.ports[0] = pa_xnew(pa_sink_port_info, i.n_ports);
+        if (ap) {
+            for (j = 0; j < i->n_ports; j++)
+                if (pa_streq(i->ports[j]->name, ap)) {
+                    i->active_port = i->ports[j];
+                    break;
+                }
+        }
+    }
 
-                    for (j = 0; j < i.n_ports; j++) {
-                        i.ports[j] = &i.ports[0][j];
+    if (c->version >= 21 && (fields & PA_SNAPSHOT_FORMATS)) {
+        uint8_t n_formats;
+        if (pa_tagstruct_getu8(t, &n_formats) < 0 || n_formats < 1)
+            return -1;
 
-                        if (pa_tagstruct_gets(t, &i.ports[j]->name) < 0 ||
-                            pa_tagstruct_gets(t, &i.ports[j]->description) < 0 ||
-                            pa_tagstruct_getu32(t, &i.ports[j]->priority) < 0) {
+        i->formats = pa_xnew0(pa_format_info*, n_formats);
 
-                            goto fail;
-                        }
+        for (j = 0; j < n_formats; j++) {
+            i->n_formats++;
+            i->formats[j] = pa_format_info_new();
 
-                        i.ports[j]->available = PA_PORT_AVAILABLE_UNKNOWN;
-                        if (o->context->version >= 24) {
-                            uint32_t av;
-                            if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
-                                goto fail;
-                            i.ports[j]->available = av;
-                        }
-                    }
+            if (pa_tagstruct_get_format_info(t, i->formats[j]) < 0)
+                return -1;
+        }
+    }
 
-                    i.ports[j] = NULL;
-                }
+    i->mute = (int) mute;
+    i->flags = (pa_sink_flags_t) flags;
+    i->state = (pa_sink_state_t) state;
 
-                if (pa_tagstruct_gets(t, &ap) < 0)
-                    goto fail;
+    return 0;
+}
 
-                if (ap) {
-                    for (j = 0; j < i.n_ports; j++)
-                        if (pa_streq(i.ports[j]->name, ap)) {
-                            i.active_port = i.ports[j];
-                            break;
-                        }
-                }
-            }
+static void context_get_sink_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    int eol = 1;
+    pa_sink_info i;
 
-            if (o->context->version >= 21) {
-                uint8_t n_formats;
-                if (pa_tagstruct_getu8(t, &n_formats) < 0 || n_formats < 1)
-                    goto fail;
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
 
-                i.formats = pa_xnew0(pa_format_info*, n_formats);
+    if (!o->context)
+        goto finish;
 
-                for (j = 0; j < n_formats; j++) {
-                    i.n_formats++;
-                    i.formats[j] = pa_format_info_new();
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, false) < 0)
+            goto finish;
 
-                    if (pa_tagstruct_get_format_info(t, i.formats[j]) < 0)
-                        goto fail;
-                }
-            }
+        eol = -1;
+    } else {
 
-            i.mute = (int) mute;
-            i.flags = (pa_sink_flags_t) flags;
-            i.state = (pa_sink_state_t) state;
+        while (!pa_tagstruct_eof(t)) {
+            if (sink_info_parse(o->context, t, PA_SNAPSHOT_ALL, &i) < 0)
+                goto fail;
 
             if (o->callback) {
                 pa_sink_info_cb_t cb = (pa_sink_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
             }
 
-            if (i.formats) {
-                for (j = 0; j < i.n_formats; j++)
-                    pa_format_info_free(i.formats[j]);
-                pa_xfree(i.formats);
-            }
-            if (i.ports) {
-                pa_xfree(i.ports[0]);
-                pa_xfree(i.ports);
-            }
-            pa_proplist_free(i.proplist);
+            sink_info_free(&i);
         }
     }
 
@@ -285,21 +298,8 @@ finish:
     return;
 
 fail:
-    pa_assert(i.proplist);
-
     pa_context_fail(o->context, PA_ERR_PROTOCOL);
-
-    if (i.formats) {
-        for (j = 0; j < i.n_formats; j++)
-            pa_format_info_free(i.formats[j]);
-        pa_xfree(i.formats);
-    }
-    if (i.ports) {
-        pa_xfree(i.ports[0]);
-        pa_xfree(i.ports);
-    }
-    pa_proplist_free(i.proplist);
-
+    sink_info_free(&i);
     goto finish;
 }
 
@@ -406,144 +406,157 @@ pa_operation* pa_context_set_sink_port_by_name(pa_context *c, const char *name,
 
 /*** Source info ***/
 
-static void context_get_source_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
-    pa_operation *o = userdata;
-    int eol = 1;
-    pa_source_info i;
+static void source_info_free(pa_source_info *i) {
     uint32_t j;
 
-    pa_assert(pd);
-    pa_assert(o);
-    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+    if (i->formats) {
+        for (j = 0; j < i->n_formats; j++)
+            pa_format_info_free(i->formats[j]);
+        pa_xfree(i->formats);
+    }
+    if (i->ports) {
+        pa_xfree(i->ports[0]);
+        pa_xfree(i->ports);
+    }
+    if (i->proplist)
+        pa_proplist_free(i->proplist);
+}
 
-    /* For safety in case someone use fail: outside the while loop below */
-    pa_zero(i);
+/* Parses one source entry. Entries omitted via the fields mask are left
+ * empty. On failure the caller still has to call source_info_free(). */
+static int source_info_parse(pa_context *c, pa_tagstruct *t, uint32_t fields, pa_source_info *i) {
+    bool mute;
+    uint32_t flags;
+    uint32_t state;
+    uint32_t j;
+    const char *ap = NULL;
+
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+    i->base_volume = PA_VOLUME_NORM;
+    i->n_volume_steps = PA_VOLUME_NORM+1;
+    mute = false;
+    state = PA_SOURCE_INVALID_STATE;
+    i->card = PA_INVALID_INDEX;
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_gets(t, &i->description) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i->sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i->channel_map) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_get_cvolume(t, &i->volume) < 0 ||
+        pa_tagstruct_get_boolean(t, &mute) < 0 ||
+        pa_tagstruct_getu32(t, &i->monitor_of_sink) < 0 ||
+        pa_tagstruct_gets(t, &i->monitor_of_sink_name) < 0 ||
+        pa_tagstruct_get_usec(t, &i->latency) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        pa_tagstruct_getu32(t, &flags) < 0 ||
+        (c->version >= 13 &&
+         (((fields & PA_SNAPSHOT_PROPLISTS) && pa_tagstruct_get_proplist(t, i->proplist) < 0) ||
+          pa_tagstruct_get_usec(t, &i->configured_latency) < 0)) ||
+        (c->version >= 15 &&
+         (pa_tagstruct_get_volume(t, &i->base_volume) < 0 ||
+          pa_tagstruct_getu32(t, &state) < 0 ||
+          pa_tagstruct_getu32(t, &i->n_volume_steps) < 0 ||
+          pa_tagstruct_getu32(t, &i->card) < 0)) ||
+        (c->version >= 16 && (fields & PA_SNAPSHOT_PORTS) &&
+         (pa_tagstruct_getu32(t, &i->n_ports)))) {
+
+        return -1;
+    }
 
-    if (!o->context)
-        goto finish;
+    if (c->version >= 16 && (fields & PA_SNAPSHOT_PORTS)) {
+        if (i->n_ports > 0) {
+            i->ports = pa_xnew(pa_source_port_info*, i->n_ports+1);
+            i->ports[0] = pa_xnew(pa_source_port_info, i->n_ports);
 
-    if (command != PA_COMMAND_REPLY) {
-        if (pa_context_handle_error(o->context, command, t, false) < 0)
-            goto finish;
+            for (j = 0; j < i->n_ports; j++) {
+                i->ports[j] = &i->ports[0][j];
 
-        eol = -1;
-    } else {
+                if (pa_tagstruct_gets(t, &i->ports[j]->name) < 0 ||
+                    pa_tagstruct_gets(t, &i->ports[j]->description) < 0 ||
+                    pa_tagstruct_getu32(t, &i->ports[j]->priority) < 0) {
 
-        while (!pa_tagstruct_eof(t)) {
-            bool mute;
-            uint32_t flags;
-            uint32_t state;
-            const char *ap;
+                    return -1;
+                }
 
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.base_volume = PA_VOLUME_NORM;
-            i.n_volume_steps = PA_VOLUME_NORM+1;
-            mute = false;
-            state = PA_SOURCE_INVALID_STATE;
-            i.card = PA_INVALID_INDEX;
+                i->ports[j]->available = PA_PORT_AVAILABLE_UNKNOWN;
+                if (c->version >= 24) {
+                    uint32_t av;
+                    if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
+                        return -1;
+                    i->ports[j]->available = av;
+                }
+            }
 
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_gets(t, &i.description) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                pa_tagstruct_get_boolean(t, &mute) < 0 ||
-                pa_tagstruct_getu32(t, &i.monitor_of_sink) < 0 ||
-                pa_tagstruct_gets(t, &i.monitor_of_sink_name) < 0 ||
-                pa_tagstruct_get_usec(t, &i.latency) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                pa_tagstruct_getu32(t, &flags) < 0 ||
-                (o->context->version >= 13 &&
-                 (pa_tagstruct_get_proplist(t, i.proplist) < 0 ||
-                  pa_tagstruct_get_usec(t, &i.configured_latency) < 0)) ||
-                (o->context->version >= 15 &&
-                 (pa_tagstruct_get_volume(t, &i.base_volume) < 0 ||
-                  pa_tagstruct_getu32(t, &state) < 0 ||
-                  pa_tagstruct_getu32(t, &i.n_volume_steps) < 0 ||
-                  pa_tagstruct_getu32(t, &i.card) < 0)) ||
-                (o->context->version >= 16 &&
-                 (pa_tagstruct_getu32(t, &i.n_ports)))) {
+            i->ports[j] = NULL;
+        }
 
-                goto fail;
-            }
+        if (pa_tagstruct_gets(t, &ap) < 0)
+            return -1;
 
-            if (o->context->version >= 16) {
-                if (i.n_ports > 0) {
-                    i.ports = pa_xnew(pa_source_port_info*, i.n_ports+1);
-                    i.ports[0] = pa_xnew(pa_source_port_info, i.n_ports);
+        if (ap) {
+            for (j = 0; j < i->n_ports; j++)
+                if (pa_streq(i->ports[j]->name, ap)) {
+                    i->active_port = i->ports[j];
+                    break;
+                }
+        }
+    }
 
-                    for (j = 0; j < i.n_ports; j++) {
-                        i.ports[j] = &i.ports[0][j];
+    if (c->version >= 22 && (fields & PA_SNAPSHOT_FORMATS)) {
+        uint8_t n_formats;
+        if (pa_tagstruct_getu8(t, &n_formats) < 0 || n_formats < 1)
+            return -1;
 
-                        if (pa_tagstruct_gets(t, &i.ports[j]->name) < 0 ||
-                            pa_tagstruct_gets(t, &i.ports[j]->description) < 0 ||
-                            pa_tagstruct_getu32(t, &i.ports[j]->priority) < 0) {
+        i->formats = pa_xnew0(pa_format_info*, n_formats);
 
-                            goto fail;
-                        }
+        for (j = 0; j < n_formats; j++) {
+            i->n_formats++;
+            i->formats[j] = pa_format_info_new();
 
-                        i.ports[j]->available = PA_PORT_AVAILABLE_UNKNOWN;
-                        if (o->context->version >= 24) {
-                            uint32_t av;
-                            if (pa_tagstruct_getu32(t, &av) < 0 || av > PA_PORT_AVAILABLE_YES)
-                                goto fail;
-                            i.ports[j]->available = av;
-                        }
-                    }
+            if (pa_tagstruct_get_format_info(t, i->formats[j]) < 0)
+                return -1;
+        }
+    }
 
-                    i.ports[j] = NULL;
-                }
+    i->mute = (int) mute;
+    i->flags = (pa_source_flags_t) flags;
+    i->state = (pa_source_state_t) state;
 
-                if (pa_tagstruct_gets(t, &ap) < 0)
-                    goto fail;
+    return 0;
+}
 
-                if (ap) {
-                    for (j = 0; j < i.n_ports; j++)
-                        if (pa_streq(i.ports[j]->name, ap)) {
-                            i.active_port = i.ports[j];
-                            break;
-                        }
-                }
-            }
+static void context_get_source_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    int eol = 1;
+    pa_source_info i;
 
-            if (o->context->version >= 22) {
-                uint8_t n_formats;
-                if (pa_tagstruct_getu8(t, &n_formats) < 0 || n_formats < 1)
-                    goto fail;
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
 
-                i.formats = pa_xnew0(pa_format_info*, n_formats);
+    if (!o->context)
+        goto finish;
 
-                for (j = 0; j < n_formats; j++) {
-                    i.n_formats++;
-                    i.formats[j] = pa_format_info_new();
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, false) < 0)
+            goto finish;
 
-                    if (pa_tagstruct_get_format_info(t, i.formats[j]) < 0)
-                        goto fail;
-                }
-            }
+        eol = -1;
+    } else {
 
-            i.mute = (int) mute;
-            i.flags = (pa_source_flags_t) flags;
-            i.state = (pa_source_state_t) state;
+        while (!pa_tagstruct_eof(t)) {
+            if (source_info_parse(o->context, t, PA_SNAPSHOT_ALL, &i) < 0)
+                goto fail;
 
             if (o->callback) {
                 pa_source_info_cb_t cb = (pa_source_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
             }
 
-            if (i.formats) {
-                for (j = 0; j < i.n_formats; j++)
-                    pa_format_info_free(i.formats[j]);
-                pa_xfree(i.formats);
-            }
-            if (i.ports) {
-                pa_xfree(i.ports[0]);
-                pa_xfree(i.ports);
-            }
-            pa_proplist_free(i.proplist);
+            source_info_free(&i);
         }
     }
 
@@ -558,21 +571,8 @@ finish:
     return;
 
 fail:
-    pa_assert(i.proplist);
-
     pa_context_fail(o->context, PA_ERR_PROTOCOL);
-
-    if (i.formats) {
-        for (j = 0; j < i.n_formats; j++)
-            pa_format_info_free(i.formats[j]);
-        pa_xfree(i.formats);
-    }
-    if (i.ports) {
-        pa_xfree(i.ports[0]);
-        pa_xfree(i.ports);
-    }
-    pa_proplist_free(i.proplist);
-
+    source_info_free(&i);
     goto finish;
 }
 
@@ -679,6 +679,25 @@ pa_operation* pa_context_set_source_port_by_name(pa_context *c, const char *name
 
 /*** Client info ***/
 
+static void client_info_free(pa_client_info *i) {
+    if (i->proplist)
+        pa_proplist_free(i->proplist);
+}
+
+static int client_info_parse(pa_context *c, pa_tagstruct *t, uint32_t fields, pa_client_info *i) {
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        (c->version >= 13 && (fields & PA_SNAPSHOT_PROPLISTS) && pa_tagstruct_get_proplist(t, i->proplist) < 0))
+        return -1;
+
+    return 0;
+}
+
 static void context_get_client_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -700,17 +719,9 @@ static void context_get_client_info_callback(pa_pdispatch *pd, uint32_t command,
         while (!pa_tagstruct_eof(t)) {
             pa_client_info i;
 
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                (o->context->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0)) {
-
+            if (client_info_parse(o->context, t, PA_SNAPSHOT_ALL, &i) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
-                pa_proplist_free(i.proplist);
+                client_info_free(&i);
                 goto finish;
             }
 
@@ -719,7 +730,7 @@ static void context_get_client_info_callback(pa_pdispatch *pd, uint32_t command,
                 cb(o->context, &i, 0, o->userdata);
             }
 
-            pa_proplist_free(i.proplist);
+            client_info_free(&i);
         }
     }
 
@@ -796,7 +807,7 @@ static void card_info_free(pa_card_info* i) {
     }
 }
 
-static int fill_card_port_info(pa_context *context, pa_tagstruct* t, pa_card_info* i) {
+static int fill_card_port_info(pa_context *context, pa_tagstruct* t, uint32_t fields, pa_card_info* i) {
     uint32_t j, k, l;
 
     if (pa_tagstruct_getu32(t, &i->n_ports) < 0)
@@ -823,7 +834,7 @@ static int fill_card_port_info(pa_context *context, pa_tagstruct* t, pa_card_inf
             pa_tagstruct_getu32(t, &available) < 0 ||
             pa_tagstruct_getu8(t, &direction) < 0 ||
             !pa_direction_valid(direction) ||
-            pa_tagstruct_get_proplist(t, port->proplist) < 0 ||
+            ((fields & PA_SNAPSHOT_PROPLISTS) && pa_tagstruct_get_proplist(t, port->proplist) < 0) ||
             pa_tagstruct_getu32(t, &port->n_profiles) < 0) {
 
             return -PA_ERR_PROTOCOL;
@@ -903,6 +914,47 @@ static int fill_card_profile_info(pa_context *context, pa_tagstruct* t, pa_card_
     return 0;
 }
 
+static int card_info_parse(pa_context *c, pa_tagstruct *t, uint32_t fields, pa_card_info *i) {
+    uint32_t j;
+    const char*ap;
+
+    pa_zero(*i);
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        pa_tagstruct_getu32(t, &i->n_profiles) < 0)
+            return -1;
+
+    if (i->n_profiles > 0) {
+        if (fill_card_profile_info(c, t, i) < 0)
+            return -1;
+    }
+
+    i->proplist = pa_proplist_new();
+
+    if (pa_tagstruct_gets(t, &ap) < 0 ||
+        ((fields & PA_SNAPSHOT_PROPLISTS) && pa_tagstruct_get_proplist(t, i->proplist) < 0))
+        return -1;
+
+    if (ap) {
+        for (j = 0; j < i->n_profiles; j++)
+            if (pa_streq(i->profiles[j].name, ap)) {
+                i->active_profile = &i->profiles[j];
+                i->active_profile2 = i->profiles2[j];
+                break;
+            }
+    }
+
+    if (c->version >= 26 && (fields & PA_SNAPSHOT_PORTS)) {
+        if (fill_card_port_info(c, t, fields, i) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
 static void context_get_card_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -923,46 +975,8 @@ static void context_get_card_info_callback(pa_pdispatch *pd, uint32_t command, u
     } else {
 
         while (!pa_tagstruct_eof(t)) {
-            uint32_t j;
-            const char*ap;
-
-            pa_zero(i);
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                pa_tagstruct_getu32(t, &i.n_profiles) < 0)
-                    goto fail;
-
-            if (i.n_profiles > 0) {
-                if (fill_card_profile_info(o->context, t, &i) < 0)
-                    goto fail;
-            }
-
-            i.proplist = pa_proplist_new();
-
-            if (pa_tagstruct_gets(t, &ap) < 0 ||
-                pa_tagstruct_get_proplist(t, i.proplist) < 0) {
-
-                pa_context_fail(o->context, PA_ERR_PROTOCOL);
-                card_info_free(&i);
-                goto finish;
-            }
-
-            if (ap) {
-                for (j = 0; j < i.n_profiles; j++)
-                    if (pa_streq(i.profiles[j].name, ap)) {
-                        i.active_profile = &i.profiles[j];
-                        i.active_profile2 = i.profiles2[j];
-                        break;
-                    }
-            }
-
-            if (o->context->version >= 26) {
-                if (fill_card_port_info(o->context, t, &i) < 0)
-                    goto fail;
-            }
+            if (card_info_parse(o->context, t, PA_SNAPSHOT_ALL, &i) < 0)
+                goto fail;
 
             if (o->callback) {
                 pa_card_info_cb_t cb = (pa_card_info_cb_t) o->callback;
@@ -1097,6 +1111,30 @@ pa_operation* pa_context_set_card_profile_by_name(pa_context *c, const char *nam
 
 /*** Module info ***/
 
+static void module_info_free(pa_module_info *i) {
+    if (i->proplist)
+        pa_proplist_free(i->proplist);
+}
+
+static int module_info_parse(pa_context *c, pa_tagstruct *t, uint32_t fields, pa_module_info *i) {
+    bool auto_unload = false;
+
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_gets(t, &i->argument) < 0 ||
+        pa_tagstruct_getu32(t, &i->n_used) < 0 ||
+        (c->version < 15 && pa_tagstruct_get_boolean(t, &auto_unload) < 0) ||
+        (c->version >= 15 && (fields & PA_SNAPSHOT_PROPLISTS) && pa_tagstruct_get_proplist(t, i->proplist) < 0))
+        return -1;
+
+    i->auto_unload = (int) auto_unload;
+
+    return 0;
+}
+
 static void context_get_module_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -1117,29 +1155,19 @@ static void context_get_module_info_callback(pa_pdispatch *pd, uint32_t command,
 
         while (!pa_tagstruct_eof(t)) {
             pa_module_info i;
-            bool auto_unload = false;
 
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_gets(t, &i.argument) < 0 ||
-                pa_tagstruct_getu32(t, &i.n_used) < 0 ||
-                (o->context->version < 15 && pa_tagstruct_get_boolean(t, &auto_unload) < 0) ||
-                (o->context->version >= 15 && pa_tagstruct_get_proplist(t, i.proplist) < 0)) {
+            if (module_info_parse(o->context, t, PA_SNAPSHOT_ALL, &i) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                module_info_free(&i);
                 goto finish;
             }
 
-            i.auto_unload = (int) auto_unload;
-
             if (o->callback) {
                 pa_module_info_cb_t cb = (pa_module_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
             }
 
-            pa_proplist_free(i.proplist);
+            module_info_free(&i);
         }
     }
 
@@ -1182,6 +1210,48 @@ pa_operation* pa_context_get_module_info_list(pa_context *c, pa_module_info_cb_t
 
 /*** Sink input info ***/
 
+static void sink_input_info_free(pa_sink_input_info *i) {
+    if (i->proplist)
+        pa_proplist_free(i->proplist);
+    if (i->format)
+        pa_format_info_free(i->format);
+}
+
+static int sink_input_info_parse(pa_context *c, pa_tagstruct *t, uint32_t fields, pa_sink_input_info *i) {
+    bool mute = false, corked = false, has_volume = false, volume_writable = true;
+
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+    i->format = pa_format_info_new();
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_getu32(t, &i->client) < 0 ||
+        pa_tagstruct_getu32(t, &i->sink) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i->sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i->channel_map) < 0 ||
+        pa_tagstruct_get_cvolume(t, &i->volume) < 0 ||
+        pa_tagstruct_get_usec(t, &i->buffer_usec) < 0 ||
+        pa_tagstruct_get_usec(t, &i->sink_usec) < 0 ||
+        pa_tagstruct_gets(t, &i->resample_method) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        (c->version >= 11 && pa_tagstruct_get_boolean(t, &mute) < 0) ||
+        (c->version >= 13 && (fields & PA_SNAPSHOT_PROPLISTS) && pa_tagstruct_get_proplist(t, i->proplist) < 0) ||
+        (c->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
+        (c->version >= 20 && (pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
+                              pa_tagstruct_get_boolean(t, &volume_writable) < 0)) ||
+        (c->version >= 21 && (fields & PA_SNAPSHOT_FORMATS) && pa_tagstruct_get_format_info(t, i->format) < 0))
+        return -1;
+
+    i->mute = (int) mute;
+    i->corked = (int) corked;
+    i->has_volume = (int) has_volume;
+    i->volume_writable = (int) volume_writable;
+
+    return 0;
+}
+
 static void context_get_sink_input_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -1202,49 +1272,19 @@ static void context_get_sink_input_info_callback(pa_pdispatch *pd, uint32_t comm
 
         while (!pa_tagstruct_eof(t)) {
             pa_sink_input_info i;
-            bool mute = false, corked = false, has_volume = false, volume_writable = true;
-
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.format = pa_format_info_new();
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_getu32(t, &i.client) < 0 ||
-                pa_tagstruct_getu32(t, &i.sink) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                pa_tagstruct_get_usec(t, &i.buffer_usec) < 0 ||
-                pa_tagstruct_get_usec(t, &i.sink_usec) < 0 ||
-                pa_tagstruct_gets(t, &i.resample_method) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                (o->context->version >= 11 && pa_tagstruct_get_boolean(t, &mute) < 0) ||
-                (o->context->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0) ||
-                (o->context->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
-                (o->context->version >= 20 && (pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &volume_writable) < 0)) ||
-                (o->context->version >= 21 && pa_tagstruct_get_format_info(t, i.format) < 0)) {
 
+            if (sink_input_info_parse(o->context, t, PA_SNAPSHOT_ALL, &i) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
-                pa_proplist_free(i.proplist);
-                pa_format_info_free(i.format);
+                sink_input_info_free(&i);
                 goto finish;
             }
 
-            i.mute = (int) mute;
-            i.corked = (int) corked;
-            i.has_volume = (int) has_volume;
-            i.volume_writable = (int) volume_writable;
-
             if (o->callback) {
                 pa_sink_input_info_cb_t cb = (pa_sink_input_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
             }
 
-            pa_proplist_free(i.proplist);
-            pa_format_info_free(i.format);
+            sink_input_info_free(&i);
         }
     }
 
@@ -1287,6 +1327,48 @@ pa_operation* pa_context_get_sink_input_info_list(pa_context *c, void (*cb)(pa_c
 
 /*** Source output info ***/
 
+static void source_output_info_free(pa_source_output_info *i) {
+    if (i->proplist)
+        pa_proplist_free(i->proplist);
+    if (i->format)
+        pa_format_info_free(i->format);
+}
+
+static int source_output_info_parse(pa_context *c, pa_tagstruct *t, uint32_t fields, pa_source_output_info *i) {
+    bool mute = false, corked = false, has_volume = false, volume_writable = true;
+
+    pa_zero(*i);
+    i->proplist = pa_proplist_new();
+    i->format = pa_format_info_new();
+
+    if (pa_tagstruct_getu32(t, &i->index) < 0 ||
+        pa_tagstruct_gets(t, &i->name) < 0 ||
+        pa_tagstruct_getu32(t, &i->owner_module) < 0 ||
+        pa_tagstruct_getu32(t, &i->client) < 0 ||
+        pa_tagstruct_getu32(t, &i->source) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &i->sample_spec) < 0 ||
+        pa_tagstruct_get_channel_map(t, &i->channel_map) < 0 ||
+        pa_tagstruct_get_usec(t, &i->buffer_usec) < 0 ||
+        pa_tagstruct_get_usec(t, &i->source_usec) < 0 ||
+        pa_tagstruct_gets(t, &i->resample_method) < 0 ||
+        pa_tagstruct_gets(t, &i->driver) < 0 ||
+        (c->version >= 13 && (fields & PA_SNAPSHOT_PROPLISTS) && pa_tagstruct_get_proplist(t, i->proplist) < 0) ||
+        (c->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
+        (c->version >= 22 && (pa_tagstruct_get_cvolume(t, &i->volume) < 0 ||
+                              pa_tagstruct_get_boolean(t, &mute) < 0 ||
+                              pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
+                              pa_tagstruct_get_boolean(t, &volume_writable) < 0 ||
+                              ((fields & PA_SNAPSHOT_FORMATS) && pa_tagstruct_get_format_info(t, i->format) < 0))))
+        return -1;
+
+    i->mute = (int) mute;
+    i->corked = (int) corked;
+    i->has_volume = (int) has_volume;
+    i->volume_writable = (int) volume_writable;
+
+    return 0;
+}
+
 static void context_get_source_output_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     int eol = 1;
@@ -1307,49 +1389,19 @@ static void context_get_source_output_info_callback(pa_pdispatch *pd, uint32_t c
 
         while (!pa_tagstruct_eof(t)) {
             pa_source_output_info i;
-            bool mute = false, corked = false, has_volume = false, volume_writable = true;
-
-            pa_zero(i);
-            i.proplist = pa_proplist_new();
-            i.format = pa_format_info_new();
-
-            if (pa_tagstruct_getu32(t, &i.index) < 0 ||
-                pa_tagstruct_gets(t, &i.name) < 0 ||
-                pa_tagstruct_getu32(t, &i.owner_module) < 0 ||
-                pa_tagstruct_getu32(t, &i.client) < 0 ||
-                pa_tagstruct_getu32(t, &i.source) < 0 ||
-                pa_tagstruct_get_sample_spec(t, &i.sample_spec) < 0 ||
-                pa_tagstruct_get_channel_map(t, &i.channel_map) < 0 ||
-                pa_tagstruct_get_usec(t, &i.buffer_usec) < 0 ||
-                pa_tagstruct_get_usec(t, &i.source_usec) < 0 ||
-                pa_tagstruct_gets(t, &i.resample_method) < 0 ||
-                pa_tagstruct_gets(t, &i.driver) < 0 ||
-                (o->context->version >= 13 && pa_tagstruct_get_proplist(t, i.proplist) < 0) ||
-                (o->context->version >= 19 && pa_tagstruct_get_boolean(t, &corked) < 0) ||
-                (o->context->version >= 22 && (pa_tagstruct_get_cvolume(t, &i.volume) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &mute) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &has_volume) < 0 ||
-                                               pa_tagstruct_get_boolean(t, &volume_writable) < 0 ||
-                                               pa_tagstruct_get_format_info(t, i.format) < 0))) {
 
+            if (source_output_info_parse(o->context, t, PA_SNAPSHOT_ALL, &i) < 0) {
                 pa_context_fail(o->context, PA_ERR_PROTOCOL);
-                pa_proplist_free(i.proplist);
-                pa_format_info_free(i.format);
+                source_output_info_free(&i);
                 goto finish;
             }
 
-            i.mute = (int) mute;
-            i.corked = (int) corked;
-            i.has_volume = (int) has_volume;
-            i.volume_writable = (int) volume_writable;
-
             if (o->callback) {
                 pa_source_output_info_cb_t cb = (pa_source_output_info_cb_t) o->callback;
                 cb(o->context, &i, 0, o->userdata);
             }
 
-            pa_proplist_free(i.proplist);
-            pa_format_info_free(i.format);
+            source_output_info_free(&i);
         }
     }
 
@@ -1390,6 +1442,187 @@ pa_operation* pa_context_get_source_output_info_list(pa_context *c,  pa_source_o
     return pa_context_send_simple_command(c, PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST, context_get_source_output_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+/*** Snapshot ***/
+
+/* Upper bound for the per-type object count in a snapshot reply, so that a
+ * bogus count cannot make us allocate unbounded memory before parsing. */
+#define SNAPSHOT_MAX_OBJECTS (64*1024)
+
+#define SNAPSHOT_PARSE(type, array, n)                                  \
+    do {                                                                \
+        if (pa_tagstruct_getu32(t, &(n)) < 0 || (n) > SNAPSHOT_MAX_OBJECTS) { \
+            (n) = 0;                                                    \
+            goto fail;                                                  \
+        }                                                               \
+        (array) = pa_xnew0(pa_##type##_info, (n) > 0 ? (n) : 1);        \
+        for (j = 0; j < (n); j++)                                       \
+            if (type##_info_parse(o->context, t, fields, &(array)[j]) < 0) { \
+                (n) = j + 1;                                            \
+                goto fail;                                              \
+            }                                                           \
+    } while (0)
+
+#define SNAPSHOT_FREE(type, array, n)                                   \
+    do {                                                                \
+        if (array) {                                                    \
+            for (j = 0; j < (n); j++)                                   \
+                type##_info_free(&(array)[j]);                          \
+            pa_xfree(array);                                            \
+        }                                                               \
+    } while (0)
+
+static void context_get_snapshot_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    pa_snapshot_info s, *p = NULL;
+    uint32_t fields, j;
+
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    pa_zero(s);
+
+    if (!o->context)
+        goto finish;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, false) < 0)
+            goto finish;
+
+    } else {
+        if (pa_tagstruct_getu32(t, &fields) < 0)
+            goto fail;
+
+        s.fields = (pa_snapshot_fields_t) fields;
+
+        SNAPSHOT_PARSE(sink, s.sinks, s.n_sinks);
+        SNAPSHOT_PARSE(source, s.sources, s.n_sources);
+        SNAPSHOT_PARSE(sink_input, s.sink_inputs, s.n_sink_inputs);
+        SNAPSHOT_PARSE(source_output, s.source_outputs, s.n_source_outputs);
+        SNAPSHOT_PARSE(client, s.clients, s.n_clients);
+        SNAPSHOT_PARSE(module, s.modules, s.n_modules);
+        SNAPSHOT_PARSE(card, s.cards, s.n_cards);
+
+        if (!pa_tagstruct_eof(t))
+            goto fail;
+
+        p = &s;
+    }
+
+    if (o->callback) {
+        pa_snapshot_info_cb_t cb = (pa_snapshot_info_cb_t) o->callback;
+        cb(o->context, p, o->userdata);
+    }
+
+    goto finish;
+
+fail:
+    pa_context_fail(o->context, PA_ERR_PROTOCOL);
+
+finish:
+    SNAPSHOT_FREE(sink, s.sinks, s.n_sinks);
+    SNAPSHOT_FREE(source, s.sources, s.n_sources);
+    SNAPSHOT_FREE(sink_input, s.sink_inputs, s.n_sink_inputs);
+    SNAPSHOT_FREE(source_output, s.source_outputs, s.n_source_outputs);
+    SNAPSHOT_FREE(client, s.clients, s.n_clients);
+    SNAPSHOT_FREE(module, s.modules, s.n_modules);
+    SNAPSHOT_FREE(card, s.cards, s.n_cards);
+
+    pa_operation_done(o);
+    pa_operation_unref(o);
+}
+
+#undef SNAPSHOT_PARSE
+#undef SNAPSHOT_FREE
+
+pa_operation* pa_context_get_snapshot(pa_context *c, pa_snapshot_fields_t fields, pa_snapshot_info_cb_t cb, void *userdata) {
+    pa_tagstruct *t;
+    pa_operation *o;
+    uint32_t tag;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+    pa_assert(cb);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, (fields & ~PA_SNAPSHOT_ALL) == 0, PA_ERR_INVALID);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 34, PA_ERR_NOTSUPPORTED);
+
+    o = pa_operation_new(c, NULL, (pa_operation_cb_t) cb, userdata);
+
+    t = pa_tagstruct_command(c, PA_COMMAND_GET_SNAPSHOT, &tag);
+    pa_tagstruct_putu32(t, (uint32_t) fields);
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_snapshot_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    return o;
+}
+
+/*** Messages ***/
+
+static void context_string_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    const char *response = NULL;
+    int success = 1;
+
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    if (!o->context)
+        goto finish;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, false) < 0)
+            goto finish;
+
+        success = 0;
+    } else if (pa_tagstruct_gets(t, &response) < 0 ||
+               !pa_tagstruct_eof(t)) {
+        pa_context_fail(o->context, PA_ERR_PROTOCOL);
+        goto finish;
+    }
+
+    if (o->callback) {
+        pa_context_string_cb_t cb = (pa_context_string_cb_t) o->callback;
+        char *r = pa_xstrdup(response);
+
+        cb(o->context, success, r, o->userdata);
+        pa_xfree(r);
+    }
+
+finish:
+    pa_operation_done(o);
+    pa_operation_unref(o);
+}
+
+pa_operation* pa_context_send_message_to_object(pa_context *c, const char *recipient_name, const char *message, const char *message_parameters, pa_context_string_cb_t cb, void *userdata) {
+    pa_operation *o;
+    pa_tagstruct *t;
+    uint32_t tag;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, recipient_name && recipient_name[0] == '/', PA_ERR_INVALID);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, message && *message, PA_ERR_INVALID);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 34, PA_ERR_NOTSUPPORTED);
+
+    o = pa_operation_new(c, NULL, (pa_operation_cb_t) cb, userdata);
+
+    t = pa_tagstruct_command(c, PA_COMMAND_SEND_OBJECT_MESSAGE, &tag);
+    pa_tagstruct_puts(t, recipient_name);
+    pa_tagstruct_puts(t, message);
+    pa_tagstruct_puts(t, message_parameters);
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_string_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    return o;
+}
+
 /*** Volume manipulation ***/
 
 pa_operation* pa_context_set_sink_volume_by_index(pa_context *c, uint32_t idx, const pa_cvolume *volume, pa_context_success_cb_t cb, void *userdata) {
@@ -134,6 +134,24 @@
  * either pa_context_get_client_info() or pa_context_get_client_info_list().
  * The information structure is called pa_client_info.
  *
+ * \subsection snapshot_subsec Snapshots
+ *
+ * Applications that poll the whole server state can use
+ * pa_context_get_snapshot() to fetch all sinks, sources, sink inputs, source
+ * outputs, clients, modules and cards in a single round trip. The fields
+ * mask allows skipping property lists, formats and ports that the
+ * application is not interested in. The information structure is called
+ * pa_snapshot_info.
+ *
+ * \subsection messages_subsec Messages
+ *
+ * Server objects can register a handler for an object path and accept
+ * messages in the form of a command string with optional parameters.
+ * pa_context_send_message_to_object() sends such a message and passes the
+ * response string to the callback. Sinks and sources, for example, answer
+ * the "get-io-stats" message on "/sink/<name>" and "/source/<name>" with
+ * the statistics of their IO thread.
+ *
  * \section ctrl_sec Control
  *
  * Some parts of the server are only possible to read, but most can also be
@@ -656,6 +674,62 @@ pa_operation* pa_context_kill_source_output(pa_context *c, uint32_t idx, pa_cont
 
 /** @} */
 
+/** @{ \name Snapshots */
+
+/** Optional parts of the objects in a snapshot. Parts that are not
+ * requested are not transferred and are left empty in the returned
+ * information structures. \since 14.0 */
+typedef enum pa_snapshot_fields {
+    PA_SNAPSHOT_PROPLISTS = 0x0001U,   /**< Include property lists */
+    PA_SNAPSHOT_FORMATS = 0x0002U,     /**< Include the supported or negotiated formats */
+    PA_SNAPSHOT_PORTS = 0x0004U,       /**< Include sink, source and card ports */
+    PA_SNAPSHOT_ALL = 0x0007U          /**< Include everything */
+} pa_snapshot_fields_t;
+
+/** Stores the complete server object graph as returned by
+ * pa_context_get_snapshot(). All pointers are only valid during the
+ * callback. Please note that this structure can be extended as part
+ * of evolutionary API updates at any time in any new release. \since 14.0 */
+typedef struct pa_snapshot_info {
+    pa_snapshot_fields_t fields;           /**< The optional parts that were included */
+    uint32_t n_sinks;                      /**< Number of entries in sinks */
+    pa_sink_info *sinks;                   /**< Array of sinks */
+    uint32_t n_sources;                    /**< Number of entries in sources */
+    pa_source_info *sources;               /**< Array of sources */
+    uint32_t n_sink_inputs;                /**< Number of entries in sink_inputs */
+    pa_sink_input_info *sink_inputs;       /**< Array of sink inputs */
+    uint32_t n_source_outputs;             /**< Number of entries in source_outputs */
+    pa_source_output_info *source_outputs; /**< Array of source outputs */
+    uint32_t n_clients;                    /**< Number of entries in clients */
+    pa_client_info *clients;               /**< Array of clients */
+    uint32_t n_modules;                    /**< Number of entries in modules */
+    pa_module_info *modules;               /**< Array of modules */
+    uint32_t n_cards;                      /**< Number of entries in cards */
+    pa_card_info *cards;                   /**< Array of cards */
+} pa_snapshot_info;
+
+/** Callback prototype for pa_context_get_snapshot(). The info pointer is NULL if the request failed. \since 14.0 */
+typedef void (*pa_snapshot_info_cb_t)(pa_context *c, const pa_snapshot_info *i, void *userdata);
+
+/** Get all sinks, sources, sink inputs, source outputs, clients, modules and
+ * cards in one reply. Only the optional parts selected in fields are
+ * transferred. \since 14.0 */
+pa_operation* pa_context_get_snapshot(pa_context *c, pa_snapshot_fields_t fields, pa_snapshot_info_cb_t cb, void *userdata);
+
+/** @} */
+
+/** @{ \name Messages */
+
+/** Callback prototype for pa_context_send_message_to_object(). The response
+ * is NULL if the request failed or the handler did not return anything. \since 14.0 */
+typedef void (*pa_context_string_cb_t)(pa_context *c, int success, char *response, void *userdata);
+
+/** Send a message to the object that registered the handler for
+ * recipient_name. message_parameters may be NULL. \since 14.0 */
+pa_operation* pa_context_send_message_to_object(pa_context *c, const char *recipient_name, const char *message, const char *message_parameters, pa_context_string_cb_t cb, void *userdata);
+
+/** @} */
+
 /** @{ \name Statistics */
 
 /** Memory block statistics. Please note that this structure
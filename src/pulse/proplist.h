@@ -234,6 +234,9 @@ PA_C_DECL_BEGIN
 /** For devices: fragment size in bytes, integer formatted as string. */
 #define PA_PROP_DEVICE_BUFFERING_FRAGMENT_SIZE "device.buffering.fragment_size"
 
+/** For devices: the CPUs the IO thread of the device is restricted to, in the format used by taskset(1), e.g. "2-3". Not set if the thread may run on any CPU. \since 14.0 */
+#define PA_PROP_DEVICE_IO_THREAD_CPUS          "device.io_thread.cpus"
+
 /** For devices: profile identifier for the profile this devices is in. E.g. "analog-stereo", "analog-surround-40", "iec958-stereo", ...*/
 #define PA_PROP_DEVICE_PROFILE_NAME            "device.profile.name"
 
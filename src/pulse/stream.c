@@ -52,6 +52,11 @@
 #define SMOOTHER_HISTORY_TIME (5000*PA_USEC_PER_MSEC)
 #define SMOOTHER_MIN_HISTORY (4)
 
+/* How often to retry reading a timing page slot the server is updating */
+#define TIMING_PAGE_RETRIES 8
+
+static bool stream_read_timing_page(pa_stream *s);
+
 pa_stream *pa_stream_new(pa_context *c, const char *name, const pa_sample_spec *ss, const pa_channel_map *map) {
     return pa_stream_new_with_proplist(c, name, ss, map, NULL);
 }
@@ -172,6 +177,13 @@ static pa_stream *pa_stream_new_with_proplist_internal(
 
     s->write_memblock = NULL;
     s->write_data = NULL;
+    s->write_length = 0;
+
+    s->write_ring = NULL;
+    s->write_ring_data = NULL;
+    s->n_write_ring = s->write_ring_current = 0;
+    s->write_ring_index = 0;
+    s->write_ring_used = false;
 
     pa_memchunk_reset(&s->peek_memchunk);
     s->peek_data = NULL;
@@ -193,6 +205,9 @@ static pa_stream *pa_stream_new_with_proplist_internal(
     s->auto_timing_update_requested = false;
     s->auto_timing_interval_usec = AUTO_TIMING_INTERVAL_START_USEC;
 
+    s->timing_slot = PA_INVALID_INDEX;
+    s->timing_page_timestamp = 0;
+
     reset_callbacks(s);
 
     s->smoother = NULL;
@@ -274,6 +289,29 @@ static void stream_unlink(pa_stream *s) {
         s->mainloop->time_free(s->auto_timing_update_event);
     }
 
+    /* The write ring blocks are imported from the connection, let go of
+     * them before it goes away */
+    if (s->write_ring_used) {
+        pa_memblock_release(s->write_memblock);
+        pa_memblock_unref(s->write_memblock);
+        s->write_memblock = NULL;
+        s->write_data = NULL;
+        s->write_ring_used = false;
+    }
+
+    if (s->write_ring) {
+        unsigned i;
+
+        for (i = 0; i < s->n_write_ring; i++)
+            pa_memblock_unref(s->write_ring[i]);
+
+        pa_xfree(s->write_ring);
+        pa_xfree(s->write_ring_data);
+        s->write_ring = NULL;
+        s->write_ring_data = NULL;
+        s->n_write_ring = 0;
+    }
+
     reset_callbacks(s);
 }
 
@@ -386,13 +424,25 @@ static void request_auto_timing_update(pa_stream *s, bool force) {
         (force || !s->auto_timing_update_requested)) {
         pa_operation *o;
 
+        /* Without any pending index changes the server's timing page is
+         * as good as asking */
+        if (!force && stream_read_timing_page(s)) {
+            if (s->latency_update_callback)
+                s->latency_update_callback(s, s->latency_update_userdata);
+
+            /* The callback might have disconnected us */
+            if (s->state != PA_STREAM_READY)
+                return;
+
+        } else {
 #ifdef STREAM_DEBUG
-        pa_log_debug("Automatically requesting new timing data");
+            pa_log_debug("Automatically requesting new timing data");
 #endif
 
-        if ((o = pa_stream_update_timing_info(s, NULL, NULL))) {
-            pa_operation_unref(o);
-            s->auto_timing_update_requested = true;
+            if ((o = pa_stream_update_timing_info(s, NULL, NULL))) {
+                pa_operation_unref(o);
+                s->auto_timing_update_requested = true;
+            }
         }
     }
 
@@ -959,6 +1009,122 @@ static void auto_timing_update_callback(pa_mainloop_api *m, pa_time_event *e, co
     pa_stream_unref(s);
 }
 
+static void stream_enable_timing_page_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    uint32_t slot;
+
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    if (!o->context || !o->stream)
+        goto finish;
+
+    /* Not being able to use the timing page is no error, we'll just go on
+     * asking for timing updates */
+    if (command != PA_COMMAND_REPLY)
+        goto finish;
+
+    if (pa_tagstruct_getu32(t, &slot) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        pa_context_fail(o->context, PA_ERR_PROTOCOL);
+        goto finish;
+    }
+
+    if (slot < o->context->n_timing_slots)
+        o->stream->timing_slot = slot;
+
+finish:
+    pa_operation_done(o);
+    pa_operation_unref(o);
+}
+
+static void enable_timing_page(pa_stream *s) {
+    pa_operation *o;
+    pa_tagstruct *t;
+    uint32_t tag;
+
+    pa_assert(s);
+    pa_assert(PA_REFCNT_VALUE(s) >= 1);
+
+    if (s->direction != PA_STREAM_PLAYBACK ||
+        s->context->version < 34 ||
+        !s->context->timing_slots)
+        return;
+
+    o = pa_operation_new(s->context, s, NULL, NULL);
+
+    t = pa_tagstruct_command(s->context, PA_COMMAND_ENABLE_TIMING_PAGE, &tag);
+    pa_tagstruct_putu32(t, s->channel);
+    pa_pstream_send_tagstruct(s->context->pstream, t);
+    pa_pdispatch_register_reply(s->context->pdispatch, tag, DEFAULT_TIMEOUT, stream_enable_timing_page_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    pa_operation_unref(o);
+}
+
+static void stream_enable_write_ring_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_stream *s = userdata;
+    uint32_t n;
+    unsigned i;
+
+    pa_assert(pd);
+    pa_assert(s);
+    pa_assert(PA_REFCNT_VALUE(s) >= 1);
+
+    /* The context dropped the blocks when it went away */
+    if (!s->context)
+        return;
+
+    /* Without a write ring we just go on with our own memory */
+    if (command != PA_COMMAND_REPLY) {
+        pa_context_drop_write_ring_pending(s->context);
+        return;
+    }
+
+    if (pa_tagstruct_getu32(t, &n) < 0 ||
+        !pa_tagstruct_eof(t) ||
+        n < 2 ||
+        n != s->context->n_write_ring_pending) {
+        pa_context_drop_write_ring_pending(s->context);
+        pa_context_fail(s->context, PA_ERR_PROTOCOL);
+        return;
+    }
+
+    s->write_ring = pa_xnewdup(pa_memblock*, s->context->write_ring_pending, n);
+    s->write_ring_data = pa_xnew(uint8_t*, n);
+    s->n_write_ring = n;
+    s->context->n_write_ring_pending = 0;
+
+    s->write_ring_current = 0;
+    s->write_ring_index = PA_WRITE_RING_HEADER_SIZE;
+
+    /* The pointers stay valid as long as the blocks are imported, but
+     * we only keep them acquired while handing them out */
+    for (i = 0; i < n; i++) {
+        s->write_ring_data[i] = pa_memblock_acquire(s->write_ring[i]);
+        pa_memblock_release(s->write_ring[i]);
+    }
+}
+
+static void enable_write_ring(pa_stream *s) {
+    pa_tagstruct *t;
+    uint32_t tag;
+
+    pa_assert(s);
+    pa_assert(PA_REFCNT_VALUE(s) >= 1);
+
+    if (s->direction != PA_STREAM_PLAYBACK ||
+        !s->context->conf->write_ring ||
+        s->context->version < 34 ||
+        !s->context->srb_template.memblock)
+        return;
+
+    t = pa_tagstruct_command(s->context, PA_COMMAND_ENABLE_WRITE_RING, &tag);
+    pa_tagstruct_putu32(t, s->channel);
+    pa_pstream_send_tagstruct(s->context->pstream, t);
+    pa_pdispatch_register_reply(s->context->pdispatch, tag, DEFAULT_TIMEOUT, stream_enable_write_ring_callback, pa_stream_ref(s), (pa_free_cb_t) pa_stream_unref);
+}
+
 static void create_stream_complete(pa_stream *s) {
     pa_assert(s);
     pa_assert(PA_REFCNT_VALUE(s) >= 1);
@@ -966,6 +1132,8 @@ static void create_stream_complete(pa_stream *s) {
 
     pa_stream_set_state(s, PA_STREAM_READY);
 
+    enable_write_ring(s);
+
     if (s->requested_bytes > 0 && s->write_callback)
         s->write_callback(s, (size_t) s->requested_bytes, s->write_userdata);
 
@@ -974,6 +1142,7 @@ static void create_stream_complete(pa_stream *s) {
         pa_assert(!s->auto_timing_update_event);
         s->auto_timing_update_event = pa_context_rttime_new(s->context, pa_rtclock_now() + s->auto_timing_interval_usec, &auto_timing_update_callback, s);
 
+        enable_timing_page(s);
         request_auto_timing_update(s, true);
     }
 
@@ -1224,7 +1393,10 @@ static int create_stream(
 
     PA_CHECK_VALIDITY(s->context, s->context->version >= 12 || !(flags & PA_STREAM_VARIABLE_RATE), PA_ERR_NOTSUPPORTED);
     PA_CHECK_VALIDITY(s->context, s->context->version >= 13 || !(flags & PA_STREAM_PEAK_DETECT), PA_ERR_NOTSUPPORTED);
-    PA_CHECK_VALIDITY(s->context, s->context->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY(s->context, s->context->state == PA_CONTEXT_READY ||
+                      (s->context->pipelined &&
+                       (s->context->state == PA_CONTEXT_AUTHORIZING ||
+                        s->context->state == PA_CONTEXT_SETTING_NAME)), PA_ERR_BADSTATE);
     /* Although some of the other flags are not supported on older
      * version, we don't check for them here, because it doesn't hurt
      * when they are passed but actually not supported. This makes
@@ -1382,6 +1554,10 @@ static int create_stream(
     pa_pstream_send_tagstruct(s->context->pstream, t);
     pa_pdispatch_register_reply(s->context->pdispatch, tag, DEFAULT_TIMEOUT, pa_create_stream_callback, s, NULL);
 
+    /* Encoded for a version the server has not confirmed yet */
+    if (s->context->state == PA_CONTEXT_AUTHORIZING)
+        s->context->pipelined_stream_sent = true;
+
     pa_stream_set_state(s, PA_STREAM_CREATING);
 
     pa_stream_unref(s);
@@ -1414,6 +1590,77 @@ int pa_stream_connect_record(
     return create_stream(PA_STREAM_RECORD, s, dev, attr, flags, NULL, NULL);
 }
 
+/* Hands out the rest of the current write ring block, or the next block
+ * if the server is done with it */
+static bool write_ring_begin(pa_stream *s, size_t nbytes) {
+    pa_write_ring_header *h;
+    size_t block_size, avail, want;
+
+    if (!s->write_ring)
+        return false;
+
+    block_size = pa_memblock_get_length(s->write_ring[s->write_ring_current]);
+    avail = pa_frame_align(block_size - s->write_ring_index, &s->sample_spec);
+
+    /* If the size is left to us, don't bother with small leftovers */
+    want = nbytes != (size_t) -1 ? nbytes : (block_size - PA_WRITE_RING_HEADER_SIZE) / 4;
+
+    if (avail < want) {
+        unsigned next = (s->write_ring_current + 1) % s->n_write_ring;
+
+        h = pa_memblock_acquire(s->write_ring[next]);
+
+        if (pa_atomic_load(&h->pending) == 0) {
+            s->write_ring_current = next;
+            s->write_ring_index = PA_WRITE_RING_HEADER_SIZE;
+
+            block_size = pa_memblock_get_length(s->write_ring[next]);
+            avail = pa_frame_align(block_size - s->write_ring_index, &s->sample_spec);
+        }
+
+        pa_memblock_release(s->write_ring[next]);
+    }
+
+    if (avail == 0)
+        return false;
+
+    s->write_memblock = pa_memblock_ref(s->write_ring[s->write_ring_current]);
+    s->write_data = (uint8_t*) pa_memblock_acquire(s->write_memblock) + s->write_ring_index;
+    s->write_length = PA_MIN(avail, nbytes);
+    s->write_ring_used = true;
+
+    return true;
+}
+
+/* Passes data written to a write ring block on to the server, by
+ * reference */
+static void write_ring_commit(pa_stream *s, const void *data, size_t length, int64_t offset, pa_seek_mode_t seek) {
+    uint8_t *base = s->write_ring_data[s->write_ring_current];
+    pa_tagstruct *t;
+    uint32_t tag;
+    size_t index;
+
+    index = (size_t) ((const uint8_t*) data - base);
+
+    if (length > 0) {
+        pa_write_ring_header *h = (pa_write_ring_header*) base;
+        pa_atomic_inc(&h->pending);
+    }
+
+    t = pa_tagstruct_command(s->context, PA_COMMAND_WRITE_RING_COMMIT, &tag);
+    pa_tagstruct_putu32(t, s->channel);
+    pa_tagstruct_putu32(t, s->write_ring_current);
+    pa_tagstruct_putu32(t, (uint32_t) index);
+    pa_tagstruct_putu32(t, (uint32_t) length);
+    pa_tagstruct_puts64(t, offset);
+    pa_tagstruct_putu32(t, seek);
+    pa_pstream_send_tagstruct(s->context->pstream, t);
+
+    /* Everything up to here belongs to the server now. pa_stream_write()
+     * made sure that we stay frame aligned. */
+    s->write_ring_index = index + length;
+}
+
 int pa_stream_begin_write(
         pa_stream *s,
         void **data,
@@ -1439,13 +1686,14 @@ int pa_stream_begin_write(
             *nbytes = m;
     }
 
-    if (!s->write_memblock) {
+    if (!s->write_memblock && !write_ring_begin(s, *nbytes)) {
         s->write_memblock = pa_memblock_new(s->context->mempool, *nbytes);
         s->write_data = pa_memblock_acquire(s->write_memblock);
+        s->write_length = pa_memblock_get_length(s->write_memblock);
     }
 
     *data = s->write_data;
-    *nbytes = pa_memblock_get_length(s->write_memblock);
+    *nbytes = s->write_length;
 
     return 0;
 }
@@ -1467,6 +1715,7 @@ int pa_stream_cancel_write(
     pa_memblock_unref(s->write_memblock);
     s->write_memblock = NULL;
     s->write_data = NULL;
+    s->write_ring_used = false;
 
     return 0;
 }
@@ -1492,7 +1741,7 @@ int pa_stream_write_ext_free(
     PA_CHECK_VALIDITY(s->context,
                       !s->write_memblock ||
                       ((data >= s->write_data) &&
-                       ((const char*) data + length <= (const char*) s->write_data + pa_memblock_get_length(s->write_memblock))),
+                       ((const char*) data + length <= (const char*) s->write_data + s->write_length)),
                       PA_ERR_INVALID);
     PA_CHECK_VALIDITY(s->context, offset % pa_frame_size(&s->sample_spec) == 0, PA_ERR_INVALID);
     PA_CHECK_VALIDITY(s->context, length % pa_frame_size(&s->sample_spec) == 0, PA_ERR_INVALID);
@@ -1512,7 +1761,31 @@ int pa_stream_write_ext_free(
         s->write_memblock = NULL;
         s->write_data = NULL;
 
-        pa_pstream_send_memblock(s->context->pstream, s->channel, offset, seek, &chunk);
+        if (s->write_ring_used) {
+            s->write_ring_used = false;
+
+            if (chunk.index % pa_frame_size(&s->sample_spec) == 0)
+                write_ring_commit(s, data, length, offset, seek);
+            else if (length > 0) {
+                pa_memchunk copy;
+
+                /* The ring stays frame aligned, so data that doesn't start
+                 * on a frame boundary is sent as a copy the usual way */
+                copy.memblock = pa_memblock_new(s->context->mempool, length);
+                copy.index = 0;
+                copy.length = length;
+
+                pa_memblock_acquire(chunk.memblock);
+                memcpy(pa_memblock_acquire(copy.memblock), data, length);
+                pa_memblock_release(copy.memblock);
+                pa_memblock_release(chunk.memblock);
+
+                pa_pstream_send_memblock(s->context->pstream, s->channel, offset, seek, &copy);
+                pa_memblock_unref(copy.memblock);
+            }
+        } else
+            pa_pstream_send_memblock(s->context->pstream, s->channel, offset, seek, &chunk);
+
         pa_memblock_unref(chunk.memblock);
 
     } else {
@@ -1526,6 +1799,28 @@ int pa_stream_write_ext_free(
         while (t_length > 0) {
             pa_memchunk chunk;
 
+            /* Copying into the write ring saves exporting our own block */
+            if (write_ring_begin(s, t_length)) {
+                void *d = s->write_data;
+                size_t l = s->write_length;
+
+                memcpy(d, t_data, l);
+                pa_memblock_release(s->write_memblock);
+                pa_memblock_unref(s->write_memblock);
+                s->write_memblock = NULL;
+                s->write_data = NULL;
+                s->write_ring_used = false;
+
+                write_ring_commit(s, d, l, t_offset, t_seek);
+
+                t_offset = 0;
+                t_seek = PA_SEEK_RELATIVE;
+
+                t_data = (const uint8_t*) t_data + l;
+                t_length -= l;
+                continue;
+            }
+
             chunk.index = 0;
 
             if (free_cb && !pa_pstream_get_shm(s->context->pstream)) {
@@ -1792,6 +2087,41 @@ static pa_usec_t calc_time(const pa_stream *s, bool ignore_transport) {
     return usec;
 }
 
+/* Feeds the timing info taken at the local time u into the smoother */
+static void stream_update_smoother(pa_stream *s, pa_usec_t u) {
+    pa_timing_info *i = &s->timing_info;
+    pa_usec_t x = u;
+
+    /* Update smoother if we're not corked */
+    if (!s->smoother || s->corked)
+        return;
+
+    if (s->direction == PA_STREAM_PLAYBACK && s->context->version >= 13) {
+        pa_usec_t su;
+
+        /* If we weren't playing then it will take some time
+         * until the audio will actually come out through the
+         * speakers. Since we follow that timing here, we need
+         * to try to fix this up */
+
+        su = pa_bytes_to_usec((uint64_t) i->since_underrun, &s->sample_spec);
+
+        if (su < i->sink_usec)
+            x += i->sink_usec - su;
+    }
+
+    if (!i->playing)
+        pa_smoother_pause(s->smoother, x);
+
+    /* Update the smoother */
+    if ((s->direction == PA_STREAM_PLAYBACK && !i->read_index_corrupt) ||
+        (s->direction == PA_STREAM_RECORD && !i->write_index_corrupt))
+        pa_smoother_put(s->smoother, u, calc_time(s, true));
+
+    if (i->playing)
+        pa_smoother_resume(s->smoother, x, true);
+}
+
 static void stream_get_timing_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_operation *o = userdata;
     struct timeval local, remote, now;
@@ -1929,37 +2259,7 @@ static void stream_get_timing_info_callback(pa_pdispatch *pd, uint32_t command,
                 i->read_index -= (int64_t) pa_memblockq_get_length(o->stream->record_memblockq);
         }
 
-        /* Update smoother if we're not corked */
-        if (o->stream->smoother && !o->stream->corked) {
-            pa_usec_t u, x;
-
-            u = x = pa_rtclock_now() - i->transport_usec;
-
-            if (o->stream->direction == PA_STREAM_PLAYBACK && o->context->version >= 13) {
-                pa_usec_t su;
-
-                /* If we weren't playing then it will take some time
-                 * until the audio will actually come out through the
-                 * speakers. Since we follow that timing here, we need
-                 * to try to fix this up */
-
-                su = pa_bytes_to_usec((uint64_t) i->since_underrun, &o->stream->sample_spec);
-
-                if (su < i->sink_usec)
-                    x += i->sink_usec - su;
-            }
-
-            if (!i->playing)
-                pa_smoother_pause(o->stream->smoother, x);
-
-            /* Update the smoother */
-            if ((o->stream->direction == PA_STREAM_PLAYBACK && !i->read_index_corrupt) ||
-                (o->stream->direction == PA_STREAM_RECORD && !i->write_index_corrupt))
-                pa_smoother_put(o->stream->smoother, u, calc_time(o->stream, true));
-
-            if (i->playing)
-                pa_smoother_resume(o->stream->smoother, x, true);
-        }
+        stream_update_smoother(o->stream, pa_rtclock_now() - i->transport_usec);
     }
 
     o->stream->auto_timing_update_requested = false;
@@ -1978,6 +2278,79 @@ finish:
     pa_operation_unref(o);
 }
 
+/* Refreshes the timing info from the slot the server's IO thread keeps
+ * up to date for us, without a round trip. Returns false if it can't be
+ * used right now, i e if the indexes need to be resynchronized through
+ * pa_stream_update_timing_info() first. */
+static bool stream_read_timing_page(pa_stream *s) {
+    pa_timing_page_slot *slot, copy;
+    pa_timing_info *i = &s->timing_info;
+    pa_usec_t now;
+    unsigned n;
+
+    pa_assert(s);
+    pa_assert(PA_REFCNT_VALUE(s) >= 1);
+
+    if (s->timing_slot == PA_INVALID_INDEX ||
+        s->state != PA_STREAM_READY ||
+        s->timing_slot >= s->context->n_timing_slots)
+        return false;
+
+    if (!s->timing_info_valid ||
+        i->read_index_corrupt ||
+        s->auto_timing_update_requested)
+        return false;
+
+    slot = &s->context->timing_slots[s->timing_slot];
+
+    for (n = 0;; n++) {
+        int seq;
+
+        if (n >= TIMING_PAGE_RETRIES)
+            return false;
+
+        seq = pa_atomic_load(&slot->seq);
+        if (seq & 1)
+            continue;
+
+        memcpy(&copy, slot, sizeof(copy));
+
+        /* Don't let the copy be done after the second look at seq */
+        pa_atomic_fence();
+
+        if (pa_atomic_load(&slot->seq) == seq)
+            break;
+    }
+
+    if (copy.timestamp == 0)
+        return false;
+
+    /* Nothing new, e g because we are corked */
+    if (copy.timestamp == s->timing_page_timestamp)
+        return true;
+
+    s->timing_page_timestamp = copy.timestamp;
+
+    i->sink_usec = copy.sink_usec;
+    i->playing = !!(copy.flags & PA_TIMING_PAGE_PLAYING);
+    i->since_underrun = (int64_t) (i->playing ? copy.playing_for : copy.underrun_for);
+
+    /* The write index is ours, we only take the read index */
+    i->read_index = copy.read_index;
+
+    /* Same machine, same clock */
+    now = pa_rtclock_now();
+    pa_gettimeofday(&i->timestamp);
+    if (copy.timestamp < now)
+        pa_timeval_sub(&i->timestamp, now - copy.timestamp);
+    i->transport_usec = 0;
+    i->synchronized_clocks = true;
+
+    stream_update_smoother(s, PA_MIN(copy.timestamp, now));
+
+    return true;
+}
+
 pa_operation* pa_stream_update_timing_info(pa_stream *s, pa_stream_success_cb_t cb, void *userdata) {
     uint32_t tag;
     pa_operation *o;
@@ -2466,6 +2839,8 @@ int pa_stream_get_time(pa_stream *s, pa_usec_t *r_usec) {
     PA_CHECK_VALIDITY(s->context, s->direction != PA_STREAM_PLAYBACK || !s->timing_info.read_index_corrupt, PA_ERR_NODATA);
     PA_CHECK_VALIDITY(s->context, s->direction != PA_STREAM_RECORD || !s->timing_info.write_index_corrupt, PA_ERR_NODATA);
 
+    stream_read_timing_page(s);
+
     if (s->smoother)
         usec = pa_smoother_get(s->smoother, pa_rtclock_now());
     else
@@ -23,15 +23,62 @@
 
 #include <stdio.h>
 
+#include <pulse/xmalloc.h>
+
 #include <pulsecore/macro.h>
 #include <pulsecore/pstream-util.h>
 
 #include "internal.h"
 #include "subscribe.h"
 
+/* Sanity limit for the number of removed properties in a delta event */
+#define MAX_REMOVED_KEYS 1024
+
+static int subscription_delta_parse(pa_tagstruct *t, pa_subscription_delta *d) {
+    uint32_t fields, j;
+    bool mute = false;
+
+    if (pa_tagstruct_getu32(t, &fields) < 0 ||
+        (fields & ~PA_SUBSCRIPTION_DELTA_ALL))
+        return -1;
+
+    d->fields = (pa_subscription_delta_fields_t) fields;
+
+    if (((fields & PA_SUBSCRIPTION_DELTA_VOLUME) && pa_tagstruct_get_cvolume(t, &d->volume) < 0) ||
+        ((fields & PA_SUBSCRIPTION_DELTA_MUTE) && pa_tagstruct_get_boolean(t, &mute) < 0) ||
+        ((fields & PA_SUBSCRIPTION_DELTA_STATE) && pa_tagstruct_getu32(t, &d->state) < 0) ||
+        ((fields & PA_SUBSCRIPTION_DELTA_LATENCY) && pa_tagstruct_get_usec(t, &d->latency) < 0))
+        return -1;
+
+    d->mute = (int) mute;
+
+    if (fields & PA_SUBSCRIPTION_DELTA_PROPLIST) {
+        d->proplist = pa_proplist_new();
+
+        if (pa_tagstruct_get_proplist(t, d->proplist) < 0 ||
+            pa_tagstruct_getu32(t, &d->n_removed_keys) < 0)
+            return -1;
+
+        if (d->n_removed_keys > 0) {
+            if (d->n_removed_keys > MAX_REMOVED_KEYS)
+                return -1;
+
+            d->removed_keys = pa_xnew0(const char*, d->n_removed_keys);
+
+            for (j = 0; j < d->n_removed_keys; j++)
+                if (pa_tagstruct_gets(t, &d->removed_keys[j]) < 0 || !d->removed_keys[j])
+                    return -1;
+        }
+    }
+
+    return 0;
+}
+
 void pa_command_subscribe_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_context *c = userdata;
     pa_subscription_event_type_t e;
+    pa_subscription_delta d;
+    bool has_delta;
     uint32_t idx;
 
     pa_assert(pd);
@@ -41,22 +88,37 @@ void pa_command_subscribe_event(pa_pdispatch *pd, uint32_t command, uint32_t tag
     pa_assert(PA_REFCNT_VALUE(c) >= 1);
 
     pa_context_ref(c);
+    pa_zero(d);
 
     if (pa_tagstruct_getu32(t, &e) < 0 ||
-        pa_tagstruct_getu32(t, &idx) < 0 ||
+        pa_tagstruct_getu32(t, &idx) < 0) {
+        pa_context_fail(c, PA_ERR_PROTOCOL);
+        goto finish;
+    }
+
+    /* Events of a delta subscription carry a field mask and the fields */
+    has_delta = !pa_tagstruct_eof(t);
+
+    if ((has_delta && subscription_delta_parse(t, &d) < 0) ||
         !pa_tagstruct_eof(t)) {
         pa_context_fail(c, PA_ERR_PROTOCOL);
         goto finish;
     }
 
-    if (c->subscribe_callback)
+    if (has_delta && c->subscribe_delta_callback)
+        c->subscribe_delta_callback(c, e, idx, d.fields ? &d : NULL, c->subscribe_delta_userdata);
+    else if (c->subscribe_callback)
         c->subscribe_callback(c, e, idx, c->subscribe_userdata);
 
 finish:
+    if (d.proplist)
+        pa_proplist_free(d.proplist);
+    pa_xfree(d.removed_keys);
+
     pa_context_unref(c);
 }
 
-pa_operation* pa_context_subscribe(pa_context *c, pa_subscription_mask_t m, pa_context_success_cb_t cb, void *userdata) {
+static pa_operation* subscribe(pa_context *c, pa_subscription_mask_t m, bool delta, pa_context_success_cb_t cb, void *userdata) {
     pa_operation *o;
     pa_tagstruct *t;
     uint32_t tag;
@@ -65,17 +127,28 @@ pa_operation* pa_context_subscribe(pa_context *c, pa_subscription_mask_t m, pa_c
     pa_assert(PA_REFCNT_VALUE(c) >= 1);
 
     PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !delta || c->version >= 34, PA_ERR_NOTSUPPORTED);
 
     o = pa_operation_new(c, NULL, (pa_operation_cb_t) cb, userdata);
 
     t = pa_tagstruct_command(c, PA_COMMAND_SUBSCRIBE, &tag);
     pa_tagstruct_putu32(t, m);
+    if (delta)
+        pa_tagstruct_put_boolean(t, true);
     pa_pstream_send_tagstruct(c->pstream, t);
     pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, pa_context_simple_ack_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
 
     return o;
 }
 
+pa_operation* pa_context_subscribe(pa_context *c, pa_subscription_mask_t m, pa_context_success_cb_t cb, void *userdata) {
+    return subscribe(c, m, false, cb, userdata);
+}
+
+pa_operation* pa_context_subscribe_delta(pa_context *c, pa_subscription_mask_t m, pa_context_success_cb_t cb, void *userdata) {
+    return subscribe(c, m, true, cb, userdata);
+}
+
 void pa_context_set_subscribe_callback(pa_context *c, pa_context_subscribe_cb_t cb, void *userdata) {
     pa_assert(c);
     pa_assert(PA_REFCNT_VALUE(c) >= 1);
@@ -86,3 +159,14 @@ void pa_context_set_subscribe_callback(pa_context *c, pa_context_subscribe_cb_t
     c->subscribe_callback = cb;
     c->subscribe_userdata = userdata;
 }
+
+void pa_context_set_subscribe_delta_callback(pa_context *c, pa_context_subscribe_delta_cb_t cb, void *userdata) {
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+
+    if (c->state == PA_CONTEXT_TERMINATED || c->state == PA_CONTEXT_FAILED)
+        return;
+
+    c->subscribe_delta_callback = cb;
+    c->subscribe_delta_userdata = userdata;
+}
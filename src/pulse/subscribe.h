@@ -26,6 +26,8 @@
 #include <pulse/def.h>
 #include <pulse/context.h>
 #include <pulse/cdecl.h>
+#include <pulse/volume.h>
+#include <pulse/proplist.h>
 #include <pulse/version.h>
 
 /** \page subscribe Event Subscription
@@ -59,6 +61,16 @@ void my_subscription_callback(pa_context *c, pa_subscription_event_type_t t,
     }
 }
 @endverbatim
+ *
+ * \section delta_sec Delta Events
+ *
+ * Usually a client reacts to a \ref PA_SUBSCRIPTION_EVENT_CHANGE event by
+ * querying the changed object again. Clients that keep a cache of the server
+ * state can instead enable the subscription with pa_context_subscribe_delta()
+ * and set a callback with pa_context_set_subscribe_delta_callback(). Change
+ * events then carry the volume, mute, state, latency and property list
+ * fields that changed since the last event sent for the object, in a \ref
+ * pa_subscription_delta. Fields that did not change are not transferred.
  */
 
 /** \file
@@ -78,6 +90,55 @@ pa_operation* pa_context_subscribe(pa_context *c, pa_subscription_mask_t m, pa_c
 /** Set the context specific call back function that is called whenever the state of the daemon changes */
 void pa_context_set_subscribe_callback(pa_context *c, pa_context_subscribe_cb_t cb, void *userdata);
 
+/** Fields carried by a delta subscription event. \since 14.0 */
+typedef enum pa_subscription_delta_fields {
+    PA_SUBSCRIPTION_DELTA_VOLUME = 0x0001U,
+    /**< The volume of a sink, source, sink input or source output */
+
+    PA_SUBSCRIPTION_DELTA_MUTE = 0x0002U,
+    /**< The mute switch of a sink, source, sink input or source output */
+
+    PA_SUBSCRIPTION_DELTA_STATE = 0x0004U,
+    /**< The state of a sink or source, or the corked flag of a sink input or source output */
+
+    PA_SUBSCRIPTION_DELTA_LATENCY = 0x0008U,
+    /**< The configured latency of a sink or source, or the requested latency of a sink input or source output */
+
+    PA_SUBSCRIPTION_DELTA_PROPLIST = 0x0010U,
+    /**< The property list. Also available for clients, modules and cards */
+
+    PA_SUBSCRIPTION_DELTA_ALL = 0x001FU
+    /**< All of the above */
+} pa_subscription_delta_fields_t;
+
+/** The changed fields of an object, as passed to a \ref
+ * pa_context_subscribe_delta_cb_t. Members not flagged in fields are
+ * unset. All pointers are only valid during the callback. \since 14.0 */
+typedef struct pa_subscription_delta {
+    pa_subscription_delta_fields_t fields;  /**< The fields that changed */
+    pa_cvolume volume;                      /**< The new volume */
+    int mute;                               /**< The new mute switch */
+    uint32_t state;                         /**< The new pa_sink_state_t or pa_source_state_t, or non-zero if a stream is corked */
+    pa_usec_t latency;                      /**< The new latency */
+    pa_proplist *proplist;                  /**< Properties that were added or changed */
+    uint32_t n_removed_keys;                /**< Number of entries in removed_keys */
+    const char **removed_keys;              /**< Properties that were removed */
+} pa_subscription_delta;
+
+/** Delta subscription event callback prototype. d is NULL if the event
+ * carries no data, e.g. for \ref PA_SUBSCRIPTION_EVENT_NEW and \ref
+ * PA_SUBSCRIPTION_EVENT_REMOVE events. \since 14.0 */
+typedef void (*pa_context_subscribe_delta_cb_t)(pa_context *c, pa_subscription_event_type_t t, uint32_t idx, const pa_subscription_delta *d, void *userdata);
+
+/** Enable event notification like pa_context_subscribe(), but have change
+ * events carry the changed fields of the object. \since 14.0 */
+pa_operation* pa_context_subscribe_delta(pa_context *c, pa_subscription_mask_t m, pa_context_success_cb_t cb, void *userdata);
+
+/** Set the call back function that is called for events enabled with
+ * pa_context_subscribe_delta(). If set, it is called instead of the
+ * callback set with pa_context_set_subscribe_callback(). \since 14.0 */
+void pa_context_set_subscribe_delta_callback(pa_context *c, pa_context_subscribe_delta_cb_t cb, void *userdata);
+
 PA_C_DECL_END
 
 #endif
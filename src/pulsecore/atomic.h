@@ -30,7 +30,8 @@
  *
  * For now we do only full memory barriers. Eventually we might want
  * to support more elaborate memory barriers, in which case we will add
- * suffixes to the function names.
+ * suffixes to the function names. pa_atomic_fence() is a full barrier
+ * on its own, for ordering plain memory accesses around atomic ones.
  *
  * On gcc >= 4.1 we use the builtin atomic functions. otherwise we use
  * libatomic_ops
@@ -62,6 +63,10 @@ static inline void pa_atomic_store(pa_atomic_t *a, int i) {
     __atomic_store_n(&a->value, i, __ATOMIC_SEQ_CST);
 }
 
+static inline void pa_atomic_fence(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
 #else
 
 static inline int pa_atomic_load(const pa_atomic_t *a) {
@@ -74,6 +79,10 @@ static inline void pa_atomic_store(pa_atomic_t *a, int i) {
     __sync_synchronize();
 }
 
+static inline void pa_atomic_fence(void) {
+    __sync_synchronize();
+}
+
 #endif
 
 
@@ -160,6 +169,10 @@ static inline void pa_atomic_store(pa_atomic_t *a, int i) {
     membar_sync();
 }
 
+static inline void pa_atomic_fence(void) {
+    membar_sync();
+}
+
 /* Returns the previously set value */
 static inline int pa_atomic_add(pa_atomic_t *a, int i) {
     int nv = (int) atomic_add_int_nv(&a->value, i);
@@ -265,6 +278,10 @@ static inline void pa_atomic_store(pa_atomic_t *a, int i) {
     atomic_store_rel_int((unsigned int *) &a->value, i);
 }
 
+static inline void pa_atomic_fence(void) {
+    __sync_synchronize();
+}
+
 static inline int pa_atomic_add(pa_atomic_t *a, int i) {
     return atomic_fetchadd_int((unsigned int *) &a->value, i);
 }
@@ -335,6 +352,10 @@ static inline void pa_atomic_store(pa_atomic_t *a, int i) {
     a->value = i;
 }
 
+static inline void pa_atomic_fence(void) {
+    __asm __volatile ("mfence" : : : "memory");
+}
+
 static inline int pa_atomic_add(pa_atomic_t *a, int i) {
     int result;
 
@@ -419,6 +440,10 @@ static inline void pa_atomic_store(pa_atomic_t *a, int i) {
     pa_memory_barrier();
 }
 
+static inline void pa_atomic_fence(void) {
+    pa_memory_barrier();
+}
+
 /* Returns the previously set value */
 static inline int pa_atomic_add(pa_atomic_t *a, int i) {
     unsigned long not_exclusive;
@@ -559,6 +584,10 @@ static inline void pa_atomic_store(pa_atomic_t *a, int i) {
     pa_memory_barrier();
 }
 
+static inline void pa_atomic_fence(void) {
+    pa_memory_barrier();
+}
+
 /* Returns the previously set value */
 static inline int pa_atomic_add(pa_atomic_t *a, int i) {
     int old_val;
@@ -640,6 +669,10 @@ static inline void pa_atomic_store(pa_atomic_t *a, int i) {
     AO_store_full(&a->value, (AO_t) i);
 }
 
+static inline void pa_atomic_fence(void) {
+    AO_nop_full();
+}
+
 static inline int pa_atomic_add(pa_atomic_t *a, int i) {
     return (int) AO_fetch_and_add_full(&a->value, (AO_t) i);
 }
@@ -135,6 +135,7 @@ static int pa_cli_command_sink_port(pa_core *c, pa_tokenizer *t, pa_strbuf *buf,
 static int pa_cli_command_source_port(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool *fail);
 static int pa_cli_command_port_offset(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool *fail);
 static int pa_cli_command_dump_volumes(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool *fail);
+static int pa_cli_command_dump_io_stats(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool *fail);
 
 /* A method table for all available commands */
 
@@ -194,6 +195,7 @@ static const struct command commands[] = {
     { "play-file",               pa_cli_command_play_file,          "Play a sound file (args: filename, sink|index)", 3},
     { "dump",                    pa_cli_command_dump,               "Dump daemon configuration", 1},
     { "dump-volumes",            pa_cli_command_dump_volumes,       "Debug: Show the state of all volumes", 1 },
+    { "dump-io-stats",           pa_cli_command_dump_io_stats,      "Debug: Show where the IO threads of all sinks and sources spend their time", 1 },
     { "shared",                  pa_cli_command_list_shared_props,  "Debug: Show shared properties", 1},
     { "exit",                    pa_cli_command_exit,               "Terminate the daemon",         1 },
     { "vacuum",                  pa_cli_command_vacuum,             NULL, 1},
@@ -377,6 +379,11 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool
                      (unsigned) pa_atomic_load(&mstat->n_exported),
                      pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_atomic_load(&mstat->exported_size)));
 
+    pa_strbuf_printf(buf, "Memory pool slot cache hits: %u, misses: %u, malloc fallbacks: %u.\n",
+                     (unsigned) pa_atomic_load(&mstat->n_slot_cache_hits),
+                     (unsigned) pa_atomic_load(&mstat->n_slot_cache_misses),
+                     (unsigned) pa_atomic_load(&mstat->n_pool_fallbacks));
+
     pa_strbuf_printf(buf, "Total sample cache size: %s.\n",
                      pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_scache_total_size(c)));
 
@@ -1878,6 +1885,46 @@ static int pa_cli_command_dump(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool
     return 0;
 }
 
+static void append_io_stats(pa_strbuf *buf, const pa_io_stats *stats) {
+    char *s, *line;
+    const char *state = NULL;
+
+    s = pa_io_stats_to_string(stats);
+
+    while ((line = pa_split(s, "\n", &state))) {
+        pa_strbuf_printf(buf, "\t%s\n", line);
+        pa_xfree(line);
+    }
+
+    pa_xfree(s);
+}
+
+static int pa_cli_command_dump_io_stats(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool *fail) {
+    pa_sink *s;
+    pa_source *so;
+    pa_io_stats stats;
+    uint32_t idx;
+
+    pa_core_assert_ref(c);
+    pa_assert(t);
+    pa_assert(buf);
+    pa_assert(fail);
+
+    PA_IDXSET_FOREACH(s, c->sinks, idx) {
+        pa_strbuf_printf(buf, "Sink %u (%s):\n", idx, s->name);
+        pa_sink_get_io_stats(s, &stats);
+        append_io_stats(buf, &stats);
+    }
+
+    PA_IDXSET_FOREACH(so, c->sources, idx) {
+        pa_strbuf_printf(buf, "Source %u (%s):\n", idx, so->name);
+        pa_source_get_io_stats(so, &stats);
+        append_io_stats(buf, &stats);
+    }
+
+    return 0;
+}
+
 static int pa_cli_command_dump_volumes(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool *fail) {
     pa_sink *s;
     pa_source *so;
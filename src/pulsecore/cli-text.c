@@ -524,6 +524,7 @@ char *pa_sink_input_list_to_string(pa_core *c) {
 
     PA_IDXSET_FOREACH(i, c->sink_inputs, idx) {
         char ss[PA_SAMPLE_SPEC_SNPRINT_MAX], cv[PA_CVOLUME_SNPRINT_MAX], cm[PA_CHANNEL_MAP_SNPRINT_MAX], *t, clt[28];
+        char copied[PA_BYTES_SNPRINT_MAX], rendered[PA_BYTES_SNPRINT_MAX];
         pa_usec_t cl;
         const char *cmn;
         pa_cvolume v;
@@ -588,6 +589,10 @@ char *pa_sink_input_list_to_string(pa_core *c) {
 
         pa_xfree(volume_str);
 
+        pa_strbuf_printf(s, "\tcopied while rendering: %s/s of %s/s\n",
+                         pa_bytes_snprint(copied, sizeof(copied), (unsigned) pa_atomic_load(&i->bytes_copied_per_sec)),
+                         pa_bytes_snprint(rendered, sizeof(rendered), (unsigned) pa_atomic_load(&i->bytes_rendered_per_sec)));
+
         if (i->module)
             pa_strbuf_printf(s, "\tmodule: %u\n", i->module->index);
         if (i->client)
@@ -784,6 +784,129 @@ void pa_reset_priority(void) {
 #endif
 }
 
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+/* Parse a CPU list in the format used by taskset(1) and cpuset(7),
+ * e.g. "2,4-7" */
+static int parse_cpu_list(const char *cpus, cpu_set_t *set) {
+    const char *state = NULL;
+    char *k;
+    int r = 0;
+
+    CPU_ZERO(set);
+
+    while (r >= 0 && (k = pa_split(cpus, ",", &state))) {
+        char *dash;
+        uint32_t first, last, i;
+
+        if ((dash = strchr(k, '-'))) {
+            *dash = 0;
+
+            if (pa_atou(k, &first) < 0 || pa_atou(dash + 1, &last) < 0)
+                r = -1;
+        } else if (pa_atou(k, &first) < 0)
+            r = -1;
+        else
+            last = first;
+
+        if (r >= 0 && (first > last || last >= CPU_SETSIZE))
+            r = -1;
+
+        if (r >= 0)
+            for (i = first; i <= last; i++)
+                CPU_SET(i, set);
+
+        pa_xfree(k);
+    }
+
+    if (r >= 0 && CPU_COUNT(set) <= 0)
+        r = -1;
+
+    return r;
+}
+#endif
+
+/* Parse a CPU list like "2,4-7" and return the part of it the process
+ * is allowed to run on, in the same format. Returns NULL if the list is
+ * invalid, none of the listed CPUs is usable or thread CPU affinity is not
+ * supported on this platform. */
+char *pa_cpu_list_effective(const char *cpus) {
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    cpu_set_t requested, allowed, effective;
+    pa_strbuf *buf;
+    int i;
+
+    pa_assert(cpus);
+
+    if (parse_cpu_list(cpus, &requested) < 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if ((errno = pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed)) != 0)
+        return NULL;
+
+    CPU_AND(&effective, &requested, &allowed);
+
+    if (CPU_COUNT(&effective) <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    buf = pa_strbuf_new();
+
+    for (i = 0; i < CPU_SETSIZE; i++) {
+        int last;
+
+        if (!CPU_ISSET(i, &effective))
+            continue;
+
+        for (last = i; last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &effective); last++)
+            ;
+
+        if (!pa_strbuf_isempty(buf))
+            pa_strbuf_putc(buf, ',');
+
+        if (last > i)
+            pa_strbuf_printf(buf, "%i-%i", i, last);
+        else
+            pa_strbuf_printf(buf, "%i", i);
+
+        i = last;
+    }
+
+    return pa_strbuf_to_string_free(buf);
+#else
+    errno = ENOTSUP;
+    return NULL;
+#endif
+}
+
+/* Restrict the calling thread to the CPUs in the specified list. */
+int pa_thread_set_cpu_affinity(const char *cpus) {
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    cpu_set_t set;
+    int r;
+
+    pa_assert(cpus);
+
+    if (parse_cpu_list(cpus, &set) < 0) {
+        pa_log_warn("Invalid CPU list '%s'.", cpus);
+        return -1;
+    }
+
+    if ((r = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0) {
+        pa_log_warn("Failed to set thread CPU affinity to %s: %s", cpus, pa_cstrerror(r));
+        return -1;
+    }
+
+    pa_log_info("Successfully restricted thread to CPUs %s.", cpus);
+    return 0;
+#else
+    pa_log_info("Thread CPU affinity is not supported on this platform.");
+    return -1;
+#endif
+}
+
 /* Check whenever any substring in v matches the provided regex. */
 int pa_match(const char *expr, const char *v) {
 #if defined(HAVE_REGEX_H) || defined(HAVE_PCREPOSIX_H)
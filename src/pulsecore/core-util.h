@@ -84,6 +84,9 @@ char *pa_parent_dir(const char *fn);
 int pa_raise_priority(int nice_level);
 void pa_reset_priority(void);
 
+char *pa_cpu_list_effective(const char *cpus);
+int pa_thread_set_cpu_affinity(const char *cpus);
+
 int pa_parse_boolean(const char *s) PA_GCC_PURE;
 
 int pa_parse_volume(const char *s, pa_volume_t *volume);
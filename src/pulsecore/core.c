@@ -147,6 +147,8 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
     c->remixing_produce_lfe = false;
     c->remixing_consume_lfe = false;
     c->lfe_crossover_freq = 0;
+    c->native_io_threads = 0;
+    c->io_thread_cpus = NULL;
     c->deferred_volume = true;
     c->resample_method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 1;
 
@@ -221,6 +223,7 @@ static void core_free(pa_object *o) {
     pa_assert(!c->default_sink);
     pa_xfree(c->configured_default_source);
     pa_xfree(c->configured_default_sink);
+    pa_xfree(c->io_thread_cpus);
 
     pa_silence_cache_done(&c->silence_cache);
     pa_mempool_unref(c->mempool);
@@ -190,6 +190,13 @@ struct pa_core {
     int deferred_volume_extra_delay_usec;
     unsigned lfe_crossover_freq;
 
+    /* Threads serving native protocol connections, 0 for the main loop */
+    unsigned native_io_threads;
+
+    /* CPUs IO threads are restricted to unless a module overrides it,
+     * NULL for no restriction */
+    char *io_thread_cpus;
+
     pa_defer_event *module_defer_unload_event;
     pa_hashmap *modules_pending_unload; /* pa_module -> pa_module (hashmap-as-a-set) */
 
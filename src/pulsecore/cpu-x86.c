@@ -32,6 +32,18 @@
 
 #include "cpu-x86.h"
 
+#if (defined(__i386__) || defined(__amd64__)) && defined(HAVE_CPUID_H)
+/* Read the XCR0 register to find out which register states the OS saves
+ * on context switches. The caller must have checked OSXSAVE first. */
+static uint32_t get_xcr0(void) {
+    uint32_t eax, edx;
+
+    __asm__ __volatile__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+
+    return eax;
+}
+#endif
+
 void pa_cpu_get_x86_flags(pa_cpu_x86_flag_t *flags) {
 #if (defined(__i386__) || defined(__amd64__)) && defined(HAVE_CPUID_H)
     uint32_t eax, ebx, ecx, edx;
@@ -70,6 +82,21 @@ void pa_cpu_get_x86_flags(pa_cpu_x86_flag_t *flags) {
 
         if (ecx & (1<<20))
           *flags |= PA_CPU_X86_SSE4_2;
+
+        /* AVX needs both CPU support and the OS saving the YMM state */
+        if ((ecx & (1<<27)) && (ecx & (1<<28)) && (get_xcr0() & 0x6) == 0x6)
+          *flags |= PA_CPU_X86_AVX;
+    }
+
+    if (level >= 7 && (*flags & PA_CPU_X86_AVX)) {
+        __cpuid_count(0x00000007, 0, eax, ebx, ecx, edx);
+
+        if (ebx & (1<<5))
+          *flags |= PA_CPU_X86_AVX2;
+
+        /* AVX-512 additionally needs the opmask and ZMM state enabled */
+        if ((ebx & (1<<16)) && (get_xcr0() & 0xe6) == 0xe6)
+          *flags |= PA_CPU_X86_AVX512F;
     }
 
     /* get extended level */
@@ -94,7 +121,7 @@ void pa_cpu_get_x86_flags(pa_cpu_x86_flag_t *flags) {
     }
 
 finish:
-    pa_log_info("CPU flags: %s%s%s%s%s%s%s%s%s%s%s",
+    pa_log_info("CPU flags: %s%s%s%s%s%s%s%s%s%s%s%s%s%s",
     (*flags & PA_CPU_X86_CMOV) ? "CMOV " : "",
     (*flags & PA_CPU_X86_MMX) ? "MMX " : "",
     (*flags & PA_CPU_X86_SSE) ? "SSE " : "",
@@ -103,6 +130,9 @@ finish:
     (*flags & PA_CPU_X86_SSSE3) ? "SSSE3 " : "",
     (*flags & PA_CPU_X86_SSE4_1) ? "SSE4_1 " : "",
     (*flags & PA_CPU_X86_SSE4_2) ? "SSE4_2 " : "",
+    (*flags & PA_CPU_X86_AVX) ? "AVX " : "",
+    (*flags & PA_CPU_X86_AVX2) ? "AVX2 " : "",
+    (*flags & PA_CPU_X86_AVX512F) ? "AVX512F " : "",
     (*flags & PA_CPU_X86_MMXEXT) ? "MMXEXT " : "",
     (*flags & PA_CPU_X86_3DNOW) ? "3DNOW " : "",
     (*flags & PA_CPU_X86_3DNOWEXT) ? "3DNOWEXT " : "");
@@ -125,6 +155,13 @@ bool pa_cpu_init_x86(pa_cpu_x86_flag_t *flags) {
         pa_convert_func_init_sse(*flags);
     }
 
+    if (*flags & PA_CPU_X86_AVX2) {
+        pa_mix_func_init_avx(*flags);
+        pa_remap_func_init_avx(*flags);
+        pa_convert_func_init_avx(*flags);
+        pa_polyphase_func_init_avx(*flags);
+    }
+
     return true;
 #else /* defined (__i386__) || defined (__amd64__) */
     return false;
@@ -0,0 +1,375 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+
+#include "convolver.h"
+
+/* Every block of B input frames is transformed together with the previous
+ * block by a real FFT of size N = 2B and stored in a frequency domain delay
+ * line (FDL) of P spectra, one per filter partition. The output block is the
+ * inverse transform of the sum over all partitions of the delayed input
+ * spectra multiplied with the partition spectra, of which the last B samples
+ * are free of circular aliasing.
+ *
+ * The real FFT of size N is computed with a complex FFT of size B on the
+ * even/odd sample pairs. All spectra hold B + 1 complex bins, stored as
+ * interleaved real and imaginary parts. The inverse transform is not
+ * normalized, the 1/N factor is folded into the partition spectra. */
+
+struct pa_convolver {
+    unsigned block_size;
+    unsigned n_bins;
+    unsigned n_partitions;
+    unsigned n_inputs;
+    unsigned n_outputs;
+
+    /* Complex FFT of size block_size */
+    unsigned *bitrev;
+    float *twiddle;
+
+    /* e^(-2 pi i k / N) for the real FFT pre- and post-processing */
+    float *rtwiddle;
+
+    /* n_inputs windows of 2 * block_size samples, the previous and the
+     * current block */
+    float *input;
+    /* n_outputs blocks of block_size samples */
+    float *output;
+    unsigned pos;
+
+    float *fdl;
+    unsigned fdl_head;
+
+    float *filters;
+    /* Number of non-empty partitions per filter, 0 if unset */
+    unsigned *filter_partitions;
+
+    float *fft_buf;
+    float *time_buf;
+    float *acc;
+};
+
+static void fft(pa_convolver *c, float *z, bool inverse) {
+    const unsigned n = c->block_size;
+    unsigned i, j, len;
+
+    for (i = 0; i < n; i++) {
+        j = c->bitrev[i];
+
+        if (i < j) {
+            float t;
+
+            t = z[2 * i]; z[2 * i] = z[2 * j]; z[2 * j] = t;
+            t = z[2 * i + 1]; z[2 * i + 1] = z[2 * j + 1]; z[2 * j + 1] = t;
+        }
+    }
+
+    for (len = 2; len <= n; len <<= 1) {
+        const unsigned half = len / 2, step = n / len;
+
+        for (i = 0; i < n; i += len) {
+            for (j = 0; j < half; j++) {
+                float wr = c->twiddle[2 * j * step];
+                float wi = inverse ? -c->twiddle[2 * j * step + 1] : c->twiddle[2 * j * step + 1];
+                float *u = z + 2 * (i + j), *v = z + 2 * (i + j + half);
+                float vr = v[0] * wr - v[1] * wi;
+                float vi = v[0] * wi + v[1] * wr;
+
+                v[0] = u[0] - vr;
+                v[1] = u[1] - vi;
+                u[0] += vr;
+                u[1] += vi;
+            }
+        }
+    }
+}
+
+/* Real FFT of the 2 * block_size samples in x into block_size + 1 bins */
+static void rfft(pa_convolver *c, const float *x, float *X) {
+    const unsigned n = c->block_size;
+    float *z = c->fft_buf;
+    unsigned k;
+
+    /* The samples are already laid out as complex pairs (even, odd) */
+    memcpy(z, x, 2 * n * sizeof(float));
+    fft(c, z, false);
+
+    X[0] = z[0] + z[1];
+    X[1] = 0;
+    X[2 * n] = z[0] - z[1];
+    X[2 * n + 1] = 0;
+
+    for (k = 1; k < n; k++) {
+        /* E = (Z[k] + conj(Z[n - k])) / 2, O = (Z[k] - conj(Z[n - k])) / 2i */
+        float er = 0.5f * (z[2 * k] + z[2 * (n - k)]);
+        float ei = 0.5f * (z[2 * k + 1] - z[2 * (n - k) + 1]);
+        float o_r = 0.5f * (z[2 * k + 1] + z[2 * (n - k) + 1]);
+        float o_i = -0.5f * (z[2 * k] - z[2 * (n - k)]);
+        float wr = c->rtwiddle[2 * k], wi = c->rtwiddle[2 * k + 1];
+
+        X[2 * k] = er + o_r * wr - o_i * wi;
+        X[2 * k + 1] = ei + o_r * wi + o_i * wr;
+    }
+}
+
+/* Inverse of rfft(), scaled by 2 * block_size. The result is left in
+ * c->fft_buf. */
+static void irfft(pa_convolver *c, const float *X) {
+    const unsigned n = c->block_size;
+    float *z = c->fft_buf;
+    unsigned k;
+
+    for (k = 0; k < n; k++) {
+        /* 2E = X[k] + conj(X[n - k]), 2O = (X[k] - conj(X[n - k])) * w^-k */
+        float er = X[2 * k] + X[2 * (n - k)];
+        float ei = X[2 * k + 1] - X[2 * (n - k) + 1];
+        float dr = X[2 * k] - X[2 * (n - k)];
+        float di = X[2 * k + 1] + X[2 * (n - k) + 1];
+        float wr = c->rtwiddle[2 * k], wi = -c->rtwiddle[2 * k + 1];
+        float o_r = dr * wr - di * wi;
+        float o_i = dr * wi + di * wr;
+
+        /* Z = E + iO */
+        z[2 * k] = er - o_i;
+        z[2 * k + 1] = ei + o_r;
+    }
+
+    fft(c, z, true);
+}
+
+static float *fdl_slot(pa_convolver *c, unsigned input, unsigned slot) {
+    return c->fdl + ((size_t) input * c->n_partitions + slot) * 2 * c->n_bins;
+}
+
+static float *filter_partition(pa_convolver *c, unsigned input, unsigned output, unsigned partition) {
+    return c->filters + (((size_t) input * c->n_outputs + output) * c->n_partitions + partition) * 2 * c->n_bins;
+}
+
+pa_convolver *pa_convolver_new(unsigned block_size, size_t max_filter_length, unsigned n_inputs, unsigned n_outputs) {
+    pa_convolver *c;
+    unsigned i, bits;
+
+    pa_assert(block_size >= 4);
+    pa_assert(pa_is_power_of_two(block_size));
+    pa_assert(max_filter_length > 0);
+    pa_assert(n_inputs > 0);
+    pa_assert(n_outputs > 0);
+
+    c = pa_xnew0(pa_convolver, 1);
+    c->block_size = block_size;
+    c->n_bins = block_size + 1;
+    c->n_partitions = (unsigned) ((max_filter_length + block_size - 1) / block_size);
+    c->n_inputs = n_inputs;
+    c->n_outputs = n_outputs;
+
+    c->bitrev = pa_xnew(unsigned, block_size);
+    for (bits = 0; (1U << bits) < block_size; bits++)
+        ;
+    for (i = 0; i < block_size; i++) {
+        unsigned b, r = 0;
+
+        for (b = 0; b < bits; b++)
+            if (i & (1U << b))
+                r |= 1U << (bits - 1 - b);
+
+        c->bitrev[i] = r;
+    }
+
+    c->twiddle = pa_xnew(float, block_size);
+    for (i = 0; i < block_size / 2; i++) {
+        c->twiddle[2 * i] = (float) cos(-2.0 * M_PI * i / block_size);
+        c->twiddle[2 * i + 1] = (float) sin(-2.0 * M_PI * i / block_size);
+    }
+
+    c->rtwiddle = pa_xnew(float, 2 * block_size);
+    for (i = 0; i < block_size; i++) {
+        c->rtwiddle[2 * i] = (float) cos(-M_PI * i / block_size);
+        c->rtwiddle[2 * i + 1] = (float) sin(-M_PI * i / block_size);
+    }
+
+    c->input = pa_xnew0(float, (size_t) n_inputs * 2 * block_size);
+    c->output = pa_xnew0(float, (size_t) n_outputs * block_size);
+    c->fdl = pa_xnew0(float, (size_t) n_inputs * c->n_partitions * 2 * c->n_bins);
+    c->filters = pa_xnew0(float, (size_t) n_inputs * n_outputs * c->n_partitions * 2 * c->n_bins);
+    c->filter_partitions = pa_xnew0(unsigned, (size_t) n_inputs * n_outputs);
+
+    c->fft_buf = pa_xnew(float, 2 * block_size);
+    c->time_buf = pa_xnew(float, 2 * block_size);
+    c->acc = pa_xnew(float, 2 * c->n_bins);
+
+    return c;
+}
+
+void pa_convolver_free(pa_convolver *c) {
+    pa_assert(c);
+
+    pa_xfree(c->bitrev);
+    pa_xfree(c->twiddle);
+    pa_xfree(c->rtwiddle);
+    pa_xfree(c->input);
+    pa_xfree(c->output);
+    pa_xfree(c->fdl);
+    pa_xfree(c->filters);
+    pa_xfree(c->filter_partitions);
+    pa_xfree(c->fft_buf);
+    pa_xfree(c->time_buf);
+    pa_xfree(c->acc);
+    pa_xfree(c);
+}
+
+void pa_convolver_set_filter(pa_convolver *c, unsigned input, unsigned output, const float *ir, size_t length, size_t stride) {
+    const unsigned n = c->block_size;
+    const float scale = 1.0f / (2 * n);
+    unsigned p, j, k;
+
+    pa_assert(c);
+    pa_assert(input < c->n_inputs);
+    pa_assert(output < c->n_outputs);
+
+    if (!ir) {
+        c->filter_partitions[input * c->n_outputs + output] = 0;
+        return;
+    }
+
+    pa_assert(stride > 0);
+    pa_assert(length <= (size_t) c->n_partitions * n);
+
+    for (p = 0; p < c->n_partitions; p++) {
+        float *H = filter_partition(c, input, output, p);
+
+        /* Partition taps in the first half, zero padded */
+        memset(c->time_buf, 0, 2 * n * sizeof(float));
+        for (j = 0; j < n && (size_t) p * n + j < length; j++)
+            c->time_buf[j] = ir[((size_t) p * n + j) * stride];
+
+        rfft(c, c->time_buf, H);
+
+        for (k = 0; k < 2 * c->n_bins; k++)
+            H[k] *= scale;
+    }
+
+    c->filter_partitions[input * c->n_outputs + output] = (unsigned) ((length + n - 1) / n);
+}
+
+void pa_convolver_reset(pa_convolver *c) {
+    pa_assert(c);
+
+    memset(c->input, 0, (size_t) c->n_inputs * 2 * c->block_size * sizeof(float));
+    memset(c->output, 0, (size_t) c->n_outputs * c->block_size * sizeof(float));
+    memset(c->fdl, 0, (size_t) c->n_inputs * c->n_partitions * 2 * c->n_bins * sizeof(float));
+    c->pos = 0;
+    c->fdl_head = 0;
+}
+
+static void process_block(pa_convolver *c) {
+    const unsigned n = c->block_size;
+    unsigned i, o, p, k;
+
+    for (i = 0; i < c->n_inputs; i++) {
+        float *window = c->input + (size_t) i * 2 * n;
+
+        rfft(c, window, fdl_slot(c, i, c->fdl_head));
+
+        /* The current block becomes the previous one */
+        memcpy(window, window + n, n * sizeof(float));
+    }
+
+    for (o = 0; o < c->n_outputs; o++) {
+        bool any = false;
+
+        memset(c->acc, 0, 2 * c->n_bins * sizeof(float));
+
+        for (i = 0; i < c->n_inputs; i++) {
+            unsigned n_parts = c->filter_partitions[i * c->n_outputs + o];
+
+            for (p = 0; p < n_parts; p++) {
+                unsigned slot = (c->fdl_head + c->n_partitions - p) % c->n_partitions;
+                const float *X = fdl_slot(c, i, slot);
+                const float *H = filter_partition(c, i, o, p);
+
+                for (k = 0; k < 2 * c->n_bins; k += 2) {
+                    c->acc[k] += X[k] * H[k] - X[k + 1] * H[k + 1];
+                    c->acc[k + 1] += X[k] * H[k + 1] + X[k + 1] * H[k];
+                }
+
+                any = true;
+            }
+        }
+
+        if (any) {
+            irfft(c, c->acc);
+            memcpy(c->output + (size_t) o * n, c->fft_buf + n, n * sizeof(float));
+        } else
+            memset(c->output + (size_t) o * n, 0, n * sizeof(float));
+    }
+
+    c->fdl_head = (c->fdl_head + 1) % c->n_partitions;
+}
+
+void pa_convolver_process(pa_convolver *c, const float *src, float *dst, unsigned n_frames) {
+    const unsigned n = c->block_size;
+
+    pa_assert(c);
+    pa_assert(src);
+
+    while (n_frames > 0) {
+        unsigned count = PA_MIN(n_frames, n - c->pos);
+        unsigned f, i, o;
+
+        for (f = 0; f < count; f++) {
+            for (i = 0; i < c->n_inputs; i++)
+                c->input[(size_t) i * 2 * n + n + c->pos + f] = *(src++);
+
+            if (dst)
+                for (o = 0; o < c->n_outputs; o++)
+                    *(dst++) = c->output[(size_t) o * n + c->pos + f];
+        }
+
+        c->pos += count;
+        n_frames -= count;
+
+        if (c->pos >= n) {
+            process_block(c);
+            c->pos = 0;
+        }
+    }
+}
+
+unsigned pa_convolver_get_latency(pa_convolver *c) {
+    pa_assert(c);
+
+    return c->block_size;
+}
+
+unsigned pa_convolver_get_history(pa_convolver *c) {
+    pa_assert(c);
+
+    /* The output lags one block behind, and the oldest output sample still
+     * to come needs the full filter length of input before it */
+    return (c->n_partitions + 1) * c->block_size;
+}
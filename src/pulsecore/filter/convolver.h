@@ -0,0 +1,58 @@
+#ifndef fooconvolverhfoo
+#define fooconvolverhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stddef.h>
+
+/* Uniformly partitioned overlap-save FFT convolver.
+ *
+ * Convolves n_inputs interleaved float channels with a matrix of impulse
+ * responses and writes n_outputs interleaved channels, where each output is
+ * the sum of all inputs convolved with their respective filter. The impulse
+ * responses are split into partitions of block_size samples, so the cost per
+ * sample grows with the number of partitions instead of the filter length.
+ *
+ * The output is delayed by exactly block_size frames against the input. */
+
+typedef struct pa_convolver pa_convolver;
+
+/* block_size must be a power of two, at least 4 */
+pa_convolver *pa_convolver_new(unsigned block_size, size_t max_filter_length, unsigned n_inputs, unsigned n_outputs);
+void pa_convolver_free(pa_convolver *c);
+
+/* Sets the impulse response from input to output. Successive filter taps are
+ * stride floats apart, so a channel of interleaved data can be passed
+ * directly. A NULL ir removes the filter. */
+void pa_convolver_set_filter(pa_convolver *c, unsigned input, unsigned output, const float *ir, size_t length, size_t stride);
+
+/* Forget all past input */
+void pa_convolver_reset(pa_convolver *c);
+
+/* dst may be NULL to only feed input, e.g. when refilling the history */
+void pa_convolver_process(pa_convolver *c, const float *src, float *dst, unsigned n_frames);
+
+/* Returns the delay of the output in frames */
+unsigned pa_convolver_get_latency(pa_convolver *c);
+
+/* Returns the number of past input frames that future output depends on.
+ * Processing that many frames after pa_convolver_reset() brings the convolver
+ * back into the state it had after the same frames the first time. */
+unsigned pa_convolver_get_history(pa_convolver *c);
+
+#endif
@@ -0,0 +1,119 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/strbuf.h>
+
+#include "io-stats.h"
+
+/* Upper bounds of the lateness buckets in usec */
+static const pa_usec_t lateness_bounds[PA_IO_STATS_LATENESS_BUCKETS - 1] = {
+    10, 20, 50, 100, 200, 500,
+    1000, 2000, 5000, 10000, 20000
+};
+
+static const char * const stage_names[PA_IO_STAGE_MAX] = {
+    [PA_IO_STAGE_DEVICE] = "device",
+    [PA_IO_STAGE_MIX] = "mix",
+    [PA_IO_STAGE_STREAM] = "stream",
+    [PA_IO_STAGE_RESAMPLE] = "resample",
+};
+
+void pa_io_stats_reset(pa_io_stats *s) {
+    pa_assert(s);
+
+    pa_zero(*s);
+}
+
+void pa_io_stats_add_lateness(pa_io_stats *s, pa_usec_t lateness) {
+    unsigned i;
+
+    pa_assert(s);
+
+    for (i = 0; i < PA_IO_STATS_LATENESS_BUCKETS - 1; i++)
+        if (lateness < lateness_bounds[i])
+            break;
+
+    s->timer_wakeups++;
+    s->lateness[i]++;
+
+    if (lateness > s->lateness_max)
+        s->lateness_max = lateness;
+}
+
+void pa_io_stats_merge(pa_io_stats *dest, const pa_io_stats *stages, const pa_io_stats *thread) {
+    pa_assert(dest);
+    pa_assert(stages);
+    pa_assert(thread);
+
+    *dest = *thread;
+    memcpy(dest->stage, stages->stage, sizeof(dest->stage));
+}
+
+char *pa_io_stats_to_string(const pa_io_stats *s) {
+    pa_strbuf *buf;
+    pa_usec_t total;
+    unsigned i;
+
+    pa_assert(s);
+
+    buf = pa_strbuf_new();
+
+    total = s->busy + s->idle;
+    pa_strbuf_printf(buf, "loops: %llu, busy: %llu usec (%0.1f%%), idle: %llu usec\n",
+                     (unsigned long long) s->loops,
+                     (unsigned long long) s->busy,
+                     total > 0 ? (double) s->busy * 100.0 / (double) total : 0.0,
+                     (unsigned long long) s->idle);
+    pa_strbuf_printf(buf, "busy per loop: avg: %llu usec, max: %llu usec\n",
+                     (unsigned long long) (s->loops > 0 ? s->busy / s->loops : 0),
+                     (unsigned long long) s->busy_max);
+
+    for (i = 0; i < PA_IO_STAGE_MAX; i++) {
+        const pa_io_stage_stats *t = &s->stage[i];
+
+        pa_strbuf_printf(buf, "%s: calls: %llu, total: %llu usec, avg: %llu usec, max: %llu usec\n",
+                         stage_names[i],
+                         (unsigned long long) t->count,
+                         (unsigned long long) t->total,
+                         (unsigned long long) (t->count > 0 ? t->total / t->count : 0),
+                         (unsigned long long) t->max);
+    }
+
+    pa_strbuf_printf(buf, "timer wakeups: %llu, max lateness: %llu usec\n",
+                     (unsigned long long) s->timer_wakeups,
+                     (unsigned long long) s->lateness_max);
+
+    for (i = 0; i < PA_IO_STATS_LATENESS_BUCKETS; i++) {
+        if (i < PA_IO_STATS_LATENESS_BUCKETS - 1)
+            pa_strbuf_printf(buf, "lateness < %llu usec: %llu\n",
+                             (unsigned long long) lateness_bounds[i],
+                             (unsigned long long) s->lateness[i]);
+        else
+            pa_strbuf_printf(buf, "lateness >= %llu usec: %llu\n",
+                             (unsigned long long) lateness_bounds[i - 1],
+                             (unsigned long long) s->lateness[i]);
+    }
+
+    return pa_strbuf_to_string_free(buf);
+}
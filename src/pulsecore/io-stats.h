@@ -0,0 +1,81 @@
+#ifndef foopulseiostatshfoo
+#define foopulseiostatshfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <inttypes.h>
+
+#include <pulse/sample.h>
+
+/* Accounting of where an IO thread spends its time. The counters are only
+ * ever touched from the IO thread that owns them; other threads get a copy by
+ * sending a message to it. Stages nest: the device stage of a sink includes
+ * mixing, which includes peeking from the streams, which includes
+ * resampling. The time a filter sink spends is accounted in its own stats
+ * and in the stream stage of its master. */
+
+typedef enum pa_io_stage {
+    PA_IO_STAGE_DEVICE,     /* Reading from or writing to the device */
+    PA_IO_STAGE_MIX,        /* pa_sink_render*(), pa_source_post*() */
+    PA_IO_STAGE_STREAM,     /* pa_sink_input_peek(), pa_source_output_push() */
+    PA_IO_STAGE_RESAMPLE,   /* pa_resampler_run() on stream data */
+    PA_IO_STAGE_MAX
+} pa_io_stage_t;
+
+/* Wakeup lateness buckets, the last one is open ended */
+#define PA_IO_STATS_LATENESS_BUCKETS 12
+
+typedef struct pa_io_stage_stats {
+    uint64_t count;
+    pa_usec_t total;
+    pa_usec_t max;
+} pa_io_stage_stats;
+
+typedef struct pa_io_stats {
+    pa_io_stage_stats stage[PA_IO_STAGE_MAX];
+
+    /* Per thread, maintained by pa_rtpoll */
+    uint64_t loops;
+    pa_usec_t busy, idle;
+    pa_usec_t busy_max;     /* Longest single iteration */
+
+    /* How late the thread woke up when its timer elapsed */
+    uint64_t timer_wakeups;
+    uint64_t lateness[PA_IO_STATS_LATENESS_BUCKETS];
+    pa_usec_t lateness_max;
+} pa_io_stats;
+
+static inline void pa_io_stats_add(pa_io_stats *s, pa_io_stage_t stage, pa_usec_t usec) {
+    pa_io_stage_stats *t = &s->stage[stage];
+
+    t->count++;
+    t->total += usec;
+
+    if (usec > t->max)
+        t->max = usec;
+}
+
+void pa_io_stats_reset(pa_io_stats *s);
+void pa_io_stats_add_lateness(pa_io_stats *s, pa_usec_t lateness);
+
+/* Combine the stage counters of stages with the thread counters of thread */
+void pa_io_stats_merge(pa_io_stats *dest, const pa_io_stats *stages, const pa_io_stats *thread);
+
+char *pa_io_stats_to_string(const pa_io_stats *s);
+
+#endif
@@ -0,0 +1,146 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/poll.h>
+#include <pulsecore/thread.h>
+
+#include "io-worker.h"
+
+struct pa_io_worker {
+    pa_mainloop *mainloop;
+    pa_mutex *mutex;
+    pa_thread *thread;
+    pa_thread_mq thread_mq;
+    bool thread_mq_initialized;
+};
+
+static int poll_func(struct pollfd *ufds, unsigned long nfds, int timeout, void *userdata) {
+    pa_io_worker *w = userdata;
+    int r;
+
+    /* Messages that did not fit into the outq are only pushed on from
+     * here. The thread_mq does that when the main loop made room, but it
+     * only waits for that if the queue was full last time it looked. */
+    pa_asyncmsgq_write_after_poll(w->thread_mq.outq);
+    pa_asyncmsgq_write_before_poll(w->thread_mq.outq);
+
+    /* Let other threads in while we sleep */
+    pa_mutex_unlock(w->mutex);
+    r = pa_poll(ufds, nfds, timeout);
+    pa_mutex_lock(w->mutex);
+
+    return r;
+}
+
+static void thread_func(void *userdata) {
+    pa_io_worker *w = userdata;
+
+    pa_log_debug("Thread starting up");
+
+    pa_thread_mq_install(&w->thread_mq);
+
+    pa_mutex_lock(w->mutex);
+    (void) pa_mainloop_run(w->mainloop, NULL);
+    pa_mutex_unlock(w->mutex);
+
+    pa_log_debug("Thread shutting down");
+}
+
+pa_io_worker *pa_io_worker_new(pa_mainloop_api *main_mainloop, const char *name) {
+    pa_io_worker *w;
+
+    pa_assert(main_mainloop);
+    pa_assert(name);
+
+    w = pa_xnew0(pa_io_worker, 1);
+
+    if (!(w->mainloop = pa_mainloop_new()))
+        goto fail;
+
+    w->mutex = pa_mutex_new(true, false);
+
+    if (pa_thread_mq_init_thread_mainloop(&w->thread_mq, main_mainloop, pa_mainloop_get_api(w->mainloop)) < 0)
+        goto fail;
+    w->thread_mq_initialized = true;
+
+    pa_mainloop_set_poll_func(w->mainloop, poll_func, w);
+
+    if (!(w->thread = pa_thread_new(name, thread_func, w))) {
+        pa_log("Failed to create thread.");
+        goto fail;
+    }
+
+    return w;
+
+fail:
+    pa_io_worker_free(w);
+    return NULL;
+}
+
+void pa_io_worker_free(pa_io_worker *w) {
+    pa_assert(w);
+
+    if (w->thread) {
+        pa_asyncmsgq_send(w->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+        pa_thread_free(w->thread);
+    }
+
+    if (w->thread_mq_initialized)
+        pa_thread_mq_done(&w->thread_mq);
+
+    if (w->mainloop)
+        pa_mainloop_free(w->mainloop);
+
+    if (w->mutex)
+        pa_mutex_free(w->mutex);
+
+    pa_xfree(w);
+}
+
+pa_mainloop_api *pa_io_worker_get_api(pa_io_worker *w) {
+    pa_assert(w);
+
+    return pa_mainloop_get_api(w->mainloop);
+}
+
+pa_mutex *pa_io_worker_get_lock(pa_io_worker *w) {
+    pa_assert(w);
+
+    return w->mutex;
+}
+
+void pa_io_worker_lock(pa_io_worker *w) {
+    pa_assert(w);
+
+    pa_mutex_lock(w->mutex);
+}
+
+void pa_io_worker_unlock(pa_io_worker *w) {
+    pa_assert(w);
+
+    pa_mutex_unlock(w->mutex);
+}
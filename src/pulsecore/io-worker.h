@@ -0,0 +1,43 @@
+#ifndef foopulseioworkerhfoo
+#define foopulseioworkerhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <pulse/mainloop-api.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/thread-mq.h>
+
+/* A pa_mainloop running in a thread of its own, to take socket I/O off the
+ * main loop. Events are dispatched with the worker's lock held, other
+ * threads need to hold it too while they touch anything that belongs to the
+ * worker's main loop. The worker's pa_thread_mq is installed for its thread,
+ * so messages posted to its outq are dispatched in the main loop. */
+
+typedef struct pa_io_worker pa_io_worker;
+
+pa_io_worker *pa_io_worker_new(pa_mainloop_api *main_mainloop, const char *name);
+void pa_io_worker_free(pa_io_worker *w);
+
+pa_mainloop_api *pa_io_worker_get_api(pa_io_worker *w);
+
+/* The lock is recursive */
+pa_mutex *pa_io_worker_get_lock(pa_io_worker *w);
+void pa_io_worker_lock(pa_io_worker *w);
+void pa_io_worker_unlock(pa_io_worker *w);
+
+#endif
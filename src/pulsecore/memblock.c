@@ -45,6 +45,7 @@
 #include <pulsecore/refcnt.h>
 #include <pulsecore/llist.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/thread.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/memtrap.h>
 
@@ -57,6 +58,26 @@
 #define PA_MEMPOOL_SLOTS_MAX 1024
 #define PA_MEMPOOL_SLOT_SIZE (64*1024)
 
+/* Slots may be split into smaller ones for small blocks, like a slab
+ * allocator: each size class is a quarter of the one before, down to
+ * 1 KiB. At most 1/PA_MEMPOOL_SPLIT_DIVISOR of the slots is split for
+ * each class, so that full size slots remain available, and no class
+ * gets more than PA_MEMPOOL_SPLIT_SLOTS_FACTOR times as many slots as
+ * the pool has full size ones. Split slots are merged again when the
+ * pool is vacuumed. */
+#define PA_MEMPOOL_SLOT_CLASSES 4
+#define PA_MEMPOOL_SLOT_CLASS_SHIFT 2
+#define PA_MEMPOOL_SPLIT_DIVISOR 4
+#define PA_MEMPOOL_SPLIT_SLOTS_FACTOR 4
+
+/* Every thread allocates from and frees to one of up to
+ * PA_MEMPOOL_CACHES_MAX small per-pool slot caches before touching the
+ * free lists shared by all threads. Cache misses and overflows move
+ * PA_MEMPOOL_CACHE_BATCH slots at once. */
+#define PA_MEMPOOL_CACHES_MAX 32
+#define PA_MEMPOOL_CACHE_SIZE 16
+#define PA_MEMPOOL_CACHE_BATCH 8
+
 #define PA_MEMEXPORT_SLOTS_MAX 128
 
 #define PA_MEMIMPORT_SLOTS_MAX 160
@@ -197,8 +218,29 @@ struct pa_mempool {
     PA_LLIST_HEAD(pa_memimport, imports);
     PA_LLIST_HEAD(pa_memexport, exports);
 
-    /* A list of free slots that may be reused */
-    pa_flist *free_slots;
+    /* Size classes, class 0 are the slots of block_size */
+    unsigned n_classes;
+    size_t class_size[PA_MEMPOOL_SLOT_CLASSES];
+    pa_atomic_t n_split[PA_MEMPOOL_SLOT_CLASSES];
+    unsigned max_split[PA_MEMPOOL_SLOT_CLASSES];
+
+    /* For each slot of block_size, the class it has been split into.
+     * mempool_new_slot() sets it before any of the split slots is pushed
+     * to a free list or handed out. pa_mempool_vacuum() sets it back to
+     * 0 when it merges a slot, which it only does once all parts have
+     * been popped off the free lists and no block uses them, and before
+     * the merged slot is pushed to free_slots[0]. So whoever holds a slot
+     * always reads the class it was split with. */
+    uint8_t *slot_class;
+
+    /* Lists of free slots that may be reused, one per class */
+    pa_flist *free_slots[PA_MEMPOOL_SLOT_CLASSES];
+
+    /* n_caches * n_classes per-thread caches of free slots, and how
+     * many slots each of them holds */
+    unsigned n_caches;
+    pa_flist **caches;
+    pa_atomic_t *cache_fill;
 
     pa_mempool_stat stat;
 };
@@ -207,6 +249,9 @@ static void segment_detach(pa_memimport_segment *seg);
 
 PA_STATIC_FLIST_DECLARE(unused_memblocks, 0, pa_xfree);
 
+PA_STATIC_TLS_DECLARE_NO_FREE(mempool_cache_index);
+static pa_atomic_t mempool_cache_next = PA_ATOMIC_INIT(0);
+
 /* No lock necessary */
 static void stat_add(pa_memblock*b) {
     pa_assert(b);
@@ -258,8 +303,10 @@ pa_memblock *pa_memblock_new(pa_mempool *p, size_t length) {
     pa_assert(p);
     pa_assert(length);
 
-    if (!(b = pa_memblock_new_pool(p, length)))
+    if (!(b = pa_memblock_new_pool(p, length))) {
+        pa_atomic_inc(&p->stat.n_pool_fallbacks);
         b = memblock_new_appended(p, length);
+    }
 
     return b;
 }
@@ -292,28 +339,183 @@ static pa_memblock *memblock_new_appended(pa_mempool *p, size_t length) {
 }
 
 /* No lock necessary */
-static struct mempool_slot* mempool_allocate_slot(pa_mempool *p) {
+static unsigned mempool_cache_index(void) {
+    void *idx;
+
+    /* Threads are numbered in the order they first allocate, the
+     * number is shared by all pools */
+    if (!(idx = PA_STATIC_TLS_GET(mempool_cache_index))) {
+        idx = PA_UINT_TO_PTR((unsigned) pa_atomic_inc(&mempool_cache_next) + 1);
+        PA_STATIC_TLS_SET(mempool_cache_index, idx);
+    }
+
+    return PA_PTR_TO_UINT(idx) - 1;
+}
+
+/* No lock necessary */
+static unsigned mempool_cache(pa_mempool *p, unsigned class) {
+    return (mempool_cache_index() % p->n_caches) * p->n_classes + class;
+}
+
+/* No lock necessary */
+static struct mempool_slot* mempool_cache_pop(pa_mempool *p, unsigned cache) {
     struct mempool_slot *slot;
-    pa_assert(p);
 
-    if (!(slot = pa_flist_pop(p->free_slots))) {
-        int idx;
+    if ((slot = pa_flist_pop(p->caches[cache])))
+        pa_atomic_dec(&p->cache_fill[cache]);
 
-        /* The free list was empty, we have to allocate a new entry */
+    return slot;
+}
+
+/* Pushing into a full flist fails only after logging, so the fill level
+ * is checked first. The counter is raised before pushing and lowered
+ * after popping, hence it never counts fewer slots than the cache holds
+ * and the push cannot fail once the counter had room. No lock
+ * necessary */
+static bool mempool_cache_push(pa_mempool *p, unsigned cache, struct mempool_slot *slot) {
+    if (pa_atomic_inc(&p->cache_fill[cache]) >= PA_MEMPOOL_CACHE_SIZE) {
+        pa_atomic_dec(&p->cache_fill[cache]);
+        return false;
+    }
+
+    pa_assert_se(pa_flist_push(p->caches[cache], slot) >= 0);
+    return true;
+}
+
+/* No lock necessary */
+static unsigned mempool_slot_class(pa_mempool *p, size_t size) {
+    unsigned class = 0;
+
+    pa_assert(size <= p->block_size);
+
+    while (class + 1 < p->n_classes && p->class_size[class + 1] >= size)
+        class++;
+
+    return class;
+}
+
+/* No lock necessary */
+static struct mempool_slot* mempool_new_slot(pa_mempool *p, unsigned class) {
+    struct mempool_slot *slot = NULL;
+    unsigned i, n;
+
+    pa_assert(class < p->n_classes);
+
+    if (class == 0) {
+        int idx;
 
         if ((unsigned) (idx = pa_atomic_inc(&p->n_init)) >= p->n_blocks)
             pa_atomic_dec(&p->n_init);
         else
             slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) idx));
 
-        if (!slot) {
-            if (pa_log_ratelimit(PA_LOG_DEBUG))
-                pa_log_debug("Pool full");
-            pa_atomic_inc(&p->stat.n_pool_full);
+        return slot;
+    }
+
+    if ((unsigned) pa_atomic_inc(&p->n_split[class]) >= p->max_split[class]) {
+        pa_atomic_dec(&p->n_split[class]);
+        return NULL;
+    }
+
+    if (!(slot = pa_flist_pop(p->free_slots[0])) && !(slot = mempool_new_slot(p, 0))) {
+        pa_atomic_dec(&p->n_split[class]);
+        return NULL;
+    }
+
+    /* Split a full size slot: keep the first part, share the others */
+    p->slot_class[(size_t) ((uint8_t*) slot - (uint8_t*) p->memory.ptr) / p->block_size] = (uint8_t) class;
+
+    n = (unsigned) (p->block_size / p->class_size[class]);
+    for (i = 1; i < n; i++)
+        while (pa_flist_push(p->free_slots[class], (uint8_t*) slot + i * p->class_size[class]) < 0)
+            ;
+
+    return slot;
+}
+
+/* No lock necessary */
+static struct mempool_slot* mempool_allocate_slot_class(pa_mempool *p, unsigned class) {
+    struct mempool_slot *slot;
+    unsigned cache, i;
+
+    cache = mempool_cache(p, class);
+
+    if ((slot = mempool_cache_pop(p, cache))) {
+        pa_atomic_inc(&p->stat.n_slot_cache_hits);
+        return slot;
+    }
+
+    pa_atomic_inc(&p->stat.n_slot_cache_misses);
+
+    if (!(slot = pa_flist_pop(p->free_slots[class])))
+        /* The free list was empty, we have to allocate a new entry */
+        if (!(slot = mempool_new_slot(p, class)))
             return NULL;
+
+    /* Refill the cache so that the next allocations of this thread
+     * do not need to touch the shared list */
+    for (i = 1; i < PA_MEMPOOL_CACHE_BATCH; i++) {
+        struct mempool_slot *s;
+
+        if (!(s = pa_flist_pop(p->free_slots[class])))
+            break;
+
+        if (!mempool_cache_push(p, cache, s)) {
+            while (pa_flist_push(p->free_slots[class], s) < 0)
+                ;
+            break;
+        }
+    }
+
+    return slot;
+}
+
+/* Moves all cached slots to the shared lists. No lock necessary */
+static void mempool_flush_caches(pa_mempool *p) {
+    unsigned i;
+
+    for (i = 0; i < p->n_caches * p->n_classes; i++) {
+        struct mempool_slot *slot;
+
+        while ((slot = mempool_cache_pop(p, i)))
+            while (pa_flist_push(p->free_slots[i % p->n_classes], slot) < 0)
+                ;
+    }
+}
+
+/* No lock necessary */
+static struct mempool_slot* mempool_allocate_slot(pa_mempool *p, size_t size) {
+    struct mempool_slot *slot = NULL;
+    unsigned class, attempt;
+
+    pa_assert(p);
+
+    /* Fall back to larger classes if the best fitting one is exhausted.
+     * If all are, the remaining free slots might be sitting in the caches
+     * of other threads, so collect those and try once more. */
+    for (attempt = 0; attempt < 2 && !slot; attempt++) {
+        if (attempt > 0)
+            mempool_flush_caches(p);
+
+        class = mempool_slot_class(p, size);
+        for (;;) {
+            if ((slot = mempool_allocate_slot_class(p, class)))
+                break;
+
+            if (class == 0)
+                break;
+
+            class--;
         }
     }
 
+    if (!slot) {
+        if (pa_log_ratelimit(PA_LOG_DEBUG))
+            pa_log_debug("Pool full");
+        pa_atomic_inc(&p->stat.n_pool_full);
+        return NULL;
+    }
+
 /* #ifdef HAVE_VALGRIND_MEMCHECK_H */
 /*     if (PA_UNLIKELY(pa_in_valgrind())) { */
 /*         VALGRIND_MALLOCLIKE_BLOCK(slot, p->block_size, 0, 0); */
@@ -323,6 +525,32 @@ static struct mempool_slot* mempool_allocate_slot(pa_mempool *p) {
     return slot;
 }
 
+/* No lock necessary */
+static void mempool_free_slot(pa_mempool *p, struct mempool_slot *slot, unsigned class) {
+    unsigned cache, i;
+
+    cache = mempool_cache(p, class);
+
+    if (mempool_cache_push(p, cache, slot))
+        return;
+
+    /* The cache is full, hand a batch back to the shared list. The free
+     * list dimensions should easily allow all slots to fit in, hence try
+     * harder if pushing into it fails */
+    for (i = 0; i < PA_MEMPOOL_CACHE_BATCH; i++) {
+        struct mempool_slot *s;
+
+        if (!(s = mempool_cache_pop(p, cache)))
+            break;
+
+        while (pa_flist_push(p->free_slots[class], s) < 0)
+            ;
+    }
+
+    while (pa_flist_push(p->free_slots[class], slot) < 0)
+        ;
+}
+
 /* No lock necessary, totally redundant anyway */
 static inline void* mempool_slot_data(struct mempool_slot *slot) {
     return slot;
@@ -339,13 +567,20 @@ static unsigned mempool_slot_idx(pa_mempool *p, void *ptr) {
 }
 
 /* No lock necessary */
-static struct mempool_slot* mempool_slot_by_ptr(pa_mempool *p, void *ptr) {
+static struct mempool_slot* mempool_slot_by_ptr(pa_mempool *p, void *ptr, unsigned *class) {
     unsigned idx;
+    size_t offset;
 
     if ((idx = mempool_slot_idx(p, ptr)) == (unsigned) -1)
         return NULL;
 
-    return (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (idx * p->block_size));
+    *class = p->slot_class[idx];
+
+    /* Split slots are aligned to their size within the full slot */
+    offset = (size_t) ((uint8_t*) ptr - (uint8_t*) p->memory.ptr);
+    offset -= offset % p->class_size[*class];
+
+    return (struct mempool_slot*) ((uint8_t*) p->memory.ptr + offset);
 }
 
 /* No lock necessary */
@@ -382,9 +617,12 @@ pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
     if (length == (size_t) -1)
         length = pa_mempool_block_size_max(p);
 
-    if (p->block_size >= PA_ALIGN(sizeof(pa_memblock)) + length) {
+    /* Put the memblock header into the slot only if that does not bump
+     * the block into the next larger size class */
+    if (p->block_size >= length &&
+        p->class_size[mempool_slot_class(p, length)] >= PA_ALIGN(sizeof(pa_memblock)) + length) {
 
-        if (!(slot = mempool_allocate_slot(p)))
+        if (!(slot = mempool_allocate_slot(p, PA_ALIGN(sizeof(pa_memblock)) + length)))
             return NULL;
 
         b = mempool_slot_data(slot);
@@ -393,7 +631,7 @@ pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
 
     } else if (p->block_size >= length) {
 
-        if (!(slot = mempool_allocate_slot(p)))
+        if (!(slot = mempool_allocate_slot(p, length)))
             return NULL;
 
         if (!(b = pa_flist_pop(PA_STATIC_FLIST_GET(unused_memblocks))))
@@ -643,9 +881,10 @@ static void memblock_free(pa_memblock *b) {
         case PA_MEMBLOCK_POOL_EXTERNAL:
         case PA_MEMBLOCK_POOL: {
             struct mempool_slot *slot;
+            unsigned class;
             bool call_free;
 
-            pa_assert_se(slot = mempool_slot_by_ptr(b->pool, pa_atomic_ptr_load(&b->data)));
+            pa_assert_se(slot = mempool_slot_by_ptr(b->pool, pa_atomic_ptr_load(&b->data), &class));
 
             call_free = b->type == PA_MEMBLOCK_POOL_EXTERNAL;
 
@@ -655,11 +894,7 @@ static void memblock_free(pa_memblock *b) {
 /*             } */
 /* #endif */
 
-            /* The free list dimensions should easily allow all slots
-             * to fit in, hence try harder if pushing this slot into
-             * the free list fails */
-            while (pa_flist_push(b->pool->free_slots, slot) < 0)
-                ;
+            mempool_free_slot(b->pool, slot, class);
 
             if (call_free)
                 if (pa_flist_push(PA_STATIC_FLIST_GET(unused_memblocks), b) < 0)
@@ -714,7 +949,7 @@ static void memblock_make_local(pa_memblock *b) {
     if (b->length <= b->pool->block_size) {
         struct mempool_slot *slot;
 
-        if ((slot = mempool_allocate_slot(b->pool))) {
+        if ((slot = mempool_allocate_slot(b->pool, b->length))) {
             void *new_data;
             /* We can move it into a local pool, perfect! */
 
@@ -829,6 +1064,7 @@ pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client) {
     pa_mempool *p;
     char t1[PA_BYTES_SNPRINT_MAX], t2[PA_BYTES_SNPRINT_MAX];
     const size_t page_size = pa_page_size();
+    unsigned i;
 
     p = pa_xnew0(pa_mempool, 1);
     PA_REFCNT_INIT(p);
@@ -868,12 +1104,32 @@ pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client) {
     p->mutex = pa_mutex_new(true, true);
     p->semaphore = pa_semaphore_new(0);
 
-    p->free_slots = pa_flist_new(p->n_blocks);
+    p->n_classes = PA_MEMPOOL_SLOT_CLASSES;
+    p->slot_class = pa_xnew0(uint8_t, p->n_blocks);
+
+    for (i = 0; i < p->n_classes; i++) {
+        unsigned n_per_slot;
+
+        p->class_size[i] = p->block_size >> (PA_MEMPOOL_SLOT_CLASS_SHIFT * i);
+        n_per_slot = (unsigned) (p->block_size / p->class_size[i]);
+
+        p->max_split[i] = i == 0 ? 0 : PA_MIN(p->n_blocks / PA_MEMPOOL_SPLIT_DIVISOR,
+                                               p->n_blocks * PA_MEMPOOL_SPLIT_SLOTS_FACTOR / n_per_slot);
+        p->free_slots[i] = pa_flist_new(i == 0 ? p->n_blocks : p->max_split[i] * n_per_slot);
+    }
+
+    p->n_caches = PA_CLAMP(pa_ncpus(), 1U, PA_MEMPOOL_CACHES_MAX);
+    p->caches = pa_xnew(pa_flist*, p->n_caches * p->n_classes);
+    p->cache_fill = pa_xnew0(pa_atomic_t, p->n_caches * p->n_classes);
+    for (i = 0; i < p->n_caches * p->n_classes; i++)
+        p->caches[i] = pa_flist_new_with_name(PA_MEMPOOL_CACHE_SIZE, "mempool slot cache");
 
     return p;
 }
 
 static void mempool_free(pa_mempool *p) {
+    unsigned i;
+
     pa_assert(p);
 
     pa_mutex_lock(p->mutex);
@@ -886,14 +1142,18 @@ static void mempool_free(pa_mempool *p) {
 
     pa_mutex_unlock(p->mutex);
 
-    pa_flist_free(p->free_slots, NULL);
+    mempool_flush_caches(p);
+
+    for (i = 0; i < p->n_caches * p->n_classes; i++)
+        pa_flist_free(p->caches[i], NULL);
+    pa_xfree(p->caches);
+    pa_xfree(p->cache_fill);
 
     if (pa_atomic_load(&p->stat.n_allocated) > 0) {
 
         /* Ouch, somebody is retaining a memory block reference! */
 
 #ifdef DEBUG_REF
-        unsigned i;
         pa_flist *list;
 
         /* Let's try to find at least one of those leaked memory blocks */
@@ -904,10 +1164,14 @@ static void mempool_free(pa_mempool *p) {
             struct mempool_slot *slot;
             pa_memblock *b, *k;
 
+            /* Split slots are not tracked individually */
+            if (p->slot_class[i] != 0)
+                continue;
+
             slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) i));
             b = mempool_slot_data(slot);
 
-            while ((k = pa_flist_pop(p->free_slots))) {
+            while ((k = pa_flist_pop(p->free_slots[0]))) {
                 while (pa_flist_push(list, k) < 0)
                     ;
 
@@ -919,7 +1183,7 @@ static void mempool_free(pa_mempool *p) {
                 pa_log("REF: Leaked memory block %p", b);
 
             while ((k = pa_flist_pop(list)))
-                while (pa_flist_push(p->free_slots, k) < 0)
+                while (pa_flist_push(p->free_slots[0], k) < 0)
                     ;
         }
 
@@ -932,6 +1196,10 @@ static void mempool_free(pa_mempool *p) {
 /*         PA_DEBUG_TRAP; */
     }
 
+    for (i = 0; i < p->n_classes; i++)
+        pa_flist_free(p->free_slots[i], NULL);
+    pa_xfree(p->slot_class);
+
     pa_shm_free(&p->memory);
 
     pa_mutex_free(p->mutex);
@@ -958,19 +1226,71 @@ size_t pa_mempool_block_size_max(pa_mempool *p) {
 void pa_mempool_vacuum(pa_mempool *p) {
     struct mempool_slot *slot;
     pa_flist *list;
+    unsigned *n_free;
+    unsigned i;
 
     pa_assert(p);
 
+    mempool_flush_caches(p);
+
+    n_free = pa_xnew(unsigned, p->n_blocks);
+
+    /* Merge split slots whose parts are all free back into full size
+     * ones first, so that those can be punched as a whole */
+    for (i = p->n_classes - 1; i > 0; i--) {
+        unsigned n_per_slot = (unsigned) (p->block_size / p->class_size[i]);
+
+        list = pa_flist_new(p->max_split[i] * n_per_slot);
+        memset(n_free, 0, p->n_blocks * sizeof(unsigned));
+
+        while ((slot = pa_flist_pop(p->free_slots[i]))) {
+            n_free[mempool_slot_idx(p, slot)]++;
+
+            while (pa_flist_push(list, slot) < 0)
+                ;
+        }
+
+        while ((slot = pa_flist_pop(list))) {
+            unsigned idx = mempool_slot_idx(p, slot);
+
+            if (n_free[idx] < n_per_slot) {
+                /* Slots smaller than a page cannot be punched */
+                if (p->class_size[i] >= pa_page_size())
+                    pa_shm_punch(&p->memory, (size_t) ((uint8_t*) slot - (uint8_t*) p->memory.ptr), p->class_size[i]);
+
+                while (pa_flist_push(p->free_slots[i], slot) < 0)
+                    ;
+
+                continue;
+            }
+
+            /* All parts are free and nobody else can reach them
+             * anymore. Merge on the first part, skip the others. */
+            if (n_free[idx]++ > n_per_slot)
+                continue;
+
+            p->slot_class[idx] = 0;
+            pa_atomic_dec(&p->n_split[i]);
+
+            while (pa_flist_push(p->free_slots[0], (uint8_t*) p->memory.ptr + (size_t) idx * p->block_size) < 0)
+                ;
+        }
+
+        pa_flist_free(list, NULL);
+    }
+
+    pa_xfree(n_free);
+
     list = pa_flist_new(p->n_blocks);
 
-    while ((slot = pa_flist_pop(p->free_slots)))
+    while ((slot = pa_flist_pop(p->free_slots[0])))
         while (pa_flist_push(list, slot) < 0)
             ;
 
     while ((slot = pa_flist_pop(list))) {
         pa_shm_punch(&p->memory, (size_t) ((uint8_t*) slot - (uint8_t*) p->memory.ptr), p->block_size);
 
-        while (pa_flist_push(p->free_slots, slot))
+        while (pa_flist_push(p->free_slots[0], slot))
             ;
     }
 
@@ -74,6 +74,13 @@ struct pa_mempool_stat {
     pa_atomic_t n_too_large_for_pool;
     pa_atomic_t n_pool_full;
 
+    /* Pool slots served from the allocating thread's cache or from
+     * the shared free lists, and pa_memblock_new() calls that had to
+     * fall back to malloc() */
+    pa_atomic_t n_slot_cache_hits;
+    pa_atomic_t n_slot_cache_misses;
+    pa_atomic_t n_pool_fallbacks;
+
     pa_atomic_t n_allocated_by_type[PA_MEMBLOCK_TYPE_MAX];
     pa_atomic_t n_accumulated_by_type[PA_MEMBLOCK_TYPE_MAX];
 };
@@ -628,7 +628,7 @@ size_t pa_mix(
     pa_assert(data);
     pa_assert(length);
     pa_assert(spec);
-    pa_assert(nstreams > 1);
+    pa_assert(nstreams > 0);
 
     if (!volume)
         volume = pa_cvolume_reset(&full_volume, spec->channels);
@@ -0,0 +1,638 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
+#include <pulsecore/sample-util.h>
+
+#include "cpu-x86.h"
+#include "mix.h"
+
+#if defined (__GNUC__) && (defined (__i386__) || defined (__amd64__))
+
+#include <immintrin.h>
+
+/* The kernels are compiled with per-function target attributes, so that the
+ * rest of the library does not need to be built with -mavx2. They are only
+ * ever called after pa_cpu_get_x86_flags() detected support for them.
+ *
+ * Mixing is done block-wise: each stream is scaled and added to an
+ * accumulator block before moving on to the next stream, so that the
+ * per-channel volume pattern of a stream is expanded only once per block and
+ * every input is read sequentially. The results are bit-exact with the
+ * generic C functions in mix.c. */
+
+#define AVX2 __attribute__ ((target ("avx2")))
+#define AVX512 __attribute__ ((target ("avx512f")))
+
+/* Number of samples mixed per block, must be a multiple of 16 */
+#define MIX_BLOCK 512
+
+/* Number of volume entries beyond the channel count that a vector load
+ * starting at any channel may touch */
+#define VOLUME_PADDING 16
+
+/* Expand the per-channel volumes of a stream, so that the volumes of
+ * VOLUME_PADDING consecutive samples starting at any channel can be read
+ * with a single unaligned load. Integer volumes are split into their
+ * integer and fractional part. */
+static void expand_volume_hi_lo(const pa_mix_info *m, unsigned channels, int32_t *hi, int32_t *lo) {
+    unsigned k, channel = 0;
+
+    for (k = 0; k < channels + VOLUME_PADDING; k++) {
+        hi[k] = m->linear[channel].i >> 16;
+        lo[k] = m->linear[channel].i & 0xFFFF;
+
+        if (++channel >= channels)
+            channel = 0;
+    }
+}
+
+static void expand_volume_i(const pa_mix_info *m, unsigned channels, int32_t *vol) {
+    unsigned k, channel = 0;
+
+    for (k = 0; k < channels + VOLUME_PADDING; k++) {
+        vol[k] = m->linear[channel].i;
+
+        if (++channel >= channels)
+            channel = 0;
+    }
+}
+
+static void expand_volume_f(const pa_mix_info *m, unsigned channels, float *vol) {
+    unsigned k, channel = 0;
+
+    for (k = 0; k < channels + VOLUME_PADDING; k++) {
+        vol[k] = m->linear[channel].f;
+
+        if (++channel >= channels)
+            channel = 0;
+    }
+}
+
+static inline int32_t read_s32(const void *p, bool swap, bool s24_32) {
+    uint32_t v = *((const uint32_t *) p);
+
+    if (swap)
+        v = PA_UINT32_SWAP(v);
+    if (s24_32)
+        v <<= 8;
+
+    return (int32_t) v;
+}
+
+static inline void write_s32(void *p, int64_t sum, bool swap, bool s24_32) {
+    uint32_t v;
+
+    sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+    v = (uint32_t) (int32_t) sum;
+
+    if (s24_32)
+        v >>= 8;
+    if (swap)
+        v = PA_UINT32_SWAP(v);
+
+    *((uint32_t *) p) = v;
+}
+
+/* AVX2 */
+
+static inline AVX2 __m128i swap16_sse(__m128i v) {
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
+}
+
+static inline AVX2 __m128i swap32_sse(__m128i v) {
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+}
+
+static inline AVX2 __m256i swap32_avx2(__m256i v) {
+    const __m256i shuf = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    return _mm256_shuffle_epi8(v, shuf);
+}
+
+/* Arithmetic right shift of 64 bit lanes by 16, which AVX2 lacks */
+static inline AVX2 __m256i srai64_16_avx2(__m256i v) {
+    __m256i sign = _mm256_cmpgt_epi64(_mm256_setzero_si256(), v);
+    return _mm256_or_si256(_mm256_srli_epi64(v, 16), _mm256_slli_epi64(sign, 48));
+}
+
+static inline AVX2 void mix_s16_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length, bool swap) {
+    PA_DECLARE_ALIGNED(32, int32_t, acc[MIX_BLOCK]);
+    int32_t hi[PA_CHANNELS_MAX + VOLUME_PADDING], lo[PA_CHANNELS_MAX + VOLUME_PADDING];
+    const unsigned step = 8 % channels;
+    unsigned n, pos;
+
+    n = length / sizeof(int16_t);
+
+    for (pos = 0; pos < n; pos += MIX_BLOCK) {
+        unsigned count = PA_MIN(n - pos, (unsigned) MIX_BLOCK);
+        unsigned vcount = count & ~7U;
+        unsigned i, k;
+
+        for (k = 0; k < count; k++)
+            acc[k] = 0;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            const int16_t *ptr = m->ptr;
+            unsigned channel = pos % channels;
+
+            expand_volume_hi_lo(m, channels, hi, lo);
+
+            for (k = 0; k < vcount; k += 8) {
+                __m128i s = _mm_loadu_si128((const __m128i *) (ptr + k));
+                __m256i v, h, l, r;
+
+                if (swap)
+                    s = swap16_sse(s);
+
+                v = _mm256_cvtepi16_epi32(s);
+                h = _mm256_loadu_si256((const __m256i *) (hi + channel));
+                l = _mm256_loadu_si256((const __m256i *) (lo + channel));
+
+                /* (v * cv) >> 16 == v * hi + ((v * lo) >> 16) */
+                r = _mm256_add_epi32(_mm256_mullo_epi32(v, h), _mm256_srai_epi32(_mm256_mullo_epi32(v, l), 16));
+                _mm256_storeu_si256((__m256i *) (acc + k), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) (acc + k)), r));
+
+                channel += step;
+                if (channel >= channels)
+                    channel -= channels;
+            }
+
+            for (; k < count; k++) {
+                acc[k] += pa_mult_s16_volume(swap ? PA_INT16_SWAP(ptr[k]) : ptr[k], m->linear[channel].i);
+
+                if (++channel >= channels)
+                    channel = 0;
+            }
+
+            m->ptr = (uint8_t*) m->ptr + count * sizeof(int16_t);
+        }
+
+        for (k = 0; k < vcount; k += 8) {
+            __m256i a = _mm256_loadu_si256((const __m256i *) (acc + k));
+            __m128i s = _mm_packs_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+
+            if (swap)
+                s = swap16_sse(s);
+
+            _mm_storeu_si128((__m128i *) (data + pos + k), s);
+        }
+
+        for (; k < count; k++) {
+            int32_t sum = PA_CLAMP_UNLIKELY(acc[k], -0x8000, 0x7FFF);
+            data[pos + k] = swap ? PA_INT16_SWAP((int16_t) sum) : (int16_t) sum;
+        }
+    }
+}
+
+static AVX2 void pa_mix_s16ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    mix_s16_avx2(streams, nstreams, channels, data, length, false);
+}
+
+static AVX2 void pa_mix_s16re_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    mix_s16_avx2(streams, nstreams, channels, data, length, true);
+}
+
+/* Shared by S32 and S24_32, which only differ in the shift applied when
+ * reading and writing samples. Four samples are processed per vector, since
+ * the products need 64 bit precision. */
+static inline AVX2 void mix_s32_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, uint32_t *data, unsigned length, bool swap, bool s24_32) {
+    PA_DECLARE_ALIGNED(32, int64_t, acc[MIX_BLOCK]);
+    int32_t vol[PA_CHANNELS_MAX + VOLUME_PADDING];
+    const __m256i max = _mm256_set1_epi64x(0x7FFFFFFFLL);
+    const __m256i min = _mm256_set1_epi64x(-0x80000000LL);
+    const __m256i narrow = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    const unsigned step = 4 % channels;
+    unsigned n, pos;
+
+    n = length / sizeof(uint32_t);
+
+    for (pos = 0; pos < n; pos += MIX_BLOCK) {
+        unsigned count = PA_MIN(n - pos, (unsigned) MIX_BLOCK);
+        unsigned vcount = count & ~3U;
+        unsigned i, k;
+
+        for (k = 0; k < count; k++)
+            acc[k] = 0;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            const uint32_t *ptr = m->ptr;
+            unsigned channel = pos % channels;
+
+            expand_volume_i(m, channels, vol);
+
+            for (k = 0; k < vcount; k += 4) {
+                __m128i s = _mm_loadu_si128((const __m128i *) (ptr + k));
+                __m256i v, cv, r;
+
+                if (swap)
+                    s = swap32_sse(s);
+                if (s24_32)
+                    s = _mm_slli_epi32(s, 8);
+
+                v = _mm256_cvtepi32_epi64(s);
+                cv = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *) (vol + channel)));
+
+                r = srai64_16_avx2(_mm256_mul_epi32(v, cv));
+                _mm256_storeu_si256((__m256i *) (acc + k), _mm256_add_epi64(_mm256_loadu_si256((const __m256i *) (acc + k)), r));
+
+                channel += step;
+                if (channel >= channels)
+                    channel -= channels;
+            }
+
+            for (; k < count; k++) {
+                acc[k] += ((int64_t) read_s32(ptr + k, swap, s24_32) * m->linear[channel].i) >> 16;
+
+                if (++channel >= channels)
+                    channel = 0;
+            }
+
+            m->ptr = (uint8_t*) m->ptr + count * sizeof(uint32_t);
+        }
+
+        for (k = 0; k < vcount; k += 4) {
+            __m256i a = _mm256_loadu_si256((const __m256i *) (acc + k));
+            __m128i s;
+
+            a = _mm256_blendv_epi8(a, max, _mm256_cmpgt_epi64(a, max));
+            a = _mm256_blendv_epi8(a, min, _mm256_cmpgt_epi64(min, a));
+            s = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(a, narrow));
+
+            if (s24_32)
+                s = _mm_srli_epi32(s, 8);
+            if (swap)
+                s = swap32_sse(s);
+
+            _mm_storeu_si128((__m128i *) (data + pos + k), s);
+        }
+
+        for (; k < count; k++)
+            write_s32(data + pos + k, acc[k], swap, s24_32);
+    }
+}
+
+static AVX2 void pa_mix_s32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, uint32_t *data, unsigned length) {
+    mix_s32_avx2(streams, nstreams, channels, data, length, false, false);
+}
+
+static AVX2 void pa_mix_s32re_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, uint32_t *data, unsigned length) {
+    mix_s32_avx2(streams, nstreams, channels, data, length, true, false);
+}
+
+static AVX2 void pa_mix_s24_32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, uint32_t *data, unsigned length) {
+    mix_s32_avx2(streams, nstreams, channels, data, length, false, true);
+}
+
+static AVX2 void pa_mix_s24_32re_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, uint32_t *data, unsigned length) {
+    mix_s32_avx2(streams, nstreams, channels, data, length, true, true);
+}
+
+static inline AVX2 void mix_float32_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length, bool swap) {
+    PA_DECLARE_ALIGNED(32, float, acc[MIX_BLOCK]);
+    float vol[PA_CHANNELS_MAX + VOLUME_PADDING];
+    const unsigned step = 8 % channels;
+    unsigned n, pos;
+
+    n = length / sizeof(float);
+
+    for (pos = 0; pos < n; pos += MIX_BLOCK) {
+        unsigned count = PA_MIN(n - pos, (unsigned) MIX_BLOCK);
+        unsigned vcount = count & ~7U;
+        unsigned i, k;
+
+        for (k = 0; k < count; k++)
+            acc[k] = 0;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            const float *ptr = m->ptr;
+            unsigned channel = pos % channels;
+
+            expand_volume_f(m, channels, vol);
+
+            for (k = 0; k < vcount; k += 8) {
+                __m256 v, cv, r;
+
+                if (swap)
+                    v = _mm256_castsi256_ps(swap32_avx2(_mm256_loadu_si256((const __m256i *) (ptr + k))));
+                else
+                    v = _mm256_loadu_ps(ptr + k);
+
+                cv = _mm256_loadu_ps(vol + channel);
+
+                /* Streams with zero volume are skipped in the C version, so
+                 * mask them out instead of adding (possibly non-finite)
+                 * products */
+                r = _mm256_and_ps(_mm256_mul_ps(v, cv), _mm256_cmp_ps(cv, _mm256_setzero_ps(), _CMP_GT_OQ));
+                _mm256_storeu_ps(acc + k, _mm256_add_ps(_mm256_loadu_ps(acc + k), r));
+
+                channel += step;
+                if (channel >= channels)
+                    channel -= channels;
+            }
+
+            for (; k < count; k++) {
+                float cv = m->linear[channel].f;
+
+                if (PA_LIKELY(cv > 0))
+                    acc[k] += (swap ? PA_READ_FLOAT32RE(ptr + k) : ptr[k]) * cv;
+
+                if (++channel >= channels)
+                    channel = 0;
+            }
+
+            m->ptr = (uint8_t*) m->ptr + count * sizeof(float);
+        }
+
+        if (swap) {
+            for (k = 0; k < vcount; k += 8)
+                _mm256_storeu_si256((__m256i *) (data + pos + k), swap32_avx2(_mm256_castps_si256(_mm256_loadu_ps(acc + k))));
+
+            for (; k < count; k++)
+                PA_WRITE_FLOAT32RE(data + pos + k, acc[k]);
+        } else
+            memcpy(data + pos, acc, count * sizeof(float));
+    }
+}
+
+static AVX2 void pa_mix_float32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    mix_float32_avx2(streams, nstreams, channels, data, length, false);
+}
+
+static AVX2 void pa_mix_float32re_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    mix_float32_avx2(streams, nstreams, channels, data, length, true);
+}
+
+static AVX2 void pa_mix_u8_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, uint8_t *data, unsigned length) {
+    PA_DECLARE_ALIGNED(32, int32_t, acc[MIX_BLOCK]);
+    int32_t vol[PA_CHANNELS_MAX + VOLUME_PADDING];
+    const __m256i offset = _mm256_set1_epi32(0x80);
+    const unsigned step = 8 % channels;
+    unsigned pos;
+
+    for (pos = 0; pos < length; pos += MIX_BLOCK) {
+        unsigned count = PA_MIN(length - pos, (unsigned) MIX_BLOCK);
+        unsigned vcount = count & ~7U;
+        unsigned i, k;
+
+        for (k = 0; k < count; k++)
+            acc[k] = 0;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            const uint8_t *ptr = m->ptr;
+            unsigned channel = pos % channels;
+
+            expand_volume_i(m, channels, vol);
+
+            for (k = 0; k < vcount; k += 8) {
+                __m256i v, cv, r;
+
+                v = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (ptr + k))), offset);
+                cv = _mm256_loadu_si256((const __m256i *) (vol + channel));
+
+                r = _mm256_srai_epi32(_mm256_mullo_epi32(v, cv), 16);
+                _mm256_storeu_si256((__m256i *) (acc + k), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) (acc + k)), r));
+
+                channel += step;
+                if (channel >= channels)
+                    channel -= channels;
+            }
+
+            for (; k < count; k++) {
+                acc[k] += (((int32_t) ptr[k] - 0x80) * m->linear[channel].i) >> 16;
+
+                if (++channel >= channels)
+                    channel = 0;
+            }
+
+            m->ptr = (uint8_t*) m->ptr + count;
+        }
+
+        for (k = 0; k < vcount; k += 8) {
+            __m256i a = _mm256_loadu_si256((const __m256i *) (acc + k));
+            __m128i s;
+
+            a = _mm256_add_epi32(_mm256_max_epi32(_mm256_min_epi32(a, _mm256_set1_epi32(0x7F)), _mm256_set1_epi32(-0x80)), offset);
+            s = _mm_packs_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+            _mm_storel_epi64((__m128i *) (data + pos + k), _mm_packus_epi16(s, s));
+        }
+
+        for (; k < count; k++)
+            data[pos + k] = (uint8_t) (PA_CLAMP_UNLIKELY(acc[k], -0x80, 0x7F) + 0x80);
+    }
+}
+
+/* AVX-512, native endian formats only */
+
+static AVX512 void pa_mix_s16ne_avx512(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    PA_DECLARE_ALIGNED(64, int32_t, acc[MIX_BLOCK]);
+    int32_t hi[PA_CHANNELS_MAX + VOLUME_PADDING], lo[PA_CHANNELS_MAX + VOLUME_PADDING];
+    const unsigned step = 16 % channels;
+    unsigned n, pos;
+
+    n = length / sizeof(int16_t);
+
+    for (pos = 0; pos < n; pos += MIX_BLOCK) {
+        unsigned count = PA_MIN(n - pos, (unsigned) MIX_BLOCK);
+        unsigned vcount = count & ~15U;
+        unsigned i, k;
+
+        for (k = 0; k < count; k++)
+            acc[k] = 0;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            const int16_t *ptr = m->ptr;
+            unsigned channel = pos % channels;
+
+            expand_volume_hi_lo(m, channels, hi, lo);
+
+            for (k = 0; k < vcount; k += 16) {
+                __m512i v, h, l, r;
+
+                v = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *) (ptr + k)));
+                h = _mm512_loadu_si512(hi + channel);
+                l = _mm512_loadu_si512(lo + channel);
+
+                r = _mm512_add_epi32(_mm512_mullo_epi32(v, h), _mm512_srai_epi32(_mm512_mullo_epi32(v, l), 16));
+                _mm512_storeu_si512(acc + k, _mm512_add_epi32(_mm512_loadu_si512(acc + k), r));
+
+                channel += step;
+                if (channel >= channels)
+                    channel -= channels;
+            }
+
+            for (; k < count; k++) {
+                acc[k] += pa_mult_s16_volume(ptr[k], m->linear[channel].i);
+
+                if (++channel >= channels)
+                    channel = 0;
+            }
+
+            m->ptr = (uint8_t*) m->ptr + count * sizeof(int16_t);
+        }
+
+        /* The saturating narrow doubles as the clamp */
+        for (k = 0; k < vcount; k += 16)
+            _mm256_storeu_si256((__m256i *) (data + pos + k), _mm512_cvtsepi32_epi16(_mm512_loadu_si512(acc + k)));
+
+        for (; k < count; k++)
+            data[pos + k] = (int16_t) PA_CLAMP_UNLIKELY(acc[k], -0x8000, 0x7FFF);
+    }
+}
+
+static AVX512 void pa_mix_s32ne_avx512(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    PA_DECLARE_ALIGNED(64, int64_t, acc[MIX_BLOCK]);
+    int32_t vol[PA_CHANNELS_MAX + VOLUME_PADDING];
+    const unsigned step = 8 % channels;
+    unsigned n, pos;
+
+    n = length / sizeof(int32_t);
+
+    for (pos = 0; pos < n; pos += MIX_BLOCK) {
+        unsigned count = PA_MIN(n - pos, (unsigned) MIX_BLOCK);
+        unsigned vcount = count & ~7U;
+        unsigned i, k;
+
+        for (k = 0; k < count; k++)
+            acc[k] = 0;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            const int32_t *ptr = m->ptr;
+            unsigned channel = pos % channels;
+
+            expand_volume_i(m, channels, vol);
+
+            for (k = 0; k < vcount; k += 8) {
+                __m512i v, cv, r;
+
+                v = _mm512_cvtepi32_epi64(_mm256_loadu_si256((const __m256i *) (ptr + k)));
+                cv = _mm512_cvtepi32_epi64(_mm256_loadu_si256((const __m256i *) (vol + channel)));
+
+                r = _mm512_srai_epi64(_mm512_mul_epi32(v, cv), 16);
+                _mm512_storeu_si512(acc + k, _mm512_add_epi64(_mm512_loadu_si512(acc + k), r));
+
+                channel += step;
+                if (channel >= channels)
+                    channel -= channels;
+            }
+
+            for (; k < count; k++) {
+                acc[k] += ((int64_t) ptr[k] * m->linear[channel].i) >> 16;
+
+                if (++channel >= channels)
+                    channel = 0;
+            }
+
+            m->ptr = (uint8_t*) m->ptr + count * sizeof(int32_t);
+        }
+
+        for (k = 0; k < vcount; k += 8)
+            _mm256_storeu_si256((__m256i *) (data + pos + k), _mm512_cvtsepi64_epi32(_mm512_loadu_si512(acc + k)));
+
+        for (; k < count; k++)
+            data[pos + k] = (int32_t) PA_CLAMP_UNLIKELY(acc[k], -0x80000000LL, 0x7FFFFFFFLL);
+    }
+}
+
+static AVX512 void pa_mix_float32ne_avx512(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    PA_DECLARE_ALIGNED(64, float, acc[MIX_BLOCK]);
+    float vol[PA_CHANNELS_MAX + VOLUME_PADDING];
+    const unsigned step = 16 % channels;
+    unsigned n, pos;
+
+    n = length / sizeof(float);
+
+    for (pos = 0; pos < n; pos += MIX_BLOCK) {
+        unsigned count = PA_MIN(n - pos, (unsigned) MIX_BLOCK);
+        unsigned i, k;
+
+        for (k = 0; k < count; k++)
+            acc[k] = 0;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            const float *ptr = m->ptr;
+            unsigned channel = pos % channels;
+
+            expand_volume_f(m, channels, vol);
+
+            for (k = 0; k < count; k += 16) {
+                __mmask16 tail = count - k >= 16 ? 0xFFFF : (__mmask16) ((1U << (count - k)) - 1);
+                __m512 cv = _mm512_loadu_ps(vol + channel);
+                __mmask16 mask = _mm512_mask_cmp_ps_mask(tail, cv, _mm512_setzero_ps(), _CMP_GT_OQ);
+                __m512 a = _mm512_maskz_loadu_ps(tail, acc + k);
+                __m512 r = _mm512_mul_ps(_mm512_maskz_loadu_ps(tail, ptr + k), cv);
+
+                /* AVX-512 implies FMA; keep the compiler from fusing the
+                 * multiplication and addition, which would round differently
+                 * than the C version */
+                __asm__ ("" : "+v" (r));
+
+                _mm512_mask_storeu_ps(acc + k, tail, _mm512_mask_add_ps(a, mask, a, r));
+
+                channel += step;
+                if (channel >= channels)
+                    channel -= channels;
+            }
+
+            m->ptr = (uint8_t*) m->ptr + count * sizeof(float);
+        }
+
+        memcpy(data + pos, acc, count * sizeof(float));
+    }
+}
+
+#endif /* defined (__GNUC__) && (defined (__i386__) || defined (__amd64__)) */
+
+void pa_mix_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (__GNUC__) && (defined (__i386__) || defined (__amd64__))
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized mixing functions.");
+
+        pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_avx2);
+        pa_set_mix_func(PA_SAMPLE_S16RE, (pa_do_mix_func_t) pa_mix_s16re_avx2);
+        pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_avx2);
+        pa_set_mix_func(PA_SAMPLE_S32RE, (pa_do_mix_func_t) pa_mix_s32re_avx2);
+        pa_set_mix_func(PA_SAMPLE_S24_32NE, (pa_do_mix_func_t) pa_mix_s24_32ne_avx2);
+        pa_set_mix_func(PA_SAMPLE_S24_32RE, (pa_do_mix_func_t) pa_mix_s24_32re_avx2);
+        pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_avx2);
+        pa_set_mix_func(PA_SAMPLE_FLOAT32RE, (pa_do_mix_func_t) pa_mix_float32re_avx2);
+        pa_set_mix_func(PA_SAMPLE_U8, (pa_do_mix_func_t) pa_mix_u8_avx2);
+    }
+
+    if (flags & PA_CPU_X86_AVX512F) {
+        pa_log_info("Initialising AVX-512 optimized mixing functions.");
+
+        pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_avx512);
+        pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_avx512);
+        pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_avx512);
+    }
+#endif /* defined (__GNUC__) && (defined (__i386__) || defined (__amd64__)) */
+}
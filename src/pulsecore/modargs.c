@@ -534,6 +534,23 @@ int pa_modargs_get_proplist(pa_modargs *ma, const char *name, pa_proplist *p, pa
     return 0;
 }
 
+int pa_modargs_get_thread_cpus(pa_modargs *ma, const char *def, char **cpus) {
+    const char *v;
+
+    pa_assert(ma);
+    pa_assert(cpus);
+
+    *cpus = NULL;
+
+    if (!(v = pa_modargs_get_value(ma, "thread_cpus", def)) || !*v)
+        return 0;
+
+    if (!(*cpus = pa_cpu_list_effective(v)))
+        return -1;
+
+    return 0;
+}
+
 const char *pa_modargs_iterate(pa_modargs *ma, void **state) {
     struct entry *e;
 
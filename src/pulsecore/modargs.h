@@ -86,6 +86,13 @@ int pa_modargs_get_alternate_sample_rate(pa_modargs *ma, uint32_t *alternate_rat
 
 int pa_modargs_get_proplist(pa_modargs *ma, const char *name, pa_proplist *p, pa_update_mode_t m);
 
+/* Return the CPUs an IO thread shall be restricted to, from the argument
+ * "thread_cpus" or from def if the argument was not specified. Only the CPUs
+ * of the list that the process may run on are returned, see
+ * pa_cpu_list_effective(). *cpus is set to NULL if there is no restriction,
+ * otherwise it needs to be freed with pa_xfree(). */
+int pa_modargs_get_thread_cpus(pa_modargs *ma, const char *def, char **cpus);
+
 /* Iterate through the module argument list. The user should allocate a
  * state variable of type void* and initialize it with NULL. A pointer
  * to this variable should then be passed to pa_modargs_iterate()
@@ -24,6 +24,7 @@
 #include <pulse/cdecl.h>
 #include <pulse/def.h>
 
+#include <pulsecore/atomic.h>
 #include <pulsecore/pdispatch.h>
 #include <pulsecore/pstream.h>
 #include <pulsecore/tagstruct.h>
@@ -187,6 +188,13 @@ enum {
      * BOTH DIRECTIONS */
     PA_COMMAND_REGISTER_MEMFD_SHMID,
 
+    /* Supported since protocol v34 (14.0) */
+    PA_COMMAND_GET_SNAPSHOT,
+    PA_COMMAND_ENABLE_TIMING_PAGE,
+    PA_COMMAND_ENABLE_WRITE_RING,
+    PA_COMMAND_WRITE_RING_COMMIT,
+    PA_COMMAND_SEND_OBJECT_MESSAGE,
+
     PA_COMMAND_MAX
 };
 
@@ -201,6 +209,44 @@ enum {
 
 #define PA_NATIVE_DEFAULT_UNIX_SOCKET "native"
 
+/* Timing info of a playback stream that the server's IO thread publishes in
+ * the auxiliary area of the srbchannel, see PA_COMMAND_ENABLE_TIMING_PAGE.
+ * seq is odd while the server is updating the slot; readers retry until
+ * they see the same even value before and after copying it. The seq
+ * accesses alone don't order the plain accesses to the other fields, so the
+ * server needs a pa_atomic_fence() after the odd and before the even store,
+ * and readers one between the copy and the second load. The timestamp
+ * is taken from pa_rtclock_now() and is 0 as long as nothing has been
+ * published yet. */
+typedef struct pa_timing_page_slot {
+    pa_atomic_t seq;
+    uint32_t flags;
+    int64_t write_index;
+    int64_t read_index;
+    uint64_t sink_usec;
+    uint64_t timestamp;
+    uint64_t underrun_for;
+    uint64_t playing_for;
+} pa_timing_page_slot;
+
+#define PA_TIMING_PAGE_PLAYING 0x1U
+
+/* Every block of a playback stream's write ring starts with this header, see
+ * PA_COMMAND_ENABLE_WRITE_RING. pending counts the chunks committed from the
+ * block that the server still holds on to: the client increments it before
+ * committing, the server decrements it once it dropped the chunk. The sample
+ * data starts PA_WRITE_RING_HEADER_SIZE bytes into the block. */
+typedef struct pa_write_ring_header {
+    pa_atomic_t pending;
+} pa_write_ring_header;
+
+#define PA_WRITE_RING_HEADER_SIZE 64
+#define PA_WRITE_RING_BLOCKS_MAX 16U
+
+/* The channel the write ring blocks are sent on. (uint32_t) -1 marks
+ * packets on the pstream, so it can't be used for memblocks. */
+#define PA_WRITE_RING_CHANNEL ((uint32_t) -2)
+
 int pa_common_command_register_memfd_shmid(pa_pstream *p, pa_pdispatch *pd, uint32_t version,
                                            uint32_t command, pa_tagstruct *t);
 
@@ -199,6 +199,13 @@ static const char *command_names[PA_COMMAND_MAX] = {
     /* Supported since protocol v31 (9.0) */
     /* BOTH DIRECTIONS */
     [PA_COMMAND_REGISTER_MEMFD_SHMID] = "REGISTER_MEMFD_SHMID",
+
+    /* Supported since protocol v34 (14.0) */
+    [PA_COMMAND_GET_SNAPSHOT] = "GET_SNAPSHOT",
+    [PA_COMMAND_ENABLE_TIMING_PAGE] = "ENABLE_TIMING_PAGE",
+    [PA_COMMAND_ENABLE_WRITE_RING] = "ENABLE_WRITE_RING",
+    [PA_COMMAND_WRITE_RING_COMMIT] = "WRITE_RING_COMMIT",
+    [PA_COMMAND_SEND_OBJECT_MESSAGE] = "SEND_OBJECT_MESSAGE",
 };
 
 #endif
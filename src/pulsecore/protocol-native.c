@@ -34,6 +34,8 @@
 #include <pulse/util.h>
 #include <pulse/xmalloc.h>
 #include <pulse/internal.h>
+#include <pulse/introspect.h>
+#include <pulse/subscribe.h>
 
 #include <pulsecore/native-common.h>
 #include <pulsecore/packet.h>
@@ -45,6 +47,7 @@
 #include <pulsecore/pdispatch.h>
 #include <pulsecore/pstream-util.h>
 #include <pulsecore/namereg.h>
+#include <pulsecore/message-handler.h>
 #include <pulsecore/core-scache.h>
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/log.h>
@@ -57,6 +60,7 @@
 #include <pulsecore/ipacl.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/mem.h>
+#include <pulsecore/io-worker.h>
 
 #include "protocol-native.h"
 
@@ -65,9 +69,16 @@
 /* Kick a client if it doesn't authenticate within this time */
 #define AUTH_TIMEOUT (60 * PA_USEC_PER_SEC)
 
-/* Don't accept more connection than this */
+/* Don't accept more connection than this, per main loop serving them */
 #define MAX_CONNECTIONS 64
 
+/* Upper limit for native-io-threads= */
+#define MAX_IO_WORKERS 16U
+
+/* Don't query the sink latency for the timing page more often than this,
+ * clients poll it at most every 10ms */
+#define TIMING_PAGE_INTERVAL_USEC (5*PA_USEC_PER_MSEC)
+
 #define MAX_MEMBLOCKQ_LENGTH (4*1024*1024) /* 4MB */
 #define DEFAULT_TLENGTH_MSEC 2000 /* 2s */
 #define DEFAULT_PROCESS_MSEC 20   /* 20ms */
@@ -145,6 +156,28 @@ typedef struct playback_stream {
     size_t render_memblockq_length;
     pa_usec_t current_sink_latency;
     uint64_t playing_for, underrun_for;
+
+    /* While this stream reads the connection's srbchannel in the sink's IO
+     * thread, see native_connection_update_srb_thread(). srb_pstream is set
+     * from the main thread, the rest belongs to the IO thread. */
+    pa_pstream *srb_pstream;
+    pa_fdsem *srb_fdsem;
+    pa_rtpoll_item *srb_rtpoll_item;
+    bool srb_delivered;
+    bool srb_no_rtpoll:1;
+
+    /* Our slot of the connection's timing page or PA_INVALID_INDEX. The
+     * IO thread publishes to timing_slot, using timing_seq as seqlock,
+     * last at timing_published. */
+    uint32_t timing_slot_index;
+    pa_timing_page_slot *timing_slot;
+    int timing_seq;
+    pa_usec_t timing_published;
+
+    /* Blocks of the connection's rw_mempool the client writes its data
+     * into, see command_enable_write_ring() */
+    pa_memblock **write_ring;
+    unsigned n_write_ring;
 } playback_stream;
 
 #define PLAYBACK_STREAM(o) (playback_stream_cast(o))
@@ -187,7 +220,32 @@ struct pa_native_connection {
     uint32_t rrobin_index;
     pa_subscription *subscription;
     pa_time_event *auth_timeout_event;
+
+    /* The worker whose main loop does the I/O of pstream, or NULL if that
+     * is the core's main loop */
+    pa_io_worker *io_worker;
+
+    /* Size of the last reply to each command, so that the replies of
+     * polling clients can be allocated in one go */
+    size_t reply_size_hint[PA_COMMAND_MAX];
+
+    /* Delta subscription mode: the last state sent for each object, one
+     * map per facility, keyed by object index */
+    bool subscription_delta;
+    pa_hashmap *delta_cache[PA_SUBSCRIPTION_EVENT_FACILITY_MASK+1];
     pa_srbchannel *srbpending;
+
+    /* Whether the srbchannel may be read in an IO thread, and the playback
+     * stream doing so */
+    bool srb_io_thread;
+    playback_stream *srb_stream;
+
+    /* Timing page in the auxiliary area of the active srbchannel, and
+     * which of its slots are taken by playback streams */
+    pa_memblock *timing_memblock;
+    pa_timing_page_slot *timing_slots;
+    bool *timing_slot_used;
+    unsigned n_timing_slots;
 };
 
 #define PA_NATIVE_CONNECTION(o) (pa_native_connection_cast(o))
@@ -203,6 +261,12 @@ struct pa_native_protocol {
     pa_hook hooks[PA_NATIVE_HOOK_MAX];
 
     pa_hashmap *extensions;
+
+    /* Main loops in threads of their own serving connections round robin,
+     * see native-io-threads= in daemon.conf */
+    pa_io_worker **io_workers;
+    unsigned n_io_workers;
+    unsigned next_io_worker;
 };
 
 enum {
@@ -217,7 +281,11 @@ enum {
     SINK_INPUT_MESSAGE_SEEK,
     SINK_INPUT_MESSAGE_PREBUF_FORCE,
     SINK_INPUT_MESSAGE_UPDATE_LATENCY,
-    SINK_INPUT_MESSAGE_UPDATE_BUFFER_ATTR
+    SINK_INPUT_MESSAGE_UPDATE_BUFFER_ATTR,
+    SINK_INPUT_MESSAGE_SRB_ATTACH,
+    SINK_INPUT_MESSAGE_SRB_DETACH,
+    SINK_INPUT_MESSAGE_SRB_CONTINUE, /* srbchannel packet dispatched, read on */
+    SINK_INPUT_MESSAGE_SET_TIMING_SLOT
 };
 
 enum {
@@ -226,7 +294,10 @@ enum {
     PLAYBACK_STREAM_MESSAGE_OVERFLOW,
     PLAYBACK_STREAM_MESSAGE_DRAIN_ACK,
     PLAYBACK_STREAM_MESSAGE_STARTED,
-    PLAYBACK_STREAM_MESSAGE_UPDATE_TLENGTH
+    PLAYBACK_STREAM_MESSAGE_UPDATE_TLENGTH,
+    PLAYBACK_STREAM_MESSAGE_SRB_DISPATCH,      /* srbchannel packet waiting for the main loop */
+    PLAYBACK_STREAM_MESSAGE_SRB_NO_RTPOLL,
+    PLAYBACK_STREAM_MESSAGE_SRB_FAILED
 };
 
 enum {
@@ -235,7 +306,26 @@ enum {
 
 enum {
     CONNECTION_MESSAGE_RELEASE,
-    CONNECTION_MESSAGE_REVOKE
+    CONNECTION_MESSAGE_REVOKE,
+    CONNECTION_MESSAGE_PACKET,   /* pstream events from an IO worker */
+    CONNECTION_MESSAGE_MEMBLOCK,
+    CONNECTION_MESSAGE_DRAIN,
+    CONNECTION_MESSAGE_DIE
+};
+
+/* Payloads of CONNECTION_MESSAGE_PACKET and CONNECTION_MESSAGE_MEMBLOCK */
+struct worker_packet {
+    pa_packet *packet;
+#ifdef HAVE_CREDS
+    pa_cmsg_ancil_data ancil_data;
+    bool with_ancil_data;
+#endif
+};
+
+struct worker_memblock {
+    uint32_t channel;
+    pa_seek_mode_t seek;
+    size_t length; /* for holes, which have no memblock to pass along */
 };
 
 static bool sink_input_process_underrun_cb(pa_sink_input *i);
@@ -247,8 +337,15 @@ static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes);
 static void sink_input_update_max_rewind_cb(pa_sink_input *i, size_t nbytes);
 static void sink_input_update_max_request_cb(pa_sink_input *i, size_t nbytes);
 static void sink_input_send_event_cb(pa_sink_input *i, const char *event, pa_proplist *pl);
+static void sink_input_attach_cb(pa_sink_input *i);
+static void sink_input_detach_cb(pa_sink_input *i);
 
 static void native_connection_send_memblock(pa_native_connection *c);
+static void native_connection_unlink(pa_native_connection *c);
+static void delta_cache_clear(pa_native_connection *c, pa_subscription_mask_t keep);
+static void native_connection_update_srb_thread(pa_native_connection *c);
+static void srb_thread_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata);
+static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata);
 static void playback_stream_request_bytes(struct playback_stream*s);
 
 static void source_output_kill_cb(pa_source_output *o);
@@ -271,6 +368,7 @@ static void upload_stream_unlink(upload_stream *s) {
         return;
 
     pa_assert_se(pa_idxset_remove_by_data(s->connection->output_streams, s, NULL) == s);
+    native_connection_update_srb_thread(s->connection);
     s->connection = NULL;
     upload_stream_unref(s);
 }
@@ -322,6 +420,7 @@ static upload_stream* upload_stream_new(
     pa_proplist_update(s->proplist, PA_UPDATE_MERGE, c->client->proplist);
 
     pa_idxset_put(c->output_streams, s, &s->index);
+    native_connection_update_srb_thread(c);
 
     return s;
 }
@@ -627,6 +726,73 @@ static void record_stream_send_killed(record_stream *r) {
     pa_pstream_send_tagstruct(r->connection->pstream, t);
 }
 
+/* Called from main context */
+static void playback_stream_srb_attach(playback_stream *s) {
+    pa_native_connection *c = s->connection;
+    pa_fdsem *fdsem;
+
+    pa_assert(!c->srb_stream);
+
+    if (!(fdsem = pa_pstream_set_srb_thread(c->pstream, srb_thread_memblock_callback, s)))
+        return;
+
+    pa_log_debug("Reading srbchannel of playback stream %u in the IO thread.", s->index);
+
+    c->srb_stream = s;
+    s->srb_pstream = c->pstream;
+
+    if (s->sink_input->sink)
+        pa_asyncmsgq_send(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_SRB_ATTACH, fdsem, 0, NULL);
+    else
+        /* Moving, the destination sink will attach us */
+        s->srb_fdsem = fdsem;
+}
+
+/* Called from main context */
+static void playback_stream_srb_detach(playback_stream *s) {
+    pa_native_connection *c = s->connection;
+
+    pa_assert(c->srb_stream == s);
+
+    if (s->sink_input->sink)
+        pa_asyncmsgq_send(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_SRB_DETACH, NULL, 0, NULL);
+    else
+        s->srb_fdsem = NULL;
+
+    pa_assert(!s->srb_rtpoll_item);
+
+    pa_pstream_set_srb_thread(c->pstream, NULL, NULL);
+
+    c->srb_stream = NULL;
+    s->srb_pstream = NULL;
+}
+
+/* Called from main context. Audio data doesn't need the main thread, so
+ * let the sink's IO thread read it from the srbchannel directly. The
+ * srbchannel is shared by the whole connection, so this is only possible
+ * while it carries no more than one playback stream. */
+static void native_connection_update_srb_thread(pa_native_connection *c) {
+    playback_stream *s = NULL;
+
+    pa_native_connection_assert_ref(c);
+
+    if (c->srb_io_thread && pa_idxset_size(c->output_streams) == 1) {
+        output_stream *o = pa_idxset_first(c->output_streams, NULL);
+
+        if (playback_stream_isinstance(o) && !PLAYBACK_STREAM(o)->srb_no_rtpoll)
+            s = PLAYBACK_STREAM(o);
+    }
+
+    if (s == c->srb_stream)
+        return;
+
+    if (c->srb_stream)
+        playback_stream_srb_detach(c->srb_stream);
+
+    if (s)
+        playback_stream_srb_attach(s);
+}
+
 /* Called from main context */
 static void playback_stream_unlink(playback_stream *s) {
     pa_assert(s);
@@ -634,6 +800,9 @@ static void playback_stream_unlink(playback_stream *s) {
     if (!s->connection)
         return;
 
+    if (s->connection->srb_stream == s)
+        playback_stream_srb_detach(s);
+
     if (s->sink_input) {
         pa_sink_input_unlink(s->sink_input);
         pa_sink_input_unref(s->sink_input);
@@ -643,7 +812,13 @@ static void playback_stream_unlink(playback_stream *s) {
     if (s->drain_request)
         pa_pstream_send_error(s->connection->pstream, s->drain_tag, PA_ERR_NOENTITY);
 
+    if (s->timing_slot_index != PA_INVALID_INDEX) {
+        s->connection->timing_slot_used[s->timing_slot_index] = false;
+        s->timing_slot_index = PA_INVALID_INDEX;
+    }
+
     pa_assert_se(pa_idxset_remove_by_data(s->connection->output_streams, s, NULL) == s);
+    native_connection_update_srb_thread(s->connection);
     s->connection = NULL;
     playback_stream_unref(s);
 }
@@ -656,6 +831,17 @@ static void playback_stream_free(pa_object* o) {
     playback_stream_unlink(s);
 
     pa_memblockq_free(s->memblockq);
+
+    /* Chunks still in flight keep their own references */
+    if (s->write_ring) {
+        unsigned i;
+
+        for (i = 0; i < s->n_write_ring; i++)
+            pa_memblock_unref(s->write_ring[i]);
+
+        pa_xfree(s->write_ring);
+    }
+
     pa_xfree(s);
 }
 
@@ -763,6 +949,26 @@ static int playback_stream_process_msg(pa_msgobject *o, int code, void*userdata,
             }
 
             break;
+
+        case PLAYBACK_STREAM_MESSAGE_SRB_DISPATCH:
+            pa_pstream_srb_thread_dispatch(s->connection->pstream);
+
+            if (s->connection && s->connection->srb_stream == s && s->sink_input->sink)
+                pa_asyncmsgq_post(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_SRB_CONTINUE, NULL, 0, NULL, NULL);
+
+            break;
+
+        case PLAYBACK_STREAM_MESSAGE_SRB_NO_RTPOLL:
+            pa_log_debug("Sink has no rtpoll, reading srbchannel of playback stream %u in the main loop.", s->index);
+
+            s->srb_no_rtpoll = true;
+            native_connection_update_srb_thread(s->connection);
+            break;
+
+        case PLAYBACK_STREAM_MESSAGE_SRB_FAILED:
+            pa_log("Failed to read from srbchannel.");
+            native_connection_unlink(s->connection);
+            break;
     }
 
     return 0;
@@ -1052,6 +1258,7 @@ static playback_stream* playback_stream_new(
     s->early_requests = early_requests;
     pa_atomic_store(&s->seek_or_post_in_queue, 0);
     s->seek_windex = -1;
+    s->timing_slot_index = PA_INVALID_INDEX;
 
     s->sink_input->parent.process_msg = sink_input_process_msg;
     s->sink_input->pop = sink_input_pop_cb;
@@ -1063,6 +1270,8 @@ static playback_stream* playback_stream_new(
     s->sink_input->moving = sink_input_moving_cb;
     s->sink_input->suspend = sink_input_suspend_cb;
     s->sink_input->send_event = sink_input_send_event_cb;
+    s->sink_input->attach = sink_input_attach_cb;
+    s->sink_input->detach = sink_input_detach_cb;
     s->sink_input->userdata = s;
 
     start_index = ssync ? pa_memblockq_get_read_index(ssync->memblockq) : 0;
@@ -1105,6 +1314,8 @@ static playback_stream* playback_stream_new(
 
     pa_sink_input_put(s->sink_input);
 
+    native_connection_update_srb_thread(c);
+
 out:
     if (formats)
         pa_idxset_free(formats, (pa_free_cb_t) pa_format_info_free);
@@ -1150,6 +1361,11 @@ static void playback_stream_send_killed(playback_stream *p) {
     pa_pstream_send_tagstruct(p->connection->pstream, t);
 }
 
+static void pstream_packet_callback(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata);
+static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata);
+static void pstream_die_callback(pa_pstream *p, void *userdata);
+static void pstream_drain_callback(pa_pstream *p, void *userdata);
+
 /* Called from main context */
 static int native_connection_process_msg(pa_msgobject *o, int code, void*userdata, int64_t offset, pa_memchunk *chunk) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(o);
@@ -1167,6 +1383,39 @@ static int native_connection_process_msg(pa_msgobject *o, int code, void*userdat
         case CONNECTION_MESSAGE_RELEASE:
             pa_pstream_send_release(c->pstream, PA_PTR_TO_UINT(userdata));
             break;
+
+        case CONNECTION_MESSAGE_PACKET: {
+            struct worker_packet *wp = userdata;
+
+#ifdef HAVE_CREDS
+            pstream_packet_callback(c->pstream, wp->packet, wp->with_ancil_data ? &wp->ancil_data : NULL, c);
+#else
+            pstream_packet_callback(c->pstream, wp->packet, NULL, c);
+#endif
+            break;
+        }
+
+        case CONNECTION_MESSAGE_MEMBLOCK: {
+            struct worker_memblock *wm = userdata;
+            pa_memchunk hole;
+
+            if (!chunk->memblock) {
+                pa_memchunk_reset(&hole);
+                hole.length = wm->length;
+                chunk = &hole;
+            }
+
+            pstream_memblock_callback(c->pstream, wm->channel, offset, wm->seek, chunk, c);
+            break;
+        }
+
+        case CONNECTION_MESSAGE_DRAIN:
+            pstream_drain_callback(c->pstream, c);
+            break;
+
+        case CONNECTION_MESSAGE_DIE:
+            pstream_die_callback(c->pstream, c);
+            break;
     }
 
     return 0;
@@ -1184,6 +1433,10 @@ static void native_connection_unlink(pa_native_connection *c) {
 
     pa_hook_fire(&c->protocol->hooks[PA_NATIVE_HOOK_CONNECTION_UNLINK], c);
 
+    /* Take the srbchannel back from the IO thread first */
+    c->srb_io_thread = false;
+    native_connection_update_srb_thread(c);
+
     if (c->options)
         pa_native_options_unref(c->options);
 
@@ -1202,6 +1455,17 @@ static void native_connection_unlink(pa_native_connection *c) {
     if (c->subscription)
         pa_subscription_free(c->subscription);
 
+    delta_cache_clear(c, 0);
+
+    if (c->timing_memblock) {
+        pa_memblock_release(c->timing_memblock);
+        pa_memblock_unref(c->timing_memblock);
+        c->timing_memblock = NULL;
+        c->timing_slots = NULL;
+        pa_xfree(c->timing_slot_used);
+        c->timing_slot_used = NULL;
+    }
+
     if (c->pstream)
         pa_pstream_unlink(c->pstream);
 
@@ -1314,6 +1578,59 @@ static void flush_write_no_account(pa_memblockq *q) {
     pa_memblockq_flush_write(q, false);
 }
 
+/* Called from thread context */
+static void playback_stream_write_timing(playback_stream *s, pa_usec_t sink_latency, pa_usec_t now) {
+    pa_timing_page_slot *slot;
+    pa_sink_input *i;
+
+    pa_assert_se(slot = s->timing_slot);
+
+    i = s->sink_input;
+
+    /* The same values as in the reply to GET_PLAYBACK_LATENCY, but taken
+     * right here so that the client doesn't need to ask for them */
+    pa_atomic_store(&slot->seq, ++s->timing_seq);
+
+    /* The atomic store doesn't order the plain stores around it. Make sure
+     * the odd seq is visible before any of the data, and all of the data
+     * before the even seq. */
+    pa_atomic_fence();
+
+    slot->flags =
+        i->thread_info.playing_for > 0 &&
+        i->sink->thread_info.state == PA_SINK_RUNNING &&
+        i->thread_info.state == PA_SINK_INPUT_RUNNING ? PA_TIMING_PAGE_PLAYING : 0;
+    slot->write_index = pa_memblockq_get_write_index(s->memblockq);
+    slot->read_index = pa_memblockq_get_read_index(s->memblockq);
+    slot->sink_usec =
+        sink_latency +
+        pa_bytes_to_usec(pa_memblockq_get_length(i->thread_info.render_memblockq), &i->sink->sample_spec);
+    slot->underrun_for = i->thread_info.underrun_for;
+    slot->playing_for = i->thread_info.playing_for;
+    slot->timestamp = now;
+
+    pa_atomic_fence();
+    pa_atomic_store(&slot->seq, ++s->timing_seq);
+
+    s->timing_published = now;
+}
+
+/* Called from thread context */
+static void playback_stream_publish_timing(playback_stream *s) {
+    pa_usec_t now;
+
+    if (!s->timing_slot)
+        return;
+
+    /* This runs for every pop, but querying the sink latency may mean
+     * asking the device, so do it only every now and then */
+    now = pa_rtclock_now();
+    if (s->timing_published > 0 && now < s->timing_published + TIMING_PAGE_INTERVAL_USEC)
+        return;
+
+    playback_stream_write_timing(s, pa_sink_get_latency_within_thread(s->sink_input->sink, false), now);
+}
+
 /* Called from thread context */
 static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk) {
     pa_sink_input *i = PA_SINK_INPUT(o);
@@ -1424,6 +1741,11 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
             s->underrun_for = s->sink_input->thread_info.underrun_for;
             s->playing_for = s->sink_input->thread_info.playing_for;
 
+            /* The client resumes reading the timing page after this reply,
+             * make sure it doesn't find anything older there */
+            if (s->timing_slot)
+                playback_stream_write_timing(s, s->current_sink_latency, pa_rtclock_now());
+
             return 0;
 
         case PA_SINK_INPUT_MESSAGE_SET_STATE: {
@@ -1460,6 +1782,33 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
             pa_memblockq_get_attr(s->memblockq, &s->buffer_attr);
             return 0;
         }
+
+        case SINK_INPUT_MESSAGE_SRB_ATTACH:
+            s->srb_fdsem = userdata;
+
+            if (i->thread_info.attached)
+                sink_input_attach_cb(i);
+
+            return 0;
+
+        case SINK_INPUT_MESSAGE_SRB_DETACH:
+            if (i->thread_info.attached)
+                sink_input_detach_cb(i);
+
+            s->srb_fdsem = NULL;
+            return 0;
+
+        case SINK_INPUT_MESSAGE_SRB_CONTINUE:
+            /* Just waking us up is enough, reading happens in the work
+             * callback */
+            return 0;
+
+        case SINK_INPUT_MESSAGE_SET_TIMING_SLOT:
+            s->timing_slot = userdata;
+            s->timing_seq = 0;
+            s->timing_published = 0;
+            playback_stream_publish_timing(s);
+            return 0;
     }
 
     return pa_sink_input_process_msg(o, code, userdata, offset, chunk);
@@ -1518,8 +1867,10 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
 
     /* This call will not fail with prebuf=0, hence we check for
        underrun explicitly in handle_input_underrun */
-    if (pa_memblockq_peek(s->memblockq, chunk) < 0)
+    if (pa_memblockq_peek(s->memblockq, chunk) < 0) {
+        playback_stream_publish_timing(s);
         return -1;
+    }
 
     chunk->length = PA_MIN(nbytes, chunk->length);
 
@@ -1529,6 +1880,8 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     pa_memblockq_drop(s->memblockq, chunk->length);
     playback_stream_request_bytes(s);
 
+    playback_stream_publish_timing(s);
+
     return 0;
 }
 
@@ -1584,6 +1937,105 @@ static void sink_input_update_max_request_cb(pa_sink_input *i, size_t nbytes) {
     }
 }
 
+/* Called from IO context */
+static void srb_thread_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    playback_stream *s = PLAYBACK_STREAM(userdata);
+    size_t frame_size;
+
+    playback_stream_assert_ref(s);
+    pa_assert(chunk);
+
+    if (channel != s->index) {
+        pa_log_debug("Client sent block for invalid stream.");
+        /* Ignoring */
+        return;
+    }
+
+    frame_size = pa_frame_size(&s->sink_input->sample_spec);
+    if (chunk->index % frame_size != 0 || chunk->length % frame_size != 0) {
+        pa_log_warn("Client sent non-aligned memblock: index %d, length %d, frame size: %d",
+                    (int) chunk->index, (int) chunk->length, (int) frame_size);
+        return;
+    }
+
+    /* Same as pstream_memblock_callback(), minus the trip through the
+     * asyncmsgq */
+    s->srb_delivered = true;
+    pa_atomic_inc(&s->seek_or_post_in_queue);
+    if (chunk->memblock) {
+        if (seek != PA_SEEK_RELATIVE || offset != 0)
+            sink_input_process_msg(PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_SEEK, PA_UINT_TO_PTR(seek), offset, (pa_memchunk *) chunk);
+        else
+            sink_input_process_msg(PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_POST_DATA, NULL, 0, (pa_memchunk *) chunk);
+    } else
+        sink_input_process_msg(PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_SEEK, PA_UINT_TO_PTR(seek), offset+chunk->length, NULL);
+}
+
+/* Called from IO context */
+static int srb_thread_work_cb(pa_rtpoll_item *item) {
+    playback_stream *s = PLAYBACK_STREAM(pa_rtpoll_item_get_work_userdata(item));
+    bool write_ready;
+    int r;
+
+    playback_stream_assert_ref(s);
+
+    s->srb_delivered = false;
+
+    if ((r = pa_pstream_srb_thread_read(s->srb_pstream, &write_ready)) < 0) {
+        pa_rtpoll_item_free(s->srb_rtpoll_item);
+        s->srb_rtpoll_item = NULL;
+
+        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_SRB_FAILED, NULL, 0, NULL, NULL);
+        return 0;
+    }
+
+    /* Control packets are handled by the main loop, reading continues once
+     * it is done with them so that they keep their order with the data */
+    if (r > 0 || write_ready)
+        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_SRB_DISPATCH, NULL, 0, NULL, NULL);
+
+    /* New data, a seek or a flush may have requested a rewind. Have the
+     * sink thread go around its loop to process that, instead of going to
+     * sleep until the next timer or wakeup. */
+    return s->srb_delivered ? 1 : 0;
+}
+
+/* Called from IO context */
+static void sink_input_attach_cb(pa_sink_input *i) {
+    playback_stream *s;
+
+    pa_sink_input_assert_ref(i);
+    s = PLAYBACK_STREAM(i->userdata);
+    playback_stream_assert_ref(s);
+
+    if (!s->srb_fdsem)
+        return;
+
+    pa_assert(!s->srb_rtpoll_item);
+
+    if (!i->sink->thread_info.rtpoll) {
+        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_SRB_NO_RTPOLL, NULL, 0, NULL, NULL);
+        return;
+    }
+
+    s->srb_rtpoll_item = pa_rtpoll_item_new_fdsem(i->sink->thread_info.rtpoll, PA_RTPOLL_NORMAL, s->srb_fdsem);
+    pa_rtpoll_item_set_work_callback(s->srb_rtpoll_item, srb_thread_work_cb, s);
+}
+
+/* Called from IO context */
+static void sink_input_detach_cb(pa_sink_input *i) {
+    playback_stream *s;
+
+    pa_sink_input_assert_ref(i);
+    s = PLAYBACK_STREAM(i->userdata);
+    playback_stream_assert_ref(s);
+
+    if (s->srb_rtpoll_item) {
+        pa_rtpoll_item_free(s->srb_rtpoll_item);
+        s->srb_rtpoll_item = NULL;
+    }
+}
+
 /* Called from main context */
 static void sink_input_kill_cb(pa_sink_input *i) {
     playback_stream *s;
@@ -1858,6 +2310,31 @@ static pa_tagstruct *reply_new(uint32_t tag) {
     return reply;
 }
 
+/* Like reply_new(), for replies whose size is unknown up front. The buffer
+ * is preallocated to the size of the previous reply to the same command,
+ * which send_sized_reply() records. */
+static pa_tagstruct *reply_new_sized(pa_native_connection *c, uint32_t command, uint32_t tag) {
+    pa_tagstruct *reply;
+
+    pa_assert(command < PA_COMMAND_MAX);
+
+    reply = pa_tagstruct_new_sized(c->reply_size_hint[command]);
+    pa_tagstruct_putu32(reply, PA_COMMAND_REPLY);
+    pa_tagstruct_putu32(reply, tag);
+    return reply;
+}
+
+static void send_sized_reply(pa_native_connection *c, uint32_t command, pa_tagstruct *reply) {
+    size_t length;
+
+    pa_assert(command < PA_COMMAND_MAX);
+
+    pa_tagstruct_data(reply, &length);
+    c->reply_size_hint[command] = length;
+
+    pa_pstream_send_tagstruct(c->pstream, reply);
+}
+
 static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     playback_stream *s;
@@ -2479,6 +2956,11 @@ static void setup_srbchannel(pa_native_connection *c, pa_mem_type_t shm_type) {
         return;
     }
 
+    if (c->io_worker) {
+        pa_log_debug("Disabling srbchannel, reason: Connection served by an IO worker");
+        return;
+    }
+
     if (c->version < 30) {
         pa_log_debug("Disabling srbchannel, reason: Protocol too old");
         return;
@@ -2516,6 +2998,7 @@ static void setup_srbchannel(pa_native_connection *c, pa_mem_type_t shm_type) {
         goto fail;
     }
     pa_log_debug("Enabling srbchannel...");
+    pa_srbchannel_set_spin(srb, c->options->srbchannel_spin_usec);
     pa_srbchannel_export(srb, &srbt);
 
     /* Send enable command to client */
@@ -2542,6 +3025,27 @@ fail:
     }
 }
 
+/* Called from main context */
+static void native_connection_setup_timing_page(pa_native_connection *c, pa_srbchannel *srb) {
+    pa_srbchannel_template srbt;
+    void *aux;
+    size_t length;
+
+    if (c->timing_memblock)
+        return;
+
+    if (!(aux = pa_srbchannel_get_aux(srb, &length)) || length < sizeof(pa_timing_page_slot))
+        return;
+
+    pa_srbchannel_export(srb, &srbt);
+    c->timing_memblock = pa_memblock_ref(srbt.memblock);
+    pa_memblock_acquire(c->timing_memblock);
+
+    c->timing_slots = aux;
+    c->n_timing_slots = length / sizeof(pa_timing_page_slot);
+    c->timing_slot_used = pa_xnew0(bool, c->n_timing_slots);
+}
+
 static void command_enable_srbchannel(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
 
@@ -2551,8 +3055,12 @@ static void command_enable_srbchannel(pa_pdispatch *pd, uint32_t command, uint32
     }
 
     pa_log_debug("Client enabled srbchannel.");
+    native_connection_setup_timing_page(c, c->srbpending);
     pa_pstream_set_srbchannel(c->pstream, c->srbpending);
     c->srbpending = NULL;
+
+    c->srb_io_thread = c->options->srbchannel_io_thread;
+    native_connection_update_srb_thread(c);
 }
 
 static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -2954,88 +3462,278 @@ static void command_get_record_latency(pa_pdispatch *pd, uint32_t command, uint3
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
-static void command_create_upload_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+static void command_enable_timing_page(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
-    upload_stream *s;
-    uint32_t length;
-    const char *name = NULL;
-    pa_sample_spec ss;
-    pa_channel_map map;
     pa_tagstruct *reply;
-    pa_proplist *p;
+    playback_stream *s;
+    uint32_t idx;
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
 
-    if (pa_tagstruct_gets(t, &name) < 0 ||
-        pa_tagstruct_get_sample_spec(t, &ss) < 0 ||
-        pa_tagstruct_get_channel_map(t, &map) < 0 ||
-        pa_tagstruct_getu32(t, &length) < 0) {
+    if (pa_tagstruct_getu32(t, &idx) < 0 ||
+        !pa_tagstruct_eof(t)) {
         protocol_error(c);
         return;
     }
 
     CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
-    CHECK_VALIDITY(c->pstream, pa_sample_spec_valid(&ss), tag, PA_ERR_INVALID);
-    CHECK_VALIDITY(c->pstream, pa_channel_map_valid(&map), tag, PA_ERR_INVALID);
-    CHECK_VALIDITY(c->pstream, map.channels == ss.channels, tag, PA_ERR_INVALID);
-    CHECK_VALIDITY(c->pstream, (length % pa_frame_size(&ss)) == 0 && length > 0, tag, PA_ERR_INVALID);
-    CHECK_VALIDITY(c->pstream, length <= PA_SCACHE_ENTRY_SIZE_MAX, tag, PA_ERR_TOOLARGE);
+    CHECK_VALIDITY(c->pstream, c->timing_slots, tag, PA_ERR_NOTSUPPORTED);
+    s = pa_idxset_get_by_index(c->output_streams, idx);
+    CHECK_VALIDITY(c->pstream, s, tag, PA_ERR_NOENTITY);
+    CHECK_VALIDITY(c->pstream, playback_stream_isinstance(s), tag, PA_ERR_NOENTITY);
+    CHECK_VALIDITY(c->pstream, s->sink_input->sink, tag, PA_ERR_BADSTATE);
 
-    p = pa_proplist_new();
+    if (s->timing_slot_index == PA_INVALID_INDEX) {
+        uint32_t slot;
 
-    if ((c->version >= 13 && pa_tagstruct_get_proplist(t, p) < 0) ||
-        !pa_tagstruct_eof(t)) {
+        for (slot = 0; slot < c->n_timing_slots; slot++)
+            if (!c->timing_slot_used[slot])
+                break;
 
-        protocol_error(c);
-        pa_proplist_free(p);
-        return;
-    }
+        CHECK_VALIDITY(c->pstream, slot < c->n_timing_slots, tag, PA_ERR_TOOLARGE);
 
-    if (c->version < 13)
-        pa_proplist_sets(p, PA_PROP_MEDIA_NAME, name);
-    else if (!name)
-        if (!(name = pa_proplist_gets(p, PA_PROP_EVENT_ID)))
-            name = pa_proplist_gets(p, PA_PROP_MEDIA_NAME);
+        c->timing_slot_used[slot] = true;
+        s->timing_slot_index = slot;
+        pa_zero(c->timing_slots[slot]);
 
-    if (!name || !pa_namereg_is_valid_name(name)) {
-        pa_proplist_free(p);
-        CHECK_VALIDITY(c->pstream, false, tag, PA_ERR_INVALID);
+        pa_assert_se(pa_asyncmsgq_send(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_SET_TIMING_SLOT, &c->timing_slots[slot], 0, NULL) == 0);
     }
 
-    s = upload_stream_new(c, &ss, &map, name, length, p);
-    pa_proplist_free(p);
-
-    CHECK_VALIDITY(c->pstream, s, tag, PA_ERR_INVALID);
-
     reply = reply_new(tag);
-    pa_tagstruct_putu32(reply, s->index);
-    pa_tagstruct_putu32(reply, length);
+    pa_tagstruct_putu32(reply, s->timing_slot_index);
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
-static void command_finish_upload_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+static void command_enable_write_ring(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
-    uint32_t channel;
-    upload_stream *s;
+    pa_memblock *blocks[PA_WRITE_RING_BLOCKS_MAX];
+    pa_tagstruct *reply;
+    playback_stream *s;
+    size_t block_size, n;
     uint32_t idx;
+    unsigned i;
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
 
-    if (pa_tagstruct_getu32(t, &channel) < 0 ||
+    if (pa_tagstruct_getu32(t, &idx) < 0 ||
         !pa_tagstruct_eof(t)) {
         protocol_error(c);
         return;
     }
 
     CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
-
-    s = pa_idxset_get_by_index(c->output_streams, channel);
+    CHECK_VALIDITY(c->pstream, c->rw_mempool && pa_mempool_is_memfd_backed(c->rw_mempool), tag, PA_ERR_NOTSUPPORTED);
+    s = pa_idxset_get_by_index(c->output_streams, idx);
     CHECK_VALIDITY(c->pstream, s, tag, PA_ERR_NOENTITY);
-    CHECK_VALIDITY(c->pstream, upload_stream_isinstance(s), tag, PA_ERR_NOENTITY);
+    CHECK_VALIDITY(c->pstream, playback_stream_isinstance(s), tag, PA_ERR_NOENTITY);
+    CHECK_VALIDITY(c->pstream, !s->write_ring, tag, PA_ERR_EXIST);
 
-    if (!s->memchunk.memblock)
+    block_size = pa_mempool_block_size_max(c->rw_mempool);
+    CHECK_VALIDITY(c->pstream, block_size >= PA_WRITE_RING_HEADER_SIZE + pa_frame_size(&s->sink_input->sample_spec), tag, PA_ERR_NOTSUPPORTED);
+
+    /* Enough blocks for a full buffer while the next one is being filled */
+    n = (s->buffer_attr.tlength + s->buffer_attr.minreq) / (block_size - PA_WRITE_RING_HEADER_SIZE) + 2;
+    n = PA_MIN(n, PA_WRITE_RING_BLOCKS_MAX);
+
+    for (i = 0; i < n; i++) {
+        pa_write_ring_header *h;
+
+        if (!(blocks[i] = pa_memblock_new_pool(c->rw_mempool, (size_t) -1))) {
+            while (i > 0)
+                pa_memblock_unref(blocks[--i]);
+
+            pa_pstream_send_error(c->pstream, tag, PA_ERR_INTERNAL);
+            return;
+        }
+
+        h = pa_memblock_acquire(blocks[i]);
+        pa_atomic_store(&h->pending, 0);
+        pa_memblock_release(blocks[i]);
+    }
+
+    s->write_ring = pa_xnewdup(pa_memblock*, blocks, n);
+    s->n_write_ring = n;
+
+    /* The blocks go out before the reply, so that the client has them all
+     * when it sees the reply */
+    for (i = 0; i < n; i++) {
+        pa_memchunk mc;
+
+        mc.memblock = s->write_ring[i];
+        mc.index = 0;
+        mc.length = pa_memblock_get_length(mc.memblock);
+        pa_pstream_send_memblock(c->pstream, PA_WRITE_RING_CHANNEL, i, PA_SEEK_RELATIVE, &mc);
+    }
+
+    reply = reply_new(tag);
+    pa_tagstruct_putu32(reply, (uint32_t) n);
+    pa_pstream_send_tagstruct(c->pstream, reply);
+}
+
+/* Called from thread context */
+static void write_ring_chunk_free(void *userdata) {
+    pa_memblock *b = userdata;
+    pa_write_ring_header *h;
+
+    h = pa_memblock_acquire(b);
+    pa_atomic_dec(&h->pending);
+    pa_memblock_release(b);
+
+    pa_memblock_unref(b);
+}
+
+static void command_write_ring_commit(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    uint32_t idx, block, index, length, seek;
+    int64_t offset;
+    playback_stream *s;
+    pa_memchunk chunk;
+    size_t frame_size;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu32(t, &idx) < 0 ||
+        pa_tagstruct_getu32(t, &block) < 0 ||
+        pa_tagstruct_getu32(t, &index) < 0 ||
+        pa_tagstruct_getu32(t, &length) < 0 ||
+        pa_tagstruct_gets64(t, &offset) < 0 ||
+        pa_tagstruct_getu32(t, &seek) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    if (!c->authorized || seek > PA_SEEK_RELATIVE_END) {
+        protocol_error(c);
+        return;
+    }
+
+    /* No reply, just like for memblocks. The stream might be gone already
+     * if the server killed it. */
+    s = pa_idxset_get_by_index(c->output_streams, idx);
+    if (!s || !playback_stream_isinstance(s) || !s->write_ring) {
+        pa_log_debug("Client committed data for invalid stream.");
+        return;
+    }
+
+    frame_size = pa_frame_size(&s->sink_input->sample_spec);
+
+    if (block >= s->n_write_ring ||
+        index < PA_WRITE_RING_HEADER_SIZE ||
+        (index - PA_WRITE_RING_HEADER_SIZE) % frame_size != 0 ||
+        length % frame_size != 0 ||
+        index > pa_memblock_get_length(s->write_ring[block]) ||
+        length > pa_memblock_get_length(s->write_ring[block]) - index) {
+        protocol_error(c);
+        return;
+    }
+
+    chunk.index = 0;
+    chunk.length = length;
+
+    if (length > 0) {
+        uint8_t *d;
+
+        /* Refer to the data in place, the server side of the ring block
+         * only learns that the chunk was dropped */
+        d = pa_memblock_acquire(s->write_ring[block]);
+        chunk.memblock = pa_memblock_new_user(c->protocol->core->mempool, d + index, length,
+                                              write_ring_chunk_free, pa_memblock_ref(s->write_ring[block]), true);
+        pa_memblock_release(s->write_ring[block]);
+    } else
+        chunk.memblock = NULL;
+
+    pstream_memblock_callback(c->pstream, idx, offset, seek, &chunk, c);
+
+    if (chunk.memblock)
+        pa_memblock_unref(chunk.memblock);
+}
+
+static void command_create_upload_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    upload_stream *s;
+    uint32_t length;
+    const char *name = NULL;
+    pa_sample_spec ss;
+    pa_channel_map map;
+    pa_tagstruct *reply;
+    pa_proplist *p;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_gets(t, &name) < 0 ||
+        pa_tagstruct_get_sample_spec(t, &ss) < 0 ||
+        pa_tagstruct_get_channel_map(t, &map) < 0 ||
+        pa_tagstruct_getu32(t, &length) < 0) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+    CHECK_VALIDITY(c->pstream, pa_sample_spec_valid(&ss), tag, PA_ERR_INVALID);
+    CHECK_VALIDITY(c->pstream, pa_channel_map_valid(&map), tag, PA_ERR_INVALID);
+    CHECK_VALIDITY(c->pstream, map.channels == ss.channels, tag, PA_ERR_INVALID);
+    CHECK_VALIDITY(c->pstream, (length % pa_frame_size(&ss)) == 0 && length > 0, tag, PA_ERR_INVALID);
+    CHECK_VALIDITY(c->pstream, length <= PA_SCACHE_ENTRY_SIZE_MAX, tag, PA_ERR_TOOLARGE);
+
+    p = pa_proplist_new();
+
+    if ((c->version >= 13 && pa_tagstruct_get_proplist(t, p) < 0) ||
+        !pa_tagstruct_eof(t)) {
+
+        protocol_error(c);
+        pa_proplist_free(p);
+        return;
+    }
+
+    if (c->version < 13)
+        pa_proplist_sets(p, PA_PROP_MEDIA_NAME, name);
+    else if (!name)
+        if (!(name = pa_proplist_gets(p, PA_PROP_EVENT_ID)))
+            name = pa_proplist_gets(p, PA_PROP_MEDIA_NAME);
+
+    if (!name || !pa_namereg_is_valid_name(name)) {
+        pa_proplist_free(p);
+        CHECK_VALIDITY(c->pstream, false, tag, PA_ERR_INVALID);
+    }
+
+    s = upload_stream_new(c, &ss, &map, name, length, p);
+    pa_proplist_free(p);
+
+    CHECK_VALIDITY(c->pstream, s, tag, PA_ERR_INVALID);
+
+    reply = reply_new(tag);
+    pa_tagstruct_putu32(reply, s->index);
+    pa_tagstruct_putu32(reply, length);
+    pa_pstream_send_tagstruct(c->pstream, reply);
+}
+
+static void command_finish_upload_stream(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    uint32_t channel;
+    upload_stream *s;
+    uint32_t idx;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu32(t, &channel) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+
+    s = pa_idxset_get_by_index(c->output_streams, channel);
+    CHECK_VALIDITY(c->pstream, s, tag, PA_ERR_NOENTITY);
+    CHECK_VALIDITY(c->pstream, upload_stream_isinstance(s), tag, PA_ERR_NOENTITY);
+
+    if (!s->memchunk.memblock)
         pa_pstream_send_error(c->pstream, tag, PA_ERR_TOOLARGE);
     else if (pa_scache_add_item(c->protocol->core, s->name, &s->sample_spec, &s->channel_map, &s->memchunk, s->proplist, &idx) < 0)
         pa_pstream_send_error(c->pstream, tag, PA_ERR_INTERNAL);
@@ -3156,7 +3854,7 @@ static void fixup_sample_spec(pa_native_connection *c, pa_sample_spec *fixed, co
     }
 }
 
-static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink *sink) {
+static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink *sink, uint32_t fields) {
     pa_sample_spec fixed_ss;
 
     pa_assert(t);
@@ -3182,7 +3880,8 @@ static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sin
         PA_TAG_INVALID);
 
     if (c->version >= 13) {
-        pa_tagstruct_put_proplist(t, sink->proplist);
+        if (fields & PA_SNAPSHOT_PROPLISTS)
+            pa_tagstruct_put_proplist(t, sink->proplist);
         pa_tagstruct_put_usec(t, pa_sink_get_requested_latency(sink));
     }
 
@@ -3195,7 +3894,7 @@ static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sin
         pa_tagstruct_putu32(t, sink->card ? sink->card->index : PA_INVALID_INDEX);
     }
 
-    if (c->version >= 16) {
+    if (c->version >= 16 && (fields & PA_SNAPSHOT_PORTS)) {
         void *state;
         pa_device_port *p;
 
@@ -3212,7 +3911,7 @@ static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sin
         pa_tagstruct_puts(t, sink->active_port ? sink->active_port->name : NULL);
     }
 
-    if (c->version >= 21) {
+    if (c->version >= 21 && (fields & PA_SNAPSHOT_FORMATS)) {
         uint32_t i;
         pa_format_info *f;
         pa_idxset *formats = pa_sink_get_formats(sink);
@@ -3226,7 +3925,7 @@ static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sin
     }
 }
 
-static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source *source) {
+static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source *source, uint32_t fields) {
     pa_sample_spec fixed_ss;
 
     pa_assert(t);
@@ -3252,7 +3951,8 @@ static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
         PA_TAG_INVALID);
 
     if (c->version >= 13) {
-        pa_tagstruct_put_proplist(t, source->proplist);
+        if (fields & PA_SNAPSHOT_PROPLISTS)
+            pa_tagstruct_put_proplist(t, source->proplist);
         pa_tagstruct_put_usec(t, pa_source_get_requested_latency(source));
     }
 
@@ -3265,7 +3965,7 @@ static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
         pa_tagstruct_putu32(t, source->card ? source->card->index : PA_INVALID_INDEX);
     }
 
-    if (c->version >= 16) {
+    if (c->version >= 16 && (fields & PA_SNAPSHOT_PORTS)) {
         void *state;
         pa_device_port *p;
 
@@ -3282,7 +3982,7 @@ static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
         pa_tagstruct_puts(t, source->active_port ? source->active_port->name : NULL);
     }
 
-    if (c->version >= 22) {
+    if (c->version >= 22 && (fields & PA_SNAPSHOT_FORMATS)) {
         uint32_t i;
         pa_format_info *f;
         pa_idxset *formats = pa_source_get_formats(source);
@@ -3296,7 +3996,7 @@ static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
     }
 }
 
-static void client_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_client *client) {
+static void client_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_client *client, uint32_t fields) {
     pa_assert(t);
     pa_assert(client);
 
@@ -3305,11 +4005,11 @@ static void client_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_c
     pa_tagstruct_putu32(t, client->module ? client->module->index : PA_INVALID_INDEX);
     pa_tagstruct_puts(t, client->driver);
 
-    if (c->version >= 13)
+    if (c->version >= 13 && (fields & PA_SNAPSHOT_PROPLISTS))
         pa_tagstruct_put_proplist(t, client->proplist);
 }
 
-static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_card *card) {
+static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_card *card, uint32_t fields) {
     void *state = NULL;
     pa_card_profile *p;
     pa_device_port *port;
@@ -3336,9 +4036,10 @@ static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_car
     }
 
     pa_tagstruct_puts(t, card->active_profile->name);
-    pa_tagstruct_put_proplist(t, card->proplist);
+    if (fields & PA_SNAPSHOT_PROPLISTS)
+        pa_tagstruct_put_proplist(t, card->proplist);
 
-    if (c->version < 26)
+    if (c->version < 26 || !(fields & PA_SNAPSHOT_PORTS))
         return;
 
     pa_tagstruct_putu32(t, pa_hashmap_size(card->ports));
@@ -3351,7 +4052,8 @@ static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_car
         pa_tagstruct_putu32(t, port->priority);
         pa_tagstruct_putu32(t, port->available);
         pa_tagstruct_putu8(t, port->direction);
-        pa_tagstruct_put_proplist(t, port->proplist);
+        if (fields & PA_SNAPSHOT_PROPLISTS)
+            pa_tagstruct_put_proplist(t, port->proplist);
 
         pa_tagstruct_putu32(t, pa_hashmap_size(port->profiles));
 
@@ -3363,7 +4065,7 @@ static void card_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_car
     }
 }
 
-static void module_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_module *module) {
+static void module_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_module *module, uint32_t fields) {
     pa_assert(t);
     pa_assert(module);
 
@@ -3375,11 +4077,11 @@ static void module_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_m
     if (c->version < 15)
         pa_tagstruct_put_boolean(t, false); /* autoload is obsolete */
 
-    if (c->version >= 15)
+    if (c->version >= 15 && (fields & PA_SNAPSHOT_PROPLISTS))
         pa_tagstruct_put_proplist(t, module->proplist);
 }
 
-static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink_input *s) {
+static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink_input *s, uint32_t fields) {
     pa_sample_spec fixed_ss;
     pa_usec_t sink_latency;
     pa_cvolume v;
@@ -3410,7 +4112,7 @@ static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t,
     pa_tagstruct_puts(t, s->driver);
     if (c->version >= 11)
         pa_tagstruct_put_boolean(t, s->muted);
-    if (c->version >= 13)
+    if (c->version >= 13 && (fields & PA_SNAPSHOT_PROPLISTS))
         pa_tagstruct_put_proplist(t, s->proplist);
     if (c->version >= 19)
         pa_tagstruct_put_boolean(t, s->state == PA_SINK_INPUT_CORKED);
@@ -3418,11 +4120,11 @@ static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t,
         pa_tagstruct_put_boolean(t, has_volume);
         pa_tagstruct_put_boolean(t, s->volume_writable);
     }
-    if (c->version >= 21)
+    if (c->version >= 21 && (fields & PA_SNAPSHOT_FORMATS))
         pa_tagstruct_put_format_info(t, s->format);
 }
 
-static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source_output *s) {
+static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_source_output *s, uint32_t fields) {
     pa_sample_spec fixed_ss;
     pa_usec_t source_latency;
     pa_cvolume v;
@@ -3450,7 +4152,7 @@ static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *
     pa_tagstruct_put_usec(t, source_latency);
     pa_tagstruct_puts(t, pa_resample_method_to_string(pa_source_output_get_resample_method(s)));
     pa_tagstruct_puts(t, s->driver);
-    if (c->version >= 13)
+    if (c->version >= 13 && (fields & PA_SNAPSHOT_PROPLISTS))
         pa_tagstruct_put_proplist(t, s->proplist);
     if (c->version >= 19)
         pa_tagstruct_put_boolean(t, s->state == PA_SOURCE_OUTPUT_CORKED);
@@ -3459,7 +4161,8 @@ static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *
         pa_tagstruct_put_boolean(t, s->muted);
         pa_tagstruct_put_boolean(t, has_volume);
         pa_tagstruct_put_boolean(t, s->volume_writable);
-        pa_tagstruct_put_format_info(t, s->format);
+        if (fields & PA_SNAPSHOT_FORMATS)
+            pa_tagstruct_put_format_info(t, s->format);
     }
 }
 
@@ -3571,24 +4274,24 @@ static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, p
         return;
     }
 
-    reply = reply_new(tag);
+    reply = reply_new_sized(c, command, tag);
     if (sink)
-        sink_fill_tagstruct(c, reply, sink);
+        sink_fill_tagstruct(c, reply, sink, PA_SNAPSHOT_ALL);
     else if (source)
-        source_fill_tagstruct(c, reply, source);
+        source_fill_tagstruct(c, reply, source, PA_SNAPSHOT_ALL);
     else if (client)
-        client_fill_tagstruct(c, reply, client);
+        client_fill_tagstruct(c, reply, client, PA_SNAPSHOT_ALL);
     else if (card)
-        card_fill_tagstruct(c, reply, card);
+        card_fill_tagstruct(c, reply, card, PA_SNAPSHOT_ALL);
     else if (module)
-        module_fill_tagstruct(c, reply, module);
+        module_fill_tagstruct(c, reply, module, PA_SNAPSHOT_ALL);
     else if (si)
-        sink_input_fill_tagstruct(c, reply, si);
+        sink_input_fill_tagstruct(c, reply, si, PA_SNAPSHOT_ALL);
     else if (so)
-        source_output_fill_tagstruct(c, reply, so);
+        source_output_fill_tagstruct(c, reply, so, PA_SNAPSHOT_ALL);
     else
         scache_fill_tagstruct(c, reply, sce);
-    pa_pstream_send_tagstruct(c->pstream, reply);
+    send_sized_reply(c, command, reply);
 }
 
 static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -3608,7 +4311,7 @@ static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t t
 
     CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
 
-    reply = reply_new(tag);
+    reply = reply_new_sized(c, command, tag);
 
     if (command == PA_COMMAND_GET_SINK_INFO_LIST)
         i = c->protocol->core->sinks;
@@ -3632,19 +4335,19 @@ static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t t
     if (i) {
         PA_IDXSET_FOREACH(p, i, idx) {
             if (command == PA_COMMAND_GET_SINK_INFO_LIST)
-                sink_fill_tagstruct(c, reply, p);
+                sink_fill_tagstruct(c, reply, p, PA_SNAPSHOT_ALL);
             else if (command == PA_COMMAND_GET_SOURCE_INFO_LIST)
-                source_fill_tagstruct(c, reply, p);
+                source_fill_tagstruct(c, reply, p, PA_SNAPSHOT_ALL);
             else if (command == PA_COMMAND_GET_CLIENT_INFO_LIST)
-                client_fill_tagstruct(c, reply, p);
+                client_fill_tagstruct(c, reply, p, PA_SNAPSHOT_ALL);
             else if (command == PA_COMMAND_GET_CARD_INFO_LIST)
-                card_fill_tagstruct(c, reply, p);
+                card_fill_tagstruct(c, reply, p, PA_SNAPSHOT_ALL);
             else if (command == PA_COMMAND_GET_MODULE_INFO_LIST)
-                module_fill_tagstruct(c, reply, p);
+                module_fill_tagstruct(c, reply, p, PA_SNAPSHOT_ALL);
             else if (command == PA_COMMAND_GET_SINK_INPUT_INFO_LIST)
-                sink_input_fill_tagstruct(c, reply, p);
+                sink_input_fill_tagstruct(c, reply, p, PA_SNAPSHOT_ALL);
             else if (command == PA_COMMAND_GET_SOURCE_OUTPUT_INFO_LIST)
-                source_output_fill_tagstruct(c, reply, p);
+                source_output_fill_tagstruct(c, reply, p, PA_SNAPSHOT_ALL);
             else {
                 pa_assert(command == PA_COMMAND_GET_SAMPLE_INFO_LIST);
                 scache_fill_tagstruct(c, reply, p);
@@ -3652,6 +4355,105 @@ static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t t
         }
     }
 
+    send_sized_reply(c, command, reply);
+}
+
+static void command_get_snapshot(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    pa_core *core;
+    pa_tagstruct *reply;
+    uint32_t fields, idx;
+    pa_sink *sink;
+    pa_source *source;
+    pa_sink_input *si;
+    pa_source_output *so;
+    pa_client *client;
+    pa_module *module;
+    pa_card *card;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu32(t, &fields) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+    CHECK_VALIDITY(c->pstream, (fields & ~PA_SNAPSHOT_ALL) == 0, tag, PA_ERR_INVALID);
+
+    core = c->protocol->core;
+    reply = reply_new_sized(c, command, tag);
+    pa_tagstruct_putu32(reply, fields);
+
+    pa_tagstruct_putu32(reply, pa_idxset_size(core->sinks));
+    PA_IDXSET_FOREACH(sink, core->sinks, idx)
+        sink_fill_tagstruct(c, reply, sink, fields);
+
+    pa_tagstruct_putu32(reply, pa_idxset_size(core->sources));
+    PA_IDXSET_FOREACH(source, core->sources, idx)
+        source_fill_tagstruct(c, reply, source, fields);
+
+    pa_tagstruct_putu32(reply, pa_idxset_size(core->sink_inputs));
+    PA_IDXSET_FOREACH(si, core->sink_inputs, idx)
+        sink_input_fill_tagstruct(c, reply, si, fields);
+
+    pa_tagstruct_putu32(reply, pa_idxset_size(core->source_outputs));
+    PA_IDXSET_FOREACH(so, core->source_outputs, idx)
+        source_output_fill_tagstruct(c, reply, so, fields);
+
+    pa_tagstruct_putu32(reply, pa_idxset_size(core->clients));
+    PA_IDXSET_FOREACH(client, core->clients, idx)
+        client_fill_tagstruct(c, reply, client, fields);
+
+    pa_tagstruct_putu32(reply, pa_idxset_size(core->modules));
+    PA_IDXSET_FOREACH(module, core->modules, idx)
+        module_fill_tagstruct(c, reply, module, fields);
+
+    pa_tagstruct_putu32(reply, pa_idxset_size(core->cards));
+    PA_IDXSET_FOREACH(card, core->cards, idx)
+        card_fill_tagstruct(c, reply, card, fields);
+
+    send_sized_reply(c, command, reply);
+}
+
+static void command_send_object_message(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    const char *object_path = NULL, *message = NULL, *message_parameters = NULL;
+    char *response = NULL;
+    pa_tagstruct *reply;
+    int ret;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_gets(t, &object_path) < 0 ||
+        pa_tagstruct_gets(t, &message) < 0 ||
+        pa_tagstruct_gets(t, &message_parameters) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+    CHECK_VALIDITY(c->pstream, object_path && object_path[0] == '/' && pa_utf8_valid(object_path), tag, PA_ERR_INVALID);
+    CHECK_VALIDITY(c->pstream, message && pa_utf8_valid(message), tag, PA_ERR_INVALID);
+    CHECK_VALIDITY(c->pstream, !message_parameters || pa_utf8_valid(message_parameters), tag, PA_ERR_INVALID);
+
+    pa_log_debug("Client %s sent message %s to %s",
+                 pa_strnull(pa_proplist_gets(c->client->proplist, PA_PROP_APPLICATION_NAME)), message, object_path);
+
+    if ((ret = pa_message_handler_send_message(c->protocol->core, object_path, message, message_parameters, &response)) < 0) {
+        pa_xfree(response);
+        pa_pstream_send_error(c->pstream, tag, -ret);
+        return;
+    }
+
+    reply = reply_new(tag);
+    pa_tagstruct_puts(reply, response);
+    pa_xfree(response);
+
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
@@ -3700,6 +4502,249 @@ static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
+typedef struct delta_state {
+    pa_cvolume volume;
+    bool mute;
+    uint32_t state;
+    pa_usec_t latency;
+    pa_proplist *proplist;
+} delta_state;
+
+static void delta_state_free(delta_state *d) {
+    pa_assert(d);
+
+    if (d->proplist)
+        pa_proplist_free(d->proplist);
+    pa_xfree(d);
+}
+
+/* Frees the cached state of all facilities not in keep */
+static void delta_cache_clear(pa_native_connection *c, pa_subscription_mask_t keep) {
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(c->delta_cache); i++)
+        if (c->delta_cache[i] && !(keep & (1U << i))) {
+            pa_hashmap_free(c->delta_cache[i]);
+            c->delta_cache[i] = NULL;
+        }
+}
+
+/* Fills in the current state of the object, returns the fields that apply
+ * to its facility, or 0 if the object is gone */
+static uint32_t delta_state_get(pa_native_connection *c, uint32_t facility, uint32_t idx, delta_state *d) {
+    pa_core *core = c->protocol->core;
+
+    switch (facility) {
+        case PA_SUBSCRIPTION_EVENT_SINK: {
+            pa_sink *sink;
+
+            if (!(sink = pa_idxset_get_by_index(core->sinks, idx)))
+                return 0;
+
+            d->volume = *pa_sink_get_volume(sink, false);
+            d->mute = pa_sink_get_mute(sink, false);
+            d->state = sink->state;
+            d->latency = pa_sink_get_requested_latency(sink);
+            d->proplist = sink->proplist;
+            return PA_SUBSCRIPTION_DELTA_ALL;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_SOURCE: {
+            pa_source *source;
+
+            if (!(source = pa_idxset_get_by_index(core->sources, idx)))
+                return 0;
+
+            d->volume = *pa_source_get_volume(source, false);
+            d->mute = pa_source_get_mute(source, false);
+            d->state = source->state;
+            d->latency = pa_source_get_requested_latency(source);
+            d->proplist = source->proplist;
+            return PA_SUBSCRIPTION_DELTA_ALL;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT: {
+            pa_sink_input *si;
+
+            if (!(si = pa_idxset_get_by_index(core->sink_inputs, idx)))
+                return 0;
+
+            if (pa_sink_input_is_volume_readable(si))
+                pa_sink_input_get_volume(si, &d->volume, true);
+            else
+                pa_cvolume_reset(&d->volume, si->sample_spec.channels);
+            d->mute = si->muted;
+            d->state = si->state == PA_SINK_INPUT_CORKED;
+            d->latency = pa_sink_input_get_requested_latency(si);
+            d->proplist = si->proplist;
+            return PA_SUBSCRIPTION_DELTA_ALL;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT: {
+            pa_source_output *so;
+
+            if (!(so = pa_idxset_get_by_index(core->source_outputs, idx)))
+                return 0;
+
+            if (pa_source_output_is_volume_readable(so))
+                pa_source_output_get_volume(so, &d->volume, true);
+            else
+                pa_cvolume_reset(&d->volume, so->sample_spec.channels);
+            d->mute = so->muted;
+            d->state = so->state == PA_SOURCE_OUTPUT_CORKED;
+            d->latency = pa_source_output_get_requested_latency(so);
+            d->proplist = so->proplist;
+            return PA_SUBSCRIPTION_DELTA_ALL;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_CLIENT: {
+            pa_client *client;
+
+            if (!(client = pa_idxset_get_by_index(core->clients, idx)))
+                return 0;
+
+            d->proplist = client->proplist;
+            return PA_SUBSCRIPTION_DELTA_PROPLIST;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_MODULE: {
+            pa_module *module;
+
+            if (!(module = pa_idxset_get_by_index(core->modules, idx)))
+                return 0;
+
+            d->proplist = module->proplist;
+            return PA_SUBSCRIPTION_DELTA_PROPLIST;
+        }
+
+        case PA_SUBSCRIPTION_EVENT_CARD: {
+            pa_card *card;
+
+            if (!(card = pa_idxset_get_by_index(core->cards, idx)))
+                return 0;
+
+            d->proplist = card->proplist;
+            return PA_SUBSCRIPTION_DELTA_PROPLIST;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+/* Appends the fields of the object that changed since the last event we
+ * sent for it and remembers the new state */
+static void delta_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_subscription_event_type_t e, uint32_t idx) {
+    uint32_t facility = e & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+    uint32_t type = e & PA_SUBSCRIPTION_EVENT_TYPE_MASK;
+    uint32_t fields, changed = 0;
+    delta_state now, *last = NULL;
+    pa_proplist *update = NULL;
+    pa_strlist *removed = NULL;
+    uint32_t n_removed = 0;
+
+    if (c->delta_cache[facility])
+        last = pa_hashmap_get(c->delta_cache[facility], PA_UINT32_TO_PTR(idx));
+
+    pa_zero(now);
+
+    if (type == PA_SUBSCRIPTION_EVENT_REMOVE ||
+        !(fields = delta_state_get(c, facility, idx, &now))) {
+
+        if (last)
+            pa_hashmap_remove_and_free(c->delta_cache[facility], PA_UINT32_TO_PTR(idx));
+
+        pa_tagstruct_putu32(t, 0);
+        return;
+    }
+
+    if (!last) {
+        if (!c->delta_cache[facility])
+            c->delta_cache[facility] = pa_hashmap_new_full(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func,
+                                                           NULL, (pa_free_cb_t) delta_state_free);
+
+        last = pa_xnew0(delta_state, 1);
+        last->proplist = pa_proplist_new();
+        pa_hashmap_put(c->delta_cache[facility], PA_UINT32_TO_PTR(idx), last);
+
+        /* Nothing was sent for this object yet, so everything is news. The
+         * property list is compared against the empty one below. */
+        changed = fields & ~PA_SUBSCRIPTION_DELTA_PROPLIST;
+    } else if (fields & PA_SUBSCRIPTION_DELTA_VOLUME) {
+        if (!pa_cvolume_equal(&now.volume, &last->volume))
+            changed |= PA_SUBSCRIPTION_DELTA_VOLUME;
+        if (now.mute != last->mute)
+            changed |= PA_SUBSCRIPTION_DELTA_MUTE;
+        if (now.state != last->state)
+            changed |= PA_SUBSCRIPTION_DELTA_STATE;
+        if (now.latency != last->latency)
+            changed |= PA_SUBSCRIPTION_DELTA_LATENCY;
+    }
+
+    if (type == PA_SUBSCRIPTION_EVENT_NEW) {
+        /* For a new object the client fetches the full info anyway */
+        changed = 0;
+        pa_proplist_update(last->proplist, PA_UPDATE_SET, now.proplist);
+
+    } else if (!pa_proplist_equal(now.proplist, last->proplist)) {
+        const char *key;
+        void *state = NULL;
+
+        update = pa_proplist_new();
+
+        while ((key = pa_proplist_iterate(now.proplist, &state))) {
+            const void *a, *b;
+            size_t na, nb;
+
+            pa_assert_se(pa_proplist_get(now.proplist, key, &a, &na) == 0);
+
+            if (pa_proplist_get(last->proplist, key, &b, &nb) < 0 ||
+                na != nb || memcmp(a, b, na) != 0)
+                pa_proplist_set(update, key, a, na);
+        }
+
+        state = NULL;
+        while ((key = pa_proplist_iterate(last->proplist, &state)))
+            if (!pa_proplist_contains(now.proplist, key)) {
+                removed = pa_strlist_prepend(removed, key);
+                n_removed++;
+            }
+
+        pa_proplist_update(last->proplist, PA_UPDATE_SET, now.proplist);
+        changed |= PA_SUBSCRIPTION_DELTA_PROPLIST;
+    }
+
+    pa_tagstruct_putu32(t, changed);
+
+    if (changed & PA_SUBSCRIPTION_DELTA_VOLUME)
+        pa_tagstruct_put_cvolume(t, &now.volume);
+    if (changed & PA_SUBSCRIPTION_DELTA_MUTE)
+        pa_tagstruct_put_boolean(t, now.mute);
+    if (changed & PA_SUBSCRIPTION_DELTA_STATE)
+        pa_tagstruct_putu32(t, now.state);
+    if (changed & PA_SUBSCRIPTION_DELTA_LATENCY)
+        pa_tagstruct_put_usec(t, now.latency);
+    if (changed & PA_SUBSCRIPTION_DELTA_PROPLIST) {
+        pa_strlist *l;
+
+        pa_tagstruct_put_proplist(t, update);
+        pa_tagstruct_putu32(t, n_removed);
+        for (l = removed; l; l = pa_strlist_next(l))
+            pa_tagstruct_puts(t, pa_strlist_data(l));
+    }
+
+    if (fields & PA_SUBSCRIPTION_DELTA_VOLUME) {
+        last->volume = now.volume;
+        last->mute = now.mute;
+        last->state = now.state;
+        last->latency = now.latency;
+    }
+
+    if (update)
+        pa_proplist_free(update);
+    pa_strlist_free(removed);
+}
+
 static void subscription_cb(pa_core *core, pa_subscription_event_type_t e, uint32_t idx, void *userdata) {
     pa_tagstruct *t;
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
@@ -3711,17 +4756,23 @@ static void subscription_cb(pa_core *core, pa_subscription_event_type_t e, uint3
     pa_tagstruct_putu32(t, (uint32_t) -1);
     pa_tagstruct_putu32(t, e);
     pa_tagstruct_putu32(t, idx);
+
+    if (c->subscription_delta)
+        delta_fill_tagstruct(c, t, e, idx);
+
     pa_pstream_send_tagstruct(c->pstream, t);
 }
 
 static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     pa_subscription_mask_t m;
+    bool delta = false;
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
 
     if (pa_tagstruct_getu32(t, &m) < 0 ||
+        (c->version >= 34 && !pa_tagstruct_eof(t) && pa_tagstruct_get_boolean(t, &delta) < 0) ||
         !pa_tagstruct_eof(t)) {
         protocol_error(c);
         return;
@@ -3739,6 +4790,12 @@ static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag,
     } else
         c->subscription = NULL;
 
+    /* Events of facilities that are no longer subscribed are not seen, so
+     * what was cached for them would be outdated by the time they are
+     * subscribed again */
+    c->subscription_delta = c->subscription && delta;
+    delta_cache_clear(c, c->subscription_delta ? m : 0);
+
     pa_pstream_send_simple_ack(c->pstream, tag);
 }
 
@@ -4957,6 +6014,12 @@ static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
 
     [PA_COMMAND_REGISTER_MEMFD_SHMID] = command_register_memfd_shmid,
 
+    [PA_COMMAND_GET_SNAPSHOT] = command_get_snapshot,
+    [PA_COMMAND_ENABLE_TIMING_PAGE] = command_enable_timing_page,
+    [PA_COMMAND_ENABLE_WRITE_RING] = command_enable_write_ring,
+    [PA_COMMAND_WRITE_RING_COMMIT] = command_write_ring_commit,
+    [PA_COMMAND_SEND_OBJECT_MESSAGE] = command_send_object_message,
+
     [PA_COMMAND_EXTENSION] = command_extension
 };
 
@@ -5093,6 +6156,70 @@ static void pstream_release_callback(pa_pstream *p, uint32_t block_id, void *use
         pa_asyncmsgq_post(q->outq, PA_MSGOBJECT(userdata), CONNECTION_MESSAGE_RELEASE, PA_UINT_TO_PTR(block_id), 0, NULL, NULL);
 }
 
+/*** IO worker callbacks ***/
+
+/* For connections served by an IO worker the pstream callbacks run in the
+ * worker's thread. They only pass things on to the main loop, in order,
+ * where they are handled by the regular callbacks above. */
+
+static void worker_packet_free(void *userdata) {
+    struct worker_packet *wp = userdata;
+
+#ifdef HAVE_CREDS
+    /* Any fds the command did not take */
+    if (wp->with_ancil_data)
+        pa_cmsg_ancil_data_close_fds(&wp->ancil_data);
+#endif
+
+    pa_packet_unref(wp->packet);
+    pa_xfree(wp);
+}
+
+/* Called from IO worker context */
+static void worker_packet_callback(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    struct worker_packet *wp;
+
+    pa_assert(p);
+    pa_assert(packet);
+
+    wp = pa_xnew(struct worker_packet, 1);
+    wp->packet = pa_packet_ref(packet);
+
+#ifdef HAVE_CREDS
+    /* The fds are ours now, the pstream forgets about them */
+    if ((wp->with_ancil_data = !!ancil_data))
+        wp->ancil_data = *ancil_data;
+#endif
+
+    pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(userdata), CONNECTION_MESSAGE_PACKET, wp, 0, NULL, worker_packet_free);
+}
+
+/* Called from IO worker context */
+static void worker_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    struct worker_memblock *wm;
+
+    pa_assert(p);
+    pa_assert(chunk);
+
+    wm = pa_xnew(struct worker_memblock, 1);
+    wm->channel = channel;
+    wm->seek = seek;
+    wm->length = chunk->length;
+
+    pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(userdata), CONNECTION_MESSAGE_MEMBLOCK, wm, offset,
+                      chunk->memblock ? chunk : NULL, pa_xfree);
+}
+
+/* Called from IO worker context */
+static void worker_drain_callback(pa_pstream *p, void *userdata) {
+    pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(userdata), CONNECTION_MESSAGE_DRAIN, NULL, 0, NULL, NULL);
+}
+
+/* Called from IO worker context */
+static void worker_die_callback(pa_pstream *p, void *userdata) {
+    pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(userdata), CONNECTION_MESSAGE_DIE, NULL, 0, NULL, NULL);
+}
+
 /*** client callbacks ***/
 
 static void client_kill_cb(pa_client *c) {
@@ -5146,8 +6273,8 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
     pa_assert(io);
     pa_assert(o);
 
-    if (pa_idxset_size(p->connections)+1 > MAX_CONNECTIONS) {
-        pa_log_warn("Warning! Too many connections (%u), dropping incoming connection.", MAX_CONNECTIONS);
+    if (pa_idxset_size(p->connections)+1 > MAX_CONNECTIONS * (1 + p->n_io_workers)) {
+        pa_log_warn("Warning! Too many connections (%u), dropping incoming connection.", MAX_CONNECTIONS * (1 + p->n_io_workers));
         pa_iochannel_free(io);
         return;
     }
@@ -5200,13 +6327,52 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
 
     c->rw_mempool = NULL;
 
-    c->pstream = pa_pstream_new(p->core->mainloop, io, p->core->mempool);
-    pa_pstream_set_receive_packet_callback(c->pstream, pstream_packet_callback, c);
-    pa_pstream_set_receive_memblock_callback(c->pstream, pstream_memblock_callback, c);
-    pa_pstream_set_die_callback(c->pstream, pstream_die_callback, c);
-    pa_pstream_set_drain_callback(c->pstream, pstream_drain_callback, c);
-    pa_pstream_set_revoke_callback(c->pstream, pstream_revoke_callback, c);
-    pa_pstream_set_release_callback(c->pstream, pstream_release_callback, c);
+    c->io_worker = NULL;
+    if (p->n_io_workers > 0)
+        c->io_worker = p->io_workers[p->next_io_worker++ % p->n_io_workers];
+
+    if (c->io_worker) {
+        pa_mainloop_api *api = pa_io_worker_get_api(c->io_worker);
+        int ifd, ofd;
+
+        /* Move the socket over to the worker's main loop */
+        ifd = pa_iochannel_get_recv_fd(io);
+        ofd = pa_iochannel_get_send_fd(io);
+        pa_iochannel_set_noclose(io, true);
+        pa_iochannel_free(io);
+
+        pa_io_worker_lock(c->io_worker);
+
+        io = pa_iochannel_new(api, ifd, ofd);
+        c->pstream = pa_pstream_new(api, io, p->core->mempool);
+        pa_pstream_set_lock(c->pstream, pa_io_worker_get_lock(c->io_worker));
+        pa_pstream_set_receive_packet_callback(c->pstream, worker_packet_callback, c);
+        pa_pstream_set_receive_memblock_callback(c->pstream, worker_memblock_callback, c);
+        pa_pstream_set_die_callback(c->pstream, worker_die_callback, c);
+        pa_pstream_set_drain_callback(c->pstream, worker_drain_callback, c);
+        pa_pstream_set_revoke_callback(c->pstream, pstream_revoke_callback, c);
+        pa_pstream_set_release_callback(c->pstream, pstream_release_callback, c);
+
+#ifdef HAVE_CREDS
+        if (pa_iochannel_creds_supported(io))
+            pa_iochannel_creds_enable(io);
+#endif
+
+        pa_io_worker_unlock(c->io_worker);
+    } else {
+        c->pstream = pa_pstream_new(p->core->mainloop, io, p->core->mempool);
+        pa_pstream_set_receive_packet_callback(c->pstream, pstream_packet_callback, c);
+        pa_pstream_set_receive_memblock_callback(c->pstream, pstream_memblock_callback, c);
+        pa_pstream_set_die_callback(c->pstream, pstream_die_callback, c);
+        pa_pstream_set_drain_callback(c->pstream, pstream_drain_callback, c);
+        pa_pstream_set_revoke_callback(c->pstream, pstream_revoke_callback, c);
+        pa_pstream_set_release_callback(c->pstream, pstream_release_callback, c);
+
+#ifdef HAVE_CREDS
+        if (pa_iochannel_creds_supported(io))
+            pa_iochannel_creds_enable(io);
+#endif
+    }
 
     c->pdispatch = pa_pdispatch_new(p->core->mainloop, true, command_table, PA_COMMAND_MAX);
 
@@ -5215,14 +6381,10 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
 
     c->rrobin_index = PA_IDXSET_INVALID;
     c->subscription = NULL;
+    c->subscription_delta = false;
 
     pa_idxset_put(p->connections, c, NULL);
 
-#ifdef HAVE_CREDS
-    if (pa_iochannel_creds_supported(io))
-        pa_iochannel_creds_enable(io);
-#endif
-
     pa_hook_fire(&p->hooks[PA_NATIVE_HOOK_CONNECTION_PUT], c);
 }
 
@@ -5256,6 +6418,35 @@ static pa_native_protocol* native_protocol_new(pa_core *c) {
     for (h = 0; h < PA_NATIVE_HOOK_MAX; h++)
         pa_hook_init(&p->hooks[h], p);
 
+    p->io_workers = NULL;
+    p->n_io_workers = 0;
+    p->next_io_worker = 0;
+
+    if (c->native_io_threads > 0) {
+        unsigned i, n = PA_MIN(c->native_io_threads, MAX_IO_WORKERS);
+
+        if (n < c->native_io_threads)
+            pa_log_warn("native-io-threads = %u is more than the maximum of %u, using %u.",
+                        c->native_io_threads, MAX_IO_WORKERS, n);
+
+        p->io_workers = pa_xnew(pa_io_worker*, n);
+
+        for (i = 0; i < n; i++) {
+            char name[16];
+
+            pa_snprintf(name, sizeof(name), "native-io%u", i);
+
+            if (!(p->io_workers[p->n_io_workers] = pa_io_worker_new(c->mainloop, name))) {
+                pa_log_warn("Failed to start IO worker, serving connections with %u.", p->n_io_workers);
+                break;
+            }
+
+            p->n_io_workers++;
+        }
+
+        pa_log_debug("Serving native protocol connections with %u IO workers.", p->n_io_workers);
+    }
+
     pa_assert_se(pa_shared_set(c, "native-protocol", p) >= 0);
 
     return p;
@@ -5301,6 +6492,10 @@ void pa_native_protocol_unref(pa_native_protocol *p) {
 
     pa_hashmap_free(p->extensions);
 
+    while (p->n_io_workers > 0)
+        pa_io_worker_free(p->io_workers[--p->n_io_workers]);
+    pa_xfree(p->io_workers);
+
     pa_assert_se(pa_shared_remove(p->core, "native-protocol") >= 0);
 
     pa_xfree(p);
@@ -5409,6 +6604,19 @@ int pa_native_options_parse(pa_native_options *o, pa_core *c, pa_modargs *ma) {
         return -1;
     }
 
+    o->srbchannel_spin_usec = 0;
+    if (pa_modargs_get_value_u32(ma, "srbchannel-spin-usec", &o->srbchannel_spin_usec) < 0 ||
+        o->srbchannel_spin_usec > PA_SRBCHANNEL_SPIN_MAX_USEC) {
+        pa_log("srbchannel-spin-usec= expects a numerical argument between 0 and %u.", PA_SRBCHANNEL_SPIN_MAX_USEC);
+        return -1;
+    }
+
+    o->srbchannel_io_thread = false;
+    if (pa_modargs_get_value_boolean(ma, "srbchannel-io-thread", &o->srbchannel_io_thread) < 0) {
+        pa_log("srbchannel-io-thread= expects a boolean argument.");
+        return -1;
+    }
+
     if (pa_modargs_get_value_boolean(ma, "auth-anonymous", &o->auth_anonymous) < 0) {
         pa_log("auth-anonymous= expects a boolean argument.");
         return -1;
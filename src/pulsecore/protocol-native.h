@@ -43,6 +43,8 @@ typedef struct pa_native_options {
 
     bool auth_anonymous;
     bool srbchannel;
+    uint32_t srbchannel_spin_usec;
+    bool srbchannel_io_thread;
     char *auth_group;
     pa_ip_acl *auth_ip_acl;
     pa_auth_cookie *auth_cookie;
@@ -33,13 +33,19 @@
 static void pa_pstream_send_tagstruct_with_ancil_data(pa_pstream *p, pa_tagstruct *t, pa_cmsg_ancil_data *ancil_data) {
     size_t length;
     const uint8_t *data;
+    uint8_t *buf;
     pa_packet *packet;
 
     pa_assert(p);
     pa_assert(t);
 
-    pa_assert_se(data = pa_tagstruct_data(t, &length));
-    pa_assert_se(packet = pa_packet_new_data(data, length));
+    /* Hand a heap buffer over to the packet instead of copying it */
+    if ((buf = pa_tagstruct_steal_data(t, &length)))
+        packet = pa_packet_new_dynamic(buf, length);
+    else {
+        pa_assert_se(data = pa_tagstruct_data(t, &length));
+        pa_assert_se(packet = pa_packet_new_data(data, length));
+    }
     pa_tagstruct_free(t);
 
     pa_pstream_send_packet(p, packet, ancil_data);
@@ -40,6 +40,8 @@
 #include <pulsecore/refcnt.h>
 #include <pulsecore/flist.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/atomic.h>
 
 #include "pstream.h"
 
@@ -77,6 +79,12 @@ typedef uint32_t pa_pstream_descriptor[PA_PSTREAM_DESCRIPTOR_MAX];
 
 #define MINIBUF_SIZE (256)
 
+/* Up to this many queued items are coalesced into a single gathering write,
+ * and frames are read from the socket through a read-ahead buffer of this
+ * size, unless batching has been disabled for the pstream */
+#define WRITE_BATCH_MAX (16)
+#define READAHEAD_SIZE (4096)
+
 /* To allow uploading a single sample in one frame, this value should be the
  * same size (16 MB) as PA_SCACHE_ENTRY_SIZE_MAX from pulsecore/core-scache.h.
  */
@@ -118,6 +126,18 @@ struct pstream_read {
     size_t index;
 };
 
+struct pstream_write {
+    union {
+        uint8_t minibuf[MINIBUF_SIZE];
+        pa_pstream_descriptor descriptor;
+    };
+    struct item_info* current;
+    void *data;
+    size_t index;
+    int minibuf_validsize;
+    pa_memchunk memchunk;
+};
+
 struct pa_pstream {
     PA_REFCNT_DECLARE;
 
@@ -131,20 +151,27 @@ struct pa_pstream {
 
     bool dead;
 
-    struct {
-        union {
-            uint8_t minibuf[MINIBUF_SIZE];
-            pa_pstream_descriptor descriptor;
-        };
-        struct item_info* current;
-        void *data;
-        size_t index;
-        int minibuf_validsize;
-        pa_memchunk memchunk;
-    } write;
+    struct pstream_write write;
+
+    /* Items already taken off send_queue and prepared for a batched write,
+     * to be sent after write.current */
+    struct pstream_write write_next[WRITE_BATCH_MAX - 1];
+    unsigned n_write_next;
 
     struct pstream_read readio, readsrb;
 
+    /* Data read from the iochannel but not yet consumed by do_read() */
+    struct {
+        uint8_t buffer[READAHEAD_SIZE];
+        size_t index, length;
+#ifdef HAVE_CREDS
+        pa_cmsg_ancil_data ancil_data;
+#endif
+    } readahead;
+
+    bool batching;
+    pa_pstream_stats stats;
+
     /* @use_shm: beside copying the full audio data to the other
      * PA end, this pipe supports just sending references of the
      * same audio data blocks if they reside in a SHM pool.
@@ -155,6 +182,7 @@ struct pa_pstream {
      * pa_pstream_register_memfd_mempool() for more information. */
     bool use_shm, use_memfd;
     pa_idxset *registered_memfd_ids;
+    pa_mutex *registered_memfd_ids_mutex;
 
     pa_memimport *import;
     pa_memexport *export;
@@ -165,6 +193,15 @@ struct pa_pstream {
     pa_pstream_memblock_cb_t receive_memblock_callback;
     void *receive_memblock_callback_userdata;
 
+    /* Set while the srbchannel is read from another thread, see
+     * pa_pstream_set_srb_thread(). srb_thread_packet is the packet that
+     * thread stopped at, until the main loop has dispatched it. */
+    pa_pstream_memblock_cb_t srb_thread_memblock_callback;
+    void *srb_thread_memblock_callback_userdata;
+    pa_atomic_ptr_t srb_thread_packet;
+    pa_atomic_t srb_write_blocked;
+    bool srb_thread_dispatching;
+
     pa_pstream_notify_cb_t drain_callback;
     void *drain_callback_userdata;
 
@@ -177,6 +214,10 @@ struct pa_pstream {
     pa_pstream_block_id_cb_t release_callback;
     void *release_callback_userdata;
 
+    /* Taken by the entry points when the pstream's main loop runs in
+     * another thread, see pa_pstream_set_lock() */
+    pa_mutex *lock;
+
     pa_mempool *mempool;
 
 #ifdef HAVE_CREDS
@@ -235,6 +276,35 @@ void pa_cmsg_ancil_data_close_fds(struct pa_cmsg_ancil_data *ancil) {
 static int do_write(pa_pstream *p);
 static int do_read(pa_pstream *p, struct pstream_read *re);
 
+static void pstream_lock(pa_pstream *p) {
+    if (p->lock)
+        pa_mutex_lock(p->lock);
+}
+
+static void pstream_unlock(pa_pstream *p) {
+    if (p->lock)
+        pa_mutex_unlock(p->lock);
+}
+
+/* Dispatches the packet that the srbchannel reading thread stopped at. Only
+ * once that is done reading of the srbchannel may continue. */
+static void dispatch_srb_thread_packet(pa_pstream *p) {
+    pa_packet *packet;
+
+    if (p->srb_thread_dispatching || !(packet = pa_atomic_ptr_load(&p->srb_thread_packet)))
+        return;
+
+    p->srb_thread_dispatching = true;
+
+    if (p->receive_packet_callback)
+        p->receive_packet_callback(p, packet, NULL, p->receive_packet_callback_userdata);
+
+    p->srb_thread_dispatching = false;
+
+    pa_atomic_ptr_store(&p->srb_thread_packet, NULL);
+    pa_packet_unref(packet);
+}
+
 static void do_pstream_read_write(pa_pstream *p) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
@@ -245,12 +315,22 @@ static void do_pstream_read_write(pa_pstream *p) {
 
     if (!p->dead && p->srb) {
          do_write(p);
-         while (!p->dead && do_read(p, &p->readsrb) == 0);
+
+         if (!p->srb_thread_memblock_callback) {
+             /* Reading was handed back while a packet was still waiting */
+             dispatch_srb_thread_packet(p);
+
+             while (!p->dead && !pa_atomic_ptr_load(&p->srb_thread_packet) && do_read(p, &p->readsrb) == 0);
+         }
     }
 
-    if (!p->dead && pa_iochannel_is_readable(p->io)) {
-        if (do_read(p, &p->readio) < 0)
-            goto fail;
+    if (!p->dead && (pa_iochannel_is_readable(p->io) || p->readahead.index < p->readahead.length)) {
+        /* Frames that have already been read ahead won't trigger another
+         * io event, so consume all of them now */
+        do {
+            if (do_read(p, &p->readio) < 0)
+                goto fail;
+        } while (!p->dead && p->readahead.index < p->readahead.length);
     } else if (!p->dead && pa_iochannel_is_hungup(p->io))
         goto fail;
 
@@ -337,6 +417,8 @@ pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *poo
 
     p->mempool = pool;
 
+    p->batching = true;
+
     /* We do importing unconditionally */
     p->import = pa_memimport_new(p->mempool, memimport_release_cb, p);
 
@@ -355,24 +437,34 @@ int pa_pstream_attach_memfd_shmid(pa_pstream *p, unsigned shm_id, int memfd_fd)
 
     pa_assert(memfd_fd != -1);
 
+    pstream_lock(p);
+
     if (!p->use_memfd) {
         pa_log_warn("Received memfd ID registration request over a pipe "
                     "that does not support memfds");
-        return err;
+        goto finish;
     }
 
     if (pa_idxset_get_by_data(p->registered_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL)) {
         pa_log_warn("previously registered memfd SHM ID = %u", shm_id);
-        return err;
+        goto finish;
     }
 
     if (pa_memimport_attach_memfd(p->import, shm_id, memfd_fd, true)) {
         pa_log("Failed to create permanent mapping for memfd region with ID = %u", shm_id);
-        return err;
+        goto finish;
     }
 
+    /* The srbchannel reading thread might be looking IDs up concurrently */
+    pa_mutex_lock(p->registered_memfd_ids_mutex);
     pa_assert_se(pa_idxset_put(p->registered_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL) == 0);
-    return 0;
+    pa_mutex_unlock(p->registered_memfd_ids_mutex);
+
+    err = 0;
+
+finish:
+    pstream_unlock(p);
+    return err;
 }
 
 static void item_free(void *item) {
@@ -401,6 +493,9 @@ static void item_free(void *item) {
 }
 
 static void pstream_free(pa_pstream *p) {
+    pa_packet *packet;
+    unsigned i;
+
     pa_assert(p);
 
     pa_pstream_unlink(p);
@@ -413,12 +508,34 @@ static void pstream_free(pa_pstream *p) {
     if (p->write.memchunk.memblock)
         pa_memblock_unref(p->write.memchunk.memblock);
 
+    for (i = 0; i < p->n_write_next; i++) {
+        item_free(p->write_next[i].current);
+
+        if (p->write_next[i].memchunk.memblock)
+            pa_memblock_unref(p->write_next[i].memchunk.memblock);
+    }
+
+#ifdef HAVE_CREDS
+    pa_cmsg_ancil_data_close_fds(&p->readahead.ancil_data);
+#endif
+
+    pa_log_debug("pstream: wrote %llu frames (%llu bytes) in %llu calls, read %llu frames (%llu bytes) in %llu calls",
+                 (unsigned long long) p->stats.write_frames,
+                 (unsigned long long) p->stats.write_bytes,
+                 (unsigned long long) p->stats.write_calls,
+                 (unsigned long long) p->stats.read_frames,
+                 (unsigned long long) p->stats.read_bytes,
+                 (unsigned long long) p->stats.read_calls);
+
     if (p->readsrb.memblock)
         pa_memblock_unref(p->readsrb.memblock);
 
     if (p->readsrb.packet)
         pa_packet_unref(p->readsrb.packet);
 
+    if ((packet = pa_atomic_ptr_load(&p->srb_thread_packet)))
+        pa_packet_unref(packet);
+
     if (p->readio.memblock)
         pa_memblock_unref(p->readio.memblock);
 
@@ -428,6 +545,9 @@ static void pstream_free(pa_pstream *p) {
     if (p->registered_memfd_ids)
         pa_idxset_free(p->registered_memfd_ids, NULL);
 
+    if (p->registered_memfd_ids_mutex)
+        pa_mutex_free(p->registered_memfd_ids_mutex);
+
     pa_xfree(p);
 }
 
@@ -438,10 +558,13 @@ void pa_pstream_send_packet(pa_pstream*p, pa_packet *packet, pa_cmsg_ancil_data
     pa_assert(PA_REFCNT_VALUE(p) > 0);
     pa_assert(packet);
 
+    pstream_lock(p);
+
     if (p->dead) {
 #ifdef HAVE_CREDS
         pa_cmsg_ancil_data_close_fds(ancil_data);
 #endif
+        pstream_unlock(p);
         return;
     }
 
@@ -464,6 +587,8 @@ void pa_pstream_send_packet(pa_pstream*p, pa_packet *packet, pa_cmsg_ancil_data
     pa_queue_push(p->send_queue, i);
 
     p->mainloop->defer_enable(p->defer_event, 1);
+
+    pstream_unlock(p);
 }
 
 void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa_seek_mode_t seek_mode, const pa_memchunk *chunk) {
@@ -475,8 +600,12 @@ void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa
     pa_assert(channel != (uint32_t) -1);
     pa_assert(chunk);
 
-    if (p->dead)
+    pstream_lock(p);
+
+    if (p->dead) {
+        pstream_unlock(p);
         return;
+    }
 
     idx = 0;
     length = chunk->length;
@@ -510,6 +639,8 @@ void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa
     }
 
     p->mainloop->defer_enable(p->defer_event, 1);
+
+    pstream_unlock(p);
 }
 
 void pa_pstream_send_release(pa_pstream *p, uint32_t block_id) {
@@ -517,8 +648,12 @@ void pa_pstream_send_release(pa_pstream *p, uint32_t block_id) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
-    if (p->dead)
+    pstream_lock(p);
+
+    if (p->dead) {
+        pstream_unlock(p);
         return;
+    }
 
 /*     pa_log("Releasing block %u", block_id); */
 
@@ -532,6 +667,8 @@ void pa_pstream_send_release(pa_pstream *p, uint32_t block_id) {
 
     pa_queue_push(p->send_queue, item);
     p->mainloop->defer_enable(p->defer_event, 1);
+
+    pstream_unlock(p);
 }
 
 /* might be called from thread context */
@@ -555,8 +692,12 @@ void pa_pstream_send_revoke(pa_pstream *p, uint32_t block_id) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
-    if (p->dead)
+    pstream_lock(p);
+
+    if (p->dead) {
+        pstream_unlock(p);
         return;
+    }
 /*     pa_log("Revoking block %u", block_id); */
 
     if (!(item = pa_flist_pop(PA_STATIC_FLIST_GET(items))))
@@ -569,6 +710,8 @@ void pa_pstream_send_revoke(pa_pstream *p, uint32_t block_id) {
 
     pa_queue_push(p->send_queue, item);
     p->mainloop->defer_enable(p->defer_event, 1);
+
+    pstream_unlock(p);
 }
 
 /* might be called from thread context */
@@ -584,68 +727,66 @@ static void memexport_revoke_cb(pa_memexport *e, uint32_t block_id, void *userda
         pa_pstream_send_revoke(p, block_id);
 }
 
-static void prepare_next_write_item(pa_pstream *p) {
+static void prepare_write_item(pa_pstream *p, struct pstream_write *w, struct item_info *item) {
     pa_assert(p);
-    pa_assert(PA_REFCNT_VALUE(p) > 0);
-
-    p->write.current = pa_queue_pop(p->send_queue);
-
-    if (!p->write.current)
-        return;
-    p->write.index = 0;
-    p->write.data = NULL;
-    p->write.minibuf_validsize = 0;
-    pa_memchunk_reset(&p->write.memchunk);
-
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
-
-    if (p->write.current->type == PA_PSTREAM_ITEM_PACKET) {
+    pa_assert(w);
+    pa_assert(item);
+
+    w->current = item;
+    w->index = 0;
+    w->data = NULL;
+    w->minibuf_validsize = 0;
+    pa_memchunk_reset(&w->memchunk);
+
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
+
+    if (w->current->type == PA_PSTREAM_ITEM_PACKET) {
         size_t plen;
 
-        pa_assert(p->write.current->packet);
+        pa_assert(w->current->packet);
 
-        p->write.data = (void *) pa_packet_data(p->write.current->packet, &plen);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) plen);
+        w->data = (void *) pa_packet_data(w->current->packet, &plen);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) plen);
 
         if (plen <= MINIBUF_SIZE - PA_PSTREAM_DESCRIPTOR_SIZE) {
-            memcpy(&p->write.minibuf[PA_PSTREAM_DESCRIPTOR_SIZE], p->write.data, plen);
-            p->write.minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + plen;
+            memcpy(&w->minibuf[PA_PSTREAM_DESCRIPTOR_SIZE], w->data, plen);
+            w->minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + plen;
         }
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
 
     } else {
         uint32_t flags;
         bool send_payload = true;
 
-        pa_assert(p->write.current->type == PA_PSTREAM_ITEM_MEMBLOCK);
-        pa_assert(p->write.current->chunk.memblock);
+        pa_assert(w->current->type == PA_PSTREAM_ITEM_MEMBLOCK);
+        pa_assert(w->current->chunk.memblock);
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(p->write.current->channel);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) p->write.current->offset) >> 32));
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) p->write.current->offset));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(w->current->channel);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) w->current->offset) >> 32));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) w->current->offset));
 
-        flags = (uint32_t) (p->write.current->seek_mode & PA_FLAG_SEEKMASK);
+        flags = (uint32_t) (w->current->seek_mode & PA_FLAG_SEEKMASK);
 
         if (p->use_shm) {
             pa_mem_type_t type;
             uint32_t block_id, shm_id;
             size_t offset, length;
-            uint32_t *shm_info = (uint32_t *) &p->write.minibuf[PA_PSTREAM_DESCRIPTOR_SIZE];
+            uint32_t *shm_info = (uint32_t *) &w->minibuf[PA_PSTREAM_DESCRIPTOR_SIZE];
             size_t shm_size = sizeof(uint32_t) * PA_PSTREAM_SHM_MAX;
-            pa_mempool *current_pool = pa_memblock_get_pool(p->write.current->chunk.memblock);
+            pa_mempool *current_pool = pa_memblock_get_pool(w->current->chunk.memblock);
             pa_memexport *current_export;
 
             if (p->mempool == current_pool)
@@ -654,7 +795,7 @@ static void prepare_next_write_item(pa_pstream *p) {
                 pa_assert_se(current_export = pa_memexport_new(current_pool, memexport_revoke_cb, p));
 
             if (pa_memexport_put(current_export,
-                                 p->write.current->chunk.memblock,
+                                 w->current->chunk.memblock,
                                  &type,
                                  &block_id,
                                  &shm_id,
@@ -685,11 +826,11 @@ static void prepare_next_write_item(pa_pstream *p) {
 
                     shm_info[PA_PSTREAM_SHM_BLOCKID] = htonl(block_id);
                     shm_info[PA_PSTREAM_SHM_SHMID] = htonl(shm_id);
-                    shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + p->write.current->chunk.index));
-                    shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
+                    shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + w->current->chunk.index));
+                    shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) w->current->chunk.length);
 
-                    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(shm_size);
-                    p->write.minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + shm_size;
+                    w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(shm_size);
+                    w->minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + shm_size;
                 }
             }
 /*             else */
@@ -702,13 +843,31 @@ static void prepare_next_write_item(pa_pstream *p) {
         }
 
         if (send_payload) {
-            p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
-            p->write.memchunk = p->write.current->chunk;
-            pa_memblock_ref(p->write.memchunk.memblock);
+            w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) w->current->chunk.length);
+            w->memchunk = w->current->chunk;
+            pa_memblock_ref(w->memchunk.memblock);
         }
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
     }
+}
+
+static void prepare_next_write_item(pa_pstream *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    if (p->n_write_next > 0) {
+        /* Items prepared for batching never carry ancillary data */
+        p->write = p->write_next[0];
+        p->n_write_next--;
+        memmove(p->write_next, p->write_next + 1, sizeof(p->write_next[0]) * p->n_write_next);
+        return;
+    }
+
+    if (!(p->write.current = pa_queue_pop(p->send_queue)))
+        return;
+
+    prepare_write_item(p, &p->write, p->write.current);
 
 #ifdef HAVE_CREDS
     if ((p->send_ancil_data_now = p->write.current->with_ancil_data))
@@ -730,6 +889,142 @@ static void check_srbpending(pa_pstream *p) {
         pa_srbchannel_set_callback(p->srb, srb_callback, p);
 }
 
+static size_t write_item_size(struct pstream_write *w) {
+    if (w->minibuf_validsize > 0)
+        return (size_t) w->minibuf_validsize;
+
+    return PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
+}
+
+static void write_item_done(pa_pstream *p) {
+    pa_assert(p->write.current);
+
+    item_free(p->write.current);
+    p->write.current = NULL;
+
+    if (p->write.memchunk.memblock)
+        pa_memblock_unref(p->write.memchunk.memblock);
+
+    pa_memchunk_reset(&p->write.memchunk);
+}
+
+#ifdef HAVE_SYS_UIO_H
+/* Describes the unwritten part of the item in at most two iovecs. If the
+ * payload lives in a memblock it is acquired and returned in *acquired. */
+static unsigned write_item_iov(struct pstream_write *w, struct iovec *iov, pa_memblock **acquired) {
+    unsigned n = 0;
+    size_t length;
+
+    *acquired = NULL;
+
+    if (w->minibuf_validsize > 0) {
+        iov[0].iov_base = w->minibuf + w->index;
+        iov[0].iov_len = (size_t) w->minibuf_validsize - w->index;
+        return 1;
+    }
+
+    if (w->index < PA_PSTREAM_DESCRIPTOR_SIZE) {
+        iov[n].iov_base = (uint8_t*) w->descriptor + w->index;
+        iov[n].iov_len = PA_PSTREAM_DESCRIPTOR_SIZE - w->index;
+        n++;
+    }
+
+    length = ntohl(w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
+
+    if (length > 0) {
+        size_t skip = w->index > PA_PSTREAM_DESCRIPTOR_SIZE ? w->index - PA_PSTREAM_DESCRIPTOR_SIZE : 0;
+        void *d;
+
+        pa_assert(w->data || w->memchunk.memblock);
+
+        if (w->data)
+            d = w->data;
+        else {
+            d = pa_memblock_acquire_chunk(&w->memchunk);
+            *acquired = w->memchunk.memblock;
+        }
+
+        iov[n].iov_base = (uint8_t*) d + skip;
+        iov[n].iov_len = length - skip;
+        n++;
+    }
+
+    return n;
+}
+
+/* Writes the current item together with as many of the following queued
+ * items as possible in a single system call */
+static int do_write_batch(pa_pstream *p) {
+    struct iovec iov[WRITE_BATCH_MAX * 2];
+    pa_memblock *acquired[WRITE_BATCH_MAX];
+    unsigned n_iov, n_items, i;
+    size_t l = 0, left;
+    ssize_t r;
+
+    while (p->n_write_next < WRITE_BATCH_MAX - 1) {
+        struct item_info *item = pa_queue_peek(p->send_queue);
+
+        if (!item)
+            break;
+
+#ifdef HAVE_CREDS
+        /* Ancillary data has to go out with the first byte of its frame,
+         * leave it to the unbatched path */
+        if (item->with_ancil_data)
+            break;
+#endif
+
+        pa_queue_pop(p->send_queue);
+        prepare_write_item(p, &p->write_next[p->n_write_next++], item);
+    }
+
+    n_iov = write_item_iov(&p->write, iov, &acquired[0]);
+    for (i = 0; i < p->n_write_next; i++)
+        n_iov += write_item_iov(&p->write_next[i], iov + n_iov, &acquired[i + 1]);
+    n_items = p->n_write_next + 1;
+
+    for (i = 0; i < n_iov; i++)
+        l += iov[i].iov_len;
+
+    r = pa_iochannel_writev(p->io, iov, (int) n_iov);
+
+    for (i = 0; i < n_items; i++)
+        if (acquired[i])
+            pa_memblock_release(acquired[i]);
+
+    if (r < 0)
+        return -1;
+
+    p->stats.write_calls++;
+    p->stats.write_bytes += (uint64_t) r;
+
+    for (left = (size_t) r; left > 0;) {
+        size_t n;
+
+        if (!p->write.current)
+            prepare_next_write_item(p);
+
+        pa_assert(p->write.current);
+
+        n = write_item_size(&p->write) - p->write.index;
+
+        if (left < n) {
+            p->write.index += left;
+            break;
+        }
+
+        left -= n;
+        write_item_done(p);
+        p->stats.write_frames++;
+    }
+
+    if (!p->write.current && p->drain_callback && !pa_pstream_is_pending(p))
+        p->drain_callback(p, p->drain_callback_userdata);
+
+    return (size_t) r == l ? 1 : 0;
+}
+#endif
+
 static int do_write(pa_pstream *p) {
     void *d;
     size_t l;
@@ -748,6 +1043,15 @@ static int do_write(pa_pstream *p) {
         return 0;
     }
 
+#ifdef HAVE_SYS_UIO_H
+    if (p->batching && !p->srb
+#ifdef HAVE_CREDS
+        && !p->send_ancil_data_now
+#endif
+        )
+        return do_write_batch(p);
+#endif
+
     if (p->write.minibuf_validsize > 0) {
         d = p->write.minibuf + p->write.index;
         l = p->write.minibuf_validsize - p->write.index;
@@ -785,25 +1089,34 @@ static int do_write(pa_pstream *p) {
         p->send_ancil_data_now = false;
     } else
 #endif
-    if (p->srb)
+    if (p->srb) {
         r = pa_srbchannel_write(p->srb, d, l);
-    else if ((r = pa_iochannel_write(p->io, d, l)) < 0)
+
+        if ((size_t) r < l && p->srb_thread_memblock_callback) {
+            /* The wakeup for free space goes to the thread reading the
+             * srbchannel, ask it to pass that on. Retry once in case the
+             * peer made room before that request was visible. */
+            pa_atomic_store(&p->srb_write_blocked, 1);
+            r += pa_srbchannel_write(p->srb, (uint8_t*) d + r, l - r);
+        }
+    } else if ((r = pa_iochannel_write(p->io, d, l)) < 0)
         goto fail;
 
+    if (!p->srb) {
+        p->stats.write_calls++;
+        p->stats.write_bytes += (uint64_t) r;
+    }
+
     if (release_memblock)
         pa_memblock_release(release_memblock);
 
     p->write.index += (size_t) r;
 
-    if (p->write.index >= PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH])) {
-        pa_assert(p->write.current);
-        item_free(p->write.current);
-        p->write.current = NULL;
-
-        if (p->write.memchunk.memblock)
-            pa_memblock_unref(p->write.memchunk.memblock);
+    if (p->write.index >= write_item_size(&p->write)) {
+        write_item_done(p);
 
-        pa_memchunk_reset(&p->write.memchunk);
+        if (!p->srb)
+            p->stats.write_frames++;
 
         if (p->drain_callback && !pa_pstream_is_pending(p))
             p->drain_callback(p, p->drain_callback_userdata);
@@ -823,11 +1136,25 @@ fail:
     return -1;
 }
 
+/* Memblocks read from the srbchannel in another thread are passed to that
+ * thread's callback */
+static pa_pstream_memblock_cb_t get_memblock_callback(pa_pstream *p, struct pstream_read *re, void **userdata) {
+    if (re == &p->readsrb && p->srb_thread_memblock_callback) {
+        *userdata = p->srb_thread_memblock_callback_userdata;
+        return p->srb_thread_memblock_callback;
+    }
+
+    *userdata = p->receive_memblock_callback_userdata;
+    return p->receive_memblock_callback;
+}
+
 static void memblock_complete(pa_pstream *p, struct pstream_read *re) {
+    pa_pstream_memblock_cb_t cb;
+    void *userdata;
     pa_memchunk chunk;
     int64_t offset;
 
-    if (!p->receive_memblock_callback)
+    if (!(cb = get_memblock_callback(p, re, &userdata)))
         return;
 
     chunk.memblock = re->memblock;
@@ -838,13 +1165,45 @@ static void memblock_complete(pa_pstream *p, struct pstream_read *re) {
              (((uint64_t) ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])) << 32) |
              (((uint64_t) ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO]))));
 
-    p->receive_memblock_callback(
-        p,
-        ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL]),
-        offset,
-        ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & PA_FLAG_SEEKMASK,
-        &chunk,
-        p->receive_memblock_callback_userdata);
+    cb(p,
+       ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL]),
+       offset,
+       ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & PA_FLAG_SEEKMASK,
+       &chunk,
+       userdata);
+}
+
+#ifdef HAVE_CREDS
+static void merge_ancil_data(pa_pstream *p, pa_cmsg_ancil_data *b, bool with_fds) {
+    if (b->creds_valid) {
+        p->read_ancil_data.creds_valid = true;
+        p->read_ancil_data.creds = b->creds;
+    }
+    if (with_fds && b->nfd > 0) {
+        pa_assert(b->nfd <= MAX_ANCIL_DATA_FDS);
+        p->read_ancil_data.nfd = b->nfd;
+        memcpy(p->read_ancil_data.fds, b->fds, sizeof(int) * b->nfd);
+        p->read_ancil_data.close_fds_on_cleanup = b->close_fds_on_cleanup;
+        b->nfd = 0;
+    }
+}
+#endif
+
+static ssize_t read_io(pa_pstream *p, void *d, size_t l, pa_cmsg_ancil_data *ancil_data) {
+    ssize_t r;
+
+#ifdef HAVE_CREDS
+    r = pa_iochannel_read_with_ancil_data(p->io, d, l, ancil_data);
+#else
+    r = pa_iochannel_read(p->io, d, l);
+#endif
+
+    if (r > 0) {
+        p->stats.read_calls++;
+        p->stats.read_bytes += (uint64_t) r;
+    }
+
+    return r;
 }
 
 static int do_read(pa_pstream *p, struct pstream_read *re) {
@@ -879,30 +1238,40 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
                 pa_memblock_release(release_memblock);
             return 1;
         }
-    }
-    else
+    } else if (p->readahead.index < p->readahead.length || (p->batching && l < READAHEAD_SIZE)) {
+
+        if (p->readahead.index >= p->readahead.length) {
+            /* Read as much as is available, it is likely to contain the
+             * next few frames as well */
+            if ((r = read_io(p, p->readahead.buffer, READAHEAD_SIZE, &p->readahead.ancil_data)) <= 0)
+                goto fail;
+
+            p->readahead.index = 0;
+            p->readahead.length = (size_t) r;
+        }
+
+        r = (ssize_t) PA_MIN(l, p->readahead.length - p->readahead.index);
+        memcpy(d, p->readahead.buffer + p->readahead.index, (size_t) r);
+        p->readahead.index += (size_t) r;
+
+#ifdef HAVE_CREDS
+        /* The kernel never merges data following passed fds into the same
+         * read, so they belong to the frame containing the last byte */
+        merge_ancil_data(p, &p->readahead.ancil_data, p->readahead.index >= p->readahead.length);
+#endif
+    } else {
 #ifdef HAVE_CREDS
-    {
         pa_cmsg_ancil_data b;
 
-        if ((r = pa_iochannel_read_with_ancil_data(p->io, d, l, &b)) <= 0)
+        if ((r = read_io(p, d, l, &b)) <= 0)
             goto fail;
 
-        if (b.creds_valid) {
-            p->read_ancil_data.creds_valid = true;
-            p->read_ancil_data.creds = b.creds;
-        }
-        if (b.nfd > 0) {
-            pa_assert(b.nfd <= MAX_ANCIL_DATA_FDS);
-            p->read_ancil_data.nfd = b.nfd;
-            memcpy(p->read_ancil_data.fds, b.fds, sizeof(int) * b.nfd);
-            p->read_ancil_data.close_fds_on_cleanup = b.close_fds_on_cleanup;
-        }
-    }
+        merge_ancil_data(p, &b, true);
 #else
-    if ((r = pa_iochannel_read(p->io, d, l)) <= 0)
-        goto fail;
+        if ((r = read_io(p, d, l, NULL)) <= 0)
+            goto fail;
 #endif
+    }
 
     if (release_memblock)
         pa_memblock_release(release_memblock);
@@ -1007,6 +1376,14 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
 
         } else if (re->packet) {
 
+            if (re == &p->readsrb && p->srb_thread_memblock_callback) {
+                /* Packets are always dispatched from the main loop, stop
+                 * here until that happened */
+                pa_atomic_ptr_store(&p->srb_thread_packet, re->packet);
+                re->packet = NULL;
+                goto frame_done;
+            }
+
             if (p->receive_packet_callback)
 #ifdef HAVE_CREDS
                 p->receive_packet_callback(p, re->packet, &p->read_ancil_data, p->receive_packet_callback_userdata);
@@ -1016,6 +1393,9 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
 
             pa_packet_unref(re->packet);
         } else {
+            pa_pstream_memblock_cb_t cb;
+            void *userdata;
+            bool registered = true;
             pa_memblock *b = NULL;
             uint32_t flags = ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]);
             uint32_t shm_id = ntohl(re->shm_info[PA_PSTREAM_SHM_SHMID]);
@@ -1025,8 +1405,13 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
             pa_assert(((flags & PA_FLAG_SHMMASK) & PA_FLAG_SHMDATA) != 0);
             pa_assert(p->import);
 
-            if (type == PA_MEM_TYPE_SHARED_MEMFD && p->use_memfd &&
-                !pa_idxset_get_by_data(p->registered_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL)) {
+            if (type == PA_MEM_TYPE_SHARED_MEMFD && p->use_memfd) {
+                pa_mutex_lock(p->registered_memfd_ids_mutex);
+                registered = !!pa_idxset_get_by_data(p->registered_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL);
+                pa_mutex_unlock(p->registered_memfd_ids_mutex);
+            }
+
+            if (!registered) {
 
                 if (pa_log_ratelimit(PA_LOG_ERROR))
                     pa_log("Ignoring received block reference with non-registered memfd ID = %u", shm_id);
@@ -1043,7 +1428,7 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
                     pa_log_debug("Failed to import memory block.");
             }
 
-            if (p->receive_memblock_callback) {
+            if ((cb = get_memblock_callback(p, re, &userdata))) {
                 int64_t offset;
                 pa_memchunk chunk;
 
@@ -1055,13 +1440,12 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
                         (((uint64_t) ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])) << 32) |
                         (((uint64_t) ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO]))));
 
-                p->receive_memblock_callback(
-                        p,
-                        ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL]),
-                        offset,
-                        ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & PA_FLAG_SEEKMASK,
-                        &chunk,
-                        p->receive_memblock_callback_userdata);
+                cb(p,
+                   ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL]),
+                   offset,
+                   ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & PA_FLAG_SEEKMASK,
+                   &chunk,
+                   userdata);
             }
 
             if (b)
@@ -1074,6 +1458,9 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
     return 0;
 
 frame_done:
+    if (re == &p->readio)
+        p->stats.read_frames++;
+
     re->memblock = NULL;
     re->packet = NULL;
     re->index = 0;
@@ -1087,8 +1474,11 @@ frame_done:
      * to commands that does not expect fds. By doing so, server will reach
      * its open fd limit and future clients' SHM transfers will always fail.
      */
-    p->read_ancil_data.creds_valid = false;
-    p->read_ancil_data.nfd = 0;
+    if (re == &p->readio || !p->srb_thread_memblock_callback) {
+        /* The main loop owns these while another thread reads the srbchannel */
+        p->read_ancil_data.creds_valid = false;
+        p->read_ancil_data.nfd = 0;
+    }
 #endif
 
     return 0;
@@ -1154,10 +1544,14 @@ bool pa_pstream_is_pending(pa_pstream *p) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
+    pstream_lock(p);
+
     if (p->dead)
         b = false;
     else
-        b = p->write.current || !pa_queue_isempty(p->send_queue);
+        b = p->write.current || p->n_write_next > 0 || !pa_queue_isempty(p->send_queue);
+
+    pstream_unlock(p);
 
     return b;
 }
@@ -1181,8 +1575,12 @@ pa_pstream* pa_pstream_ref(pa_pstream*p) {
 void pa_pstream_unlink(pa_pstream *p) {
     pa_assert(p);
 
-    if (p->dead)
+    pstream_lock(p);
+
+    if (p->dead) {
+        pstream_unlock(p);
         return;
+    }
 
     p->dead = true;
 
@@ -1213,12 +1611,16 @@ void pa_pstream_unlink(pa_pstream *p) {
     p->drain_callback = NULL;
     p->receive_packet_callback = NULL;
     p->receive_memblock_callback = NULL;
+
+    pstream_unlock(p);
 }
 
 void pa_pstream_enable_shm(pa_pstream *p, bool enable) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
+    pstream_lock(p);
+
     p->use_shm = enable;
 
     if (enable) {
@@ -1233,6 +1635,8 @@ void pa_pstream_enable_shm(pa_pstream *p, bool enable) {
             p->export = NULL;
         }
     }
+
+    pstream_unlock(p);
 }
 
 void pa_pstream_enable_memfd(pa_pstream *p) {
@@ -1240,11 +1644,24 @@ void pa_pstream_enable_memfd(pa_pstream *p) {
     pa_assert(PA_REFCNT_VALUE(p) > 0);
     pa_assert(p->use_shm);
 
+    pstream_lock(p);
+
     p->use_memfd = true;
 
     if (!p->registered_memfd_ids) {
         p->registered_memfd_ids = pa_idxset_new(NULL, NULL);
+        p->registered_memfd_ids_mutex = pa_mutex_new(false, false);
     }
+
+    pstream_unlock(p);
+}
+
+void pa_pstream_set_lock(pa_pstream *p, pa_mutex *mutex) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(!p->srb);
+
+    p->lock = mutex;
 }
 
 bool pa_pstream_get_shm(pa_pstream *p) {
@@ -1261,6 +1678,21 @@ bool pa_pstream_get_memfd(pa_pstream *p) {
     return p->use_memfd;
 }
 
+void pa_pstream_enable_batching(pa_pstream *p, bool enable) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    p->batching = enable;
+}
+
+void pa_pstream_get_stats(pa_pstream *p, pa_pstream_stats *stats) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(stats);
+
+    *stats = p->stats;
+}
+
 void pa_pstream_set_srbchannel(pa_pstream *p, pa_srbchannel *srb) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0 || srb == NULL);
@@ -1271,6 +1703,9 @@ void pa_pstream_set_srbchannel(pa_pstream *p, pa_srbchannel *srb) {
     /* We can't handle quick switches between srbchannels. */
     pa_assert(!p->is_srbpending);
 
+    /* Nor switching under the feet of the thread reading it */
+    pa_assert(!p->srb_thread_memblock_callback);
+
     p->srbpending = srb;
     p->is_srbpending = true;
 
@@ -1280,3 +1715,78 @@ void pa_pstream_set_srbchannel(pa_pstream *p, pa_srbchannel *srb) {
     else
         do_write(p);
 }
+
+pa_fdsem *pa_pstream_set_srb_thread(pa_pstream *p, pa_pstream_memblock_cb_t cb, void *userdata) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    if (cb) {
+        pa_assert(!p->srb_thread_memblock_callback);
+
+        if (p->dead || !p->srb || p->is_srbpending)
+            return NULL;
+
+        pa_srbchannel_set_callback(p->srb, NULL, NULL);
+        pa_atomic_store(&p->srb_write_blocked, 0);
+
+        p->srb_thread_memblock_callback = cb;
+        p->srb_thread_memblock_callback_userdata = userdata;
+
+        return pa_srbchannel_get_read_fdsem(p->srb);
+    }
+
+    if (!p->srb_thread_memblock_callback)
+        return NULL;
+
+    p->srb_thread_memblock_callback = NULL;
+    p->srb_thread_memblock_callback_userdata = NULL;
+
+    /* This also takes care of a packet the thread might have stopped at */
+    if (!p->dead && p->srb)
+        pa_srbchannel_set_callback(p->srb, srb_callback, p);
+
+    return NULL;
+}
+
+int pa_pstream_srb_thread_read(pa_pstream *p, bool *write_ready) {
+    pa_assert(p);
+    pa_assert(p->srb_thread_memblock_callback);
+    pa_assert(write_ready);
+
+    *write_ready = pa_atomic_cmpxchg(&p->srb_write_blocked, 1, 0);
+
+    if (pa_atomic_ptr_load(&p->srb_thread_packet))
+        return 0;
+
+    for (;;) {
+        int r;
+
+        if ((r = do_read(p, &p->readsrb)) < 0)
+            return -1;
+
+        if (r > 0)
+            return 0;
+
+        if (pa_atomic_ptr_load(&p->srb_thread_packet))
+            return 1;
+    }
+}
+
+void pa_pstream_srb_thread_dispatch(pa_pstream *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    if (p->dead)
+        return;
+
+    pa_pstream_ref(p);
+
+    dispatch_srb_thread_packet(p);
+
+    /* Catch up on writes that waited for the peer, and on reading in case
+     * the thread stopped reading in the meantime */
+    if (!p->dead)
+        p->mainloop->defer_enable(p->defer_event, 1);
+
+    pa_pstream_unref(p);
+}
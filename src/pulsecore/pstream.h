@@ -33,6 +33,7 @@
 #include <pulsecore/memchunk.h>
 #include <pulsecore/creds.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
 
 typedef struct pa_pstream pa_pstream;
 
@@ -41,6 +42,16 @@ typedef void (*pa_pstream_memblock_cb_t)(pa_pstream *p, uint32_t channel, int64_
 typedef void (*pa_pstream_notify_cb_t)(pa_pstream *p, void *userdata);
 typedef void (*pa_pstream_block_id_cb_t)(pa_pstream *p, uint32_t block_id, void *userdata);
 
+/* Traffic on the pstream's iochannel, srbchannel transfers are not included */
+typedef struct pa_pstream_stats {
+    uint64_t write_calls;
+    uint64_t write_bytes;
+    uint64_t write_frames;
+    uint64_t read_calls;
+    uint64_t read_bytes;
+    uint64_t read_frames;
+} pa_pstream_stats;
+
 pa_pstream* pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *p);
 
 pa_pstream* pa_pstream_ref(pa_pstream*p);
@@ -69,8 +80,38 @@ void pa_pstream_enable_memfd(pa_pstream *p);
 bool pa_pstream_get_shm(pa_pstream *p);
 bool pa_pstream_get_memfd(pa_pstream *p);
 
+/* For pstreams whose main loop runs in a thread of its own and dispatches
+ * with mutex held: makes the functions that may be called from other threads
+ * (sending, unlinking, the SHM setup) take the mutex too, which therefore
+ * needs to be recursive. No srbchannel may be used on such a pstream. Set it
+ * right after pa_pstream_new(), with the mutex held. */
+void pa_pstream_set_lock(pa_pstream *p, pa_mutex *mutex);
+
+/* Coalesce queued frames into one gathering write and read frames through a
+ * read-ahead buffer, to save system calls. Enabled by default. */
+void pa_pstream_enable_batching(pa_pstream *p, bool enable);
+
+void pa_pstream_get_stats(pa_pstream *p, pa_pstream_stats *stats);
+
 /* Enables shared ringbuffer channel. Note that the srbchannel is now owned by the pstream.
    Setting srb to NULL will free any existing srbchannel. */
 void pa_pstream_set_srbchannel(pa_pstream *p, pa_srbchannel *srb);
 
+/* Hands reading of the srbchannel over to another thread: memblocks read
+ * there are passed to cb in that thread, while reading stops at each packet
+ * until the main loop dispatched it with pa_pstream_srb_thread_dispatch().
+ * Returns the semaphore the thread should wait on, or NULL if there is no
+ * active srbchannel. Pass cb = NULL to take reading back, only after the
+ * other thread stopped reading. Called from main context. */
+pa_fdsem *pa_pstream_set_srb_thread(pa_pstream *p, pa_pstream_memblock_cb_t cb, void *userdata);
+
+/* Called from the thread reading the srbchannel when the semaphore was
+ * signalled. Returns a negative value on error, 1 if a packet is waiting for
+ * pa_pstream_srb_thread_dispatch() and 0 otherwise. *write_ready is set if
+ * the main loop waits for space in the srbchannel and should be kicked with
+ * pa_pstream_srb_thread_dispatch() too. */
+int pa_pstream_srb_thread_read(pa_pstream *p, bool *write_ready);
+
+void pa_pstream_srb_thread_dispatch(pa_pstream *p);
+
 #endif
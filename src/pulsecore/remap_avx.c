@@ -0,0 +1,444 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+#include "remap.h"
+
+#if defined (__GNUC__) && (defined (__i386__) || defined (__amd64__))
+
+#include <immintrin.h>
+
+/* The kernels are compiled with per-function target attributes, so that the
+ * rest of the library does not need to be built with -mavx2. They are only
+ * ever called after pa_cpu_get_x86_flags() detected support for them.
+ *
+ * Every output sample is the dot product of its input frame with one row of
+ * the channel matrix. When a block of input frames fits into one vector, as
+ * with upmixing from few channels, the input sample of every output lane is
+ * picked with a permutation per input channel and multiplied with a vector of
+ * coefficients. Otherwise an input frame is loaded into as many vectors of
+ * eight channels as needed and multiplied with the row, and the eight
+ * products that make up eight consecutive output samples are then summed
+ * horizontally in one go. Either way, output samples are produced in their
+ * interleaved order, so no shuffling of the output is needed for any channel
+ * count.
+ *
+ * The s16 results are bit-exact with remap_channels_matrix_s16ne_c(), as the
+ * generic code wraps around just like the integer sums here. The float
+ * results only differ by the order of the additions. */
+
+#define AVX2 __attribute__ ((target ("avx2")))
+#define AVX2_INLINE static inline __attribute__ ((always_inline, target ("avx2")))
+
+/* Maximum number of vectors an input frame is split into */
+#define MAX_CHUNKS (PA_CHANNELS_MAX / 8)
+
+/* Number of frames after which the output is a whole number of vectors */
+#define FRAMES_PER_BLOCK(n_oc) (8 / PA_MIN((n_oc) & -(n_oc), 8u))
+
+/* Horizontal sums of eight vectors, as one vector */
+AVX2_INLINE __m256 hsum8_ps(const __m256 *p) {
+    __m256 a = _mm256_hadd_ps(_mm256_hadd_ps(p[0], p[1]), _mm256_hadd_ps(p[2], p[3]));
+    __m256 b = _mm256_hadd_ps(_mm256_hadd_ps(p[4], p[5]), _mm256_hadd_ps(p[6], p[7]));
+
+    return _mm256_add_ps(_mm256_permute2f128_ps(a, b, 0x20), _mm256_permute2f128_ps(a, b, 0x31));
+}
+
+AVX2_INLINE __m256i hsum8_epi32(const __m256i *p) {
+    __m256i a = _mm256_hadd_epi32(_mm256_hadd_epi32(p[0], p[1]), _mm256_hadd_epi32(p[2], p[3]));
+    __m256i b = _mm256_hadd_epi32(_mm256_hadd_epi32(p[4], p[5]), _mm256_hadd_epi32(p[6], p[7]));
+
+    return _mm256_add_epi32(_mm256_permute2x128_si256(a, b, 0x20), _mm256_permute2x128_si256(a, b, 0x31));
+}
+
+/* Truncates eight int32 to int16 and stores them */
+AVX2_INLINE void store_s16(int16_t *d, __m256i v) {
+    v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(
+        0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+        0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1));
+    v = _mm256_permute4x64_epi64(v, 0x08);
+
+    _mm_storeu_si128((__m128i *) d, _mm256_castsi256_si128(v));
+}
+
+/* Whether all input frames of a block fit into one vector. Each output
+ * vector is then computed by picking the input sample for every lane with a
+ * permutation, once per input channel, which avoids the horizontal sums and
+ * wastes no lanes when there are few input channels. */
+#define USE_PERMUTE(n_ic, n_oc) (FRAMES_PER_BLOCK(n_oc) * (n_ic) <= 8)
+
+/* Lane mask for the first n lanes */
+AVX2_INLINE __m256i lane_mask(unsigned n) {
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32((int) n), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+/* Remaps one block of FRAMES_PER_BLOCK(n_oc) frames, of which only the first
+ * nf are read. The masked loads keep samples of the next frame, which might
+ * be Inf or NaN, out of the products. */
+AVX2_INLINE void dot_block_float32ne(const float *coef, float *dst, const float *src, unsigned nf,
+        unsigned n_ic, unsigned n_oc) {
+
+    const unsigned n_k = (n_ic + 7) / 8;
+    const __m256i mask = lane_mask(n_ic % 8 ? n_ic % 8 : 8);
+    __m256 x[MAX_CHUNKS], p[8];
+    unsigned f, k, oc, q = 0;
+
+    for (f = 0; f < FRAMES_PER_BLOCK(n_oc); f++, src += n_ic) {
+        for (k = 0; k < n_k; k++) {
+            if (f >= nf)
+                x[k] = _mm256_setzero_ps();
+            else if (k < n_k - 1 || n_ic % 8 == 0)
+                x[k] = _mm256_loadu_ps(src + 8 * k);
+            else
+                x[k] = _mm256_maskload_ps(src + 8 * k, mask);
+        }
+
+        for (oc = 0; oc < n_oc; oc++) {
+            const float *c = coef + oc * n_k * 8;
+            __m256 d = _mm256_mul_ps(x[0], _mm256_loadu_ps(c));
+
+            for (k = 1; k < n_k; k++)
+                d = _mm256_add_ps(d, _mm256_mul_ps(x[k], _mm256_loadu_ps(c + 8 * k)));
+
+            p[q % 8] = d;
+
+            if (++q % 8 == 0) {
+                _mm256_storeu_ps(dst, hsum8_ps(p));
+                dst += 8;
+            }
+        }
+    }
+}
+
+/* The state holds the coefficients for every output vector and input
+ * channel, followed by the matching lane indices into the input vector */
+AVX2_INLINE void permute_block_float32ne(const float *coef, float *dst, const float *src, unsigned nf,
+        unsigned n_ic, unsigned n_oc) {
+
+    const unsigned n_j = FRAMES_PER_BLOCK(n_oc) * n_oc / 8;
+    const int32_t *idx = (const int32_t *) (coef + n_j * n_ic * 8);
+    unsigned j, ic;
+    __m256 x;
+
+    if (nf * n_ic == 8)
+        x = _mm256_loadu_ps(src);
+    else
+        x = _mm256_maskload_ps(src, lane_mask(nf * n_ic));
+
+    for (j = 0; j < n_j; j++, dst += 8) {
+        __m256 d = _mm256_setzero_ps();
+
+        for (ic = 0; ic < n_ic; ic++, coef += 8, idx += 8) {
+            __m256 s = _mm256_permutevar8x32_ps(x, _mm256_loadu_si256((const __m256i *) idx));
+
+            d = ic == 0 ? _mm256_mul_ps(s, _mm256_loadu_ps(coef)) : _mm256_add_ps(d, _mm256_mul_ps(s, _mm256_loadu_ps(coef)));
+        }
+
+        _mm256_storeu_ps(dst, d);
+    }
+}
+
+AVX2_INLINE void remap_matrix_float32ne(const float *coef, float *dst, const float *src, unsigned n,
+        unsigned n_ic, unsigned n_oc) {
+
+    const unsigned fpb = FRAMES_PER_BLOCK(n_oc);
+
+    for (; n >= fpb; n -= fpb, src += fpb * n_ic, dst += fpb * n_oc) {
+        if (USE_PERMUTE(n_ic, n_oc))
+            permute_block_float32ne(coef, dst, src, fpb, n_ic, n_oc);
+        else
+            dot_block_float32ne(coef, dst, src, fpb, n_ic, n_oc);
+    }
+
+    if (n > 0) {
+        float out[8 * PA_CHANNELS_MAX];
+
+        if (USE_PERMUTE(n_ic, n_oc))
+            permute_block_float32ne(coef, out, src, n, n_ic, n_oc);
+        else
+            dot_block_float32ne(coef, out, src, n, n_ic, n_oc);
+
+        memcpy(dst, out, n * n_oc * sizeof(float));
+    }
+}
+
+/* Like the float versions, but the input is always read in whole vectors of
+ * eight samples. The extra samples are multiplied with zero or end up in
+ * output that is thrown away. */
+AVX2_INLINE void dot_block_s16ne(const int32_t *coef, int16_t *dst, const int16_t *src,
+        unsigned n_ic, unsigned n_oc) {
+
+    const unsigned n_k = (n_ic + 7) / 8;
+    __m256i x[MAX_CHUNKS], p[8];
+    unsigned f, k, oc, q = 0;
+
+    for (f = 0; f < FRAMES_PER_BLOCK(n_oc); f++, src += n_ic) {
+        for (k = 0; k < n_k; k++)
+            x[k] = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (src + 8 * k)));
+
+        for (oc = 0; oc < n_oc; oc++) {
+            const int32_t *c = coef + oc * n_k * 8;
+            __m256i d = _mm256_srai_epi32(_mm256_mullo_epi32(x[0], _mm256_loadu_si256((const __m256i *) c)), 16);
+
+            for (k = 1; k < n_k; k++)
+                d = _mm256_add_epi32(d,
+                    _mm256_srai_epi32(_mm256_mullo_epi32(x[k], _mm256_loadu_si256((const __m256i *) (c + 8 * k))), 16));
+
+            p[q % 8] = d;
+
+            if (++q % 8 == 0) {
+                store_s16(dst, hsum8_epi32(p));
+                dst += 8;
+            }
+        }
+    }
+}
+
+AVX2_INLINE void permute_block_s16ne(const int32_t *coef, int16_t *dst, const int16_t *src,
+        unsigned n_ic, unsigned n_oc) {
+
+    const unsigned n_j = FRAMES_PER_BLOCK(n_oc) * n_oc / 8;
+    const int32_t *idx = coef + n_j * n_ic * 8;
+    __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) src));
+    unsigned j, ic;
+
+    for (j = 0; j < n_j; j++, dst += 8) {
+        __m256i d = _mm256_setzero_si256();
+
+        for (ic = 0; ic < n_ic; ic++, coef += 8, idx += 8) {
+            __m256i s = _mm256_permutevar8x32_epi32(x, _mm256_loadu_si256((const __m256i *) idx));
+
+            d = _mm256_add_epi32(d, _mm256_srai_epi32(_mm256_mullo_epi32(s, _mm256_loadu_si256((const __m256i *) coef)), 16));
+        }
+
+        store_s16(dst, d);
+    }
+}
+
+AVX2_INLINE void remap_matrix_s16ne(const int32_t *coef, int16_t *dst, const int16_t *src, unsigned n,
+        unsigned n_ic, unsigned n_oc) {
+
+    const unsigned fpb = FRAMES_PER_BLOCK(n_oc);
+    /* Frames at the end whose samples the full vector loads would read past */
+    const unsigned pad = n_ic % 8 ? (8 + n_ic - 1) / n_ic : 0;
+
+    for (; n >= fpb + pad; n -= fpb, src += fpb * n_ic, dst += fpb * n_oc) {
+        if (USE_PERMUTE(n_ic, n_oc))
+            permute_block_s16ne(coef, dst, src, n_ic, n_oc);
+        else
+            dot_block_s16ne(coef, dst, src, n_ic, n_oc);
+    }
+
+    if (n > 0) {
+        int16_t in[16 * PA_CHANNELS_MAX + 8] = { 0 }, out[8 * PA_CHANNELS_MAX];
+        const int16_t *s = in;
+
+        memcpy(in, src, n * n_ic * sizeof(int16_t));
+
+        for (; n > 0; s += fpb * n_ic) {
+            unsigned nf = PA_MIN(n, fpb);
+
+            if (USE_PERMUTE(n_ic, n_oc))
+                permute_block_s16ne(coef, out, s, n_ic, n_oc);
+            else
+                dot_block_s16ne(coef, out, s, n_ic, n_oc);
+
+            memcpy(dst, out, nf * n_oc * sizeof(int16_t));
+
+            dst += nf * n_oc;
+            n -= nf;
+        }
+    }
+}
+
+/* The generic kernels and the specializations for common layouts, where the
+ * channel counts are known at compile time */
+#define DEFINE_REMAP(name, n_ic, n_oc)                                                   \
+    static AVX2 void remap_##name##_float32ne_avx2(pa_remap_t *m, float *dst, const float *src, unsigned n) { \
+        remap_matrix_float32ne(m->state, dst, src, n, (n_ic), (n_oc));                   \
+    }                                                                                    \
+    static AVX2 void remap_##name##_s16ne_avx2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) { \
+        remap_matrix_s16ne(m->state, dst, src, n, (n_ic), (n_oc));                       \
+    }
+
+DEFINE_REMAP(channels_matrix, m->i_ss.channels, m->o_ss.channels)
+DEFINE_REMAP(ch4_to_stereo, 4, 2)
+DEFINE_REMAP(ch6_to_stereo, 6, 2)
+DEFINE_REMAP(ch8_to_stereo, 8, 2)
+DEFINE_REMAP(ch8_to_ch6, 8, 6)
+DEFINE_REMAP(stereo_to_ch6, 2, 6)
+DEFINE_REMAP(stereo_to_ch8, 2, 8)
+DEFINE_REMAP(ch6_to_ch8, 6, 8)
+
+static const struct {
+    unsigned n_ic, n_oc;
+    const char *name;
+    pa_do_remap_func_t func_s16, func_float;
+} special_remaps[] = {
+#define SPECIAL_REMAP(name, n_ic, n_oc, description) \
+    { n_ic, n_oc, description, (pa_do_remap_func_t) remap_##name##_s16ne_avx2, (pa_do_remap_func_t) remap_##name##_float32ne_avx2 }
+    SPECIAL_REMAP(ch4_to_stereo, 4, 2, "4-channel to stereo"),
+    SPECIAL_REMAP(ch6_to_stereo, 6, 2, "5.1 to stereo"),
+    SPECIAL_REMAP(ch8_to_stereo, 8, 2, "7.1 to stereo"),
+    SPECIAL_REMAP(ch8_to_ch6, 8, 6, "7.1 to 5.1"),
+    SPECIAL_REMAP(stereo_to_ch6, 2, 6, "stereo to 5.1"),
+    SPECIAL_REMAP(stereo_to_ch8, 2, 8, "stereo to 7.1"),
+    SPECIAL_REMAP(ch6_to_ch8, 6, 8, "5.1 to 7.1"),
+#undef SPECIAL_REMAP
+};
+
+/* Layouts that the generic or the older SIMD code handle with plain copies
+ * or fixed averages, which these kernels cannot beat */
+static bool is_simple_remap(const pa_remap_t *m) {
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    int8_t arrange[PA_CHANNELS_MAX];
+    unsigned i;
+
+    if (pa_setup_remap_arrange(m, arrange))
+        return true;
+
+    if (n_ic == 1 && (n_oc == 2 || n_oc == 4)) {
+        for (i = 0; i < n_oc; i++)
+            if (m->map_table_i[i][0] != 0x10000)
+                return false;
+        return true;
+    }
+
+    if (n_oc == 1 && (n_ic == 2 || n_ic == 4)) {
+        for (i = 0; i < n_ic; i++)
+            if (m->map_table_i[0][i] != 0x10000 / (int32_t) n_ic)
+                return false;
+        return true;
+    }
+
+    return false;
+}
+
+/* Lays out the coefficients for the kernels, clamped the way the generic
+ * code treats them. Integer and float coefficients both take four bytes. */
+static void *setup_state(const pa_remap_t *m) {
+    unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    unsigned oc, ic;
+    union {
+        float f;
+        int32_t i;
+    } *c;
+
+    if (USE_PERMUTE(n_ic, n_oc)) {
+        /* Coefficients and lane indices for every output vector of a block
+         * and every input channel */
+        unsigned n_j = FRAMES_PER_BLOCK(n_oc) * n_oc / 8, j, l;
+
+        c = pa_xmalloc0(2 * n_j * n_ic * 8 * sizeof(*c));
+
+        for (j = 0; j < n_j; j++) {
+            for (ic = 0; ic < n_ic; ic++) {
+                for (l = 0; l < 8; l++) {
+                    unsigned q = j * 8 + l, k = (j * n_ic + ic) * 8 + l;
+
+                    oc = q % n_oc;
+
+                    if (m->format == PA_SAMPLE_FLOAT32NE)
+                        c[k].f = PA_CLAMP_UNLIKELY(m->map_table_f[oc][ic], 0.0f, 1.0f);
+                    else
+                        c[k].i = PA_CLAMP_UNLIKELY(m->map_table_i[oc][ic], 0, 0x10000);
+
+                    c[n_j * n_ic * 8 + k].i = (q / n_oc) * n_ic + ic;
+                }
+            }
+        }
+    } else {
+        /* One row of the matrix per output channel, padded to whole vectors */
+        unsigned n_k = (n_ic + 7) / 8;
+
+        c = pa_xmalloc0(n_oc * n_k * 8 * sizeof(*c));
+
+        for (oc = 0; oc < n_oc; oc++) {
+            for (ic = 0; ic < n_ic; ic++) {
+                if (m->format == PA_SAMPLE_FLOAT32NE)
+                    c[oc * n_k * 8 + ic].f = PA_CLAMP_UNLIKELY(m->map_table_f[oc][ic], 0.0f, 1.0f);
+                else
+                    c[oc * n_k * 8 + ic].i = PA_CLAMP_UNLIKELY(m->map_table_i[oc][ic], 0, 0x10000);
+            }
+        }
+    }
+
+    return c;
+}
+
+static pa_init_remap_func_t init_remap_prev;
+
+static void init_remap_avx2(pa_remap_t *m) {
+    unsigned n_ic, n_oc, i;
+
+    n_ic = m->i_ss.channels;
+    n_oc = m->o_ss.channels;
+
+    if (m->format == PA_SAMPLE_S32NE || is_simple_remap(m)) {
+        init_remap_prev(m);
+        return;
+    }
+
+    for (i = 0; i < PA_ELEMENTSOF(special_remaps); i++) {
+        if (special_remaps[i].n_ic == n_ic && special_remaps[i].n_oc == n_oc) {
+            pa_log_info("Using AVX2 %s remapping", special_remaps[i].name);
+            m->state = setup_state(m);
+            pa_set_remap_func(m, special_remaps[i].func_s16, NULL, special_remaps[i].func_float);
+            return;
+        }
+    }
+
+    /* With fewer than seven input channels the dot products waste too many
+     * lanes to beat the generic code, which also skips muted channels */
+    if (!USE_PERMUTE(n_ic, n_oc) && n_ic < 7) {
+        init_remap_prev(m);
+        return;
+    }
+
+    pa_log_info("Using AVX2 matrix remapping");
+    m->state = setup_state(m);
+    pa_set_remap_func(m, (pa_do_remap_func_t) remap_channels_matrix_s16ne_avx2,
+        NULL, (pa_do_remap_func_t) remap_channels_matrix_float32ne_avx2);
+}
+
+#endif /* defined (__GNUC__) && (defined (__i386__) || defined (__amd64__)) */
+
+void pa_remap_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (__GNUC__) && (defined (__i386__) || defined (__amd64__))
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized remappers.");
+
+        /* Layouts not handled here go to the previously installed function */
+        if (pa_get_init_remap_func() != (pa_init_remap_func_t) init_remap_avx2)
+            init_remap_prev = pa_get_init_remap_func();
+
+        pa_set_init_remap_func((pa_init_remap_func_t) init_remap_avx2);
+    }
+
+#endif /* defined (__GNUC__) && (defined (__i386__) || defined (__amd64__)) */
+}
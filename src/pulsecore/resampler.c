@@ -25,7 +25,9 @@
 
 #include <pulse/xmalloc.h>
 #include <pulsecore/log.h>
+#include <pulsecore/llist.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
 #include <pulsecore/strbuf.h>
 #include <pulsecore/core-util.h>
 
@@ -38,6 +40,22 @@ struct ffmpeg_data { /* data specific to ffmpeg */
     struct AVResampleContext *state;
 };
 
+struct pa_resampler_filter {
+    pa_resample_method_t method;
+    uint32_t in_rate, out_rate;
+    unsigned quality;
+
+    unsigned ref;
+    void *data;
+
+    PA_LLIST_FIELDS(pa_resampler_filter);
+};
+
+/* All filters in use. There are only ever a few different conversions, so a
+ * list is good enough. */
+static PA_LLIST_HEAD(pa_resampler_filter, filters);
+static pa_static_mutex filters_mutex = PA_STATIC_MUTEX_INIT;
+
 static int copy_init(pa_resampler *r);
 
 static void setup_remap(const pa_resampler *r, pa_remap_t *m, bool *lfe_remixed);
@@ -118,6 +136,9 @@ static int (* const init_table[])(pa_resampler *r) = {
     [PA_RESAMPLER_SOXR_HQ]                 = NULL,
     [PA_RESAMPLER_SOXR_VHQ]                = NULL,
 #endif
+    [PA_RESAMPLER_POLYPHASE_MQ]            = pa_resampler_polyphase_init,
+    [PA_RESAMPLER_POLYPHASE_HQ]            = pa_resampler_polyphase_init,
+    [PA_RESAMPLER_POLYPHASE_VHQ]           = pa_resampler_polyphase_init,
 };
 
 static pa_resample_method_t choose_auto_resampler(pa_resample_flags_t flags) {
@@ -632,6 +653,98 @@ const pa_sample_spec* pa_resampler_output_sample_spec(pa_resampler *r) {
     return &r->o_ss;
 }
 
+/* Called with filters_mutex held */
+static pa_resampler_filter *filter_find(pa_resample_method_t method, uint32_t in_rate, uint32_t out_rate, unsigned quality) {
+    pa_resampler_filter *f;
+
+    for (f = filters; f; f = f->next)
+        if (f->method == method && f->in_rate == in_rate && f->out_rate == out_rate && f->quality == quality)
+            return f;
+
+    return NULL;
+}
+
+pa_resampler_filter *pa_resampler_filter_get(pa_resample_method_t method, uint32_t in_rate, uint32_t out_rate, unsigned quality,
+                                             pa_resampler_filter_create_cb_t create) {
+    pa_resampler_filter *f;
+    void *data;
+    pa_mutex *m;
+
+    pa_assert(create);
+
+    m = pa_static_mutex_get(&filters_mutex, false, false);
+    pa_mutex_lock(m);
+
+    if ((f = filter_find(method, in_rate, out_rate, quality)))
+        goto found;
+
+    pa_mutex_unlock(m);
+
+    /* Computing the filter may take a while, and IO threads come here when
+     * rates change, so it is done without the lock. If another thread
+     * created the same filter in the meantime, the first one wins. */
+    data = create(method, in_rate, out_rate, quality);
+
+    pa_mutex_lock(m);
+
+    if ((f = filter_find(method, in_rate, out_rate, quality))) {
+        pa_xfree(data);
+        goto found;
+    }
+
+    f = pa_xnew0(pa_resampler_filter, 1);
+    f->method = method;
+    f->in_rate = in_rate;
+    f->out_rate = out_rate;
+    f->quality = quality;
+    f->ref = 1;
+    f->data = data;
+
+    PA_LLIST_PREPEND(pa_resampler_filter, filters, f);
+
+    pa_mutex_unlock(m);
+
+    return f;
+
+found:
+    f->ref++;
+    pa_log_debug("Sharing %s filter for %u -> %u Hz with %u other resamplers.",
+                 pa_resample_method_to_string(method), in_rate, out_rate, f->ref - 1);
+
+    pa_mutex_unlock(m);
+
+    return f;
+}
+
+void pa_resampler_filter_unref(pa_resampler_filter *f) {
+    pa_mutex *m;
+
+    pa_assert(f);
+
+    m = pa_static_mutex_get(&filters_mutex, false, false);
+    pa_mutex_lock(m);
+
+    pa_assert(f->ref >= 1);
+
+    if (--f->ref > 0) {
+        pa_mutex_unlock(m);
+        return;
+    }
+
+    PA_LLIST_REMOVE(pa_resampler_filter, filters, f);
+
+    pa_mutex_unlock(m);
+
+    pa_xfree(f->data);
+    pa_xfree(f);
+}
+
+const void *pa_resampler_filter_data(const pa_resampler_filter *f) {
+    pa_assert(f);
+
+    return f->data;
+}
+
 static const char * const resample_methods[] = {
     "src-sinc-best-quality",
     "src-sinc-medium-quality",
@@ -667,7 +780,10 @@ static const char * const resample_methods[] = {
     "peaks",
     "soxr-mq",
     "soxr-hq",
-    "soxr-vhq"
+    "soxr-vhq",
+    "polyphase-mq",
+    "polyphase-hq",
+    "polyphase-vhq"
 };
 
 const char *pa_resample_method_to_string(pa_resample_method_t m) {
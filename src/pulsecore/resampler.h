@@ -30,6 +30,7 @@
 
 typedef struct pa_resampler pa_resampler;
 typedef struct pa_resampler_impl pa_resampler_impl;
+typedef struct pa_resampler_filter pa_resampler_filter;
 
 struct pa_resampler_impl {
     void (*free)(pa_resampler *r);
@@ -61,6 +62,9 @@ typedef enum pa_resample_method {
     PA_RESAMPLER_SOXR_MQ,
     PA_RESAMPLER_SOXR_HQ,
     PA_RESAMPLER_SOXR_VHQ,
+    PA_RESAMPLER_POLYPHASE_MQ,
+    PA_RESAMPLER_POLYPHASE_HQ,
+    PA_RESAMPLER_POLYPHASE_VHQ,
     PA_RESAMPLER_MAX
 } pa_resample_method_t;
 
@@ -174,6 +178,28 @@ int pa_resampler_peaks_init(pa_resampler *r);
 int pa_resampler_speex_init(pa_resampler *r);
 int pa_resampler_trivial_init(pa_resampler*r);
 int pa_resampler_soxr_init(pa_resampler *r);
+int pa_resampler_polyphase_init(pa_resampler *r);
+
+/* Inner loops of the polyphase resampler. n is a multiple of 8. The
+ * interpolation computes h from four consecutive rows of n coefficients. */
+typedef float (*pa_polyphase_dot_func_t)(const float *x, const float *h, unsigned n);
+typedef void (*pa_polyphase_interpolate_func_t)(float *h, const float *rows, unsigned n, const float w[4]);
+
+void pa_get_polyphase_funcs(pa_polyphase_dot_func_t *dot, pa_polyphase_interpolate_func_t *interpolate);
+void pa_set_polyphase_funcs(pa_polyphase_dot_func_t dot, pa_polyphase_interpolate_func_t interpolate);
+
+/* Filter state shared by all resamplers doing the same conversion, keyed by
+ * method, rates and a method specific quality or variant of the filter. The
+ * create function is called with the key, without any lock held, when no
+ * such filter exists yet. If two threads race, one of the results is
+ * dropped with pa_xfree(), as is the data when the last reference goes
+ * away. These may be called from any thread. */
+typedef void *(*pa_resampler_filter_create_cb_t)(pa_resample_method_t method, uint32_t in_rate, uint32_t out_rate, unsigned quality);
+
+pa_resampler_filter *pa_resampler_filter_get(pa_resample_method_t method, uint32_t in_rate, uint32_t out_rate, unsigned quality,
+                                             pa_resampler_filter_create_cb_t create);
+void pa_resampler_filter_unref(pa_resampler_filter *f);
+const void *pa_resampler_filter_data(const pa_resampler_filter *f);
 
 /* Resampler-specific quirks */
 bool pa_speex_is_fixed_point(void);
@@ -0,0 +1,456 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/resampler.h>
+
+/* A windowed sinc FIR resampler working on float samples.
+ *
+ * For a rate ratio of L/M (reduced by the greatest common divisor), the
+ * filter is split into L phases that are computed once, and each output
+ * sample is a dot product of one phase with the last n_taps input samples of
+ * its channel. If the ratio has too many phases, as with adaptive rates, a
+ * fixed number of phases is stored instead and the phase for an output
+ * sample is interpolated with a cubic polynomial from the four nearest ones.
+ * Variable rate resamplers always use the interpolated table, so that a rate
+ * update only needs to change the step size.
+ *
+ * The stream position is tracked exactly, as an input sample index plus a
+ * fraction with the reduced output rate as denominator.
+ *
+ * Input samples are copied into one history buffer per channel, so that the
+ * dot products run over contiguous memory.
+ *
+ * Filter tables only depend on the reduced ratio, or for interpolated
+ * tables only on the cutoff, and are shared through the resampler filter
+ * cache. Creating a stream that converts like an existing one therefore
+ * needs no filter design. */
+
+/* Phase tables with more phases or samples than these are interpolated */
+#define MAX_EXACT_PHASES 512
+#define MAX_EXACT_TABLE_SIZE (64 * 1024)
+
+/* Upper limit for the number of taps when downsampling by large factors */
+#define MAX_TAPS 2048U
+
+/* Relative change of the cutoff frequency a variable rate resampler accepts
+ * before it recomputes its filter */
+#define CUTOFF_TOLERANCE 0.01
+
+static const struct {
+    unsigned n_taps;
+    double attenuation;
+    unsigned n_phases;
+} qualities[] = {
+    [PA_RESAMPLER_POLYPHASE_MQ - PA_RESAMPLER_POLYPHASE_MQ] = { 48, 75.0, 32 },
+    [PA_RESAMPLER_POLYPHASE_HQ - PA_RESAMPLER_POLYPHASE_MQ] = { 96, 100.0, 64 },
+    [PA_RESAMPLER_POLYPHASE_VHQ - PA_RESAMPLER_POLYPHASE_MQ] = { 160, 120.0, 128 },
+};
+
+struct polyphase_filter {
+    unsigned n_taps;
+    unsigned n_phases;
+    bool interpolate;
+    double cutoff;
+
+    /* One row of n_taps coefficients per phase. Interpolated tables have an
+     * extra row before and two after the n_phases phases. */
+    float table[];
+};
+
+struct polyphase_data {
+    pa_resampler_filter *filter_ref;
+    const struct polyphase_filter *filter;
+
+    /* Reduced rate ratio and the step between two output samples */
+    unsigned den;
+    unsigned step_int, step_frac;
+
+    /* Position of the next output sample in the history buffers */
+    unsigned index, frac;
+
+    /* n_taps - 1 samples of history followed by the input, per channel */
+    float *history;
+    unsigned history_stride;
+
+    /* Phase interpolated for the current output sample */
+    float *coefs;
+};
+
+static float dot_c(const float *x, const float *h, unsigned n) {
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    unsigned k;
+
+    for (k = 0; k < n; k += 4) {
+        s0 += x[k] * h[k];
+        s1 += x[k + 1] * h[k + 1];
+        s2 += x[k + 2] * h[k + 2];
+        s3 += x[k + 3] * h[k + 3];
+    }
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+static void interpolate_c(float *h, const float *rows, unsigned n, const float w[4]) {
+    unsigned k;
+
+    for (k = 0; k < n; k++)
+        h[k] = w[0] * rows[k] + w[1] * rows[n + k] + w[2] * rows[2 * n + k] + w[3] * rows[3 * n + k];
+}
+
+static pa_polyphase_dot_func_t dot_func = dot_c;
+static pa_polyphase_interpolate_func_t interpolate_func = interpolate_c;
+
+void pa_get_polyphase_funcs(pa_polyphase_dot_func_t *dot, pa_polyphase_interpolate_func_t *interpolate) {
+    pa_assert(dot);
+    pa_assert(interpolate);
+
+    *dot = dot_func;
+    *interpolate = interpolate_func;
+}
+
+void pa_set_polyphase_funcs(pa_polyphase_dot_func_t dot, pa_polyphase_interpolate_func_t interpolate) {
+    pa_assert(dot);
+    pa_assert(interpolate);
+
+    dot_func = dot;
+    interpolate_func = interpolate;
+}
+
+/* Zeroth order modified Bessel function of the first kind */
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    unsigned k;
+
+    for (k = 1; term > sum * 1e-12; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+/* Kaiser windowed sinc with the given cutoff in cycles per input sample,
+ * t is in input samples relative to the center of the window */
+static double kaiser_sinc(double t, double cutoff, double beta, unsigned n_taps) {
+    double x = 2.0 * t / n_taps, s;
+
+    if (fabs(x) >= 1.0)
+        return 0.0;
+
+    s = fabs(t) < 1e-9 ? 1.0 : sin(2.0 * M_PI * cutoff * t) / (2.0 * M_PI * cutoff * t);
+
+    return 2.0 * cutoff * s * bessel_i0(beta * sqrt(1.0 - x * x)) / bessel_i0(beta);
+}
+
+/* Kaiser's estimate of the transition band width for the number of taps of
+ * the quality level, placed so that the stopband starts at the lower Nyquist
+ * frequency. When downsampling, the filter is stretched accordingly. */
+static double filter_cutoff(unsigned q, double ratio) {
+    double width = (qualities[q].attenuation - 8.0) / (2.285 * 2.0 * M_PI * qualities[q].n_taps) * ratio;
+
+    return 0.5 * ratio - width / 2;
+}
+
+static unsigned filter_taps(unsigned q, double ratio) {
+    return PA_MIN(PA_ROUND_UP((unsigned) ceil(qualities[q].n_taps / ratio), 8U), MAX_TAPS);
+}
+
+/* Filter cache callback, quality tells whether the table is interpolated */
+static void *create_filter(pa_resample_method_t method, uint32_t in_rate, uint32_t out_rate, unsigned quality) {
+    unsigned q = method - PA_RESAMPLER_POLYPHASE_MQ;
+    double ratio = PA_MIN((double) out_rate / in_rate, 1.0);
+    double beta = 0.1102 * (qualities[q].attenuation - 8.7);
+    unsigned n_taps, n_phases, n_rows, row, k;
+    struct polyphase_filter *f;
+    bool interpolate = quality;
+
+    n_taps = filter_taps(q, ratio);
+
+    if (interpolate) {
+        /* A stretched filter needs fewer phases for the same accuracy */
+        n_phases = PA_MAX((unsigned) ceil(qualities[q].n_phases * ratio), 8u);
+        n_rows = n_phases + 3;
+    } else {
+        /* The rates are reduced, so the output rate is the phase count */
+        n_phases = out_rate;
+        n_rows = n_phases;
+    }
+
+    f = pa_xmalloc(sizeof(struct polyphase_filter) + n_rows * n_taps * sizeof(float));
+    f->n_taps = n_taps;
+    f->n_phases = n_phases;
+    f->interpolate = interpolate;
+    f->cutoff = filter_cutoff(q, ratio);
+
+    for (row = 0; row < n_rows; row++) {
+        float *h = f->table + row * n_taps;
+        double phase = interpolate ? (double) row - 1 : (double) row;
+        double sum = 0;
+
+        for (k = 0; k < n_taps; k++) {
+            double t = n_taps / 2.0 - 1.0 - k + phase / n_phases;
+
+            h[k] = (float) kaiser_sinc(t, f->cutoff, beta, n_taps);
+            sum += h[k];
+        }
+
+        /* Normalize the DC gain of each phase */
+        if (sum > 0)
+            for (k = 0; k < n_taps; k++)
+                h[k] = (float) (h[k] / sum);
+    }
+
+    pa_log_debug("Polyphase filter with %u taps, %u%s phases, cutoff %.4f.",
+                 n_taps, n_phases, interpolate ? " interpolated" : "", f->cutoff);
+
+    return f;
+}
+
+/* Replaces the filter with the one for the current rates */
+static void acquire_filter(pa_resampler *r, struct polyphase_data *d) {
+    unsigned q = r->method - PA_RESAMPLER_POLYPHASE_MQ;
+    unsigned g = pa_gcd(r->i_ss.rate, r->o_ss.rate);
+    uint32_t in_rate = r->i_ss.rate / g, out_rate = r->o_ss.rate / g;
+    double ratio = PA_MIN((double) out_rate / in_rate, 1.0);
+    unsigned n_taps = filter_taps(q, ratio);
+    bool interpolate;
+
+    interpolate = (r->flags & PA_RESAMPLER_VARIABLE_RATE) ||
+        out_rate > MAX_EXACT_PHASES || out_rate * n_taps > MAX_EXACT_TABLE_SIZE;
+
+    /* Interpolated tables for upsampling are all the same */
+    if (interpolate && out_rate >= in_rate)
+        in_rate = out_rate = 1;
+
+    if (d->filter_ref)
+        pa_resampler_filter_unref(d->filter_ref);
+
+    d->filter_ref = pa_resampler_filter_get(r->method, in_rate, out_rate, interpolate, create_filter);
+    d->filter = pa_resampler_filter_data(d->filter_ref);
+
+    pa_xfree(d->coefs);
+    d->coefs = pa_xnew(float, d->filter->n_taps);
+}
+
+static void set_ratio(struct polyphase_data *d, uint32_t in_rate, uint32_t out_rate) {
+    unsigned g = pa_gcd(in_rate, out_rate);
+    unsigned den = out_rate / g, num = in_rate / g;
+
+    /* Keep the position of the next output sample */
+    if (d->den)
+        d->frac = (unsigned) (((uint64_t) d->frac * den) / d->den);
+
+    d->den = den;
+    d->step_int = num / den;
+    d->step_frac = num % den;
+}
+
+/* Makes room for n input frames after the history */
+static void fit_history(pa_resampler *r, struct polyphase_data *d, unsigned n) {
+    unsigned n_history = d->filter->n_taps - 1, stride, c;
+    float *history;
+
+    if (d->history && n_history + n <= d->history_stride)
+        return;
+
+    stride = n_history + PA_MAX(n, 1024u);
+    history = pa_xnew0(float, stride * r->work_channels);
+
+    if (d->history) {
+        for (c = 0; c < r->work_channels; c++)
+            memcpy(history + c * stride, d->history + c * d->history_stride, n_history * sizeof(float));
+
+        pa_xfree(d->history);
+    }
+
+    d->history = history;
+    d->history_stride = stride;
+}
+
+static const float *get_coefs(struct polyphase_data *d) {
+    const struct polyphase_filter *f = d->filter;
+    uint64_t x;
+    unsigned p;
+    float t, w[4];
+
+    if (!f->interpolate)
+        return f->table + d->frac * f->n_taps;
+
+    x = (uint64_t) d->frac * f->n_phases;
+    p = (unsigned) (x / d->den);
+    t = (float) (x % d->den) / d->den;
+
+    /* Lagrange weights for the phases p - 1 to p + 2, which are stored in
+     * the rows p to p + 3 */
+    w[0] = -t * (t - 1) * (t - 2) / 6;
+    w[1] = (t + 1) * (t - 1) * (t - 2) / 2;
+    w[2] = -(t + 1) * t * (t - 2) / 2;
+    w[3] = (t + 1) * t * (t - 1) / 6;
+
+    interpolate_func(d->coefs, f->table + p * f->n_taps, f->n_taps, w);
+
+    return d->coefs;
+}
+
+static unsigned polyphase_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames,
+                                   pa_memchunk *output, unsigned *out_n_frames) {
+    struct polyphase_data *d;
+    unsigned channels, n_taps, n_history, o_index, c, i;
+    float *src, *dst;
+
+    pa_assert(r);
+    pa_assert(input);
+    pa_assert(output);
+    pa_assert(out_n_frames);
+
+    d = r->impl.data;
+    channels = r->work_channels;
+    n_taps = d->filter->n_taps;
+    n_history = n_taps - 1;
+
+    fit_history(r, d, in_n_frames);
+
+    src = pa_memblock_acquire_chunk(input);
+    dst = pa_memblock_acquire_chunk(output);
+
+    for (c = 0; c < channels; c++) {
+        float *h = d->history + c * d->history_stride + n_history;
+
+        for (i = 0; i < in_n_frames; i++)
+            h[i] = src[i * channels + c];
+    }
+
+    for (o_index = 0; d->index < in_n_frames; o_index++) {
+        const float *coefs = get_coefs(d);
+
+        pa_assert_fp(o_index < *out_n_frames);
+
+        for (c = 0; c < channels; c++)
+            dst[o_index * channels + c] = dot_func(d->history + c * d->history_stride + d->index, coefs, n_taps);
+
+        d->index += d->step_int;
+        d->frac += d->step_frac;
+
+        if (d->frac >= d->den) {
+            d->frac -= d->den;
+            d->index++;
+        }
+    }
+
+    pa_memblock_release(input->memblock);
+    pa_memblock_release(output->memblock);
+
+    for (c = 0; c < channels; c++) {
+        float *h = d->history + c * d->history_stride;
+
+        memmove(h, h + in_n_frames, n_history * sizeof(float));
+    }
+
+    d->index -= in_n_frames;
+    *out_n_frames = o_index;
+
+    return 0;
+}
+
+static void polyphase_reset(pa_resampler *r) {
+    struct polyphase_data *d;
+
+    pa_assert(r);
+
+    d = r->impl.data;
+
+    if (d->history)
+        memset(d->history, 0, d->history_stride * r->work_channels * sizeof(float));
+
+    d->index = 0;
+    d->frac = 0;
+}
+
+static void polyphase_update_rates(pa_resampler *r) {
+    struct polyphase_data *d;
+    unsigned n_taps;
+    double cutoff;
+
+    pa_assert(r);
+
+    d = r->impl.data;
+
+    set_ratio(d, r->i_ss.rate, r->o_ss.rate);
+
+    /* An interpolated table works for any ratio, so only the step changes,
+     * unless a downsampling filter needs a different cutoff */
+    cutoff = filter_cutoff(r->method - PA_RESAMPLER_POLYPHASE_MQ, PA_MIN((double) r->o_ss.rate / r->i_ss.rate, 1.0));
+    if (d->filter->interpolate && fabs(cutoff - d->filter->cutoff) <= d->filter->cutoff * CUTOFF_TOLERANCE)
+        return;
+
+    n_taps = d->filter->n_taps;
+    acquire_filter(r, d);
+
+    /* The history does not fit a filter of different length */
+    if (d->filter->n_taps != n_taps) {
+        pa_xfree(d->history);
+        d->history = NULL;
+        d->index = 0;
+    }
+}
+
+static void polyphase_free(pa_resampler *r) {
+    struct polyphase_data *d;
+
+    pa_assert(r);
+
+    d = r->impl.data;
+    if (!d)
+        return;
+
+    if (d->filter_ref)
+        pa_resampler_filter_unref(d->filter_ref);
+
+    pa_xfree(d->coefs);
+    pa_xfree(d->history);
+    pa_xfree(d);
+}
+
+int pa_resampler_polyphase_init(pa_resampler *r) {
+    struct polyphase_data *d;
+
+    pa_assert(r);
+    pa_assert(r->work_format == PA_SAMPLE_FLOAT32NE);
+
+    d = pa_xnew0(struct polyphase_data, 1);
+
+    set_ratio(d, r->i_ss.rate, r->o_ss.rate);
+    acquire_filter(r, d);
+
+    r->impl.free = polyphase_free;
+    r->impl.reset = polyphase_reset;
+    r->impl.update_rates = polyphase_update_rates;
+    r->impl.resample = polyphase_resample;
+    r->impl.data = d;
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/resampler.h>
+
+#if defined (__GNUC__) && (defined (__i386__) || defined (__amd64__))
+
+#include <immintrin.h>
+
+/* Like the other AVX2 code, the kernels are compiled with per-function
+ * target attributes and only installed after the CPU was checked. The sums
+ * are split over two accumulators to hide the latency of the additions. */
+
+#define AVX2 __attribute__ ((target ("avx2")))
+
+static AVX2 float dot_avx2(const float *x, const float *h, unsigned n) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    __m128 s;
+    unsigned k = 0;
+
+    for (; k + 16 <= n; k += 16) {
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(x + k), _mm256_loadu_ps(h + k)));
+        s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(x + k + 8), _mm256_loadu_ps(h + k + 8)));
+    }
+
+    if (k < n)
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(x + k), _mm256_loadu_ps(h + k)));
+
+    s0 = _mm256_add_ps(s0, s1);
+    s = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+
+    return _mm_cvtss_f32(s);
+}
+
+static AVX2 void interpolate_avx2(float *h, const float *rows, unsigned n, const float w[4]) {
+    __m256 w0 = _mm256_set1_ps(w[0]), w1 = _mm256_set1_ps(w[1]);
+    __m256 w2 = _mm256_set1_ps(w[2]), w3 = _mm256_set1_ps(w[3]);
+    unsigned k;
+
+    for (k = 0; k < n; k += 8) {
+        __m256 a = _mm256_add_ps(_mm256_mul_ps(w0, _mm256_loadu_ps(rows + k)),
+                                 _mm256_mul_ps(w1, _mm256_loadu_ps(rows + n + k)));
+        __m256 b = _mm256_add_ps(_mm256_mul_ps(w2, _mm256_loadu_ps(rows + 2 * n + k)),
+                                 _mm256_mul_ps(w3, _mm256_loadu_ps(rows + 3 * n + k)));
+
+        _mm256_storeu_ps(h + k, _mm256_add_ps(a, b));
+    }
+}
+
+#endif /* defined (__GNUC__) && (defined (__i386__) || defined (__amd64__)) */
+
+void pa_polyphase_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (__GNUC__) && (defined (__i386__) || defined (__amd64__))
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized polyphase resampler functions.");
+
+        pa_set_polyphase_funcs(dot_avx2, interpolate_avx2);
+    }
+#endif /* defined (__GNUC__) && (defined (__i386__) || defined (__amd64__)) */
+}
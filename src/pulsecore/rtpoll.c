@@ -26,6 +26,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_TIMERFD_H)
+#define USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
 
 #include <pulse/xmalloc.h>
 #include <pulse/timeval.h>
@@ -38,12 +45,26 @@
 #include <pulsecore/flist.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/ratelimit.h>
+#include <pulsecore/hashmap.h>
 #include <pulse/rtclock.h>
 
 #include "rtpoll.h"
 
 /* #define DEBUG_TIMING */
 
+#ifdef USE_EPOLL
+/* An fd registered with the epoll instance. Several pollfds may refer to
+ * the same fd, their events are combined. */
+struct epoll_entry {
+    int fd;
+    uint32_t events;    /* What is registered with epoll_ctl() */
+    uint32_t wanted;    /* What the pollfds ask for in this iteration */
+    uint32_t revents;
+    bool registered:1;
+    bool seen:1;
+};
+#endif
+
 struct pa_rtpoll {
     struct pollfd *pollfd, *pollfd2;
     unsigned n_pollfd_alloc, n_pollfd_used;
@@ -57,6 +78,33 @@ struct pa_rtpoll {
     bool quit:1;
     bool timer_elapsed:1;
 
+    /* Accounting of the time spent in and out of the poll */
+    pa_io_stats stats;
+    pa_usec_t woken_up;
+
+    pa_rtpoll_backend_t backend;
+
+#ifdef USE_EPOLL
+    int epoll_fd, timer_fd;
+    pa_hashmap *epoll_entries;  /* fd -> struct epoll_entry */
+    struct epoll_event *epoll_events;
+    unsigned n_epoll_events_alloc;
+
+    /* The timerfd is only reprogrammed when next_elapse changes */
+    struct timeval timer_armed_at;
+    bool timer_armed:1;
+
+    /* Items with fds were added or removed. An fd may have been closed
+     * and its number reused, so we start over with a new epoll instance */
+    bool epoll_reset_needed:1;
+
+    /* The fd each pollfd had at the last update, in the order of pollfd.
+     * Items may also switch the fd of a pollfd they keep, see
+     * epoll_update(). */
+    int *epoll_pollfd_fds;
+    unsigned n_epoll_pollfd_fds;
+#endif
+
 #ifdef DEBUG_TIMING
     pa_usec_t timestamp;
     pa_usec_t slept, awake;
@@ -86,15 +134,147 @@ struct pa_rtpoll_item {
 
 PA_STATIC_FLIST_DECLARE(items, 0, pa_xfree);
 
-pa_rtpoll *pa_rtpoll_new(void) {
+static pa_rtpoll_backend_t default_backend = PA_RTPOLL_BACKEND_POLL;
+
+static const char * const backend_names[PA_RTPOLL_BACKEND_MAX] = {
+    [PA_RTPOLL_BACKEND_POLL] = "poll",
+    [PA_RTPOLL_BACKEND_EPOLL] = "epoll",
+};
+
+pa_rtpoll_backend_t pa_parse_rtpoll_backend(const char *string) {
+    pa_rtpoll_backend_t b;
+
+    pa_assert(string);
+
+    for (b = 0; b < PA_RTPOLL_BACKEND_MAX; b++)
+        if (pa_streq(string, backend_names[b]))
+            return b;
+
+    return PA_RTPOLL_BACKEND_INVALID;
+}
+
+const char *pa_rtpoll_backend_to_string(pa_rtpoll_backend_t b) {
+
+    if (b < 0 || b >= PA_RTPOLL_BACKEND_MAX)
+        return NULL;
+
+    return backend_names[b];
+}
+
+bool pa_rtpoll_backend_supported(pa_rtpoll_backend_t b) {
+
+    if (b < 0 || b >= PA_RTPOLL_BACKEND_MAX)
+        return false;
+
+#ifndef USE_EPOLL
+    if (b == PA_RTPOLL_BACKEND_EPOLL)
+        return false;
+#endif
+
+    return true;
+}
+
+void pa_rtpoll_set_default_backend(pa_rtpoll_backend_t b) {
+    pa_assert(pa_rtpoll_backend_supported(b));
+
+    default_backend = b;
+}
+
+#ifdef USE_EPOLL
+static void epoll_close(pa_rtpoll *p) {
+    pa_assert(p);
+
+    if (p->epoll_fd >= 0)
+        pa_close(p->epoll_fd);
+    p->epoll_fd = -1;
+
+    pa_hashmap_remove_all(p->epoll_entries);
+}
+
+static int epoll_open(pa_rtpoll *p) {
+    struct epoll_event ev;
+
+    pa_assert(p);
+    pa_assert(p->epoll_fd < 0);
+
+    if ((p->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        pa_log_error("epoll_create1(): %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    pa_zero(ev);
+    ev.events = EPOLLIN;
+    ev.data.fd = p->timer_fd;
+
+    if (epoll_ctl(p->epoll_fd, EPOLL_CTL_ADD, p->timer_fd, &ev) < 0) {
+        pa_log_error("epoll_ctl(): %s", pa_cstrerror(errno));
+        epoll_close(p);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int epoll_init(pa_rtpoll *p) {
+    pa_assert(p);
+
+    p->epoll_fd = -1;
+    p->epoll_entries = pa_hashmap_new_full(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func, NULL, pa_xfree);
+
+    if ((p->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC)) < 0) {
+        pa_log_error("timerfd_create(): %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    return epoll_open(p);
+}
+
+static void epoll_done(pa_rtpoll *p) {
+    pa_assert(p);
+
+    if (!p->epoll_entries)
+        return;
+
+    epoll_close(p);
+
+    if (p->timer_fd >= 0)
+        pa_close(p->timer_fd);
+    p->timer_fd = -1;
+
+    pa_hashmap_free(p->epoll_entries);
+    p->epoll_entries = NULL;
+
+    pa_xfree(p->epoll_events);
+    p->epoll_events = NULL;
+    p->n_epoll_events_alloc = 0;
+
+    pa_xfree(p->epoll_pollfd_fds);
+    p->epoll_pollfd_fds = NULL;
+    p->n_epoll_pollfd_fds = 0;
+}
+#endif
+
+pa_rtpoll *pa_rtpoll_new_with_backend(pa_rtpoll_backend_t b) {
     pa_rtpoll *p;
 
+    pa_assert(pa_rtpoll_backend_supported(b));
+
     p = pa_xnew0(pa_rtpoll, 1);
 
     p->n_pollfd_alloc = 32;
     p->pollfd = pa_xnew(struct pollfd, p->n_pollfd_alloc);
     p->pollfd2 = pa_xnew(struct pollfd, p->n_pollfd_alloc);
 
+    p->backend = b;
+
+#ifdef USE_EPOLL
+    if (p->backend == PA_RTPOLL_BACKEND_EPOLL && epoll_init(p) < 0) {
+        pa_log_warn("Failed to set up epoll, falling back to poll.");
+        epoll_done(p);
+        p->backend = PA_RTPOLL_BACKEND_POLL;
+    }
+#endif
+
 #ifdef DEBUG_TIMING
     p->timestamp = pa_rtclock_now();
 #endif
@@ -102,6 +282,16 @@ pa_rtpoll *pa_rtpoll_new(void) {
     return p;
 }
 
+pa_rtpoll *pa_rtpoll_new(void) {
+    return pa_rtpoll_new_with_backend(default_backend);
+}
+
+pa_rtpoll_backend_t pa_rtpoll_get_backend(pa_rtpoll *p) {
+    pa_assert(p);
+
+    return p->backend;
+}
+
 static void rtpoll_rebuild(pa_rtpoll *p) {
 
     struct pollfd *e, *t;
@@ -158,6 +348,11 @@ static void rtpoll_item_destroy(pa_rtpoll_item *i) {
 
     p->n_pollfd_used -= i->n_pollfd;
 
+#ifdef USE_EPOLL
+    if (i->n_pollfd > 0)
+        p->epoll_reset_needed = true;
+#endif
+
     if (pa_flist_push(PA_STATIC_FLIST_GET(items), i) < 0)
         pa_xfree(i);
 
@@ -173,6 +368,10 @@ void pa_rtpoll_free(pa_rtpoll *p) {
     pa_xfree(p->pollfd);
     pa_xfree(p->pollfd2);
 
+#ifdef USE_EPOLL
+    epoll_done(p);
+#endif
+
     pa_xfree(p);
 }
 
@@ -203,10 +402,231 @@ static void reset_all_revents(pa_rtpoll *p) {
     }
 }
 
+#ifdef USE_EPOLL
+/* Bring the epoll instance in line with the pollfds of all items. pollfds
+ * may be changed by their users at any time, so we have to look at all of
+ * them, but epoll_ctl() is only called for the ones that changed. */
+static int epoll_update(pa_rtpoll *p) {
+    struct epoll_entry *e;
+    pa_rtpoll_item *i;
+    void *state;
+    unsigned n = 0;
+
+    pa_assert(p);
+
+    if (p->epoll_reset_needed || p->n_epoll_pollfd_fds != p->n_pollfd_used) {
+        unsigned k;
+
+        epoll_close(p);
+
+        if (epoll_open(p) < 0)
+            return -1;
+
+        p->epoll_reset_needed = false;
+
+        p->epoll_pollfd_fds = pa_xrealloc(p->epoll_pollfd_fds, PA_MAX(p->n_pollfd_used, 1U) * sizeof(int));
+        p->n_epoll_pollfd_fds = p->n_pollfd_used;
+
+        for (k = 0; k < p->n_pollfd_used; k++)
+            p->epoll_pollfd_fds[k] = p->pollfd[k].fd;
+    }
+
+    PA_HASHMAP_FOREACH(e, p->epoll_entries, state)
+        e->seen = false;
+
+    for (i = p->items; i; i = i->next) {
+        unsigned k;
+
+        if (i->dead)
+            continue;
+
+        for (k = 0; k < i->n_pollfd; k++) {
+            struct pollfd *f = &i->pollfd[k];
+            int *old_fd = &p->epoll_pollfd_fds[f - p->pollfd];
+
+            if (f->fd != *old_fd) {
+                /* The old fd may have been closed, which drops it from the
+                 * epoll set, and the new one may have the number of an fd
+                 * closed earlier. Register both from scratch. */
+                if (*old_fd >= 0 && (e = pa_hashmap_get(p->epoll_entries, PA_INT_TO_PTR(*old_fd)))) {
+                    if (e->registered)
+                        epoll_ctl(p->epoll_fd, EPOLL_CTL_DEL, e->fd, NULL);
+                    e->registered = false;
+                }
+
+                if (f->fd >= 0 && (e = pa_hashmap_get(p->epoll_entries, PA_INT_TO_PTR(f->fd)))) {
+                    if (e->registered)
+                        epoll_ctl(p->epoll_fd, EPOLL_CTL_DEL, e->fd, NULL);
+                    e->registered = false;
+                }
+
+                *old_fd = f->fd;
+            }
+
+            if (f->fd < 0)
+                continue;
+
+            if (!(e = pa_hashmap_get(p->epoll_entries, PA_INT_TO_PTR(f->fd)))) {
+                e = pa_xnew0(struct epoll_entry, 1);
+                e->fd = f->fd;
+                pa_assert_se(pa_hashmap_put(p->epoll_entries, PA_INT_TO_PTR(e->fd), e) == 0);
+            }
+
+            if (!e->seen) {
+                e->seen = true;
+                e->wanted = 0;
+                e->revents = 0;
+            }
+
+            /* The POLL and EPOLL flags have the same values on Linux */
+            e->wanted |= (uint32_t) f->events;
+        }
+    }
+
+    PA_HASHMAP_FOREACH(e, p->epoll_entries, state) {
+        struct epoll_event ev;
+
+        if (!e->seen) {
+            /* The fd might be closed already, so ignore errors */
+            if (e->registered)
+                epoll_ctl(p->epoll_fd, EPOLL_CTL_DEL, e->fd, NULL);
+
+            pa_hashmap_remove_and_free(p->epoll_entries, PA_INT_TO_PTR(e->fd));
+            continue;
+        }
+
+        n++;
+
+        if (e->registered && e->events == e->wanted)
+            continue;
+
+        pa_zero(ev);
+        ev.events = e->wanted;
+        ev.data.fd = e->fd;
+
+        if (epoll_ctl(p->epoll_fd, e->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, e->fd, &ev) < 0) {
+            pa_log_warn("Cannot watch fd %i with epoll, falling back to poll: %s", e->fd, pa_cstrerror(errno));
+            return -1;
+        }
+
+        e->events = e->wanted;
+        e->registered = true;
+    }
+
+    /* One more for the timerfd */
+    if (n + 1 > p->n_epoll_events_alloc) {
+        p->n_epoll_events_alloc = (n + 1) * 2;
+        p->epoll_events = pa_xrealloc(p->epoll_events, p->n_epoll_events_alloc * sizeof(struct epoll_event));
+    }
+
+    return 0;
+}
+
+static int epoll_update_timer(pa_rtpoll *p) {
+    struct itimerspec its;
+
+    pa_assert(p);
+
+    pa_zero(its);
+
+    if (p->timer_enabled && !p->quit) {
+        if (p->timer_armed && pa_timeval_cmp(&p->timer_armed_at, &p->next_elapse) == 0)
+            return 0;
+
+        /* next_elapse is in the CLOCK_MONOTONIC time domain of pa_rtclock_get() */
+        its.it_value.tv_sec = p->next_elapse.tv_sec;
+        its.it_value.tv_nsec = (long) p->next_elapse.tv_usec * PA_NSEC_PER_USEC;
+
+        /* An all zero value would disarm the timer */
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+            its.it_value.tv_nsec = 1;
+
+        p->timer_armed_at = p->next_elapse;
+        p->timer_armed = true;
+    } else {
+        if (!p->timer_armed)
+            return 0;
+
+        p->timer_armed = false;
+    }
+
+    if (timerfd_settime(p->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+        pa_log_error("timerfd_settime(): %s", pa_cstrerror(errno));
+        p->timer_armed = false;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Returns the number of fds with events, like poll() */
+static int epoll_sleep(pa_rtpoll *p) {
+    pa_rtpoll_item *i;
+    int n, k, r = 0;
+
+    pa_assert(p);
+
+    if ((n = epoll_wait(p->epoll_fd, p->epoll_events, (int) p->n_epoll_events_alloc, p->quit ? 0 : -1)) < 0)
+        return n;
+
+    for (k = 0; k < n; k++) {
+        struct epoll_event *ev = &p->epoll_events[k];
+        struct epoll_entry *e;
+
+        if (ev->data.fd == p->timer_fd) {
+            uint64_t expirations;
+
+            /* Clear the expiration. The timer is one-shot, so it has to be
+             * programmed again even if next_elapse stays the same, in
+             * which case it elapses immediately, like with poll() */
+            if (read(p->timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                pa_log_warn("Failed to read from timerfd: %s", pa_cstrerror(errno));
+
+            p->timer_armed = false;
+            continue;
+        }
+
+        if ((e = pa_hashmap_get(p->epoll_entries, PA_INT_TO_PTR(ev->data.fd)))) {
+            e->revents = ev->events;
+            r++;
+        }
+    }
+
+    for (i = p->items; i; i = i->next) {
+        unsigned j;
+
+        if (i->dead)
+            continue;
+
+        for (j = 0; j < i->n_pollfd; j++) {
+            struct pollfd *f = &i->pollfd[j];
+            struct epoll_entry *e;
+
+            f->revents = 0;
+
+            if (f->fd < 0 || !(e = pa_hashmap_get(p->epoll_entries, PA_INT_TO_PTR(f->fd))))
+                continue;
+
+            f->revents = (short) (e->revents & ((uint32_t) f->events | EPOLLERR | EPOLLHUP));
+        }
+    }
+
+    return r;
+}
+
+static void epoll_fall_back(pa_rtpoll *p) {
+    pa_assert(p);
+
+    epoll_done(p);
+    p->backend = PA_RTPOLL_BACKEND_POLL;
+}
+#endif
+
 int pa_rtpoll_run(pa_rtpoll *p) {
     pa_rtpoll_item *i;
     int r = 0;
     struct timeval timeout;
+    pa_usec_t before_poll, after_poll;
 
     pa_assert(p);
     pa_assert(!p->running);
@@ -282,6 +702,12 @@ int pa_rtpoll_run(pa_rtpoll *p) {
     if (p->rebuild_needed)
         rtpoll_rebuild(p);
 
+#ifdef USE_EPOLL
+    if (p->backend == PA_RTPOLL_BACKEND_EPOLL)
+        if (epoll_update(p) < 0 || epoll_update_timer(p) < 0)
+            epoll_fall_back(p);
+#endif
+
     pa_zero(timeout);
 
     /* Calculate timeout */
@@ -307,20 +733,49 @@ int pa_rtpoll_run(pa_rtpoll *p) {
     }
 #endif
 
+    before_poll = pa_rtclock_now();
+
     /* OK, now let's sleep */
-#ifdef HAVE_PPOLL
+#ifdef USE_EPOLL
+    if (p->backend == PA_RTPOLL_BACKEND_EPOLL)
+        r = epoll_sleep(p);
+    else
+#endif
     {
+#ifdef HAVE_PPOLL
         struct timespec ts;
         ts.tv_sec = timeout.tv_sec;
         ts.tv_nsec = timeout.tv_usec * 1000;
         r = ppoll(p->pollfd, p->n_pollfd_used, (p->quit || p->timer_enabled) ? &ts : NULL, NULL);
-    }
 #else
-    r = pa_poll(p->pollfd, p->n_pollfd_used, (p->quit || p->timer_enabled) ? (int) ((timeout.tv_sec*1000) + (timeout.tv_usec / 1000)) : -1);
+        r = pa_poll(p->pollfd, p->n_pollfd_used, (p->quit || p->timer_enabled) ? (int) ((timeout.tv_sec*1000) + (timeout.tv_usec / 1000)) : -1);
 #endif
+    }
 
     p->timer_elapsed = r == 0;
 
+    after_poll = pa_rtclock_now();
+
+    p->stats.loops++;
+    p->stats.idle += after_poll - before_poll;
+
+    if (p->woken_up > 0) {
+        pa_usec_t busy = before_poll - p->woken_up;
+
+        p->stats.busy += busy;
+
+        if (busy > p->stats.busy_max)
+            p->stats.busy_max = busy;
+    }
+
+    p->woken_up = after_poll;
+
+    if (p->timer_elapsed && p->timer_enabled) {
+        pa_usec_t elapse = pa_timeval_load(&p->next_elapse);
+
+        pa_io_stats_add_lateness(&p->stats, after_poll > elapse ? after_poll - elapse : 0);
+    }
+
 #ifdef DEBUG_TIMING
     {
         pa_usec_t now = pa_rtclock_now();
@@ -374,6 +829,20 @@ finish:
     return r < 0 ? r : !p->quit;
 }
 
+void pa_rtpoll_get_io_stats(pa_rtpoll *p, pa_io_stats *stats) {
+    pa_assert(p);
+    pa_assert(stats);
+
+    *stats = p->stats;
+}
+
+void pa_rtpoll_reset_io_stats(pa_rtpoll *p) {
+    pa_assert(p);
+
+    pa_io_stats_reset(&p->stats);
+    p->woken_up = 0;
+}
+
 void pa_rtpoll_set_timer_absolute(pa_rtpoll *p, pa_usec_t usec) {
     pa_assert(p);
 
@@ -432,6 +901,9 @@ pa_rtpoll_item *pa_rtpoll_item_new(pa_rtpoll *p, pa_rtpoll_priority_t prio, unsi
     if (n_fds > 0) {
         p->rebuild_needed = 1;
         p->n_pollfd_used += n_fds;
+#ifdef USE_EPOLL
+        p->epoll_reset_needed = true;
+#endif
     }
 
     return i;
@@ -26,6 +26,7 @@
 #include <pulse/sample.h>
 #include <pulsecore/asyncmsgq.h>
 #include <pulsecore/fdsem.h>
+#include <pulsecore/io-stats.h>
 #include <pulsecore/macro.h>
 
 /* An implementation of a "real-time" poll loop. Basically, this is
@@ -51,9 +52,33 @@ typedef enum pa_rtpoll_priority {
     PA_RTPOLL_NEVER  = INT_MAX,       /* For stuff that doesn't register any callbacks, but only fds to listen on */
 } pa_rtpoll_priority_t;
 
+/* How pa_rtpoll_run() sleeps. The poll backend passes the pollfd array
+ * to ppoll() with a relative timeout. The epoll backend keeps the fds
+ * registered with an epoll instance, only updating it when the pollfds
+ * change, and sleeps until an absolute CLOCK_MONOTONIC deadline on a
+ * timerfd. If an fd cannot be watched with epoll, the rtpoll falls back
+ * to the poll backend. */
+typedef enum pa_rtpoll_backend {
+    PA_RTPOLL_BACKEND_INVALID = -1,
+    PA_RTPOLL_BACKEND_POLL,
+    PA_RTPOLL_BACKEND_EPOLL,
+    PA_RTPOLL_BACKEND_MAX
+} pa_rtpoll_backend_t;
+
+pa_rtpoll_backend_t pa_parse_rtpoll_backend(const char *string);
+const char *pa_rtpoll_backend_to_string(pa_rtpoll_backend_t b);
+bool pa_rtpoll_backend_supported(pa_rtpoll_backend_t b);
+
+/* The backend used by pa_rtpoll_new(). Should be set once at startup,
+ * before any IO threads are created. */
+void pa_rtpoll_set_default_backend(pa_rtpoll_backend_t b);
+
 pa_rtpoll *pa_rtpoll_new(void);
+pa_rtpoll *pa_rtpoll_new_with_backend(pa_rtpoll_backend_t b);
 void pa_rtpoll_free(pa_rtpoll *p);
 
+pa_rtpoll_backend_t pa_rtpoll_get_backend(pa_rtpoll *p);
+
 /* Sleep on the rtpoll until the time event, or any of the fd events
  * is triggered. Returns negative on error, positive if the loop
  * should continue to run, 0 when the loop should be terminated
@@ -68,6 +93,11 @@ void pa_rtpoll_set_timer_disabled(pa_rtpoll *p);
  * the last pa_rtpoll_run() invocation to finish */
 bool pa_rtpoll_timer_elapsed(pa_rtpoll *p);
 
+/* Busy and idle time and timer wakeup lateness of the thread running the
+ * rtpoll. May only be called from that thread. */
+void pa_rtpoll_get_io_stats(pa_rtpoll *p, pa_io_stats *stats);
+void pa_rtpoll_reset_io_stats(pa_rtpoll *p);
+
 /* A new fd wakeup item for pa_rtpoll */
 pa_rtpoll_item *pa_rtpoll_item_new(pa_rtpoll *p, pa_rtpoll_priority_t prio, unsigned n_fds);
 void pa_rtpoll_item_free(pa_rtpoll_item *i);
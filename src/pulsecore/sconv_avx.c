@@ -0,0 +1,380 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
+
+#include "cpu-x86.h"
+#include "sconv.h"
+
+#if defined (__GNUC__) && (defined (__i386__) || defined (__amd64__))
+
+#include <immintrin.h>
+
+/* The kernels are compiled with per-function target attributes, so that the
+ * rest of the library does not need to be built with -mavx2. They are only
+ * ever called after pa_cpu_get_x86_flags() detected support for them.
+ *
+ * All integer formats are converted through a common intermediate: eight
+ * samples held as left-justified 32 bit integers, i.e. scaled to the full
+ * range of an int32. Reading a format into that representation and writing
+ * it back out is exactly what the generic code in sconv-s16le.c does with its
+ * shifts, so every conversion is a load, an optional float step and a store.
+ * Conversions from float round first and clamp the way lrintf() and
+ * PA_CLAMP_UNLIKELY() do. The results are bit-exact with the generic C
+ * functions.
+ *
+ * x86 is little endian, so NE is LE and RE is BE throughout. The a-law and
+ * u-law formats are table lookups and stay on the C paths. */
+
+#define AVX2 __attribute__ ((target ("avx2")))
+#define AVX2_INLINE static inline __attribute__ ((always_inline, target ("avx2")))
+
+/* Byte shuffles reversing every 16 and 32 bit word of a 128 bit lane */
+#define SWAP16_MASK \
+    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14
+#define SWAP32_MASK \
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+
+AVX2_INLINE __m256i swap32(__m256i v) {
+    return _mm256_shuffle_epi8(v, _mm256_setr_epi8(SWAP32_MASK, SWAP32_MASK));
+}
+
+/* Loads of eight samples into left-justified int32 */
+
+AVX2_INLINE __m256i load_u8(const uint8_t *a) {
+    __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) a));
+
+    return _mm256_slli_epi32(_mm256_sub_epi32(v, _mm256_set1_epi32(0x80)), 24);
+}
+
+AVX2_INLINE __m256i load_s16le(const uint8_t *a) {
+    return _mm256_slli_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) a)), 16);
+}
+
+AVX2_INLINE __m256i load_s16be(const uint8_t *a) {
+    __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) a), _mm_setr_epi8(SWAP16_MASK));
+
+    return _mm256_slli_epi32(_mm256_cvtepi16_epi32(v), 16);
+}
+
+AVX2_INLINE __m256i load_s32le(const uint8_t *a) {
+    return _mm256_loadu_si256((const __m256i *) a);
+}
+
+AVX2_INLINE __m256i load_s32be(const uint8_t *a) {
+    return swap32(_mm256_loadu_si256((const __m256i *) a));
+}
+
+/* The upper lane is read from a + 8 so that no byte beyond the 24 bytes of
+ * the eight samples is touched; its samples start at byte 4 of the lane. The
+ * low byte of every sample is left zero. */
+AVX2_INLINE __m256i load_s24(const uint8_t *a, __m256i shuffle) {
+    __m256i v = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) a));
+
+    v = _mm256_inserti128_si256(v, _mm_loadu_si128((const __m128i *) (a + 8)), 1);
+    return _mm256_shuffle_epi8(v, shuffle);
+}
+
+AVX2_INLINE __m256i load_s24le(const uint8_t *a) {
+    return load_s24(a, _mm256_setr_epi8(
+        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+        -1, 4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15));
+}
+
+AVX2_INLINE __m256i load_s24be(const uint8_t *a) {
+    return load_s24(a, _mm256_setr_epi8(
+        -1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9,
+        -1, 6, 5, 4, -1, 9, 8, 7, -1, 12, 11, 10, -1, 15, 14, 13));
+}
+
+AVX2_INLINE __m256i load_s24_32le(const uint8_t *a) {
+    return _mm256_slli_epi32(_mm256_loadu_si256((const __m256i *) a), 8);
+}
+
+AVX2_INLINE __m256i load_s24_32be(const uint8_t *a) {
+    return _mm256_slli_epi32(swap32(_mm256_loadu_si256((const __m256i *) a)), 8);
+}
+
+/* Stores of eight left-justified int32 samples, dropping the low bits */
+
+AVX2_INLINE __m128i pack_s16(__m256i v) {
+    v = _mm256_srai_epi32(v, 16);
+    return _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+AVX2_INLINE void store_u8(uint8_t *b, __m256i v) {
+    __m128i s = pack_s16(_mm256_srai_epi32(v, 8));
+
+    s = _mm_xor_si128(_mm_packs_epi16(s, s), _mm_set1_epi8((char) 0x80));
+    _mm_storel_epi64((__m128i *) b, s);
+}
+
+AVX2_INLINE void store_s16le(uint8_t *b, __m256i v) {
+    _mm_storeu_si128((__m128i *) b, pack_s16(v));
+}
+
+AVX2_INLINE void store_s16be(uint8_t *b, __m256i v) {
+    _mm_storeu_si128((__m128i *) b, _mm_shuffle_epi8(pack_s16(v), _mm_setr_epi8(SWAP16_MASK)));
+}
+
+AVX2_INLINE void store_s32le(uint8_t *b, __m256i v) {
+    _mm256_storeu_si256((__m256i *) b, v);
+}
+
+AVX2_INLINE void store_s32be(uint8_t *b, __m256i v) {
+    _mm256_storeu_si256((__m256i *) b, swap32(v));
+}
+
+/* Picks the upper three bytes of every sample, moves the two 12 byte halves
+ * next to each other and writes exactly 24 bytes */
+AVX2_INLINE void store_s24(uint8_t *b, __m256i v, __m256i shuffle) {
+    v = _mm256_shuffle_epi8(v, shuffle);
+    v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+
+    _mm_storeu_si128((__m128i *) b, _mm256_castsi256_si128(v));
+    _mm_storel_epi64((__m128i *) (b + 16), _mm256_extracti128_si256(v, 1));
+}
+
+AVX2_INLINE void store_s24le(uint8_t *b, __m256i v) {
+    store_s24(b, v, _mm256_setr_epi8(
+        1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1,
+        1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1));
+}
+
+AVX2_INLINE void store_s24be(uint8_t *b, __m256i v) {
+    store_s24(b, v, _mm256_setr_epi8(
+        3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, -1, -1, -1, -1,
+        3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, -1, -1, -1, -1));
+}
+
+AVX2_INLINE void store_s24_32le(uint8_t *b, __m256i v) {
+    _mm256_storeu_si256((__m256i *) b, _mm256_srli_epi32(v, 8));
+}
+
+AVX2_INLINE void store_s24_32be(uint8_t *b, __m256i v) {
+    _mm256_storeu_si256((__m256i *) b, swap32(_mm256_srli_epi32(v, 8)));
+}
+
+/* Float loads and stores */
+
+AVX2_INLINE __m256 load_f32le(const uint8_t *a) {
+    return _mm256_loadu_ps((const float *) a);
+}
+
+AVX2_INLINE __m256 load_f32be(const uint8_t *a) {
+    return _mm256_castsi256_ps(swap32(_mm256_loadu_si256((const __m256i *) a)));
+}
+
+AVX2_INLINE void store_f32le(uint8_t *b, __m256 v) {
+    _mm256_storeu_ps((float *) b, v);
+}
+
+AVX2_INLINE void store_f32be(uint8_t *b, __m256 v) {
+    _mm256_storeu_si256((__m256i *) b, swap32(_mm256_castps_si256(v)));
+}
+
+/* Conversions between left-justified int32 and float */
+
+AVX2_INLINE __m256 s32_to_float(__m256i v) {
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(1.0f / (1U << 31)));
+}
+
+/* cvtps2dq returns 0x80000000 for anything out of range, which is right for
+ * the negative side. Positive overflow is turned into 0x7FFFFFFF. */
+AVX2_INLINE __m256i float_to_s32(__m256 f) {
+    __m256 v = _mm256_mul_ps(f, _mm256_set1_ps((float) (1U << 31)));
+    __m256 over = _mm256_cmp_ps(v, _mm256_set1_ps((float) (1U << 31)), _CMP_GE_OQ);
+
+    return _mm256_xor_si256(_mm256_cvtps_epi32(v), _mm256_castps_si256(over));
+}
+
+/* Clamping before rounding gives the same result as clamping the result of
+ * lrintf(), as the bounds are integers */
+AVX2_INLINE __m256i float_to_s16(__m256 f) {
+    __m256 v = _mm256_mul_ps(f, _mm256_set1_ps(1 << 15));
+
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(-0x8000)), _mm256_set1_ps(0x7FFF));
+    return _mm256_slli_epi32(_mm256_cvtps_epi32(v), 16);
+}
+
+/* u8_from_float32ne() scales in double precision and rounds to float before
+ * clamping, which is repeated here for bit-exactness */
+AVX2_INLINE __m256i float_to_u8(__m256 f) {
+    const __m256d scale = _mm256_set1_pd(127.0), offset = _mm256_set1_pd(128.0);
+    __m128 lo, hi;
+    __m256 v;
+
+    lo = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(f)), scale), offset));
+    hi = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(f, 1)), scale), offset));
+
+    v = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+
+    return _mm256_slli_epi32(_mm256_sub_epi32(_mm256_cvtps_epi32(v), _mm256_set1_epi32(0x80)), 24);
+}
+
+/* Each kernel converts blocks of eight samples. The remaining samples are
+ * copied into a zero padded buffer and converted as one more block, so that
+ * the tail goes through the very same code. */
+#define DEFINE_CONVERT(name, in_size, out_size, convert)                       \
+    static AVX2 void name(unsigned n, const uint8_t *a, uint8_t *b) {         \
+        for (; n >= 8; n -= 8, a += 8 * (in_size), b += 8 * (out_size))        \
+            convert(a, b);                                                     \
+                                                                               \
+        if (n > 0) {                                                           \
+            uint8_t in[8 * 4] = { 0 }, out[8 * 4];                             \
+                                                                               \
+            memcpy(in, a, n * (in_size));                                      \
+            convert(in, out);                                                  \
+            memcpy(b, out, n * (out_size));                                    \
+        }                                                                      \
+    }
+
+/* Integer format to integer format, through left-justified int32 */
+#define DEFINE_INT_TO_INT(name, load, in_size, store, out_size)                \
+    AVX2_INLINE void name##_block(const uint8_t *a, uint8_t *b) {              \
+        store(b, load(a));                                                     \
+    }                                                                          \
+    DEFINE_CONVERT(name, in_size, out_size, name##_block)
+
+#define DEFINE_INT_TO_FLOAT(name, load, in_size, store)                        \
+    AVX2_INLINE void name##_block(const uint8_t *a, uint8_t *b) {              \
+        store(b, s32_to_float(load(a)));                                       \
+    }                                                                          \
+    DEFINE_CONVERT(name, in_size, 4, name##_block)
+
+#define DEFINE_FLOAT_TO_INT(name, load, to_int, store, out_size)               \
+    AVX2_INLINE void name##_block(const uint8_t *a, uint8_t *b) {              \
+        store(b, to_int(load(a)));                                             \
+    }                                                                          \
+    DEFINE_CONVERT(name, 4, out_size, name##_block)
+
+AVX2_INLINE void swap_f32_block(const uint8_t *a, uint8_t *b) {
+    store_f32le(b, load_f32be(a));
+}
+
+AVX2_INLINE void swap_s16_block(const uint8_t *a, uint8_t *b) {
+    _mm_storeu_si128((__m128i *) b, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) a), _mm_setr_epi8(SWAP16_MASK)));
+}
+
+DEFINE_CONVERT(f32_swap_avx2, 4, 4, swap_f32_block)
+DEFINE_CONVERT(s16_swap_avx2, 2, 2, swap_s16_block)
+
+/* to float32ne */
+DEFINE_INT_TO_FLOAT(u8_to_f32ne_avx2, load_u8, 1, store_f32le)
+DEFINE_INT_TO_FLOAT(s16le_to_f32ne_avx2, load_s16le, 2, store_f32le)
+DEFINE_INT_TO_FLOAT(s16be_to_f32ne_avx2, load_s16be, 2, store_f32le)
+DEFINE_INT_TO_FLOAT(s32le_to_f32ne_avx2, load_s32le, 4, store_f32le)
+DEFINE_INT_TO_FLOAT(s32be_to_f32ne_avx2, load_s32be, 4, store_f32le)
+DEFINE_INT_TO_FLOAT(s24le_to_f32ne_avx2, load_s24le, 3, store_f32le)
+DEFINE_INT_TO_FLOAT(s24be_to_f32ne_avx2, load_s24be, 3, store_f32le)
+DEFINE_INT_TO_FLOAT(s24_32le_to_f32ne_avx2, load_s24_32le, 4, store_f32le)
+DEFINE_INT_TO_FLOAT(s24_32be_to_f32ne_avx2, load_s24_32be, 4, store_f32le)
+
+/* from float32ne */
+DEFINE_FLOAT_TO_INT(u8_from_f32ne_avx2, load_f32le, float_to_u8, store_u8, 1)
+DEFINE_FLOAT_TO_INT(s16le_from_f32ne_avx2, load_f32le, float_to_s16, store_s16le, 2)
+DEFINE_FLOAT_TO_INT(s16be_from_f32ne_avx2, load_f32le, float_to_s16, store_s16be, 2)
+DEFINE_FLOAT_TO_INT(s32le_from_f32ne_avx2, load_f32le, float_to_s32, store_s32le, 4)
+DEFINE_FLOAT_TO_INT(s32be_from_f32ne_avx2, load_f32le, float_to_s32, store_s32be, 4)
+DEFINE_FLOAT_TO_INT(s24le_from_f32ne_avx2, load_f32le, float_to_s32, store_s24le, 3)
+DEFINE_FLOAT_TO_INT(s24be_from_f32ne_avx2, load_f32le, float_to_s32, store_s24be, 3)
+DEFINE_FLOAT_TO_INT(s24_32le_from_f32ne_avx2, load_f32le, float_to_s32, store_s24_32le, 4)
+DEFINE_FLOAT_TO_INT(s24_32be_from_f32ne_avx2, load_f32le, float_to_s32, store_s24_32be, 4)
+
+/* to s16ne */
+DEFINE_INT_TO_INT(u8_to_s16ne_avx2, load_u8, 1, store_s16le, 2)
+DEFINE_INT_TO_INT(s32le_to_s16ne_avx2, load_s32le, 4, store_s16le, 2)
+DEFINE_INT_TO_INT(s32be_to_s16ne_avx2, load_s32be, 4, store_s16le, 2)
+DEFINE_INT_TO_INT(s24le_to_s16ne_avx2, load_s24le, 3, store_s16le, 2)
+DEFINE_INT_TO_INT(s24be_to_s16ne_avx2, load_s24be, 3, store_s16le, 2)
+DEFINE_INT_TO_INT(s24_32le_to_s16ne_avx2, load_s24_32le, 4, store_s16le, 2)
+DEFINE_INT_TO_INT(s24_32be_to_s16ne_avx2, load_s24_32be, 4, store_s16le, 2)
+DEFINE_FLOAT_TO_INT(f32be_to_s16ne_avx2, load_f32be, float_to_s16, store_s16le, 2)
+
+/* from s16ne */
+DEFINE_INT_TO_INT(u8_from_s16ne_avx2, load_s16le, 2, store_u8, 1)
+DEFINE_INT_TO_INT(s32le_from_s16ne_avx2, load_s16le, 2, store_s32le, 4)
+DEFINE_INT_TO_INT(s32be_from_s16ne_avx2, load_s16le, 2, store_s32be, 4)
+DEFINE_INT_TO_INT(s24le_from_s16ne_avx2, load_s16le, 2, store_s24le, 3)
+DEFINE_INT_TO_INT(s24be_from_s16ne_avx2, load_s16le, 2, store_s24be, 3)
+DEFINE_INT_TO_INT(s24_32le_from_s16ne_avx2, load_s16le, 2, store_s24_32le, 4)
+DEFINE_INT_TO_INT(s24_32be_from_s16ne_avx2, load_s16le, 2, store_s24_32be, 4)
+DEFINE_INT_TO_FLOAT(f32be_from_s16ne_avx2, load_s16le, 2, store_f32be)
+
+#endif /* defined (__GNUC__) && (defined (__i386__) || defined (__amd64__)) */
+
+void pa_convert_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if defined (__GNUC__) && (defined (__i386__) || defined (__amd64__))
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized conversions.");
+
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_U8, (pa_convert_func_t) u8_to_f32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) s16le_to_f32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) s16be_to_f32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) s32le_to_f32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) s32be_to_f32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_to_f32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_to_f32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) s24_32le_to_f32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) s24_32be_to_f32ne_avx2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_FLOAT32BE, (pa_convert_func_t) f32_swap_avx2);
+
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_U8, (pa_convert_func_t) u8_from_f32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) s16le_from_f32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) s16be_from_f32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) s32le_from_f32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) s32be_from_f32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_from_f32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_from_f32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) s24_32le_from_f32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) s24_32be_from_f32ne_avx2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_FLOAT32BE, (pa_convert_func_t) f32_swap_avx2);
+
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_U8, (pa_convert_func_t) u8_to_s16ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) s16_swap_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) s16le_from_f32ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32BE, (pa_convert_func_t) f32be_to_s16ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) s32le_to_s16ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) s32be_to_s16ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_to_s16ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_to_s16ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) s24_32le_to_s16ne_avx2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) s24_32be_to_s16ne_avx2);
+
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_U8, (pa_convert_func_t) u8_from_s16ne_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) s16_swap_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) s16le_to_f32ne_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32BE, (pa_convert_func_t) f32be_from_s16ne_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) s32le_from_s16ne_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) s32be_from_s16ne_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_from_s16ne_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_from_s16ne_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) s24_32le_from_s16ne_avx2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) s24_32be_from_s16ne_avx2);
+    }
+
+#endif /* defined (__GNUC__) && (defined (__i386__) || defined (__amd64__)) */
+}
@@ -25,6 +25,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
 #include <pulse/utf8.h>
 #include <pulse/xmalloc.h>
 #include <pulse/util.h>
@@ -562,6 +564,11 @@ int pa_sink_input_new(
     i->thread_info.underrun_for_sink = 0;
     i->thread_info.playing_for = 0;
     i->thread_info.direct_outputs = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    i->thread_info.copy_stats_start = 0;
+    i->thread_info.bytes_copied = 0;
+    i->thread_info.bytes_rendered = 0;
+    pa_atomic_store(&i->bytes_copied_per_sec, 0);
+    pa_atomic_store(&i->bytes_rendered_per_sec, 0);
 
     pa_assert_se(pa_idxset_put(core->sink_inputs, i, &i->index) == 0);
     pa_assert_se(pa_idxset_put(i->sink->inputs, pa_sink_input_ref(i), NULL) == 0);
@@ -866,13 +873,24 @@ pa_usec_t pa_sink_input_get_latency(pa_sink_input *i, pa_usec_t *sink_latency) {
     return r[0];
 }
 
+/* Called from thread context */
+static void memchunk_make_writable_counted(pa_sink_input *i, pa_memchunk *c) {
+    pa_memblock *b = c->memblock;
+
+    pa_memchunk_make_writable(c, 0);
+
+    if (c->memblock != b)
+        i->thread_info.bytes_copied += c->length;
+}
+
 /* Called from thread context */
 void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa_memchunk *chunk, pa_cvolume *volume) {
-    bool do_volume_adj_here, need_volume_factor_sink;
+    bool do_volume_adj_here, need_volume_factor_sink, mix_volume_factor_sink;
     bool volume_is_norm;
     size_t block_size_max_sink, block_size_max_sink_input;
     size_t ilength;
     size_t ilength_full;
+    pa_usec_t start;
 
     pa_sink_input_assert_ref(i);
     pa_sink_input_assert_io_context(i);
@@ -885,6 +903,8 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
     pa_log_debug("peek");
 #endif
 
+    start = pa_rtclock_now();
+
     block_size_max_sink_input = i->thread_info.resampler ?
         pa_resampler_max_block_size(i->thread_info.resampler) :
         pa_frame_align(pa_mempool_block_size_max(i->core->mempool), &i->sample_spec);
@@ -921,6 +941,16 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
     volume_is_norm = pa_cvolume_is_norm(&i->thread_info.soft_volume) && !i->thread_info.muted;
     need_volume_factor_sink = !pa_cvolume_is_norm(&i->volume_factor_sink);
 
+    /* If the data needs neither remapping nor resampling the sink can
+     * apply volume_factor_sink together with the soft volume while
+     * mixing, and the data the implementor hands out, e.g. a block
+     * imported from a client, reaches the mix without being copied
+     * first. The render queue is recreated whenever the resampler
+     * changes, so it never holds data that was scaled already. */
+    mix_volume_factor_sink = need_volume_factor_sink && !do_volume_adj_here && !i->thread_info.resampler;
+    if (mix_volume_factor_sink)
+        need_volume_factor_sink = false;
+
     while (!pa_memblockq_is_readable(i->thread_info.render_memblockq)) {
         pa_memchunk tchunk;
 
@@ -961,7 +991,7 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
 
             /* It might be necessary to adjust the volume here */
             if (do_volume_adj_here && !volume_is_norm) {
-                pa_memchunk_make_writable(&wchunk, 0);
+                memchunk_make_writable_counted(i, &wchunk);
 
                 if (i->thread_info.muted) {
                     pa_silence_memchunk(&wchunk, &i->thread_info.sample_spec);
@@ -984,14 +1014,17 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
             if (!i->thread_info.resampler) {
 
                 if (nvfs) {
-                    pa_memchunk_make_writable(&wchunk, 0);
+                    memchunk_make_writable_counted(i, &wchunk);
                     pa_volume_memchunk(&wchunk, &i->sink->sample_spec, &i->volume_factor_sink);
                 }
 
                 pa_memblockq_push_align(i->thread_info.render_memblockq, &wchunk);
             } else {
                 pa_memchunk rchunk;
+                pa_usec_t resample_start = pa_rtclock_now();
+
                 pa_resampler_run(i->thread_info.resampler, &wchunk, &rchunk);
+                pa_io_stats_add(&i->sink->thread_info.io_stats, PA_IO_STAGE_RESAMPLE, pa_rtclock_now() - resample_start);
 
 #ifdef SINK_INPUT_DEBUG
                 pa_log_debug("pushing %lu", (unsigned long) rchunk.length);
@@ -999,8 +1032,11 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
 
                 if (rchunk.memblock) {
 
+                    /* Resampling always writes a new block */
+                    i->thread_info.bytes_copied += rchunk.length;
+
                     if (nvfs) {
-                        pa_memchunk_make_writable(&rchunk, 0);
+                        memchunk_make_writable_counted(i, &rchunk);
                         pa_volume_memchunk(&rchunk, &i->sink->sample_spec, &i->volume_factor_sink);
                     }
 
@@ -1039,8 +1075,50 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
     else if (i->thread_info.muted)
         /* We've both the same channel map, so let's have the sink do the adjustment for us*/
         pa_cvolume_mute(volume, i->sink->sample_spec.channels);
+    else if (mix_volume_factor_sink)
+        pa_sw_cvolume_multiply(volume, &i->thread_info.soft_volume, &i->volume_factor_sink);
     else
         *volume = i->thread_info.soft_volume;
+
+    pa_io_stats_add(&i->sink->thread_info.io_stats, PA_IO_STAGE_STREAM, pa_rtclock_now() - start);
+}
+
+/* Called from thread context */
+static void reset_copy_stats(pa_sink_input *i) {
+    i->thread_info.copy_stats_start = 0;
+    i->thread_info.bytes_copied = 0;
+    i->thread_info.bytes_rendered = 0;
+    pa_atomic_store(&i->bytes_copied_per_sec, 0);
+    pa_atomic_store(&i->bytes_rendered_per_sec, 0);
+}
+
+/* Called from thread context */
+static void update_copy_stats(pa_sink_input *i, size_t nbytes) {
+    pa_usec_t now, elapsed;
+
+    /* Silence handed out after the implementor ran out of data is not
+     * counted, so the rates fall to zero within a second after a
+     * stream stops without being corked */
+    if (i->thread_info.playing_for > 0)
+        i->thread_info.bytes_rendered += nbytes;
+
+    now = pa_rtclock_now();
+
+    if (i->thread_info.copy_stats_start == 0) {
+        i->thread_info.copy_stats_start = now;
+        return;
+    }
+
+    elapsed = now - i->thread_info.copy_stats_start;
+    if (elapsed < PA_USEC_PER_SEC)
+        return;
+
+    pa_atomic_store(&i->bytes_copied_per_sec, (int) ((uint64_t) i->thread_info.bytes_copied * PA_USEC_PER_SEC / elapsed));
+    pa_atomic_store(&i->bytes_rendered_per_sec, (int) ((uint64_t) i->thread_info.bytes_rendered * PA_USEC_PER_SEC / elapsed));
+
+    i->thread_info.copy_stats_start = now;
+    i->thread_info.bytes_copied = 0;
+    i->thread_info.bytes_rendered = 0;
 }
 
 /* Called from thread context */
@@ -1057,6 +1135,8 @@ void pa_sink_input_drop(pa_sink_input *i, size_t nbytes /* in sink sample spec *
 #endif
 
     pa_memblockq_drop(i->thread_info.render_memblockq, nbytes);
+
+    update_copy_stats(i, nbytes);
 }
 
 /* Called from thread context */
@@ -2040,6 +2120,11 @@ void pa_sink_input_set_state_within_thread(pa_sink_input *i, pa_sink_input_state
     if (i->state_change)
         i->state_change(i, state);
 
+    /* The sink might not render anymore, which would leave the last
+     * rates in place */
+    if (state != PA_SINK_INPUT_RUNNING)
+        reset_copy_stats(i);
+
     if (corking) {
 
         pa_log_debug("Requesting rewind due to corking");
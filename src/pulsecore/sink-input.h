@@ -24,6 +24,7 @@
 #include <inttypes.h>
 
 #include <pulsecore/typedefs.h>
+#include <pulsecore/atomic.h>
 #include <pulse/sample.h>
 #include <pulse/format.h>
 #include <pulsecore/memblockq.h>
@@ -132,6 +133,13 @@ struct pa_sink_input {
 
     pa_resample_method_t requested_resample_method, actual_resample_method;
 
+    /* Bytes per second that the IO thread copied while preparing this
+     * stream's data for mixing, and bytes per second it rendered, both
+     * measured over the last second. Both are zero while the stream
+     * is not running. Written from IO thread context, may be read from
+     * any context. */
+    pa_atomic_t bytes_copied_per_sec, bytes_rendered_per_sec;
+
     /* Returns the chunk of audio data and drops it from the
      * queue. Returns -1 on failure. Called from IO thread context. If
      * data needs to be generated from scratch then please in the
@@ -258,6 +266,11 @@ struct pa_sink_input {
         pa_usec_t requested_sink_latency;
 
         pa_hashmap *direct_outputs;
+
+        /* Byte counts of the current measurement period for
+         * bytes_copied_per_sec and bytes_rendered_per_sec */
+        pa_usec_t copy_stats_start;
+        size_t bytes_copied, bytes_rendered;
     } thread_info;
 
     void *userdata;
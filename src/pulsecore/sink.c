@@ -46,6 +46,7 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/play-memblockq.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/message-handler.h>
 
 #include "sink.h"
 
@@ -635,8 +636,32 @@ void pa_sink_enable_decibel_volume(pa_sink *s, bool enable) {
         pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SINK|PA_SUBSCRIPTION_EVENT_CHANGE, s->index);
 }
 
+/* Called from main context */
+static int sink_message_handler(const char *object_path, const char *message, const char *message_parameters, char **response, void *userdata) {
+    pa_sink *s = userdata;
+
+    pa_sink_assert_ref(s);
+
+    if (pa_streq(message, "get-io-stats")) {
+        pa_io_stats stats;
+
+        pa_sink_get_io_stats(s, &stats);
+        *response = pa_io_stats_to_string(&stats);
+        return PA_OK;
+    }
+
+    if (pa_streq(message, "reset-io-stats")) {
+        pa_sink_reset_io_stats(s);
+        return PA_OK;
+    }
+
+    return -PA_ERR_NOTIMPLEMENTED;
+}
+
 /* Called from main context */
 void pa_sink_put(pa_sink* s) {
+    char *object_path;
+
     pa_sink_assert_ref(s);
     pa_assert_ctl_context();
 
@@ -721,6 +746,10 @@ void pa_sink_put(pa_sink* s) {
 
     pa_source_put(s->monitor_source);
 
+    object_path = pa_sprintf_malloc("/sink/%s", s->name);
+    pa_message_handler_register(s->core, object_path, "IO thread statistics", sink_message_handler, s);
+    pa_xfree(object_path);
+
     pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SINK | PA_SUBSCRIPTION_EVENT_NEW, s->index);
     pa_hook_fire(&s->core->hooks[PA_CORE_HOOK_SINK_PUT], s);
 
@@ -753,9 +782,16 @@ void pa_sink_unlink(pa_sink* s) {
 
     linked = PA_SINK_IS_LINKED(s->state);
 
-    if (linked)
+    if (linked) {
+        char *object_path;
+
         pa_hook_fire(&s->core->hooks[PA_CORE_HOOK_SINK_UNLINK], s);
 
+        object_path = pa_sprintf_malloc("/sink/%s", s->name);
+        pa_message_handler_unregister(s->core, object_path);
+        pa_xfree(object_path);
+    }
+
     if (s->state != PA_SINK_UNLINKED)
         pa_namereg_unregister(s->core, s->name);
     pa_idxset_remove_by_data(s->core->sinks, s, NULL);
@@ -1157,14 +1193,24 @@ static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *
                 pa_source_output *o;
                 pa_memchunk c;
 
-                if (m && m->chunk.memblock) {
+                if (m && m->chunk.memblock && !pa_cvolume_is_norm(&m->volume)) {
+                    void *ptr;
+
+                    pa_assert(result->length <= m->chunk.length);
+
+                    /* Apply the volume while copying, instead of copying
+                     * the block first and then applying the volume on it */
+                    c.memblock = pa_memblock_new(s->core->mempool, result->length);
+                    c.index = 0;
+
+                    ptr = pa_memblock_acquire(c.memblock);
+                    c.length = pa_mix(m, 1, ptr, result->length, &s->sample_spec, NULL, false);
+                    pa_memblock_release(c.memblock);
+                } else if (m && m->chunk.memblock) {
                     c = m->chunk;
                     pa_memblock_ref(c.memblock);
                     pa_assert(result->length <= c.length);
                     c.length = result->length;
-
-                    pa_memchunk_make_writable(&c, 0);
-                    pa_volume_memchunk(&c, &s->sample_spec, &m->volume);
                 } else {
                     c = s->silence;
                     pa_memblock_ref(c.memblock);
@@ -1216,6 +1262,7 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
     pa_mix_info info[MAX_MIX_CHANNELS];
     unsigned n;
     size_t block_size_max;
+    pa_usec_t start;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1235,6 +1282,8 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     pa_sink_ref(s);
 
+    start = pa_rtclock_now();
+
     if (length <= 0)
         length = pa_frame_align(MIX_BUFFER_LENGTH, &s->sample_spec);
 
@@ -1257,24 +1306,44 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
     } else if (n == 1) {
         pa_cvolume volume;
 
-        *result = info[0].chunk;
-        pa_memblock_ref(result->memblock);
-
-        if (result->length > length)
-            result->length = length;
-
         pa_sw_cvolume_multiply(&volume, &s->thread_info.soft_volume, &info[0].volume);
 
-        if (s->thread_info.soft_muted || pa_cvolume_is_muted(&volume)) {
-            pa_memblock_unref(result->memblock);
+        if (s->thread_info.soft_muted || pa_cvolume_is_muted(&volume))
             pa_silence_memchunk_get(&s->core->silence_cache,
                                     s->core->mempool,
                                     result,
                                     &s->sample_spec,
-                                    result->length);
-        } else if (!pa_cvolume_is_norm(&volume)) {
-            pa_memchunk_make_writable(result, 0);
-            pa_volume_memchunk(result, &s->sample_spec, &volume);
+                                    PA_MIN(info[0].chunk.length, length));
+        else if (pa_cvolume_is_norm(&volume)) {
+            *result = info[0].chunk;
+            pa_memblock_ref(result->memblock);
+
+            if (result->length > length)
+                result->length = length;
+        } else {
+            void *ptr;
+
+            /* Write the input with stream and sink volume applied into the
+             * result in a single pass, instead of copying the input into a
+             * writable block and applying the volume on it afterwards.
+             *
+             * This is not bit-exact with scaling by the combined volume
+             * above: pa_mix() multiplies the linear factors of both volumes
+             * instead of rounding their product to a pa_volume_t first,
+             * just like it does with several inputs. The difference grows
+             * with the volumes, at 150% the bound is two steps for s16, see
+             * cpu-mix-test. */
+            result->memblock = pa_memblock_new(s->core->mempool, length);
+
+            ptr = pa_memblock_acquire(result->memblock);
+            result->length = pa_mix(info, 1,
+                                    ptr, length,
+                                    &s->sample_spec,
+                                    &s->thread_info.soft_volume,
+                                    false);
+            pa_memblock_release(result->memblock);
+
+            result->index = 0;
         }
     } else {
         void *ptr;
@@ -1293,6 +1362,8 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     inputs_drop(s, info, n, result);
 
+    pa_io_stats_add(&s->thread_info.io_stats, PA_IO_STAGE_MIX, pa_rtclock_now() - start);
+
     pa_sink_unref(s);
 }
 
@@ -1301,6 +1372,7 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
     pa_mix_info info[MAX_MIX_CHANNELS];
     unsigned n;
     size_t length, block_size_max;
+    pa_usec_t start;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1320,6 +1392,8 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
     pa_sink_ref(s);
 
+    start = pa_rtclock_now();
+
     length = target->length;
     block_size_max = pa_mempool_block_size_max(s->core->mempool);
     if (length > block_size_max)
@@ -1344,7 +1418,7 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
         if (s->thread_info.soft_muted || pa_cvolume_is_muted(&volume))
             pa_silence_memchunk(target, &s->sample_spec);
-        else {
+        else if (pa_cvolume_is_norm(&volume)) {
             pa_memchunk vchunk;
 
             vchunk = info[0].chunk;
@@ -1353,13 +1427,23 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
             if (vchunk.length > length)
                 vchunk.length = length;
 
-            if (!pa_cvolume_is_norm(&volume)) {
-                pa_memchunk_make_writable(&vchunk, 0);
-                pa_volume_memchunk(&vchunk, &s->sample_spec, &volume);
-            }
-
             pa_memchunk_memcpy(target, &vchunk);
             pa_memblock_unref(vchunk.memblock);
+        } else {
+            void *ptr;
+
+            /* Apply the volume while writing into the target, see
+             * pa_sink_render() for how this differs from the two pass
+             * path */
+            ptr = pa_memblock_acquire(target->memblock);
+
+            target->length = pa_mix(info, 1,
+                                    (uint8_t*) ptr + target->index, target->length,
+                                    &s->sample_spec,
+                                    &s->thread_info.soft_volume,
+                                    false);
+
+            pa_memblock_release(target->memblock);
         }
 
     } else {
@@ -1378,6 +1462,8 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
     inputs_drop(s, info, n, target);
 
+    pa_io_stats_add(&s->thread_info.io_stats, PA_IO_STAGE_MIX, pa_rtclock_now() - start);
+
     pa_sink_unref(s);
 }
 
@@ -2921,6 +3007,27 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             *((pa_usec_t*) userdata) = s->thread_info.fixed_latency;
             return 0;
 
+        case PA_SINK_MESSAGE_GET_IO_STATS: {
+            pa_io_stats thread;
+
+            pa_io_stats_reset(&thread);
+
+            if (s->thread_info.rtpoll)
+                pa_rtpoll_get_io_stats(s->thread_info.rtpoll, &thread);
+
+            pa_io_stats_merge(userdata, &s->thread_info.io_stats, &thread);
+            return 0;
+        }
+
+        case PA_SINK_MESSAGE_RESET_IO_STATS:
+
+            pa_io_stats_reset(&s->thread_info.io_stats);
+
+            if (s->thread_info.rtpoll)
+                pa_rtpoll_reset_io_stats(s->thread_info.rtpoll);
+
+            return 0;
+
         case PA_SINK_MESSAGE_SET_FIXED_LATENCY:
 
             pa_sink_set_fixed_latency_within_thread(s, (pa_usec_t) offset);
@@ -3318,6 +3425,27 @@ pa_usec_t pa_sink_get_fixed_latency(pa_sink *s) {
     return latency;
 }
 
+/* Called from main thread */
+void pa_sink_get_io_stats(pa_sink *s, pa_io_stats *stats) {
+    pa_sink_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(stats);
+
+    if (PA_SINK_IS_LINKED(s->state))
+        pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_GET_IO_STATS, stats, 0, NULL) == 0);
+    else
+        pa_io_stats_reset(stats);
+}
+
+/* Called from main thread */
+void pa_sink_reset_io_stats(pa_sink *s) {
+    pa_sink_assert_ref(s);
+    pa_assert_ctl_context();
+
+    if (PA_SINK_IS_LINKED(s->state))
+        pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_RESET_IO_STATS, NULL, 0, NULL) == 0);
+}
+
 /* Called from IO thread */
 void pa_sink_set_fixed_latency_within_thread(pa_sink *s, pa_usec_t latency) {
     pa_sink_assert_ref(s);
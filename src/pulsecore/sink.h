@@ -38,6 +38,7 @@
 #include <pulsecore/asyncmsgq.h>
 #include <pulsecore/msgobject.h>
 #include <pulsecore/rtpoll.h>
+#include <pulsecore/io-stats.h>
 #include <pulsecore/device-port.h>
 #include <pulsecore/card.h>
 #include <pulsecore/queue.h>
@@ -325,6 +326,9 @@ struct pa_sink {
         uint32_t volume_change_safety_margin;
         /* Usec delay added to all volume change events, may be negative. */
         int32_t volume_change_extra_delay;
+
+        /* Time spent rendering, see pa_sink_get_io_stats() */
+        pa_io_stats io_stats;
     } thread_info;
 
     void *userdata;
@@ -358,6 +362,8 @@ typedef enum pa_sink_message {
     PA_SINK_MESSAGE_SET_MAX_REQUEST,
     PA_SINK_MESSAGE_UPDATE_VOLUME_AND_MUTE,
     PA_SINK_MESSAGE_SET_PORT_LATENCY_OFFSET,
+    PA_SINK_MESSAGE_GET_IO_STATS,
+    PA_SINK_MESSAGE_RESET_IO_STATS,
     PA_SINK_MESSAGE_MAX
 } pa_sink_message_t;
 
@@ -452,6 +458,14 @@ pa_usec_t pa_sink_get_requested_latency(pa_sink *s);
 void pa_sink_get_latency_range(pa_sink *s, pa_usec_t *min_latency, pa_usec_t *max_latency);
 pa_usec_t pa_sink_get_fixed_latency(pa_sink *s);
 
+/* Where the IO thread of the sink spent its time since it was started or the
+ * stats were last reset. The thread wide counters are shared with all other
+ * sinks and sources driven by the same thread, resetting them affects all of
+ * them. Also available as "get-io-stats" and "reset-io-stats" messages to
+ * the object path "/sink/<name>". */
+void pa_sink_get_io_stats(pa_sink *s, pa_io_stats *stats);
+void pa_sink_reset_io_stats(pa_sink *s);
+
 size_t pa_sink_get_max_rewind(pa_sink *s);
 size_t pa_sink_get_max_request(pa_sink *s);
 
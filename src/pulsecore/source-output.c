@@ -29,6 +29,7 @@
 #include <pulse/xmalloc.h>
 #include <pulse/util.h>
 #include <pulse/internal.h>
+#include <pulse/rtclock.h>
 
 #include <pulsecore/core-format.h>
 #include <pulsecore/mix.h>
@@ -746,6 +747,7 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
     bool volume_is_norm;
     size_t length;
     size_t limit, mbs = 0;
+    pa_usec_t start;
 
     pa_source_output_assert_ref(o);
     pa_source_output_assert_io_context(o);
@@ -756,6 +758,8 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
     if (!o->push || o->thread_info.state == PA_SOURCE_OUTPUT_CORKED)
         return;
 
+    start = pa_rtclock_now();
+
     pa_assert(o->thread_info.state == PA_SOURCE_OUTPUT_RUNNING);
 
     if (pa_memblockq_push(o->thread_info.delay_memblockq, chunk) < 0) {
@@ -832,6 +836,7 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
             o->push(o, &qchunk);
         else {
             pa_memchunk rchunk;
+            pa_usec_t resample_start;
 
             if (mbs == 0)
                 mbs = pa_resampler_max_block_size(o->thread_info.resampler);
@@ -839,7 +844,9 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
             if (qchunk.length > mbs)
                 qchunk.length = mbs;
 
+            resample_start = pa_rtclock_now();
             pa_resampler_run(o->thread_info.resampler, &qchunk, &rchunk);
+            pa_io_stats_add(&o->source->thread_info.io_stats, PA_IO_STAGE_RESAMPLE, pa_rtclock_now() - resample_start);
 
             if (rchunk.length > 0)
                 o->push(o, &rchunk);
@@ -851,6 +858,8 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
         pa_memblock_unref(qchunk.memblock);
         pa_memblockq_drop(o->thread_info.delay_memblockq, qchunk.length);
     }
+
+    pa_io_stats_add(&o->source->thread_info.io_stats, PA_IO_STAGE_STREAM, pa_rtclock_now() - start);
 }
 
 /* Called from thread context */
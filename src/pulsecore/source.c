@@ -40,6 +40,7 @@
 #include <pulsecore/log.h>
 #include <pulsecore/mix.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/message-handler.h>
 
 #include "source.h"
 
@@ -585,8 +586,32 @@ void pa_source_enable_decibel_volume(pa_source *s, bool enable) {
         pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SOURCE|PA_SUBSCRIPTION_EVENT_CHANGE, s->index);
 }
 
+/* Called from main context */
+static int source_message_handler(const char *object_path, const char *message, const char *message_parameters, char **response, void *userdata) {
+    pa_source *s = userdata;
+
+    pa_source_assert_ref(s);
+
+    if (pa_streq(message, "get-io-stats")) {
+        pa_io_stats stats;
+
+        pa_source_get_io_stats(s, &stats);
+        *response = pa_io_stats_to_string(&stats);
+        return PA_OK;
+    }
+
+    if (pa_streq(message, "reset-io-stats")) {
+        pa_source_reset_io_stats(s);
+        return PA_OK;
+    }
+
+    return -PA_ERR_NOTIMPLEMENTED;
+}
+
 /* Called from main context */
 void pa_source_put(pa_source *s) {
+    char *object_path;
+
     pa_source_assert_ref(s);
     pa_assert_ctl_context();
 
@@ -663,6 +688,10 @@ void pa_source_put(pa_source *s) {
     else
         pa_assert_se(source_set_state(s, PA_SOURCE_IDLE, 0) == 0);
 
+    object_path = pa_sprintf_malloc("/source/%s", s->name);
+    pa_message_handler_register(s->core, object_path, "IO thread statistics", source_message_handler, s);
+    pa_xfree(object_path);
+
     pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SOURCE | PA_SUBSCRIPTION_EVENT_NEW, s->index);
     pa_hook_fire(&s->core->hooks[PA_CORE_HOOK_SOURCE_PUT], s);
 
@@ -693,9 +722,16 @@ void pa_source_unlink(pa_source *s) {
 
     linked = PA_SOURCE_IS_LINKED(s->state);
 
-    if (linked)
+    if (linked) {
+        char *object_path;
+
         pa_hook_fire(&s->core->hooks[PA_CORE_HOOK_SOURCE_UNLINK], s);
 
+        object_path = pa_sprintf_malloc("/source/%s", s->name);
+        pa_message_handler_unregister(s->core, object_path);
+        pa_xfree(object_path);
+    }
+
     if (s->state != PA_SOURCE_UNLINKED)
         pa_namereg_unregister(s->core, s->name);
     pa_idxset_remove_by_data(s->core->sources, s, NULL);
@@ -965,6 +1001,7 @@ void pa_source_process_rewind(pa_source *s, size_t nbytes) {
 void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
     pa_source_output *o;
     void *state = NULL;
+    pa_usec_t start;
 
     pa_source_assert_ref(s);
     pa_source_assert_io_context(s);
@@ -974,6 +1011,8 @@ void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
     if (s->thread_info.state == PA_SOURCE_SUSPENDED)
         return;
 
+    start = pa_rtclock_now();
+
     if (s->thread_info.soft_muted || !pa_cvolume_is_norm(&s->thread_info.soft_volume)) {
         pa_memchunk vchunk = *chunk;
 
@@ -1002,10 +1041,14 @@ void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
                 pa_source_output_push(o, chunk);
         }
     }
+
+    pa_io_stats_add(&s->thread_info.io_stats, PA_IO_STAGE_MIX, pa_rtclock_now() - start);
 }
 
 /* Called from IO thread context */
 void pa_source_post_direct(pa_source*s, pa_source_output *o, const pa_memchunk *chunk) {
+    pa_usec_t start;
+
     pa_source_assert_ref(s);
     pa_source_assert_io_context(s);
     pa_assert(PA_SOURCE_IS_LINKED(s->thread_info.state));
@@ -1016,6 +1059,8 @@ void pa_source_post_direct(pa_source*s, pa_source_output *o, const pa_memchunk *
     if (s->thread_info.state == PA_SOURCE_SUSPENDED)
         return;
 
+    start = pa_rtclock_now();
+
     if (s->thread_info.soft_muted || !pa_cvolume_is_norm(&s->thread_info.soft_volume)) {
         pa_memchunk vchunk = *chunk;
 
@@ -1032,6 +1077,8 @@ void pa_source_post_direct(pa_source*s, pa_source_output *o, const pa_memchunk *
         pa_memblock_unref(vchunk.memblock);
     } else
         pa_source_output_push(o, chunk);
+
+    pa_io_stats_add(&s->thread_info.io_stats, PA_IO_STAGE_MIX, pa_rtclock_now() - start);
 }
 
 /* Called from main thread */
@@ -2273,6 +2320,27 @@ int pa_source_process_msg(pa_msgobject *object, int code, void *userdata, int64_
             *((pa_usec_t*) userdata) = s->thread_info.fixed_latency;
             return 0;
 
+        case PA_SOURCE_MESSAGE_GET_IO_STATS: {
+            pa_io_stats thread;
+
+            pa_io_stats_reset(&thread);
+
+            if (s->thread_info.rtpoll)
+                pa_rtpoll_get_io_stats(s->thread_info.rtpoll, &thread);
+
+            pa_io_stats_merge(userdata, &s->thread_info.io_stats, &thread);
+            return 0;
+        }
+
+        case PA_SOURCE_MESSAGE_RESET_IO_STATS:
+
+            pa_io_stats_reset(&s->thread_info.io_stats);
+
+            if (s->thread_info.rtpoll)
+                pa_rtpoll_reset_io_stats(s->thread_info.rtpoll);
+
+            return 0;
+
         case PA_SOURCE_MESSAGE_SET_FIXED_LATENCY:
 
             pa_source_set_fixed_latency_within_thread(s, (pa_usec_t) offset);
@@ -2603,6 +2671,27 @@ pa_usec_t pa_source_get_fixed_latency(pa_source *s) {
     return latency;
 }
 
+/* Called from main thread */
+void pa_source_get_io_stats(pa_source *s, pa_io_stats *stats) {
+    pa_source_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(stats);
+
+    if (PA_SOURCE_IS_LINKED(s->state))
+        pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_GET_IO_STATS, stats, 0, NULL) == 0);
+    else
+        pa_io_stats_reset(stats);
+}
+
+/* Called from main thread */
+void pa_source_reset_io_stats(pa_source *s) {
+    pa_source_assert_ref(s);
+    pa_assert_ctl_context();
+
+    if (PA_SOURCE_IS_LINKED(s->state))
+        pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_RESET_IO_STATS, NULL, 0, NULL) == 0);
+}
+
 /* Called from IO thread */
 void pa_source_set_fixed_latency_within_thread(pa_source *s, pa_usec_t latency) {
     pa_source_assert_ref(s);
@@ -39,6 +39,7 @@
 #include <pulsecore/asyncmsgq.h>
 #include <pulsecore/msgobject.h>
 #include <pulsecore/rtpoll.h>
+#include <pulsecore/io-stats.h>
 #include <pulsecore/card.h>
 #include <pulsecore/device-port.h>
 #include <pulsecore/queue.h>
@@ -267,6 +268,9 @@ struct pa_source {
         uint32_t volume_change_safety_margin;
         /* Usec delay added to all volume change events, may be negative. */
         int32_t volume_change_extra_delay;
+
+        /* Time spent posting, see pa_source_get_io_stats() */
+        pa_io_stats io_stats;
     } thread_info;
 
     void *userdata;
@@ -296,6 +300,8 @@ typedef enum pa_source_message {
     PA_SOURCE_MESSAGE_SET_MAX_REWIND,
     PA_SOURCE_MESSAGE_UPDATE_VOLUME_AND_MUTE,
     PA_SOURCE_MESSAGE_SET_PORT_LATENCY_OFFSET,
+    PA_SOURCE_MESSAGE_GET_IO_STATS,
+    PA_SOURCE_MESSAGE_RESET_IO_STATS,
     PA_SOURCE_MESSAGE_MAX
 } pa_source_message_t;
 
@@ -385,6 +391,10 @@ pa_usec_t pa_source_get_requested_latency(pa_source *s);
 void pa_source_get_latency_range(pa_source *s, pa_usec_t *min_latency, pa_usec_t *max_latency);
 pa_usec_t pa_source_get_fixed_latency(pa_source *s);
 
+/* See pa_sink_get_io_stats(), the object path is "/source/<name>" */
+void pa_source_get_io_stats(pa_source *s, pa_io_stats *stats);
+void pa_source_reset_io_stats(pa_source *s);
+
 size_t pa_source_get_max_rewind(pa_source *s);
 
 int pa_source_update_status(pa_source*s);
@@ -24,10 +24,17 @@
 #include "srbchannel.h"
 
 #include <pulsecore/atomic.h>
+#include <pulsecore/core-util.h>
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 
 /* #define DEBUG_SRBCHANNEL */
 
+/* When spinning is enabled, the adaptive spin budget never shrinks below
+ * this fraction of the configured maximum, so that we notice when the
+ * peer starts answering quickly again. */
+#define SPIN_MIN_DIVISOR 8
+
 /* This ringbuffer might be useful in other contexts too, but
  * right now it's only used inside the srbchannel, so let's keep it here
  * for the time being. */
@@ -86,6 +93,19 @@ struct pa_srbchannel {
     pa_io_event *read_event;
     pa_defer_event *defer_event;
     pa_mainloop_api *mainloop;
+
+    /* Spin-then-sleep: spin_max is the configured limit (0 disables
+     * spinning), spin_budget the current adaptive budget. sleep_start is
+     * when we gave up spinning and went to poll(), or 0. */
+    pa_usec_t spin_max, spin_budget;
+    pa_usec_t sleep_start;
+
+    /* Whether sem_read is prepared for poll(), i e pa_fdsem_before_poll()
+     * succeeded and pa_fdsem_after_poll() is still due */
+    bool waiting;
+
+    void *aux;
+    size_t aux_length;
 };
 
 /* We always listen to sem_read, and always signal on sem_write.
@@ -163,7 +183,7 @@ size_t pa_srbchannel_read(pa_srbchannel *sr, void *data, size_t l) {
 }
 
 /* This is the memory layout of the ringbuffer shm block. It is followed by
-   read and write ringbuffer memory. */
+   the auxiliary area and the read and write ringbuffer memory. */
 struct srbheader {
     pa_atomic_t read_count;
     pa_atomic_t write_count;
@@ -178,6 +198,78 @@ struct srbheader {
     /* TODO: Maybe a marker here to make sure we talk to a server with equally sized struct */
 };
 
+/* Room for the auxiliary area between the header and the ringbuffers. The
+ * peer only looks at the offsets in the header, so older peers simply don't
+ * see it. */
+#define SRBCHANNEL_AUX_SIZE 4096
+
+static inline void cpu_relax(void) {
+#if defined(__GNUC__) && (defined(__i386__) || defined(__amd64__))
+    __asm__ __volatile__ ("pause");
+#elif defined(__GNUC__) && defined(__aarch64__)
+    __asm__ __volatile__ ("yield");
+#endif
+}
+
+/* Busy-waits up to the current spin budget for the peer to write into our
+ * read buffer. Returns true if it did. The peer's pa_fdsem_post() does not
+ * need a system call while we are not waiting in poll(). */
+static bool srbchannel_spin(pa_srbchannel *sr) {
+    pa_usec_t now, deadline;
+    int count;
+
+    if (sr->spin_budget <= 0)
+        return false;
+
+    count = pa_atomic_load(sr->rb_read.count);
+    deadline = pa_rtclock_now() + sr->spin_budget;
+
+    do {
+        unsigned i;
+
+        for (i = 0; i < 32; i++) {
+            if (pa_atomic_load(sr->rb_read.count) != count) {
+                /* The peer has posted the semaphore as well, or is about
+                 * to. Consume that, so that pa_fdsem_before_poll() doesn't
+                 * send us around the loop, and into another spin, again. */
+                pa_fdsem_try(sr->sem_read);
+                sr->sleep_start = 0;
+                return true;
+            }
+
+            cpu_relax();
+        }
+    } while ((now = pa_rtclock_now()) < deadline);
+
+    sr->sleep_start = now;
+
+    return false;
+}
+
+/* Called when we wake up from poll() after spinning in vain. If the peer
+ * answered shortly after we gave up, widen the budget to cover that next
+ * time, otherwise back off. */
+static void srbchannel_adapt_spin(pa_srbchannel *sr) {
+    pa_usec_t slept, answer;
+
+    if (sr->spin_max <= 0 || sr->sleep_start <= 0)
+        return;
+
+    slept = pa_rtclock_now() - sr->sleep_start;
+    answer = sr->spin_budget + slept;
+    sr->sleep_start = 0;
+
+    if (answer < sr->spin_max)
+        sr->spin_budget = PA_MIN(sr->spin_max, answer + answer / 2);
+    else
+        sr->spin_budget = PA_MAX(sr->spin_budget / 2, sr->spin_max / SPIN_MIN_DIVISOR);
+
+#ifdef DEBUG_SRBCHANNEL
+    pa_log("Woke up %llu usec after spinning, spin budget now %llu usec",
+           (unsigned long long) slept, (unsigned long long) sr->spin_budget);
+#endif
+}
+
 static void srbchannel_rwloop(pa_srbchannel* sr) {
     do {
 #ifdef DEBUG_SRBCHANNEL
@@ -200,13 +292,24 @@ static void srbchannel_rwloop(pa_srbchannel* sr) {
         pa_log("In rw loop from srbchannel, after callback, count = %d", q);
 #endif
 
-    } while (pa_fdsem_before_poll(sr->sem_read) < 0);
+    } while (srbchannel_spin(sr) || pa_fdsem_before_poll(sr->sem_read) < 0);
+
+    sr->waiting = true;
+}
+
+static void srbchannel_stop_waiting(pa_srbchannel *sr) {
+    if (!sr->waiting)
+        return;
+
+    pa_fdsem_after_poll(sr->sem_read);
+    sr->waiting = false;
 }
 
 static void semread_cb(pa_mainloop_api *m, pa_io_event *e, int fd, pa_io_event_flags_t events, void *userdata) {
     pa_srbchannel* sr = userdata;
 
-    pa_fdsem_after_poll(sr->sem_read);
+    srbchannel_stop_waiting(sr);
+    srbchannel_adapt_spin(sr);
     srbchannel_rwloop(sr);
 }
 
@@ -218,6 +321,7 @@ static void defer_cb(pa_mainloop_api *m, pa_defer_event *e, void *userdata) {
 #endif
 
     m->defer_enable(e, 0);
+    srbchannel_stop_waiting(sr);
     srbchannel_rwloop(sr);
 }
 
@@ -235,7 +339,11 @@ pa_srbchannel* pa_srbchannel_new(pa_mainloop_api *m, pa_mempool *p) {
     srh = pa_memblock_acquire(sr->memblock);
     pa_zero(*srh);
 
-    sr->rb_read.memory = (uint8_t*) srh + PA_ALIGN(sizeof(*srh));
+    sr->aux = (uint8_t*) srh + PA_ALIGN(sizeof(*srh));
+    sr->aux_length = SRBCHANNEL_AUX_SIZE;
+    memset(sr->aux, 0, sr->aux_length);
+
+    sr->rb_read.memory = (uint8_t*) sr->aux + sr->aux_length;
     srh->readbuf_offset = sr->rb_read.memory - (uint8_t*) srh;
 
     capacity = (pa_memblock_get_length(sr->memblock) - srh->readbuf_offset) / 2;
@@ -305,6 +413,12 @@ pa_srbchannel* pa_srbchannel_new_from_template(pa_mainloop_api *m, pa_srbchannel
     sr->rb_read.memory = (uint8_t*) srh + srh->readbuf_offset;
     sr->rb_write.memory = (uint8_t*) srh + srh->writebuf_offset;
 
+    /* Created by a peer without auxiliary area? */
+    if ((size_t) srh->readbuf_offset > PA_ALIGN(sizeof(*srh))) {
+        sr->aux = (uint8_t*) srh + PA_ALIGN(sizeof(*srh));
+        sr->aux_length = srh->readbuf_offset - PA_ALIGN(sizeof(*srh));
+    }
+
     sr->sem_read = pa_fdsem_open_shm(&srh->read_semdata, t->readfd);
     if (!sr->sem_read)
         goto fail;
@@ -338,19 +452,55 @@ void pa_srbchannel_export(pa_srbchannel *sr, pa_srbchannel_template *t) {
 }
 
 void pa_srbchannel_set_callback(pa_srbchannel *sr, pa_srbchannel_cb_t callback, void *userdata) {
-    if (sr->callback)
-        pa_fdsem_after_poll(sr->sem_read);
+    srbchannel_stop_waiting(sr);
 
     sr->callback = callback;
     sr->cb_userdata = userdata;
 
+    /* Without a callback somebody else might be waiting on sem_read, don't
+     * steal its wakeups. */
+    sr->mainloop->io_enable(sr->read_event, sr->callback ? PA_IO_EVENT_INPUT : PA_IO_EVENT_NULL);
+
     if (sr->callback) {
         /* If there are events to be read already in the ringbuffer, we will not get any IO event for that,
            because that's how pa_fdsem works. Therefore check the ringbuffer in a defer event instead. */
         if (!sr->defer_event)
             sr->defer_event = sr->mainloop->defer_new(sr->mainloop, defer_cb, sr);
         sr->mainloop->defer_enable(sr->defer_event, 1);
+    } else if (sr->defer_event)
+        sr->mainloop->defer_enable(sr->defer_event, 0);
+}
+
+void *pa_srbchannel_get_aux(pa_srbchannel *sr, size_t *length) {
+    pa_assert(sr);
+    pa_assert(length);
+
+    *length = sr->aux_length;
+    return sr->aux;
+}
+
+pa_fdsem *pa_srbchannel_get_read_fdsem(pa_srbchannel *sr) {
+    pa_assert(sr);
+
+    return sr->sem_read;
+}
+
+void pa_srbchannel_set_spin(pa_srbchannel *sr, pa_usec_t max_usec) {
+    pa_assert(sr);
+
+    /* The peer can't make progress while we spin on its CPU */
+    if (max_usec > 0 && pa_ncpus() < 2) {
+        pa_log_debug("Not spinning on srbchannel, only one CPU available");
+        max_usec = 0;
     }
+
+    if (max_usec > PA_SRBCHANNEL_SPIN_MAX_USEC) {
+        pa_log_debug("Limiting srbchannel spin time to %u usec", PA_SRBCHANNEL_SPIN_MAX_USEC);
+        max_usec = PA_SRBCHANNEL_SPIN_MAX_USEC;
+    }
+
+    sr->spin_max = sr->spin_budget = max_usec;
+    sr->sleep_start = 0;
 }
 
 void pa_srbchannel_free(pa_srbchannel *sr)
@@ -54,4 +54,27 @@ size_t pa_srbchannel_read(pa_srbchannel *sr, void *data, size_t l);
 typedef bool (*pa_srbchannel_cb_t)(pa_srbchannel *sr, void *userdata);
 void pa_srbchannel_set_callback(pa_srbchannel *sr, pa_srbchannel_cb_t callback, void *userdata);
 
+/* The auxiliary area of the shm block, which is not used by the srbchannel
+ * itself and can be read and written by both sides. Returns NULL if the
+ * srbchannel was created by a peer that did not reserve one. The area is
+ * zeroed on creation and stays valid as long as the srbchannel's memblock is
+ * referenced. */
+void *pa_srbchannel_get_aux(pa_srbchannel *sr, size_t *length);
+
+/* The semaphore that is signalled when data becomes available for reading,
+ * for waiting on the srbchannel from another thread's poll loop. Only do so
+ * while no callback is set. */
+pa_fdsem *pa_srbchannel_get_read_fdsem(pa_srbchannel *sr);
+
+/* Upper limit for the spin time. Spinning blocks the thread that reads
+ * from the srbchannel, which may be the main loop or an IO thread. */
+#define PA_SRBCHANNEL_SPIN_MAX_USEC 500
+
+/* Before going to sleep, let the reading side spin on the ringbuffer for up
+ * to max_usec waiting for the peer, which saves the wakeup round trip
+ * through poll() when the peer answers quickly. The spin time actually used
+ * adapts to how fast the peer answers. 0 disables spinning (the default),
+ * values above PA_SRBCHANNEL_SPIN_MAX_USEC are clamped. */
+void pa_srbchannel_set_spin(pa_srbchannel *sr, pa_usec_t max_usec);
+
 #endif
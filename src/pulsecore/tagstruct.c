@@ -73,6 +73,19 @@ pa_tagstruct *pa_tagstruct_new(void) {
     return t;
 }
 
+pa_tagstruct *pa_tagstruct_new_sized(size_t size_hint) {
+    pa_tagstruct*t;
+
+    t = pa_tagstruct_new();
+
+    if (size_hint > MAX_APPENDED_SIZE) {
+        t->type = PA_TAGSTRUCT_DYNAMIC;
+        t->data = pa_xmalloc(t->allocated = size_hint);
+    }
+
+    return t;
+}
+
 pa_tagstruct *pa_tagstruct_new_fixed(const uint8_t* data, size_t length) {
     pa_tagstruct*t;
 
@@ -104,11 +117,13 @@ static inline void extend(pa_tagstruct*t, size_t l) {
     if (t->length+l <= t->allocated)
         return;
 
+    /* Grow geometrically, so that building large replies such as info
+     * lists doesn't realloc for every entry */
     if (t->type == PA_TAGSTRUCT_DYNAMIC)
-        t->data = pa_xrealloc(t->data, t->allocated = t->length + l + GROW_TAG_SIZE);
+        t->data = pa_xrealloc(t->data, t->allocated = PA_MAX(t->length + l + GROW_TAG_SIZE, 2 * t->allocated));
     else if (t->type == PA_TAGSTRUCT_APPENDED) {
         t->type = PA_TAGSTRUCT_DYNAMIC;
-        t->data = pa_xmalloc(t->allocated = t->length + l + GROW_TAG_SIZE);
+        t->data = pa_xmalloc(t->allocated = PA_MAX(t->length + l + GROW_TAG_SIZE, 2 * t->allocated));
         memcpy(t->data, t->per_type.appended, t->length);
     }
 }
@@ -463,6 +478,26 @@ const uint8_t* pa_tagstruct_data(pa_tagstruct*t, size_t *l) {
     return t->data;
 }
 
+uint8_t* pa_tagstruct_steal_data(pa_tagstruct*t, size_t *l) {
+    uint8_t *d;
+
+    pa_assert(t);
+    pa_assert(l);
+
+    if (t->type != PA_TAGSTRUCT_DYNAMIC || t->length == 0)
+        return NULL;
+
+    d = t->data;
+    *l = t->length;
+
+    t->data = t->per_type.appended;
+    t->allocated = MAX_APPENDED_SIZE;
+    t->length = t->rindex = 0;
+    t->type = PA_TAGSTRUCT_APPENDED;
+
+    return d;
+}
+
 int pa_tagstruct_get_boolean(pa_tagstruct*t, bool *b) {
     pa_assert(t);
     pa_assert(b);
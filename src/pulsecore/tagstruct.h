@@ -61,12 +61,20 @@ enum {
 };
 
 pa_tagstruct *pa_tagstruct_new(void);
+/* Preallocates size_hint bytes, for callers that know roughly how large the
+ * tagstruct will get */
+pa_tagstruct *pa_tagstruct_new_sized(size_t size_hint);
 pa_tagstruct *pa_tagstruct_new_fixed(const uint8_t* data, size_t length);
 void pa_tagstruct_free(pa_tagstruct*t);
 
 int pa_tagstruct_eof(pa_tagstruct*t);
 const uint8_t* pa_tagstruct_data(pa_tagstruct*t, size_t *l);
 
+/* Takes over the heap buffer of the tagstruct, which has to be freed with
+ * pa_xfree(). Returns NULL if the data is stored inline, i.e. is small
+ * enough to be copied cheaply. The tagstruct is empty afterwards. */
+uint8_t* pa_tagstruct_steal_data(pa_tagstruct*t, size_t *l);
+
 void pa_tagstruct_put(pa_tagstruct *t, ...);
 
 void pa_tagstruct_puts(pa_tagstruct*t, const char *s);
@@ -27,12 +27,25 @@
 #include <pulse/sample.h>
 #include <pulse/xmalloc.h>
 
+#include <pulsecore/core-util.h>
 #include <pulsecore/macro.h>
 
 #include "time-smoother.h"
 
 #define HISTORY_MAX 64
 
+/* Kalman filter tuning. Times are in usec, rates are dimensionless. */
+#define KALMAN_OFFSET_NOISE 1e-6            /* Remote time wander: (1 usec)^2 per second */
+#define KALMAN_RATE_NOISE 1e-18             /* Rate wander: (1 ppm)^2 per second */
+#define KALMAN_RATE_VARIANCE_INITIAL 1e-6   /* Clocks differ by less than 1000 ppm */
+#define KALMAN_RATE_VARIANCE_MIN 1e-12      /* Don't trust an old rate by more than 1 ppm */
+#define KALMAN_OFFSET_VARIANCE_UNKNOWN 1e12 /* (1 s)^2, the next measurement is taken as is */
+#define KALMAN_JITTER_VARIANCE_INITIAL 2.5e5 /* (500 usec)^2 */
+#define KALMAN_JITTER_VARIANCE_MIN 1.0
+#define KALMAN_JITTER_WEIGHT 16             /* Measurements averaged for the jitter estimate */
+#define KALMAN_OUTLIER_SIGMA 5
+#define KALMAN_OUTLIER_MAX 3                /* Consecutive outliers that make a jump */
+
 /*
  * Implementation of a time smoothing algorithm to synchronize remote
  * clocks to a local one. Evens out noise, adjusts to clock skew and
@@ -54,6 +67,20 @@
  *
  * If 'monotonic' is true the resulting estimation function is
  * guaranteed to be monotonic.
+ *
+ * Alternatively the remote clock can be tracked with a Kalman filter
+ * whose state is the remote time 'ky' at the local time 'kx' of the last
+ * measurement and the rate 'kr' of the remote clock. 'p' is the
+ * covariance of that state. Each measurement first advances the state to
+ * its local time, growing the covariance by the process noise, and then
+ * pulls it towards the measured value, weighted by how the state
+ * uncertainty compares to the measurement noise. The latter is learned
+ * from the innovations, so the filter settles on a long averaging time
+ * for noisy clocks and follows quiet ones closely. Measurements far
+ * outside the expected spread are ignored unless several arrive in a
+ * row, in which case the remote clock is assumed to have jumped. Since
+ * the rate is a property of the device, it is kept over resets, so that
+ * after a resume only the offset has to be found again.
  */
 
 struct pa_smoother {
@@ -86,8 +113,42 @@ struct pa_smoother {
     pa_usec_t pause_time;
 
     unsigned min_history;
+
+    pa_smoother_algorithm_t algorithm;
+
+    /* Kalman filter state */
+    pa_usec_t kx;
+    double ky, kr;
+    double p00, p01, p11;
+    double jitter;        /* Variance of the measurements */
+    unsigned n_updates, n_outliers;
+};
+
+static const char * const algorithm_names[PA_SMOOTHER_MAX] = {
+    [PA_SMOOTHER_INTERPOLATE] = "interpolate",
+    [PA_SMOOTHER_KALMAN] = "kalman",
 };
 
+pa_smoother_algorithm_t pa_parse_smoother_algorithm(const char *string) {
+    pa_smoother_algorithm_t a;
+
+    pa_assert(string);
+
+    for (a = 0; a < PA_SMOOTHER_MAX; a++)
+        if (pa_streq(string, algorithm_names[a]))
+            return a;
+
+    return PA_SMOOTHER_INVALID;
+}
+
+const char *pa_smoother_algorithm_to_string(pa_smoother_algorithm_t a) {
+
+    if (a < 0 || a >= PA_SMOOTHER_MAX)
+        return NULL;
+
+    return algorithm_names[a];
+}
+
 pa_smoother* pa_smoother_new(
         pa_usec_t adjust_time,
         pa_usec_t history_time,
@@ -104,12 +165,16 @@ pa_smoother* pa_smoother_new(
     pa_assert(min_history >= 2);
     pa_assert(min_history <= HISTORY_MAX);
 
-    s = pa_xnew(pa_smoother, 1);
+    s = pa_xnew0(pa_smoother, 1);
     s->adjust_time = adjust_time;
     s->history_time = history_time;
     s->min_history = min_history;
     s->monotonic = monotonic;
     s->smoothing = smoothing;
+    s->algorithm = PA_SMOOTHER_INTERPOLATE;
+    s->kr = 1;
+    s->p11 = KALMAN_RATE_VARIANCE_INITIAL;
+    s->jitter = KALMAN_JITTER_VARIANCE_INITIAL;
 
     pa_smoother_reset(s, time_offset, paused);
 
@@ -122,6 +187,27 @@ void pa_smoother_free(pa_smoother* s) {
     pa_xfree(s);
 }
 
+void pa_smoother_set_algorithm(pa_smoother *s, pa_smoother_algorithm_t a) {
+    pa_assert(s);
+    pa_assert(a >= 0 && a < PA_SMOOTHER_MAX);
+
+    if (s->algorithm == a)
+        return;
+
+    s->algorithm = a;
+    s->kr = 1;
+    s->p11 = KALMAN_RATE_VARIANCE_INITIAL;
+    s->jitter = KALMAN_JITTER_VARIANCE_INITIAL;
+
+    pa_smoother_reset(s, s->time_offset, s->paused);
+}
+
+pa_smoother_algorithm_t pa_smoother_get_algorithm(pa_smoother *s) {
+    pa_assert(s);
+
+    return s->algorithm;
+}
+
 #define REDUCE(x)                               \
     do {                                        \
         x = (x) % HISTORY_MAX;                  \
@@ -274,11 +360,86 @@ static void calc_abc(pa_smoother *s) {
     s->abc_valid = true;
 }
 
+static void kalman_estimate(pa_smoother *s, pa_usec_t x, pa_usec_t *y, double *deriv) {
+    double t;
+
+    t = s->ky + s->kr * ((double) x - (double) s->kx);
+
+    *y = t >= 0 ? (pa_usec_t) llrint(t) : 0;
+
+    if (deriv)
+        *deriv = s->kr;
+}
+
+static void kalman_put(pa_smoother *s, pa_usec_t x, pa_usec_t y) {
+    double dt, ey, v, e, k0, k1, p00, p01, p11;
+
+    if (s->n_updates == 0) {
+        /* The rate and its variance are kept from before the reset */
+        s->kx = x;
+        s->ky = (double) y;
+        s->p00 = s->jitter;
+        s->p01 = 0;
+        s->n_updates = 1;
+        return;
+    }
+
+    /* Measurements from before the current state carry no news */
+    if (x < s->kx)
+        return;
+
+    /* Advance the state to x */
+    dt = (double) (x - s->kx);
+    ey = s->ky + s->kr * dt;
+    p00 = s->p00 + dt * (2 * s->p01 + dt * s->p11) + KALMAN_OFFSET_NOISE * dt;
+    p01 = s->p01 + dt * s->p11;
+    p11 = s->p11 + KALMAN_RATE_NOISE * dt;
+
+    /* Innovation and its expected variance */
+    v = (double) y - ey;
+    e = p00 + s->jitter;
+
+    if (s->n_updates >= s->min_history && v * v > KALMAN_OUTLIER_SIGMA * KALMAN_OUTLIER_SIGMA * e) {
+
+        if (++s->n_outliers < KALMAN_OUTLIER_MAX) {
+            s->kx = x;
+            s->ky = ey;
+            s->p00 = p00;
+            s->p01 = p01;
+            s->p11 = p11;
+            return;
+        }
+
+        /* The remote clock jumped, take its new position as is */
+        p00 += v * v;
+        e = p00 + s->jitter;
+    } else
+        s->jitter = PA_MAX(s->jitter + (v * v - p00 - s->jitter) / KALMAN_JITTER_WEIGHT, KALMAN_JITTER_VARIANCE_MIN);
+
+    s->n_outliers = 0;
+
+    k0 = p00 / e;
+    k1 = p01 / e;
+
+    s->kx = x;
+    s->ky = ey + k0 * v;
+    s->kr += k1 * v;
+
+    s->p00 = (1 - k0) * p00;
+    s->p01 = (1 - k0) * p01;
+    s->p11 = p11 - k1 * p01;
+
+    s->n_updates++;
+}
+
 static void estimate(pa_smoother *s, pa_usec_t x, pa_usec_t *y, double *deriv) {
     pa_assert(s);
     pa_assert(y);
 
-    if (x >= s->px) {
+    if (s->algorithm == PA_SMOOTHER_KALMAN)
+        kalman_estimate(s, x, y, deriv);
+
+    else if (x >= s->px) {
         /* Linear interpolation right from px */
         int64_t t;
 
@@ -355,6 +516,18 @@ void pa_smoother_put(pa_smoother *s, pa_usec_t x, pa_usec_t y) {
 
     x = PA_LIKELY(x >= s->time_offset) ? x - s->time_offset : 0;
 
+    if (s->algorithm == PA_SMOOTHER_KALMAN) {
+        kalman_put(s, x, y);
+
+        /* pa_smoother_translate() looks at the gradient */
+        s->dp = s->monotonic && s->kr < 0 ? 0 : s->kr;
+
+#ifdef DEBUG_DATA
+        pa_log_debug("%p, put(%llu | %llu) = %llu", s, (unsigned long long) (x + s->time_offset), (unsigned long long) x, (unsigned long long) y);
+#endif
+        return;
+    }
+
     is_new = x >= s->ex;
 
     if (is_new) {
@@ -469,6 +642,13 @@ void pa_smoother_resume(pa_smoother *s, pa_usec_t x, bool fix_now) {
 void pa_smoother_fix_now(pa_smoother *s) {
     pa_assert(s);
 
+    if (s->algorithm == PA_SMOOTHER_KALMAN) {
+        /* Forget where we are, but not how fast we go */
+        s->p00 = KALMAN_OFFSET_VARIANCE_UNKNOWN;
+        s->p01 = 0;
+        return;
+    }
+
     s->px = s->ex;
     s->py = s->ry;
 }
@@ -515,6 +695,16 @@ void pa_smoother_reset(pa_smoother *s, pa_usec_t time_offset, bool paused) {
 
     s->abc_valid = false;
 
+    s->kx = 0;
+    s->ky = 0;
+    s->p00 = s->p01 = 0;
+    s->n_updates = s->n_outliers = 0;
+
+    if (s->algorithm == PA_SMOOTHER_KALMAN) {
+        s->dp = s->kr;
+        s->p11 = PA_MAX(s->p11, KALMAN_RATE_VARIANCE_MIN);
+    }
+
     s->paused = paused;
     s->time_offset = s->pause_time = time_offset;
 
@@ -522,3 +712,60 @@ void pa_smoother_reset(pa_smoother *s, pa_usec_t time_offset, bool paused) {
     pa_log_debug("reset()");
 #endif
 }
+
+void pa_smoother_get_quality(pa_smoother *s, pa_smoother_quality *q) {
+    unsigned i, j;
+    double ax = 0, ay = 0, k = 0, t = 0, r, residual = 0, sigma;
+
+    pa_assert(s);
+    pa_assert(q);
+
+    pa_zero(*q);
+
+    if (s->algorithm == PA_SMOOTHER_KALMAN) {
+        q->n_updates = s->n_updates;
+        q->rate = s->kr;
+        q->rate_error = sqrt(s->p11);
+        q->error = (pa_usec_t) llrint(sqrt(s->p00));
+        q->jitter = (pa_usec_t) llrint(sqrt(s->jitter));
+        return;
+    }
+
+    q->n_updates = s->n_history;
+    q->rate = s->dp;
+
+    if (s->n_history < 3)
+        return;
+
+    /* Spread of the history around its regression line */
+    i = s->history_idx;
+    for (j = s->n_history; j > 0; j--) {
+        ax += (double) s->history_x[i];
+        ay += (double) s->history_y[i];
+        REDUCE_INC(i);
+    }
+
+    ax /= s->n_history;
+    ay /= s->n_history;
+
+    i = s->history_idx;
+    for (j = s->n_history; j > 0; j--) {
+        double dx = (double) s->history_x[i] - ax, dy = (double) s->history_y[i] - ay;
+
+        k += dx * dy;
+        t += dx * dx;
+        residual += dy * dy;
+        REDUCE_INC(i);
+    }
+
+    if (t <= 0)
+        return;
+
+    r = k / t;
+    residual -= r * k;
+    sigma = sqrt(PA_MAX(residual, 0.0) / (s->n_history - 2));
+
+    q->rate_error = sigma / sqrt(t);
+    q->error = (pa_usec_t) llrint(sigma / sqrt(s->n_history));
+    q->jitter = (pa_usec_t) llrint(sigma);
+}
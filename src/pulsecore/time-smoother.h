@@ -25,6 +25,29 @@
 
 typedef struct pa_smoother pa_smoother;
 
+/* How the remote time is estimated. PA_SMOOTHER_INTERPOLATE does a linear
+ * regression over a history window and smooths towards it with a spline, see
+ * time-smoother.c. PA_SMOOTHER_KALMAN tracks remote time and clock rate with a
+ * two state Kalman filter: updates are O(1), the rate survives
+ * pa_smoother_reset() and the filter knows how good its estimate is. */
+typedef enum pa_smoother_algorithm {
+    PA_SMOOTHER_INVALID = -1,
+    PA_SMOOTHER_INTERPOLATE,
+    PA_SMOOTHER_KALMAN,
+    PA_SMOOTHER_MAX
+} pa_smoother_algorithm_t;
+
+pa_smoother_algorithm_t pa_parse_smoother_algorithm(const char *string);
+const char *pa_smoother_algorithm_to_string(pa_smoother_algorithm_t a);
+
+typedef struct pa_smoother_quality {
+    unsigned n_updates;     /* Measurements since the last reset */
+    double rate;            /* Speed of the remote clock relative to the local one */
+    double rate_error;      /* Standard deviation of rate */
+    pa_usec_t error;        /* Standard deviation of the remote time estimate */
+    pa_usec_t jitter;       /* Standard deviation of the measurements */
+} pa_smoother_quality;
+
 pa_smoother* pa_smoother_new(
         pa_usec_t x_adjust_time,
         pa_usec_t x_history_time,
@@ -36,6 +59,14 @@ pa_smoother* pa_smoother_new(
 
 void pa_smoother_free(pa_smoother* s);
 
+/* Defaults to PA_SMOOTHER_INTERPOLATE. Switching discards the dataset, so
+ * this should be called before the first pa_smoother_put(). The Kalman
+ * filter ignores x_adjust_time, x_history_time and smoothing, min_history
+ * is the number of measurements after which it starts rejecting
+ * outliers. */
+void pa_smoother_set_algorithm(pa_smoother *s, pa_smoother_algorithm_t a);
+pa_smoother_algorithm_t pa_smoother_get_algorithm(pa_smoother *s);
+
 /* Adds a new value to our dataset. x = local/system time, y = remote time */
 void pa_smoother_put(pa_smoother *s, pa_usec_t x, pa_usec_t y);
 
@@ -54,4 +85,6 @@ void pa_smoother_reset(pa_smoother *s, pa_usec_t time_offset, bool paused);
 
 void pa_smoother_fix_now(pa_smoother *s);
 
+void pa_smoother_get_quality(pa_smoother *s, pa_smoother_quality *q);
+
 #endif
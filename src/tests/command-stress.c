@@ -0,0 +1,219 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <check.h>
+
+#include <pulse/pulseaudio.h>
+#include <pulse/rtclock.h>
+
+#include <pulsecore/atomic.h>
+
+/* Many clients spread over a handful of client side threads, all hammering
+ * the server with small introspection requests at the same time. With the
+ * default configuration the server only admits 64 clients, test-daemon.sh
+ * hence runs this test against a separate daemon with native IO worker
+ * threads enabled. */
+#define NMAINLOOPS 8
+#define NCLIENTS 256
+#define NCOMMANDS 200
+
+struct client {
+    pa_context *context;
+    pa_threaded_mainloop *mainloop;
+    unsigned left;
+    pa_usec_t sent;
+    pa_usec_t *latencies;
+};
+
+static pa_threaded_mainloop *mainloops[NMAINLOOPS];
+static struct client clients[NCLIENTS];
+static pa_usec_t latencies[NCLIENTS * NCOMMANDS];
+static pa_atomic_t n_finished = PA_ATOMIC_INIT(0);
+static pa_atomic_t command_failed = PA_ATOMIC_INIT(0);
+
+static void next_command(struct client *c);
+
+static void command_done(struct client *c) {
+    *(c->latencies++) = pa_rtclock_now() - c->sent;
+
+    if (--c->left > 0)
+        next_command(c);
+    else
+        /* n_finished is shared by all main loops */
+        pa_atomic_inc(&n_finished);
+}
+
+static void server_info_cb(pa_context *context, const pa_server_info *i, void *userdata) {
+    if (!i) {
+        fprintf(stderr, "get_server_info() failed: %s\n", pa_strerror(pa_context_errno(context)));
+        pa_atomic_store(&command_failed, 1);
+    }
+
+    command_done(userdata);
+}
+
+static void sink_info_cb(pa_context *context, const pa_sink_info *i, int eol, void *userdata) {
+    if (eol < 0) {
+        fprintf(stderr, "get_sink_info_list() failed: %s\n", pa_strerror(pa_context_errno(context)));
+        pa_atomic_store(&command_failed, 1);
+    }
+
+    if (eol)
+        command_done(userdata);
+}
+
+static void next_command(struct client *c) {
+    pa_operation *o;
+
+    c->sent = pa_rtclock_now();
+
+    if (c->left % 4 == 0)
+        o = pa_context_get_sink_info_list(c->context, sink_info_cb, c);
+    else
+        o = pa_context_get_server_info(c->context, server_info_cb, c);
+
+    fail_unless(o != NULL);
+    pa_operation_unref(o);
+}
+
+static void context_state_callback(pa_context *context, void *userdata) {
+    struct client *c = userdata;
+
+    switch (pa_context_get_state(context)) {
+        case PA_CONTEXT_READY:
+        case PA_CONTEXT_FAILED:
+        case PA_CONTEXT_TERMINATED:
+            pa_threaded_mainloop_signal(c->mainloop, 0);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static int cmp_usec(const void *a, const void *b) {
+    pa_usec_t x = *(const pa_usec_t *) a, y = *(const pa_usec_t *) b;
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+START_TEST (command_stress_test) {
+    pa_usec_t start;
+    unsigned i;
+
+    for (i = 0; i < NMAINLOOPS; i++) {
+        mainloops[i] = pa_threaded_mainloop_new();
+        fail_unless(mainloops[i] != NULL);
+        fail_unless(pa_threaded_mainloop_start(mainloops[i]) == 0);
+    }
+
+    /* Connect one client after the other, the listening socket only has a
+     * small backlog */
+    for (i = 0; i < NCLIENTS; i++) {
+        struct client *c = &clients[i];
+        pa_context_state_t state;
+
+        c->mainloop = mainloops[i % NMAINLOOPS];
+        c->left = NCOMMANDS;
+        c->latencies = latencies + i * NCOMMANDS;
+
+        pa_threaded_mainloop_lock(c->mainloop);
+
+        c->context = pa_context_new(pa_threaded_mainloop_get_api(c->mainloop), "command-stress");
+        fail_unless(c->context != NULL);
+        pa_context_set_state_callback(c->context, context_state_callback, c);
+        fail_unless(pa_context_connect(c->context, NULL, 0, NULL) >= 0);
+
+        while ((state = pa_context_get_state(c->context)) != PA_CONTEXT_READY) {
+            if (!PA_CONTEXT_IS_GOOD(state)) {
+                fprintf(stderr, "Connection %u failed: %s\n", i, pa_strerror(pa_context_errno(c->context)));
+                ck_abort();
+            }
+
+            pa_threaded_mainloop_wait(c->mainloop);
+        }
+
+        pa_threaded_mainloop_unlock(c->mainloop);
+    }
+
+    start = pa_rtclock_now();
+
+    for (i = 0; i < NMAINLOOPS; i++)
+        pa_threaded_mainloop_lock(mainloops[i]);
+
+    for (i = 0; i < NCLIENTS; i++)
+        next_command(&clients[i]);
+
+    for (i = 0; i < NMAINLOOPS; i++)
+        pa_threaded_mainloop_unlock(mainloops[i]);
+
+    while (pa_atomic_load(&n_finished) < NCLIENTS)
+        pa_msleep(10);
+
+    fprintf(stderr, "%u clients, %u commands in %llu msec\n",
+            NCLIENTS, NCLIENTS * NCOMMANDS,
+            (unsigned long long) ((pa_rtclock_now() - start) / PA_USEC_PER_MSEC));
+
+    qsort(latencies, NCLIENTS * NCOMMANDS, sizeof(pa_usec_t), cmp_usec);
+
+    fprintf(stderr, "Command latency p50 %llu usec, p99 %llu usec, max %llu usec\n",
+            (unsigned long long) latencies[NCLIENTS * NCOMMANDS / 2],
+            (unsigned long long) latencies[NCLIENTS * NCOMMANDS * 99 / 100],
+            (unsigned long long) latencies[NCLIENTS * NCOMMANDS - 1]);
+
+    for (i = 0; i < NCLIENTS; i++) {
+        pa_threaded_mainloop_lock(clients[i].mainloop);
+        pa_context_disconnect(clients[i].context);
+        pa_context_unref(clients[i].context);
+        pa_threaded_mainloop_unlock(clients[i].mainloop);
+    }
+
+    for (i = 0; i < NMAINLOOPS; i++) {
+        pa_threaded_mainloop_stop(mainloops[i]);
+        pa_threaded_mainloop_free(mainloops[i]);
+    }
+
+    fail_unless(!pa_atomic_load(&command_failed));
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Command Stress");
+    tc = tcase_create("commandstress");
+    tcase_add_test(tc, command_stress_test);
+    tcase_set_timeout(tc, 5 * 60);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -48,6 +48,7 @@
  */
 #define NSTREAMS 20
 #define NTESTS 1000
+#define NLATENCY 50
 #define SAMPLE_HZ 44100
 
 static pa_context *context = NULL;
@@ -195,6 +196,125 @@ static void context_state_callback(pa_context *c, void *userdata) {
     }
 }
 
+/* Time-to-first-sample: from pa_context_connect() until the server asks for
+ * the first chunk of audio, once with the regular request/reply handshake and
+ * once with PA_CONTEXT_PIPELINED, which lets the client name and the stream
+ * creation ride along with the AUTH request. */
+struct latency_run {
+    pa_mainloop *mainloop;
+    pa_stream *stream;
+    bool pipelined;
+    pa_usec_t first_sample;
+};
+
+static void latency_stream_write_callback(pa_stream *s, size_t nbytes, void *userdata) {
+    struct latency_run *r = userdata;
+
+    if (!r->first_sample) {
+        r->first_sample = pa_rtclock_now();
+        pa_mainloop_quit(r->mainloop, 0);
+    }
+
+    stream_write_callback(s, nbytes, NULL);
+}
+
+static void latency_connect_stream(pa_context *c, struct latency_run *r) {
+    r->stream = pa_stream_new(c, "latency", &sample_spec, NULL);
+    fail_unless(r->stream != NULL);
+
+    pa_stream_set_state_callback(r->stream, stream_state_callback, NULL);
+    pa_stream_set_write_callback(r->stream, latency_stream_write_callback, r);
+    fail_unless(pa_stream_connect_playback(r->stream, NULL, NULL, 0, NULL, NULL) == 0);
+}
+
+static void latency_context_state_callback(pa_context *c, void *userdata) {
+    struct latency_run *r = userdata;
+
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_AUTHORIZING:
+            if (r->pipelined && !r->stream)
+                latency_connect_stream(c, r);
+            break;
+
+        case PA_CONTEXT_READY:
+            if (!r->stream)
+                latency_connect_stream(c, r);
+            break;
+
+        case PA_CONTEXT_FAILED:
+            fprintf(stderr, "Context error: %s\n", pa_strerror(pa_context_errno(c)));
+            ck_abort();
+            break;
+
+        default:
+            break;
+    }
+}
+
+static pa_usec_t time_to_first_sample(bool pipelined) {
+    struct latency_run r;
+    pa_context *c;
+    pa_usec_t start;
+
+    memset(&r, 0, sizeof(r));
+    r.pipelined = pipelined;
+
+    r.mainloop = pa_mainloop_new();
+    fail_unless(r.mainloop != NULL);
+
+    c = pa_context_new(pa_mainloop_get_api(r.mainloop), bname);
+    fail_unless(c != NULL);
+
+    pa_context_set_state_callback(c, latency_context_state_callback, &r);
+
+    start = pa_rtclock_now();
+
+    if (pa_context_connect(c, NULL, pipelined ? PA_CONTEXT_PIPELINED : PA_CONTEXT_NOFLAGS, NULL) < 0) {
+        fprintf(stderr, "pa_context_connect() failed.\n");
+        ck_abort();
+    }
+
+    fail_unless(pa_mainloop_run(r.mainloop, NULL) >= 0);
+    fail_unless(r.first_sample >= start);
+
+    pa_stream_set_state_callback(r.stream, NULL, NULL);
+    pa_stream_disconnect(r.stream);
+    pa_stream_unref(r.stream);
+
+    pa_context_set_state_callback(c, NULL, NULL);
+    pa_context_disconnect(c);
+    pa_context_unref(c);
+
+    pa_mainloop_free(r.mainloop);
+
+    return r.first_sample - start;
+}
+
+START_TEST (connect_latency_test) {
+    int mode;
+
+    for (mode = 0; mode < 2; mode++) {
+        pa_usec_t sum = 0, min = (pa_usec_t) -1, max = 0;
+        int i;
+
+        for (i = 0; i < NLATENCY; i++) {
+            pa_usec_t t = time_to_first_sample(mode == 1);
+
+            sum += t;
+            min = PA_MIN(min, t);
+            max = PA_MAX(max, t);
+        }
+
+        fprintf(stderr, "%s connect: time to first sample avg %llu usec, min %llu usec, max %llu usec (%d runs)\n",
+                mode == 1 ? "Pipelined" : "Sequential",
+                (unsigned long long) (sum / NLATENCY),
+                (unsigned long long) min,
+                (unsigned long long) max,
+                NLATENCY);
+    }
+}
+END_TEST
+
 START_TEST (connect_stress_test) {
     int i;
 
@@ -222,6 +342,7 @@ int main(int argc, char *argv[]) {
 
     s = suite_create("Connect Stress");
     tc = tcase_create("connectstress");
+    tcase_add_test(tc, connect_latency_test);
     tcase_add_test(tc, connect_stress_test);
     tcase_set_timeout(tc, 20 * 60);
     suite_add_tcase(s, tc);
@@ -0,0 +1,229 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <math.h>
+
+#include <pulse/xmalloc.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/random.h>
+
+#include <pulsecore/filter/convolver.h>
+
+#include "runtime-test-util.h"
+
+#define N_INPUTS 6
+#define N_OUTPUTS 2
+#define N_FRAMES 4096
+#define TOLERANCE 1e-4
+
+/* Where the rewind case resumes, not aligned to any block size */
+#define REWIND_POS (N_FRAMES / 2 + 37)
+
+#define TIMES 5
+#define TIMES2 10
+
+static void random_floats(float *d, size_t n, float scale) {
+    size_t i;
+
+    pa_random(d, n * sizeof(float));
+
+    for (i = 0; i < n; i++) {
+        union { float f; uint32_t i; } u;
+
+        u.f = d[i];
+        d[i] = ((float) (u.i & 0xffff) / 0x8000 - 1.0f) * scale;
+    }
+}
+
+/* The time domain algorithm module-virtual-surround-sink used before: every
+ * output channel is the sum of all input channels convolved with the impulse
+ * response of that pair. ir holds N_INPUTS * N_OUTPUTS interleaved responses. */
+static void direct_convolve(const float *src, float *dst, unsigned n_frames, const float *ir, unsigned ir_len) {
+    unsigned l, i, o, j;
+
+    for (l = 0; l < n_frames; l++) {
+        for (o = 0; o < N_OUTPUTS; o++) {
+            float sum = 0;
+
+            for (j = 0; j < ir_len && j <= l; j++)
+                for (i = 0; i < N_INPUTS; i++)
+                    sum += src[(l - j) * N_INPUTS + i] * ir[j * N_INPUTS * N_OUTPUTS + i * N_OUTPUTS + o];
+
+            dst[l * N_OUTPUTS + o] = sum;
+        }
+    }
+}
+
+static pa_convolver *setup_convolver(unsigned block_size, const float *ir, unsigned ir_len) {
+    pa_convolver *c;
+    unsigned i, o;
+
+    c = pa_convolver_new(block_size, ir_len, N_INPUTS, N_OUTPUTS);
+
+    for (i = 0; i < N_INPUTS; i++)
+        for (o = 0; o < N_OUTPUTS; o++)
+            pa_convolver_set_filter(c, i, o, ir + i * N_OUTPUTS + o, ir_len, N_INPUTS * N_OUTPUTS);
+
+    return c;
+}
+
+static void run_convolver_test(unsigned block_size, unsigned ir_len) {
+    float *src, *ir, *ref, *out;
+    pa_convolver *c;
+    unsigned latency, history, done, l;
+    double max_err = 0;
+
+    src = pa_xnew(float, N_FRAMES * N_INPUTS);
+    ir = pa_xnew(float, ir_len * N_INPUTS * N_OUTPUTS);
+    ref = pa_xnew(float, N_FRAMES * N_OUTPUTS);
+    out = pa_xnew(float, N_FRAMES * N_OUTPUTS);
+
+    random_floats(src, N_FRAMES * N_INPUTS, 1.0f);
+    random_floats(ir, ir_len * N_INPUTS * N_OUTPUTS, 1.0f / ir_len);
+
+    direct_convolve(src, ref, N_FRAMES, ir, ir_len);
+
+    c = setup_convolver(block_size, ir, ir_len);
+    latency = pa_convolver_get_latency(c);
+    fail_unless(latency == block_size);
+
+    /* Feed odd-sized chunks to cover partially filled blocks */
+    for (done = 0; done < N_FRAMES;) {
+        unsigned n = PA_MIN(N_FRAMES - done, 1 + (done * 7 + 13) % 333);
+
+        pa_convolver_process(c, src + done * N_INPUTS, out + done * N_OUTPUTS, n);
+        done += n;
+    }
+
+    for (l = 0; l < latency * N_OUTPUTS; l++)
+        fail_unless(out[l] == 0.0f);
+
+    for (l = 0; l < (N_FRAMES - latency) * N_OUTPUTS; l++) {
+        double err = fabs(ref[l] - out[l + latency * N_OUTPUTS]);
+
+        if (!(err <= max_err))
+            max_err = err;
+    }
+
+    pa_log_debug("block size %u, %u taps: maximum deviation %g", block_size, ir_len, max_err);
+    fail_unless(max_err < TOLERANCE);
+
+    /* After a reset the output must not depend on earlier input */
+    pa_convolver_reset(c);
+    pa_convolver_process(c, src, out, N_FRAMES);
+
+    for (l = 0; l < (N_FRAMES - latency) * N_OUTPUTS; l++)
+        fail_unless(fabs(ref[l] - out[l + latency * N_OUTPUTS]) < TOLERANCE);
+
+    /* Rewind the way module-virtual-surround-sink does: reset, refill the
+     * history from the input before the rewind position and continue from
+     * there. The output must carry on without a gap or a transient. */
+    history = pa_convolver_get_history(c);
+    fail_unless(history <= REWIND_POS);
+
+    pa_convolver_reset(c);
+    pa_convolver_process(c, src + (REWIND_POS - history) * N_INPUTS, NULL, history);
+    pa_convolver_process(c, src + REWIND_POS * N_INPUTS, out, N_FRAMES - REWIND_POS);
+
+    for (l = 0; l < (N_FRAMES - REWIND_POS) * N_OUTPUTS; l++)
+        fail_unless(fabs(ref[l + (REWIND_POS - latency) * N_OUTPUTS] - out[l]) < TOLERANCE);
+
+    pa_convolver_free(c);
+
+    pa_xfree(src);
+    pa_xfree(ir);
+    pa_xfree(ref);
+    pa_xfree(out);
+}
+
+START_TEST (convolver_test) {
+    run_convolver_test(4, 3);
+    run_convolver_test(64, 64);
+    run_convolver_test(64, 200);
+    run_convolver_test(128, 1000);
+    run_convolver_test(256, 100);
+}
+END_TEST
+
+static void run_convolver_benchmark(unsigned block_size, unsigned ir_len) {
+    float *src, *ir, *out;
+    pa_convolver *c;
+    char label[64];
+
+    src = pa_xnew(float, N_FRAMES * N_INPUTS);
+    ir = pa_xnew(float, ir_len * N_INPUTS * N_OUTPUTS);
+    out = pa_xnew(float, N_FRAMES * N_OUTPUTS);
+
+    random_floats(src, N_FRAMES * N_INPUTS, 1.0f);
+    random_floats(ir, ir_len * N_INPUTS * N_OUTPUTS, 1.0f / ir_len);
+
+    c = setup_convolver(block_size, ir, ir_len);
+
+    pa_snprintf(label, sizeof(label), "direct, %u taps", ir_len);
+    PA_RUNTIME_TEST_RUN_START(label, TIMES, TIMES2) {
+        direct_convolve(src, out, N_FRAMES, ir, ir_len);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    pa_snprintf(label, sizeof(label), "partitioned %u, %u taps", block_size, ir_len);
+    PA_RUNTIME_TEST_RUN_START(label, TIMES, TIMES2) {
+        pa_convolver_process(c, src, out, N_FRAMES);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    pa_convolver_free(c);
+
+    pa_xfree(src);
+    pa_xfree(ir);
+    pa_xfree(out);
+}
+
+START_TEST (convolver_benchmark) {
+    run_convolver_benchmark(64, 64);
+    run_convolver_benchmark(128, 256);
+    run_convolver_benchmark(256, 1024);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Convolver");
+    tc = tcase_create("convolver");
+    tcase_add_test(tc, convolver_test);
+    tcase_add_test(tc, convolver_benchmark);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
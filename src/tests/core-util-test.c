@@ -20,6 +20,7 @@
 #endif
 
 #include <signal.h>
+#include <string.h>
 
 #include <check.h>
 
@@ -248,6 +249,46 @@ START_TEST (modargs_test_unescape) {
 }
 END_TEST
 
+START_TEST (modargs_test_cpu_list) {
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    char *allowed, *value, *single, *list;
+    uint32_t cpu;
+
+    /* Everything the process may run on, in canonical form */
+    allowed = pa_cpu_list_effective("0-1023");
+    fail_unless(allowed != NULL);
+
+    value = pa_cpu_list_effective(allowed);
+    ck_assert_str_eq(value, allowed);
+    pa_xfree(value);
+
+    single = pa_xstrndup(allowed, strcspn(allowed, ",-"));
+    fail_unless(pa_atou(single, &cpu) == 0);
+
+    value = pa_cpu_list_effective(single);
+    ck_assert_str_eq(value, single);
+    pa_xfree(value);
+
+    /* Duplicates are merged */
+    list = pa_sprintf_malloc("%u,%u-%u", cpu, cpu, cpu);
+    value = pa_cpu_list_effective(list);
+    ck_assert_str_eq(value, single);
+    pa_xfree(value);
+
+    pa_xfree(list);
+    pa_xfree(single);
+    pa_xfree(allowed);
+
+    fail_unless(pa_cpu_list_effective("") == NULL);
+    fail_unless(pa_cpu_list_effective("a") == NULL);
+    fail_unless(pa_cpu_list_effective("1-") == NULL);
+    fail_unless(pa_cpu_list_effective("3-1") == NULL);
+    fail_unless(pa_cpu_list_effective("0,,1") == NULL);
+    fail_unless(pa_cpu_list_effective("100000") == NULL);
+#endif
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -274,6 +315,7 @@ int main(int argc, char *argv[]) {
     tcase_add_test_raise_signal(tc, modargs_test_replace_fail_4, SIGABRT);
     tcase_add_test(tc, modargs_test_escape);
     tcase_add_test(tc, modargs_test_unescape);
+    tcase_add_test(tc, modargs_test_cpu_list);
 
     sr = srunner_create(s);
     srunner_run_all(sr, CK_NORMAL);
@@ -20,11 +20,13 @@
 #endif
 
 #include <check.h>
+#include <math.h>
 
 #include <pulsecore/cpu.h>
 #include <pulsecore/cpu-arm.h>
 #include <pulsecore/random.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
 #include <pulsecore/mix.h>
 
 #include "runtime-test-util.h"
@@ -145,6 +147,123 @@ static void run_mix_test(
     pa_mempool_unref(pool);
 }
 
+/* Mixes nstreams streams of the given format with func and orig_func and
+ * checks that the results are bit-exact. The number of frames is odd and the
+ * streams are misaligned, so that the tail handling gets exercised too. */
+static void run_mix_format_test(
+        pa_sample_format_t format,
+        pa_do_mix_func_t func,
+        pa_do_mix_func_t orig_func,
+        unsigned nstreams,
+        unsigned channels,
+        bool correct,
+        bool perf) {
+
+    pa_mix_info m[PA_CHANNELS_MAX];
+    pa_mempool *pool;
+    size_t ss, nsamples, length;
+    uint8_t *out, *out_ref;
+    unsigned i, j;
+
+    pa_assert(nstreams <= PA_CHANNELS_MAX);
+
+    ss = pa_sample_size_of_format(format);
+    nsamples = channels * (SAMPLES - 1);
+    length = nsamples * ss;
+
+    fail_unless((pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true)) != NULL, NULL);
+
+    for (i = 0; i < nstreams; i++) {
+        uint8_t *d;
+
+        m[i].chunk.memblock = pa_memblock_new(pool, length + 8);
+        m[i].chunk.index = 1 + i % 3;
+        m[i].chunk.length = length;
+
+        d = pa_memblock_acquire_chunk(&m[i].chunk);
+
+        if (format == PA_SAMPLE_FLOAT32NE || format == PA_SAMPLE_FLOAT32RE) {
+            /* Random bytes would give NaNs, use samples in [-1, 1) */
+            int16_t *r = pa_xnew(int16_t, nsamples);
+
+            pa_random(r, nsamples * sizeof(int16_t));
+            for (j = 0; j < nsamples; j++) {
+                float f = r[j] / (float) 0x8000;
+
+                if (format == PA_SAMPLE_FLOAT32RE)
+                    PA_WRITE_FLOAT32RE(d + j * ss, f);
+                else
+                    memcpy(d + j * ss, &f, sizeof(float));
+            }
+            pa_xfree(r);
+        } else
+            pa_random(d, length);
+
+        pa_memblock_release(m[i].chunk.memblock);
+
+        /* Mix of attenuation, gain and muted channels */
+        m[i].volume.channels = channels;
+        for (j = 0; j < channels; j++) {
+            int32_t v = (0x4000 + 0x8ad1 * (i + j)) % 0x1c000;
+
+            if ((i + j) % 5 == 0)
+                v = 0;
+
+            if (format == PA_SAMPLE_FLOAT32NE || format == PA_SAMPLE_FLOAT32RE)
+                m[i].linear[j].f = v / (float) 0x10000;
+            else
+                m[i].linear[j].i = v;
+        }
+    }
+
+    out = pa_xmalloc(length);
+    out_ref = pa_xmalloc(length);
+
+    if (correct) {
+        acquire_mix_streams(m, nstreams);
+        orig_func(m, nstreams, channels, out_ref, length);
+        release_mix_streams(m, nstreams);
+
+        acquire_mix_streams(m, nstreams);
+        func(m, nstreams, channels, out, length);
+        release_mix_streams(m, nstreams);
+
+        for (j = 0; j < length; j++) {
+            if (out[j] != out_ref[j]) {
+                pa_log_debug("Correctness test failed: format=%s, streams=%u, channels=%u",
+                    pa_sample_format_to_string(format), nstreams, channels);
+                pa_log_debug("byte %u: %02x != %02x", j, out[j], out_ref[j]);
+                ck_abort();
+            }
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing %s mixing performance, %u streams with %u channels",
+            pa_sample_format_to_string(format), nstreams, channels);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES / 10, TIMES2) {
+            acquire_mix_streams(m, nstreams);
+            func(m, nstreams, channels, out, length);
+            release_mix_streams(m, nstreams);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES / 10, TIMES2) {
+            acquire_mix_streams(m, nstreams);
+            orig_func(m, nstreams, channels, out_ref, length);
+            release_mix_streams(m, nstreams);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+
+    pa_xfree(out);
+    pa_xfree(out_ref);
+
+    for (i = 0; i < nstreams; i++)
+        pa_memblock_unref(m[i].chunk.memblock);
+
+    pa_mempool_unref(pool);
+}
+
 START_TEST (mix_special_test) {
     pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
     pa_do_mix_func_t orig_func, special_func;
@@ -168,6 +287,168 @@ START_TEST (mix_special_test) {
 }
 END_TEST
 
+/* The two pass path scales by pa_sw_cvolume_multiply() of the stream and
+ * sink volume, which rounds the product to a pa_volume_t, while pa_mix()
+ * multiplies the linear factors of both. Returns the largest difference
+ * between the two linear factors over all channels, which grows with the
+ * volumes. */
+static double fused_linear_error(const pa_cvolume *volume, const pa_cvolume *sink_volume, const pa_cvolume *total_volume) {
+    double e = 0;
+    unsigned i;
+
+    for (i = 0; i < volume->channels; i++)
+        e = PA_MAX(e, fabs(pa_sw_volume_to_linear(total_volume->values[i]) -
+                           pa_sw_volume_to_linear(volume->values[i]) * pa_sw_volume_to_linear(sink_volume->values[i])));
+
+    return e;
+}
+
+/* Compares applying a volume to a single input the way pa_sink_render() used
+ * to do it (copy into a writable block, then scale in place) with the fused
+ * single pass through pa_mix(). Without a sink volume the results must be
+ * bit-exact, with one they may differ by what fused_linear_error() allows. */
+static void run_fused_volume_test(pa_sample_format_t format, unsigned channels, bool with_sink_volume) {
+    pa_sample_spec spec;
+    pa_cvolume volume, sink_volume, total_volume;
+    pa_mempool *pool;
+    pa_memchunk in, copy, fused;
+    pa_mix_info m;
+    size_t length;
+    void *ptr;
+    unsigned i;
+
+    spec.format = format;
+    spec.rate = 48000;
+    spec.channels = channels;
+
+    length = pa_frame_size(&spec) * SAMPLES;
+
+    pa_cvolume_init(&volume);
+    volume.channels = channels;
+    for (i = 0; i < channels; i++)
+        volume.values[i] = PA_VOLUME_NORM / 2 + i * (PA_VOLUME_NORM / 8);
+
+    /* Odd values up to 150%, so that the product needs rounding */
+    pa_cvolume_init(&sink_volume);
+    sink_volume.channels = channels;
+    for (i = 0; i < channels; i++)
+        sink_volume.values[i] = PA_VOLUME_NORM + PA_VOLUME_NORM / 2 - 1 - i * 4099;
+
+    if (with_sink_volume)
+        pa_sw_cvolume_multiply(&total_volume, &sink_volume, &volume);
+    else
+        total_volume = volume;
+
+    fail_unless((pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true)) != NULL, NULL);
+
+    in.memblock = pa_memblock_new(pool, length);
+    in.index = 0;
+    in.length = length;
+
+    ptr = pa_memblock_acquire(in.memblock);
+    if (format == PA_SAMPLE_FLOAT32NE) {
+        float *f = ptr;
+        int16_t r;
+
+        for (i = 0; i < length / sizeof(float); i++) {
+            pa_random(&r, sizeof(r));
+            f[i] = r / (float) 0x8000;
+        }
+    } else
+        pa_random(ptr, length);
+    pa_memblock_release(in.memblock);
+
+    m.chunk = in;
+    m.volume = volume;
+
+    /* Two passes: copy, then volume in place */
+    copy = in;
+    pa_memblock_ref(copy.memblock);
+    pa_memchunk_make_writable(&copy, 0);
+    pa_volume_memchunk(&copy, &spec, &total_volume);
+
+    /* One pass: volume applied while writing the output */
+    fused.memblock = pa_memblock_new(pool, length);
+    fused.index = 0;
+    ptr = pa_memblock_acquire(fused.memblock);
+    fused.length = pa_mix(&m, 1, ptr, length, &spec, with_sink_volume ? &sink_volume : NULL, false);
+    pa_memblock_release(fused.memblock);
+
+    fail_unless(fused.length == copy.length);
+
+    if (!with_sink_volume)
+        fail_unless(memcmp((uint8_t*) pa_memblock_acquire(copy.memblock) + copy.index,
+                           pa_memblock_acquire(fused.memblock), length) == 0);
+    else if (format == PA_SAMPLE_FLOAT32NE) {
+        const float *a = (const float*) ((uint8_t*) pa_memblock_acquire(copy.memblock) + copy.index);
+        const float *b = pa_memblock_acquire(fused.memblock);
+        /* Samples are within [-1, 1], plus some float rounding */
+        float tolerance = (float) fused_linear_error(&volume, &sink_volume, &total_volume) + 1e-6f;
+
+        pa_log_debug("Fused float volume with %u channels may be off by %g", channels, tolerance);
+
+        for (i = 0; i < length / sizeof(float); i++)
+            fail_unless(fabsf(a[i] - b[i]) <= tolerance);
+    } else {
+        const int16_t *a = (const int16_t*) ((uint8_t*) pa_memblock_acquire(copy.memblock) + copy.index);
+        const int16_t *b = pa_memblock_acquire(fused.memblock);
+        /* On top of what the linear factors differ by, rounding both 16.16
+         * factors (and the sink factor to a float in pa_mix()) moves a
+         * sample of up to 0x8000 by less than one step, and truncating the
+         * scaled sample by less than another. The difference is an integer
+         * below that bound. */
+        int tolerance = (int) ceil(0x8000 * fused_linear_error(&volume, &sink_volume, &total_volume) + 2) - 1;
+
+        pa_log_debug("Fused s16 volume with %u channels may be off by %i", channels, tolerance);
+
+        for (i = 0; i < length / sizeof(int16_t); i++)
+            fail_unless(abs(a[i] - b[i]) <= tolerance);
+    }
+
+    pa_memblock_release(copy.memblock);
+    pa_memblock_release(fused.memblock);
+
+    if (!with_sink_volume) {
+        /* Not measured: each pass is assumed to read and write the whole
+         * period, so the copy only counts if make_writable() really copied */
+        pa_log_debug("Testing %s single input volume with %u channels: estimated %zu bytes touched per period with copy and volume, %zu fused",
+            pa_sample_format_to_string(format), channels,
+            (copy.memblock != in.memblock ? 2 * length : 0) + 2 * length, 2 * length);
+
+        PA_RUNTIME_TEST_RUN_START("fused", TIMES, TIMES2) {
+            ptr = pa_memblock_acquire(fused.memblock);
+            pa_mix(&m, 1, ptr, length, &spec, NULL, false);
+            pa_memblock_release(fused.memblock);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("copy+volume", TIMES, TIMES2) {
+            pa_memchunk c = in;
+
+            pa_memblock_ref(c.memblock);
+            pa_memchunk_make_writable(&c, 0);
+            pa_volume_memchunk(&c, &spec, &volume);
+            pa_memblock_unref(c.memblock);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+
+    pa_memblock_unref(copy.memblock);
+    pa_memblock_unref(fused.memblock);
+    pa_memblock_unref(in.memblock);
+
+    pa_mempool_unref(pool);
+}
+
+START_TEST (mix_fused_volume_test) {
+    run_fused_volume_test(PA_SAMPLE_S16NE, 2, false);
+    run_fused_volume_test(PA_SAMPLE_FLOAT32NE, 2, false);
+    run_fused_volume_test(PA_SAMPLE_S16NE, 6, false);
+
+    run_fused_volume_test(PA_SAMPLE_S16NE, 2, true);
+    run_fused_volume_test(PA_SAMPLE_FLOAT32NE, 2, true);
+    run_fused_volume_test(PA_SAMPLE_S16NE, 6, true);
+}
+END_TEST
+
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
 START_TEST (mix_neon_test) {
     pa_do_mix_func_t orig_func, neon_func;
@@ -196,6 +477,70 @@ START_TEST (mix_neon_test) {
 END_TEST
 #endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
 
+#if defined (__i386__) || defined (__amd64__)
+static const pa_sample_format_t avx_formats[] = {
+    PA_SAMPLE_U8,
+    PA_SAMPLE_S16NE,
+    PA_SAMPLE_S16RE,
+    PA_SAMPLE_S32NE,
+    PA_SAMPLE_S32RE,
+    PA_SAMPLE_S24_32NE,
+    PA_SAMPLE_S24_32RE,
+    PA_SAMPLE_FLOAT32NE,
+    PA_SAMPLE_FLOAT32RE,
+};
+
+static void run_avx_mix_tests(pa_cpu_x86_flag_t flags, const pa_do_mix_func_t orig_funcs[]) {
+    static const unsigned channels[] = { 1, 2, 3, 4, 6, 8 };
+    unsigned i, j;
+
+    pa_mix_func_init_avx(flags);
+
+    for (i = 0; i < PA_ELEMENTSOF(avx_formats); i++) {
+        pa_do_mix_func_t func = pa_get_mix_func(avx_formats[i]);
+
+        for (j = 0; j < PA_ELEMENTSOF(channels); j++) {
+            run_mix_format_test(avx_formats[i], func, orig_funcs[i], 2, channels[j], true, false);
+            run_mix_format_test(avx_formats[i], func, orig_funcs[i], 9, channels[j], true, false);
+        }
+
+        run_mix_format_test(avx_formats[i], func, orig_funcs[i], 32, 2, true, true);
+    }
+
+    /* Restore the generic functions */
+    for (i = 0; i < PA_ELEMENTSOF(avx_formats); i++)
+        pa_set_mix_func(avx_formats[i], orig_funcs[i]);
+}
+
+START_TEST (mix_avx_test) {
+    pa_do_mix_func_t orig_funcs[PA_ELEMENTSOF(avx_formats)];
+    pa_cpu_x86_flag_t flags = 0;
+    unsigned i;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    for (i = 0; i < PA_ELEMENTSOF(avx_formats); i++)
+        orig_funcs[i] = pa_get_mix_func(avx_formats[i]);
+
+    pa_log_debug("Checking AVX2 mix");
+    run_avx_mix_tests(flags & ~PA_CPU_X86_AVX512F, orig_funcs);
+
+    if (!(flags & PA_CPU_X86_AVX512F)) {
+        pa_log_info("AVX-512 not supported. Skipping");
+        return;
+    }
+
+    pa_log_debug("Checking AVX-512 mix");
+    run_avx_mix_tests(flags, orig_funcs);
+}
+END_TEST
+#endif /* defined (__i386__) || defined (__amd64__) */
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -209,8 +554,12 @@ int main(int argc, char *argv[]) {
 
     tc = tcase_create("mix");
     tcase_add_test(tc, mix_special_test);
+    tcase_add_test(tc, mix_fused_volume_test);
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, mix_neon_test);
+#endif
+#if defined (__i386__) || defined (__amd64__)
+    tcase_add_test(tc, mix_avx_test);
 #endif
     tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
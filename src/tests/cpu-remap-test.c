@@ -21,6 +21,7 @@
 
 #include <check.h>
 
+#include <pulse/xmalloc.h>
 #include <pulsecore/cpu-x86.h>
 #include <pulsecore/cpu.h>
 #include <pulsecore/random.h>
@@ -305,6 +306,81 @@ static void remap_init2_test_channels(
     remap_test_channels(&remap_func, &remap_orig);
 }
 
+/* Sets up a matrix with a mix of muted, attenuated and full scale
+ * coefficients, like the ones the resampler builds for surround layouts */
+static void setup_remap_matrix(
+    pa_remap_t *m,
+    pa_sample_format_t f,
+    unsigned in_channels,
+    unsigned out_channels) {
+
+    unsigned i, o;
+
+    m->format = f;
+    m->i_ss.channels = in_channels;
+    m->o_ss.channels = out_channels;
+
+    for (o = 0; o < out_channels; o++) {
+        for (i = 0; i < in_channels; i++) {
+            static const float coefs[] = { 0.0f, 1.0f, 0.5f, 0.0f, 0.7071f, 0.25f, 0.0f };
+
+            m->map_table_f[o][i] = coefs[(o * 3 + i * 2) % PA_ELEMENTSOF(coefs)] / PA_MAX(1u, in_channels / 3);
+            m->map_table_i[o][i] = (int32_t) (m->map_table_f[o][i] * 0x10000);
+        }
+    }
+}
+
+/* Compares init_func against the generic matrix code, with either the
+ * averaging matrix of setup_remap_channels() or a mixed one. orig_init_func
+ * must not handle the layout, so that the generic code is used. If fallback
+ * is set, init_func is expected to leave the layout to orig_init_func
+ * instead. */
+static void remap_init_matrix_test_channels(
+        pa_init_remap_func_t init_func,
+        pa_init_remap_func_t orig_init_func,
+        pa_sample_format_t f,
+        unsigned in_channels,
+        unsigned out_channels,
+        bool mixed,
+        bool fallback) {
+
+    pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
+    pa_init_remap_func_t installed_init_func = pa_get_init_remap_func();
+    pa_remap_t remap_orig = {0}, remap_func = {0};
+
+    if (mixed) {
+        setup_remap_matrix(&remap_orig, f, in_channels, out_channels);
+        setup_remap_matrix(&remap_func, f, in_channels, out_channels);
+    } else {
+        setup_remap_channels(&remap_orig, f, in_channels, out_channels, false);
+        setup_remap_channels(&remap_func, f, in_channels, out_channels, false);
+    }
+
+    cpu_info.force_generic_code = true;
+    pa_remap_func_init(&cpu_info);
+    pa_set_init_remap_func(orig_init_func);
+    pa_init_remap_func(&remap_orig);
+
+    cpu_info.force_generic_code = false;
+    pa_remap_func_init(&cpu_info);
+    pa_set_init_remap_func(init_func);
+    pa_init_remap_func(&remap_func);
+    pa_set_init_remap_func(installed_init_func);
+
+    fail_unless(remap_orig.do_remap != NULL);
+
+    if (fallback)
+        fail_unless(remap_func.do_remap == remap_orig.do_remap);
+    else {
+        fail_unless(remap_func.do_remap != NULL);
+        fail_unless(remap_func.do_remap != remap_orig.do_remap);
+        remap_test_channels(&remap_func, &remap_orig);
+    }
+
+    pa_xfree(remap_orig.state);
+    pa_xfree(remap_func.state);
+}
+
 START_TEST (remap_special_test) {
     pa_log_debug("Checking special remap (float, mono->stereo)");
     remap_init2_test_channels(PA_SAMPLE_FLOAT32NE, 1, 2, false);
@@ -403,6 +479,54 @@ START_TEST (remap_sse2_test) {
     remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 1, 2, false);
 }
 END_TEST
+
+START_TEST (remap_avx2_test) {
+    /* The averaging matrix of mono to 5.1 is a plain copy, which is left
+     * to the previous function. So are the matrix layouts with fewer
+     * than seven input channels that don't fit the permute variant, see
+     * init_remap_avx2(). */
+    static const struct {
+        unsigned in_channels, out_channels;
+        bool fallback_averaging, fallback_mixed;
+    } layouts[] = {
+        { 4, 2, false, false }, { 6, 2, false, false }, { 8, 2, false, false },
+        { 8, 6, false, false }, { 2, 6, false, false }, { 2, 8, false, false },
+        { 6, 8, false, false }, { 7, 5, false, false }, { 3, 8, false, false },
+        { 1, 6, true, false },
+        { 3, 2, true, true }, { 5, 3, true, true }, { 6, 1, true, true },
+    };
+    static const pa_sample_format_t formats[] = { PA_SAMPLE_FLOAT32NE, PA_SAMPLE_S16NE };
+    pa_cpu_x86_flag_t flags = 0;
+    pa_init_remap_func_t init_func, orig_init_func;
+    unsigned i, j;
+
+    pa_cpu_get_x86_flags(&flags);
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    orig_init_func = pa_get_init_remap_func();
+    pa_remap_func_init_avx(flags);
+    init_func = pa_get_init_remap_func();
+
+    for (i = 0; i < PA_ELEMENTSOF(layouts); i++) {
+        for (j = 0; j < PA_ELEMENTSOF(formats); j++) {
+            pa_log_debug("Checking AVX2 remap (%s, %u-channel->%u-channel)", pa_sample_format_to_string(formats[j]),
+                layouts[i].in_channels, layouts[i].out_channels);
+            remap_init_matrix_test_channels(init_func, orig_init_func, formats[j],
+                layouts[i].in_channels, layouts[i].out_channels, false, layouts[i].fallback_averaging);
+
+            pa_log_debug("Checking AVX2 remap (%s, %u-channel->%u-channel, mixed matrix)", pa_sample_format_to_string(formats[j]),
+                layouts[i].in_channels, layouts[i].out_channels);
+            remap_init_matrix_test_channels(init_func, orig_init_func, formats[j],
+                layouts[i].in_channels, layouts[i].out_channels, true, layouts[i].fallback_mixed);
+        }
+    }
+
+    pa_set_init_remap_func(orig_init_func);
+}
+END_TEST
 #endif /* defined (__i386__) || defined (__amd64__) */
 
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
@@ -513,6 +637,7 @@ int main(int argc, char *argv[]) {
 #if defined (__i386__) || defined (__amd64__)
     tcase_add_test(tc, remap_mmx_test);
     tcase_add_test(tc, remap_sse2_test);
+    tcase_add_test(tc, remap_avx2_test);
 #endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, remap_neon_test);
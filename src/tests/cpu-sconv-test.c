@@ -20,11 +20,14 @@
 #endif
 
 #include <check.h>
+#include <string.h>
 
+#include <pulse/xmalloc.h>
 #include <pulsecore/cpu-arm.h>
 #include <pulsecore/cpu-x86.h>
 #include <pulsecore/random.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
 #include <pulsecore/sconv.h>
 
 #include "runtime-test-util.h"
@@ -135,6 +138,80 @@ static void run_conv_test_s16_to_float(
 #endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
 
 #if defined (__i386__) || defined (__amd64__)
+/* Converts nsamples samples of in_format with func and orig_func and checks
+ * that the results are bit-exact. Float input covers a little more than the
+ * full scale, so that clipping gets exercised. The buffers are misaligned by
+ * align samples, which also varies the sample count to cover the tail
+ * handling. */
+static void run_conv_format_test(
+        pa_convert_func_t func,
+        pa_convert_func_t orig_func,
+        pa_sample_format_t in_format,
+        pa_sample_format_t out_format,
+        int align,
+        bool correct,
+        bool perf) {
+
+    size_t in_ss, out_ss, nsamples;
+    uint8_t *in, *out, *out_ref;
+    size_t i;
+
+    /* Nothing to compare if no optimized function was installed */
+    if (func == orig_func)
+        return;
+
+    in_ss = pa_sample_size_of_format(in_format);
+    out_ss = pa_sample_size_of_format(out_format);
+    nsamples = SAMPLES - align;
+
+    in = pa_xmalloc((SAMPLES + 8) * in_ss);
+    out = pa_xmalloc0((SAMPLES + 8) * out_ss);
+    out_ref = pa_xmalloc0((SAMPLES + 8) * out_ss);
+
+    if (in_format == PA_SAMPLE_FLOAT32NE || in_format == PA_SAMPLE_FLOAT32RE) {
+        for (i = 0; i < nsamples; i++) {
+            float f = 2.1f * (rand()/(float) RAND_MAX - 0.5f);
+
+            if (in_format == PA_SAMPLE_FLOAT32RE)
+                PA_WRITE_FLOAT32RE(in + (align + i) * in_ss, f);
+            else
+                memcpy(in + (align + i) * in_ss, &f, sizeof(float));
+        }
+    } else
+        pa_random(in + align * in_ss, nsamples * in_ss);
+
+    if (correct) {
+        orig_func(nsamples, in + align * in_ss, out_ref + align * out_ss);
+        func(nsamples, in + align * in_ss, out + align * out_ss);
+
+        for (i = 0; i < (SAMPLES + 8) * out_ss; i++) {
+            if (out[i] != out_ref[i]) {
+                pa_log_debug("Correctness test failed: %s -> %s, align=%d",
+                    pa_sample_format_to_string(in_format), pa_sample_format_to_string(out_format), align);
+                pa_log_debug("byte %zu: %02x != %02x", i, out[i], out_ref[i]);
+                ck_abort();
+            }
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing %s -> %s conversion performance, %zu samples",
+            pa_sample_format_to_string(in_format), pa_sample_format_to_string(out_format), nsamples);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            func(nsamples, in + align * in_ss, out + align * out_ss);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            orig_func(nsamples, in + align * in_ss, out_ref + align * out_ss);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+
+    pa_xfree(in);
+    pa_xfree(out);
+    pa_xfree(out_ref);
+}
+
 START_TEST (sconv_sse2_test) {
     pa_cpu_x86_flag_t flags = 0;
     pa_convert_func_t orig_func, sse2_func;
@@ -188,6 +265,73 @@ START_TEST (sconv_sse_test) {
     run_conv_test_float_to_s16(sse_func, orig_func, 7, true, true);
 }
 END_TEST
+
+static const pa_sample_format_t avx_formats[] = {
+    PA_SAMPLE_U8,
+    PA_SAMPLE_S16LE,
+    PA_SAMPLE_S16BE,
+    PA_SAMPLE_S32LE,
+    PA_SAMPLE_S32BE,
+    PA_SAMPLE_S24LE,
+    PA_SAMPLE_S24BE,
+    PA_SAMPLE_S24_32LE,
+    PA_SAMPLE_S24_32BE,
+    PA_SAMPLE_FLOAT32LE,
+    PA_SAMPLE_FLOAT32BE,
+};
+
+#define N_AVX_FORMATS PA_ELEMENTSOF(avx_formats)
+
+START_TEST (sconv_avx2_test) {
+    pa_convert_func_t orig_to_float[N_AVX_FORMATS], orig_from_float[N_AVX_FORMATS];
+    pa_convert_func_t orig_to_s16[N_AVX_FORMATS], orig_from_s16[N_AVX_FORMATS];
+    pa_cpu_x86_flag_t flags = 0;
+    unsigned i;
+    int align;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    for (i = 0; i < N_AVX_FORMATS; i++) {
+        orig_to_float[i] = pa_get_convert_to_float32ne_function(avx_formats[i]);
+        orig_from_float[i] = pa_get_convert_from_float32ne_function(avx_formats[i]);
+        orig_to_s16[i] = pa_get_convert_to_s16ne_function(avx_formats[i]);
+        orig_from_s16[i] = pa_get_convert_from_s16ne_function(avx_formats[i]);
+    }
+
+    pa_convert_func_init_avx(PA_CPU_X86_AVX2);
+
+    pa_log_debug("Checking AVX2 sconv");
+    for (i = 0; i < N_AVX_FORMATS; i++) {
+        pa_sample_format_t f = avx_formats[i];
+
+        for (align = 0; align < 8; align++) {
+            bool perf = align == 7;
+
+            run_conv_format_test(pa_get_convert_to_float32ne_function(f), orig_to_float[i],
+                f, PA_SAMPLE_FLOAT32NE, align, true, perf);
+            run_conv_format_test(pa_get_convert_from_float32ne_function(f), orig_from_float[i],
+                PA_SAMPLE_FLOAT32NE, f, align, true, perf);
+            run_conv_format_test(pa_get_convert_to_s16ne_function(f), orig_to_s16[i],
+                f, PA_SAMPLE_S16NE, align, true, perf);
+            run_conv_format_test(pa_get_convert_from_s16ne_function(f), orig_from_s16[i],
+                PA_SAMPLE_S16NE, f, align, true, perf);
+        }
+    }
+
+    /* Restore the previous functions */
+    for (i = 0; i < N_AVX_FORMATS; i++) {
+        pa_set_convert_to_float32ne_function(avx_formats[i], orig_to_float[i]);
+        pa_set_convert_from_float32ne_function(avx_formats[i], orig_from_float[i]);
+        pa_set_convert_to_s16ne_function(avx_formats[i], orig_to_s16[i]);
+        pa_set_convert_from_s16ne_function(avx_formats[i], orig_from_s16[i]);
+    }
+}
+END_TEST
 #endif /* defined (__i386__) || defined (__amd64__) */
 
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
@@ -247,6 +391,7 @@ int main(int argc, char *argv[]) {
 #if defined (__i386__) || defined (__amd64__)
     tcase_add_test(tc, sconv_sse2_test);
     tcase_add_test(tc, sconv_sse_test);
+    tcase_add_test(tc, sconv_avx2_test);
 #endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, sconv_neon_test);
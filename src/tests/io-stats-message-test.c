@@ -0,0 +1,165 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Queries the IO thread statistics of a null sink through the
+ * "get-io-stats" and "reset-io-stats" messages. The null sink renders a
+ * whole block of its maximum latency as soon as it is loaded and then sleeps
+ * until that has been played, so right after a reset nothing was mixed. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+
+#include <pulse/pulseaudio.h>
+
+#define SINK_NAME "io_stats_test"
+#define OBJECT_PATH "/sink/" SINK_NAME
+
+static pa_mainloop_api *mainloop_api = NULL;
+static pa_context *context = NULL;
+static uint32_t module_index = PA_INVALID_INDEX;
+static const char *bname = NULL;
+
+static unsigned long long loops_before = 0, mix_before = 0;
+static bool done = false;
+
+static void parse_stats(const char *response, unsigned long long *loops, unsigned long long *mix) {
+    const char *p;
+
+    fail_unless(response != NULL);
+
+    fail_unless(sscanf(response, "loops: %llu", loops) == 1);
+    fail_unless((p = strstr(response, "mix: calls: ")) != NULL);
+    fail_unless(sscanf(p, "mix: calls: %llu", mix) == 1);
+}
+
+static void unload_module_cb(pa_context *c, int success, void *userdata) {
+    fail_unless(success);
+
+    mainloop_api->quit(mainloop_api, 0);
+}
+
+static void get_after_reset_cb(pa_context *c, int success, char *response, void *userdata) {
+    unsigned long long loops, mix;
+
+    fail_unless(success);
+    parse_stats(response, &loops, &mix);
+
+    fprintf(stderr, "After reset: %llu loops, %llu mix calls\n", loops, mix);
+
+    fail_unless(mix < mix_before);
+
+    done = true;
+
+    pa_operation_unref(pa_context_unload_module(c, module_index, unload_module_cb, NULL));
+}
+
+static void reset_cb(pa_context *c, int success, char *response, void *userdata) {
+    fail_unless(success);
+
+    pa_operation_unref(pa_context_send_message_to_object(c, OBJECT_PATH, "get-io-stats", NULL, get_after_reset_cb, NULL));
+}
+
+static void get_before_reset_cb(pa_context *c, int success, char *response, void *userdata) {
+    fail_unless(success);
+    parse_stats(response, &loops_before, &mix_before);
+
+    fprintf(stderr, "Before reset: %llu loops, %llu mix calls\n", loops_before, mix_before);
+
+    fail_unless(mix_before > 0);
+
+    pa_operation_unref(pa_context_send_message_to_object(c, OBJECT_PATH, "reset-io-stats", NULL, reset_cb, NULL));
+}
+
+static void load_module_cb(pa_context *c, uint32_t idx, void *userdata) {
+    fail_unless(idx != PA_INVALID_INDEX);
+    module_index = idx;
+
+    pa_operation_unref(pa_context_send_message_to_object(c, OBJECT_PATH, "get-io-stats", NULL, get_before_reset_cb, NULL));
+}
+
+static void context_state_cb(pa_context *c, void *userdata) {
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_CONNECTING:
+        case PA_CONTEXT_AUTHORIZING:
+        case PA_CONTEXT_SETTING_NAME:
+            break;
+
+        case PA_CONTEXT_READY:
+            pa_operation_unref(pa_context_load_module(c, "module-null-sink", "sink_name=" SINK_NAME, load_module_cb, NULL));
+            break;
+
+        case PA_CONTEXT_TERMINATED:
+            mainloop_api->quit(mainloop_api, 0);
+            break;
+
+        case PA_CONTEXT_FAILED:
+        default:
+            fprintf(stderr, "Context error: %s\n", pa_strerror(pa_context_errno(c)));
+            ck_abort();
+    }
+}
+
+START_TEST (io_stats_message_test) {
+    pa_mainloop *m;
+    int ret = 1;
+
+    fail_unless((m = pa_mainloop_new()) != NULL);
+    mainloop_api = pa_mainloop_get_api(m);
+
+    fail_unless((context = pa_context_new(mainloop_api, bname)) != NULL);
+    pa_context_set_state_callback(context, context_state_cb, NULL);
+    fail_unless(pa_context_connect(context, NULL, 0, NULL) == 0);
+
+    fail_unless(pa_mainloop_run(m, &ret) >= 0);
+    fail_unless(ret == 0);
+    fail_unless(done);
+
+    pa_context_disconnect(context);
+    pa_context_unref(context);
+    pa_mainloop_free(m);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    bname = argv[0];
+
+    s = suite_create("IO Stats Message");
+    tc = tcase_create("iostatsmessage");
+    tcase_add_test(tc, io_stats_message_test);
+    tcase_set_timeout(tc, 10);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,158 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <check.h>
+
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/io-stats.h>
+
+START_TEST (lateness_test) {
+    pa_io_stats s;
+    unsigned i;
+
+    pa_io_stats_reset(&s);
+
+    /* The bounds are exclusive upper limits */
+    pa_io_stats_add_lateness(&s, 0);
+    pa_io_stats_add_lateness(&s, 9);
+    pa_io_stats_add_lateness(&s, 10);
+    pa_io_stats_add_lateness(&s, 999);
+    pa_io_stats_add_lateness(&s, 1000);
+    pa_io_stats_add_lateness(&s, 19999);
+    pa_io_stats_add_lateness(&s, 20000);
+    pa_io_stats_add_lateness(&s, 5 * PA_USEC_PER_SEC);
+
+    ck_assert_int_eq(s.lateness[0], 2);
+    ck_assert_int_eq(s.lateness[1], 1);
+    ck_assert_int_eq(s.lateness[6], 1);
+    ck_assert_int_eq(s.lateness[7], 1);
+    ck_assert_int_eq(s.lateness[PA_IO_STATS_LATENESS_BUCKETS - 2], 1);
+    ck_assert_int_eq(s.lateness[PA_IO_STATS_LATENESS_BUCKETS - 1], 2);
+
+    for (i = 2; i < 6; i++)
+        ck_assert_int_eq(s.lateness[i], 0);
+
+    ck_assert_int_eq(s.timer_wakeups, 8);
+    ck_assert_int_eq(s.lateness_max, 5 * PA_USEC_PER_SEC);
+
+    pa_io_stats_reset(&s);
+
+    ck_assert_int_eq(s.timer_wakeups, 0);
+    ck_assert_int_eq(s.lateness[0], 0);
+    ck_assert_int_eq(s.lateness_max, 0);
+}
+END_TEST
+
+START_TEST (merge_test) {
+    pa_io_stats stages, thread, merged;
+
+    pa_io_stats_reset(&stages);
+    pa_io_stats_reset(&thread);
+
+    pa_io_stats_add(&stages, PA_IO_STAGE_MIX, 30);
+    pa_io_stats_add(&stages, PA_IO_STAGE_MIX, 10);
+    pa_io_stats_add(&stages, PA_IO_STAGE_RESAMPLE, 5);
+    stages.loops = 1000;
+
+    pa_io_stats_add(&thread, PA_IO_STAGE_DEVICE, 1000);
+    pa_io_stats_add_lateness(&thread, 50);
+    thread.loops = 7;
+    thread.busy = 200;
+    thread.idle = 800;
+    thread.busy_max = 60;
+
+    pa_io_stats_merge(&merged, &stages, &thread);
+
+    /* Stage counters come from the device, everything else from the thread */
+    ck_assert_int_eq(merged.stage[PA_IO_STAGE_MIX].count, 2);
+    ck_assert_int_eq(merged.stage[PA_IO_STAGE_MIX].total, 40);
+    ck_assert_int_eq(merged.stage[PA_IO_STAGE_MIX].max, 30);
+    ck_assert_int_eq(merged.stage[PA_IO_STAGE_RESAMPLE].count, 1);
+    ck_assert_int_eq(merged.stage[PA_IO_STAGE_DEVICE].count, 0);
+
+    ck_assert_int_eq(merged.loops, 7);
+    ck_assert_int_eq(merged.busy, 200);
+    ck_assert_int_eq(merged.idle, 800);
+    ck_assert_int_eq(merged.busy_max, 60);
+    ck_assert_int_eq(merged.timer_wakeups, 1);
+    ck_assert_int_eq(merged.lateness[3], 1);
+    ck_assert_int_eq(merged.lateness_max, 50);
+}
+END_TEST
+
+START_TEST (to_string_test) {
+    pa_io_stats s;
+    char *t;
+
+    /* Nothing accounted yet must not divide by zero */
+    pa_io_stats_reset(&s);
+    t = pa_io_stats_to_string(&s);
+    ck_assert_ptr_ne(strstr(t, "loops: 0, busy: 0 usec (0.0%), idle: 0 usec\n"), NULL);
+    ck_assert_ptr_ne(strstr(t, "busy per loop: avg: 0 usec, max: 0 usec\n"), NULL);
+    ck_assert_ptr_ne(strstr(t, "mix: calls: 0, total: 0 usec, avg: 0 usec, max: 0 usec\n"), NULL);
+    pa_xfree(t);
+
+    s.loops = 4;
+    s.busy = 300;
+    s.idle = 100;
+    s.busy_max = 120;
+    pa_io_stats_add(&s, PA_IO_STAGE_MIX, 20);
+    pa_io_stats_add(&s, PA_IO_STAGE_MIX, 10);
+    pa_io_stats_add_lateness(&s, 5);
+    pa_io_stats_add_lateness(&s, PA_USEC_PER_SEC);
+
+    t = pa_io_stats_to_string(&s);
+    ck_assert_ptr_ne(strstr(t, "loops: 4, busy: 300 usec (75.0%), idle: 100 usec\n"), NULL);
+    ck_assert_ptr_ne(strstr(t, "busy per loop: avg: 75 usec, max: 120 usec\n"), NULL);
+    ck_assert_ptr_ne(strstr(t, "device: calls: 0, total: 0 usec, avg: 0 usec, max: 0 usec\n"), NULL);
+    ck_assert_ptr_ne(strstr(t, "mix: calls: 2, total: 30 usec, avg: 15 usec, max: 20 usec\n"), NULL);
+    ck_assert_ptr_ne(strstr(t, "timer wakeups: 2, max lateness: 1000000 usec\n"), NULL);
+    ck_assert_ptr_ne(strstr(t, "lateness < 10 usec: 1\n"), NULL);
+    ck_assert_ptr_ne(strstr(t, "lateness < 20 usec: 0\n"), NULL);
+    ck_assert_ptr_ne(strstr(t, "lateness >= 20000 usec: 1\n"), NULL);
+    pa_xfree(t);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("IO Stats");
+    tc = tcase_create("iostats");
+    tcase_add_test(tc, lateness_test);
+    tcase_add_test(tc, merge_test);
+    tcase_add_test(tc, to_string_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
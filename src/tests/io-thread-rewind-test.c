@@ -0,0 +1,260 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Checks that stream data the sink's IO thread reads from the srbchannel
+ * (srbchannel-io-thread=1) takes effect right away. Data written while the
+ * stream is in underrun needs a rewind of the sink; the null sink would
+ * otherwise not get to it before its next timer wakeup, which is up to its
+ * full latency away. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <check.h>
+
+#include <pulse/pulseaudio.h>
+#include <pulse/rtclock.h>
+
+#define SAMPLE_HZ 44100
+#define CHUNK_USEC (100 * PA_USEC_PER_MSEC)
+#define TLENGTH_USEC (2 * PA_USEC_PER_SEC)
+/* After a rewind the null sink still plays what it rendered beyond the
+ * rewound part, which is less than a mempool block. Without the rewind new
+ * data waits for most of the sink latency, which is close to TLENGTH_USEC. */
+#define MAX_START_USEC PA_USEC_PER_SEC
+
+static const pa_sample_spec sample_spec = {
+    .format = PA_SAMPLE_S16LE,
+    .rate = SAMPLE_HZ,
+    .channels = 2
+};
+
+static pa_mainloop_api *mainloop_api = NULL;
+static pa_context *context = NULL;
+static pa_context *io_context = NULL;
+static pa_stream *stream = NULL;
+static uint32_t module_index = PA_INVALID_INDEX;
+static char socket_path[256];
+static const char *bname = NULL;
+
+static void *chunk = NULL;
+static size_t chunk_size = 0;
+
+/* 1: the first chunk was written, 2: the second one, 3: done */
+static int phase = 0;
+static pa_usec_t written_at = 0;
+static bool started = false;
+
+static void unload_module_cb(pa_context *c, int success, void *userdata) {
+    fail_unless(success);
+
+    mainloop_api->quit(mainloop_api, 0);
+}
+
+static void finish(void) {
+    phase = 3;
+
+    pa_stream_disconnect(stream);
+    pa_stream_unref(stream);
+    stream = NULL;
+
+    pa_context_disconnect(io_context);
+    pa_context_unref(io_context);
+    io_context = NULL;
+
+    pa_operation_unref(pa_context_unload_module(context, module_index, unload_module_cb, NULL));
+}
+
+static void write_chunk(pa_stream *s, int64_t offset, pa_seek_mode_t seek) {
+    written_at = pa_rtclock_now();
+    started = false;
+    phase++;
+
+    fail_unless(pa_stream_write(s, chunk, chunk_size, NULL, offset, seek) == 0);
+}
+
+static void started_cb(pa_stream *s, void *userdata) {
+    pa_usec_t delay = pa_rtclock_now() - written_at;
+
+    fprintf(stderr, "Chunk %i started playing after %llu usec\n", phase, (unsigned long long) delay);
+    fail_unless(delay < MAX_START_USEC);
+
+    started = true;
+
+    if (phase == 2)
+        finish();
+}
+
+static void underflow_cb(pa_stream *s, void *userdata) {
+    /* Only the underrun after the first chunk is interesting. The null
+     * sink renders ahead, so this may come right after it started. */
+    if (phase != 1 || !started)
+        return;
+
+    /* The sink has rendered silence far ahead by now. Write with a seek,
+     * so that the data goes through SINK_INPUT_MESSAGE_SEEK in the IO
+     * thread. */
+    write_chunk(s, 0, PA_SEEK_RELATIVE_ON_READ);
+}
+
+static void stream_state_cb(pa_stream *s, void *userdata) {
+    switch (pa_stream_get_state(s)) {
+        case PA_STREAM_UNCONNECTED:
+        case PA_STREAM_CREATING:
+        case PA_STREAM_TERMINATED:
+            break;
+
+        case PA_STREAM_READY:
+            write_chunk(s, 0, PA_SEEK_RELATIVE);
+            break;
+
+        default:
+        case PA_STREAM_FAILED:
+            fprintf(stderr, "Stream error: %s\n", pa_strerror(pa_context_errno(pa_stream_get_context(s))));
+            ck_abort();
+    }
+}
+
+static void io_context_state_cb(pa_context *c, void *userdata) {
+    pa_buffer_attr attr;
+
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_CONNECTING:
+        case PA_CONTEXT_AUTHORIZING:
+        case PA_CONTEXT_SETTING_NAME:
+        case PA_CONTEXT_TERMINATED:
+            break;
+
+        case PA_CONTEXT_READY:
+            attr.maxlength = (uint32_t) -1;
+            attr.tlength = (uint32_t) pa_usec_to_bytes(TLENGTH_USEC, &sample_spec);
+            attr.prebuf = (uint32_t) chunk_size;
+            attr.minreq = (uint32_t) -1;
+            attr.fragsize = (uint32_t) -1;
+
+            fail_unless((stream = pa_stream_new(c, "io thread rewind", &sample_spec, NULL)) != NULL);
+            pa_stream_set_state_callback(stream, stream_state_cb, NULL);
+            pa_stream_set_started_callback(stream, started_cb, NULL);
+            pa_stream_set_underflow_callback(stream, underflow_cb, NULL);
+            fail_unless(pa_stream_connect_playback(stream, NULL, &attr, 0, NULL, NULL) == 0);
+            break;
+
+        case PA_CONTEXT_FAILED:
+        default:
+            fprintf(stderr, "Context error: %s\n", pa_strerror(pa_context_errno(c)));
+            ck_abort();
+    }
+}
+
+static void load_module_cb(pa_context *c, uint32_t idx, void *userdata) {
+    char server[sizeof(socket_path) + 5];
+
+    fail_unless(idx != PA_INVALID_INDEX);
+    module_index = idx;
+
+    snprintf(server, sizeof(server), "unix:%s", socket_path);
+
+    fail_unless((io_context = pa_context_new(mainloop_api, bname)) != NULL);
+    pa_context_set_state_callback(io_context, io_context_state_cb, NULL);
+    fail_unless(pa_context_connect(io_context, server, PA_CONTEXT_NOAUTOSPAWN, NULL) == 0);
+}
+
+static void context_state_cb(pa_context *c, void *userdata) {
+    char args[sizeof(socket_path) + 64];
+
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_CONNECTING:
+        case PA_CONTEXT_AUTHORIZING:
+        case PA_CONTEXT_SETTING_NAME:
+            break;
+
+        case PA_CONTEXT_READY:
+            /* A private protocol instance that reads stream data in the
+             * sink's IO thread */
+            snprintf(args, sizeof(args), "socket=%s srbchannel-io-thread=1 auth-anonymous=1", socket_path);
+            pa_operation_unref(pa_context_load_module(c, "module-native-protocol-unix", args, load_module_cb, NULL));
+            break;
+
+        case PA_CONTEXT_TERMINATED:
+            mainloop_api->quit(mainloop_api, 0);
+            break;
+
+        case PA_CONTEXT_FAILED:
+        default:
+            fprintf(stderr, "Context error: %s\n", pa_strerror(pa_context_errno(c)));
+            ck_abort();
+    }
+}
+
+START_TEST (io_thread_rewind_test) {
+    pa_mainloop *m;
+    const char *dir;
+    int ret = 1;
+
+    if (!(dir = getenv("PULSE_RUNTIME_PATH")))
+        dir = "/tmp";
+
+    snprintf(socket_path, sizeof(socket_path), "%s/io-thread-rewind-test-%lu", dir, (unsigned long) getpid());
+
+    chunk_size = pa_usec_to_bytes(CHUNK_USEC, &sample_spec);
+    chunk = pa_xmalloc0(chunk_size);
+
+    fail_unless((m = pa_mainloop_new()) != NULL);
+    mainloop_api = pa_mainloop_get_api(m);
+
+    fail_unless((context = pa_context_new(mainloop_api, bname)) != NULL);
+    pa_context_set_state_callback(context, context_state_cb, NULL);
+    fail_unless(pa_context_connect(context, NULL, 0, NULL) == 0);
+
+    fail_unless(pa_mainloop_run(m, &ret) >= 0);
+    fail_unless(ret == 0);
+    fail_unless(phase == 3);
+
+    pa_context_disconnect(context);
+    pa_context_unref(context);
+    pa_mainloop_free(m);
+    pa_xfree(chunk);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    bname = argv[0];
+
+    s = suite_create("IO Thread Rewind");
+    tc = tcase_create("iothreadrewind");
+    tcase_add_test(tc, io_thread_rewind_test);
+    tcase_set_timeout(tc, 10);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -52,6 +52,9 @@ static void print_stats(pa_mempool *p, const char *text) {
                  "\texported_size = %u\n"
                  "\tn_too_large_for_pool = %u\n"
                  "\tn_pool_full = %u\n"
+                 "\tn_slot_cache_hits = %u\n"
+                 "\tn_slot_cache_misses = %u\n"
+                 "\tn_pool_fallbacks = %u\n"
                  "}",
            text,
            (unsigned) pa_atomic_load(&s->n_allocated),
@@ -63,7 +66,10 @@ static void print_stats(pa_mempool *p, const char *text) {
            (unsigned) pa_atomic_load(&s->imported_size),
            (unsigned) pa_atomic_load(&s->exported_size),
            (unsigned) pa_atomic_load(&s->n_too_large_for_pool),
-           (unsigned) pa_atomic_load(&s->n_pool_full));
+           (unsigned) pa_atomic_load(&s->n_pool_full),
+           (unsigned) pa_atomic_load(&s->n_slot_cache_hits),
+           (unsigned) pa_atomic_load(&s->n_slot_cache_misses),
+           (unsigned) pa_atomic_load(&s->n_pool_fallbacks));
 }
 
 START_TEST (memblock_test) {
@@ -176,6 +182,112 @@ START_TEST (memblock_test) {
 }
 END_TEST
 
+START_TEST (memblock_slot_class_test) {
+    pa_mempool *pool_a, *pool_b, *fallback_pool;
+    pa_memexport *export_a;
+    pa_memimport *import_b;
+    pa_memblock *blocks[256], *mb, *fallback;
+    const pa_mempool_stat *stat;
+    unsigned n, i, hits;
+    pa_mem_type_t mem_type;
+    uint32_t id, shm_id;
+    size_t offset, size;
+    uint8_t *x;
+
+    /* 16 full size slots */
+    pool_a = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 16 * 64 * 1024, true);
+    fail_unless(pool_a != NULL);
+    pool_b = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    fail_unless(pool_b != NULL);
+
+    stat = pa_mempool_get_stat(pool_a);
+
+    /* Small blocks are packed into split slots, so many more than 16
+     * of them fit */
+    for (n = 0; n < PA_ELEMENTSOF(blocks); n++) {
+        if (!(blocks[n] = pa_memblock_new_pool(pool_a, 1000)))
+            break;
+
+        x = pa_memblock_acquire(blocks[n]);
+        memset(x, (int) n, 1000);
+        pa_memblock_release(blocks[n]);
+    }
+
+    pa_log_debug("%u small blocks fit into the pool", n);
+    fail_unless(n > 16);
+    fail_unless(n < PA_ELEMENTSOF(blocks));
+
+    /* No two blocks may overlap */
+    for (i = 0; i < n; i++) {
+        x = pa_memblock_acquire(blocks[i]);
+        fail_unless(x[0] == (uint8_t) i && x[999] == (uint8_t) i);
+        pa_memblock_release(blocks[i]);
+    }
+
+    /* The pool is exhausted now */
+    fallback = pa_memblock_new(pool_a, 1000);
+    fallback_pool = pa_memblock_get_pool(fallback);
+    fail_unless(fallback_pool == pool_a);
+    pa_mempool_unref(fallback_pool);
+    fail_unless(pa_atomic_load(&stat->n_pool_fallbacks) == 1);
+    pa_memblock_unref(fallback);
+
+    /* Blocks in split slots are exported like any other */
+    export_a = pa_memexport_new(pool_a, revoke_cb, (void*) "A");
+    fail_unless(export_a != NULL);
+    import_b = pa_memimport_new(pool_b, release_cb, (void*) "B");
+    fail_unless(import_b != NULL);
+
+    fail_unless(pa_memexport_put(export_a, blocks[n - 1], &mem_type, &id, &shm_id, &offset, &size) >= 0);
+    fail_unless(size == 1000);
+
+    mb = pa_memimport_get(import_b, mem_type, id, shm_id, offset, size, false);
+    fail_unless(mb != NULL);
+    x = pa_memblock_acquire(mb);
+    fail_unless(x[0] == (uint8_t) (n - 1) && x[999] == (uint8_t) (n - 1));
+    pa_memblock_release(mb);
+    pa_memblock_unref(mb);
+
+    pa_memimport_free(import_b);
+    pa_memexport_free(export_a);
+
+    for (i = 0; i < n; i++)
+        pa_memblock_unref(blocks[i]);
+
+    /* Freed slots go to this thread's cache first and are handed out
+     * from there again */
+    hits = (unsigned) pa_atomic_load(&stat->n_slot_cache_hits);
+    for (i = 0; i < 4; i++)
+        blocks[i] = pa_memblock_new_pool(pool_a, 1000);
+    fail_unless((unsigned) pa_atomic_load(&stat->n_slot_cache_hits) >= hits + 4);
+
+    for (i = 0; i < 4; i++)
+        pa_memblock_unref(blocks[i]);
+
+    print_stats(pool_a, "A");
+
+    pa_mempool_vacuum(pool_a);
+
+    /* All slots are reachable again after vacuuming */
+    for (i = 0; i < n; i++)
+        fail_unless((blocks[i] = pa_memblock_new_pool(pool_a, 1000)) != NULL);
+    for (i = 0; i < n; i++)
+        pa_memblock_unref(blocks[i]);
+
+    /* Vacuuming merges the split slots again */
+    pa_mempool_vacuum(pool_a);
+
+    for (i = 0; i < 16; i++)
+        fail_unless((blocks[i] = pa_memblock_new_pool(pool_a, pa_mempool_block_size_max(pool_a))) != NULL);
+    fail_unless(pa_memblock_new_pool(pool_a, pa_mempool_block_size_max(pool_a)) == NULL);
+    for (i = 0; i < 16; i++)
+        pa_memblock_unref(blocks[i]);
+
+    pa_mempool_unref(pool_a);
+    pa_mempool_unref(pool_b);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -188,6 +300,7 @@ int main(int argc, char *argv[]) {
     s = suite_create("Memblock");
     tc = tcase_create("memblock");
     tcase_add_test(tc, memblock_test);
+    tcase_add_test(tc, memblock_slot_class_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
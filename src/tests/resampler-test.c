@@ -22,8 +22,10 @@
 #include <stdio.h>
 #include <getopt.h>
 #include <locale.h>
+#include <math.h>
 
 #include <pulse/pulseaudio.h>
+#include <pulse/xmalloc.h>
 
 #include <pulse/rtclock.h>
 #include <pulse/sample.h>
@@ -37,6 +39,7 @@
 #include <pulsecore/memblock.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/cpu.h>
 
 static void dump_block(const char *label, const pa_sample_spec *ss, const pa_memchunk *chunk) {
     void *d;
@@ -251,6 +254,262 @@ static pa_memblock* generate_block(pa_mempool *pool, const pa_sample_spec *ss) {
     return r;
 }
 
+/* Resamples a sine of the given frequency and returns the RMS of what is not
+ * the sine in the output, relative to the input RMS. Tones above the lower
+ * Nyquist frequency should vanish entirely, so the whole output counts.
+ * If gain is not NULL, it is set to the amplitude of the sine found in the
+ * output relative to the input. */
+static double measure_tone(pa_mempool *pool, const pa_sample_spec *a, const pa_sample_spec *b,
+                           pa_resample_method_t method, double freq, double *gain) {
+    const unsigned chunk_frames = 4096;
+    const unsigned in_frames = a->rate * 2, skip_frames = b->rate / 10;
+    pa_resampler *resampler;
+    double *out, in_rms = 0, cc = 0, cs = 0, ss = 0, yc = 0, ys = 0, err = 0, det, ac = 0, as = 0;
+    unsigned n_out = 0, done, i;
+
+    pa_assert(a->format == PA_SAMPLE_FLOAT32NE && a->channels == 1);
+
+    pa_assert_se(resampler = pa_resampler_new(pool, a, NULL, b, NULL, 0, method, 0));
+    out = pa_xnew(double, (uint64_t) in_frames * b->rate / a->rate + chunk_frames);
+
+    for (done = 0; done < in_frames; done += chunk_frames) {
+        pa_memchunk i_chunk, o_chunk;
+        float *d;
+
+        i_chunk.memblock = pa_memblock_new(pool, chunk_frames * sizeof(float));
+        i_chunk.index = 0;
+        i_chunk.length = chunk_frames * sizeof(float);
+
+        d = pa_memblock_acquire(i_chunk.memblock);
+        for (i = 0; i < chunk_frames; i++) {
+            d[i] = (float) (0.5 * sin(2.0 * M_PI * freq * (done + i) / a->rate));
+            in_rms += (double) d[i] * d[i];
+        }
+        pa_memblock_release(i_chunk.memblock);
+
+        pa_resampler_run(resampler, &i_chunk, &o_chunk);
+        pa_memblock_unref(i_chunk.memblock);
+
+        if (o_chunk.memblock) {
+            d = pa_memblock_acquire_chunk(&o_chunk);
+            for (i = 0; i < o_chunk.length / sizeof(float); i++)
+                out[n_out++] = d[i];
+            pa_memblock_release(o_chunk.memblock);
+            pa_memblock_unref(o_chunk.memblock);
+        }
+    }
+
+    pa_resampler_free(resampler);
+
+    in_rms = sqrt(in_rms / in_frames);
+
+    /* Least squares fit of a sine of unknown phase after the start-up
+     * transient, if the tone is expected in the output at all */
+    if (2 * freq < b->rate) {
+        for (i = skip_frames; i < n_out; i++) {
+            double c = cos(2.0 * M_PI * freq * i / b->rate), s = sin(2.0 * M_PI * freq * i / b->rate);
+
+            cc += c * c;
+            cs += c * s;
+            ss += s * s;
+            yc += out[i] * c;
+            ys += out[i] * s;
+        }
+
+        det = cc * ss - cs * cs;
+        ac = (yc * ss - ys * cs) / det;
+        as = (ys * cc - yc * cs) / det;
+    }
+
+    for (i = skip_frames; i < n_out; i++) {
+        double y = out[i] - ac * cos(2.0 * M_PI * freq * i / b->rate) - as * sin(2.0 * M_PI * freq * i / b->rate);
+
+        err += y * y;
+    }
+
+    pa_xfree(out);
+
+    if (gain)
+        *gain = sqrt(ac * ac + as * as) / 0.5;
+
+    return sqrt(err / (n_out - skip_frames)) / in_rms;
+}
+
+/* Sweeps tones over the input band. Tones in the passband of both rates
+ * measure aliasing and imaging, tones above the lower Nyquist frequency
+ * measure the stopband attenuation. */
+static void measure_stopband(pa_mempool *pool, uint32_t from_rate, uint32_t to_rate, pa_resample_method_t method) {
+    pa_sample_spec a, b;
+    double nyquist, pass_worst = 0, stop_worst = 0, freq;
+    unsigned k;
+
+    a.format = b.format = PA_SAMPLE_FLOAT32NE;
+    a.channels = b.channels = 1;
+    a.rate = from_rate;
+    b.rate = to_rate;
+
+    nyquist = PA_MIN(from_rate, to_rate) / 2.0;
+
+    for (k = 1; k < 80; k++) {
+        double e;
+
+        freq = from_rate / 2.0 * k / 80;
+
+        /* Skip the transition band */
+        if (freq > 0.8 * nyquist && freq < nyquist * 1.05)
+            continue;
+
+        e = measure_tone(pool, &a, &b, method, freq, NULL);
+        pa_log_debug("%8.1f Hz: %7.1f dB", freq, 20 * log10(e));
+
+        if (freq < nyquist)
+            pass_worst = PA_MAX(pass_worst, e);
+        else
+            stop_worst = PA_MAX(stop_worst, e);
+    }
+
+    printf("%s %u -> %u Hz: passband distortion %.1f dB", pa_resample_method_to_string(method), from_rate, to_rate,
+           20 * log10(pass_worst));
+    if (stop_worst > 0)
+        printf(", stopband attenuation %.1f dB", -20 * log10(stop_worst));
+    printf("\n");
+}
+
+/* Limits for check_polyphase(), with some margin to what the filter designs
+ * achieve. The distortion is relative to the input, in dB. */
+static const struct {
+    pa_resample_method_t method;
+    double max_passband_distortion;
+    double min_stopband_attenuation;
+} polyphase_limits[] = {
+    { PA_RESAMPLER_POLYPHASE_MQ, -75.0, 72.0 },
+    { PA_RESAMPLER_POLYPHASE_HQ, -100.0, 95.0 },
+    { PA_RESAMPLER_POLYPHASE_VHQ, -120.0, 115.0 },
+};
+
+/* Largest deviation from unity gain in the passband, in dB */
+#define POLYPHASE_MAX_GAIN_ERROR 0.01
+
+/* A few tones in the passband must come out as the same tone with unity gain
+ * and nothing else, and tones above the lower Nyquist frequency must not come
+ * out at all. The odd rates need interpolated filter tables. */
+static bool check_polyphase(pa_mempool *pool) {
+    static const uint32_t rates[][2] = {
+        { 44100, 48000 },
+        { 48000, 44100 },
+        { 44100, 48001 },
+        { 48001, 44100 },
+    };
+    /* Fractions of the lower Nyquist frequency, and of the band between it
+     * and the input Nyquist frequency when downsampling */
+    static const double pass_tones[] = { 0.02, 0.4, 0.75 };
+    static const double stop_tones[] = { 0.2, 0.9 };
+    bool ok = true;
+    unsigned m, r, k;
+
+    for (m = 0; m < PA_ELEMENTSOF(polyphase_limits); m++) {
+        pa_resample_method_t method = polyphase_limits[m].method;
+
+        if (!pa_resample_method_supported(method))
+            continue;
+
+        for (r = 0; r < PA_ELEMENTSOF(rates); r++) {
+            pa_sample_spec a, b;
+            double nyquist, e, gain;
+
+            a.format = b.format = PA_SAMPLE_FLOAT32NE;
+            a.channels = b.channels = 1;
+            a.rate = rates[r][0];
+            b.rate = rates[r][1];
+
+            nyquist = PA_MIN(a.rate, b.rate) / 2.0;
+
+            for (k = 0; k < PA_ELEMENTSOF(pass_tones); k++) {
+                e = 20 * log10(measure_tone(pool, &a, &b, method, pass_tones[k] * nyquist, &gain));
+
+                pa_log_debug("%s %u -> %u Hz, %.1f Hz: distortion %.1f dB, gain %.5f dB",
+                             pa_resample_method_to_string(method), a.rate, b.rate, pass_tones[k] * nyquist,
+                             e, 20 * log10(gain));
+
+                if (e > polyphase_limits[m].max_passband_distortion ||
+                    fabs(20 * log10(gain)) > POLYPHASE_MAX_GAIN_ERROR) {
+                    pa_log_error("%s %u -> %u Hz: %.1f Hz comes out with %.1f dB distortion and %.5f dB gain",
+                                 pa_resample_method_to_string(method), a.rate, b.rate, pass_tones[k] * nyquist,
+                                 e, 20 * log10(gain));
+                    ok = false;
+                }
+            }
+
+            if (b.rate >= a.rate)
+                continue;
+
+            for (k = 0; k < PA_ELEMENTSOF(stop_tones); k++) {
+                double freq = nyquist + stop_tones[k] * (a.rate / 2.0 - nyquist);
+
+                e = -20 * log10(measure_tone(pool, &a, &b, method, freq, NULL));
+
+                pa_log_debug("%s %u -> %u Hz, %.1f Hz: attenuation %.1f dB",
+                             pa_resample_method_to_string(method), a.rate, b.rate, freq, e);
+
+                if (e < polyphase_limits[m].min_stopband_attenuation) {
+                    pa_log_error("%s %u -> %u Hz: %.1f Hz is only attenuated by %.1f dB",
+                                 pa_resample_method_to_string(method), a.rate, b.rate, freq, e);
+                    ok = false;
+                }
+            }
+        }
+    }
+
+    return ok;
+}
+
+/* Creates the given number of streams and runs them in 10 ms chunks, as a
+ * sink would, and prints the time taken for both */
+static void measure_cpu_load(pa_mempool *pool, const pa_sample_spec *a, const pa_sample_spec *b,
+                             pa_resample_method_t method, unsigned n_streams, int seconds) {
+    pa_resampler **resamplers;
+    pa_memchunk i, j;
+    pa_usec_t ts, elapsed;
+    unsigned s, n_chunks, c;
+
+    resamplers = pa_xnew(pa_resampler *, n_streams);
+
+    ts = pa_rtclock_now();
+    for (s = 0; s < n_streams; s++)
+        pa_assert_se(resamplers[s] = pa_resampler_new(pool, a, NULL, b, NULL, 0, method, 0));
+    elapsed = pa_rtclock_now() - ts;
+
+    printf("%s: %u streams created in %llu usec\n",
+           pa_resample_method_to_string(resamplers[0]->method), n_streams, (unsigned long long) elapsed);
+
+    i.memblock = pa_memblock_new(pool, pa_usec_to_bytes(10 * PA_USEC_PER_MSEC, a));
+    i.length = pa_memblock_get_length(i.memblock);
+    i.index = 0;
+    pa_silence_memchunk(&i, a);
+
+    n_chunks = (unsigned) seconds * 100;
+
+    ts = pa_rtclock_now();
+    for (c = 0; c < n_chunks; c++) {
+        for (s = 0; s < n_streams; s++) {
+            pa_resampler_run(resamplers[s], &i, &j);
+            if (j.memblock)
+                pa_memblock_unref(j.memblock);
+        }
+    }
+    elapsed = pa_rtclock_now() - ts;
+
+    printf("%s: %u streams, %llu usec for %d seconds, %.3f%% CPU per stream\n",
+           pa_resample_method_to_string(resamplers[0]->method), n_streams, (unsigned long long) elapsed, seconds,
+           100.0 * elapsed / ((double) seconds * PA_USEC_PER_SEC * n_streams));
+
+    pa_memblock_unref(i.memblock);
+
+    for (s = 0; s < n_streams; s++)
+        pa_resampler_free(resamplers[s]);
+    pa_xfree(resamplers);
+}
+
 static void help(const char *argv0) {
     printf("%s [options]\n\n"
            "-h, --help                            Show this help\n"
@@ -263,6 +522,8 @@ static void help(const char *argv0) {
            "      --to-channels=CHANNELS          To number of channels (defaults to 1)\n"
            "      --resample-method=METHOD        Resample method (defaults to auto)\n"
            "      --seconds=SECONDS               From stream duration (defaults to 60)\n"
+           "      --stopband                      Measure passband distortion and stopband attenuation\n"
+           "      --cpu-load=STREAMS              Measure the CPU time per stream with this many streams\n"
            "\n"
            "If the formats are not specified, the test performs all formats combinations,\n"
            "back and forth.\n"
@@ -284,7 +545,9 @@ enum {
     ARG_TO_CHANNELS,
     ARG_SECONDS,
     ARG_RESAMPLE_METHOD,
-    ARG_DUMP_RESAMPLE_METHODS
+    ARG_DUMP_RESAMPLE_METHODS,
+    ARG_STOPBAND,
+    ARG_CPU_LOAD
 };
 
 static void dump_resample_methods(void) {
@@ -300,7 +563,8 @@ int main(int argc, char *argv[]) {
     pa_mempool *pool = NULL;
     pa_sample_spec a, b;
     int ret = 1, c;
-    bool all_formats = true;
+    bool all_formats = true, stopband = false;
+    unsigned cpu_load_streams = 0;
     pa_resample_method_t method;
     int seconds;
     unsigned crossover_freq = 120;
@@ -318,6 +582,8 @@ int main(int argc, char *argv[]) {
         {"seconds",               1, NULL, ARG_SECONDS},
         {"resample-method",       1, NULL, ARG_RESAMPLE_METHOD},
         {"dump-resample-methods", 0, NULL, ARG_DUMP_RESAMPLE_METHODS},
+        {"stopband",              0, NULL, ARG_STOPBAND},
+        {"cpu-load",              1, NULL, ARG_CPU_LOAD},
         {NULL,                    0, NULL, 0}
     };
 
@@ -398,6 +664,14 @@ int main(int argc, char *argv[]) {
                 method = pa_parse_resample_method(optarg);
                 break;
 
+            case ARG_STOPBAND:
+                stopband = true;
+                break;
+
+            case ARG_CPU_LOAD:
+                cpu_load_streams = (unsigned) atoi(optarg);
+                break;
+
             default:
                 goto quit;
         }
@@ -406,6 +680,22 @@ int main(int argc, char *argv[]) {
     ret = 0;
     pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
 
+    if (stopband) {
+        measure_stopband(pool, a.rate, b.rate, method);
+        goto quit;
+    }
+
+    if (cpu_load_streams > 0) {
+        pa_cpu_info cpu_info;
+
+        /* Use the same optimized functions as the daemon, unless disabled
+         * with $PULSE_NO_SIMD */
+        pa_cpu_init(&cpu_info);
+
+        measure_cpu_load(pool, &a, &b, method, cpu_load_streams, seconds);
+        goto quit;
+    }
+
     if (!all_formats) {
 
         pa_resampler *resampler;
@@ -471,6 +761,9 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    if (!check_polyphase(pool))
+        ret = 1;
+
  quit:
     if (pool)
         pa_mempool_unref(pool);
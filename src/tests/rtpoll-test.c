@@ -21,11 +21,20 @@
 
 #include <check.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
 
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
 #include <pulsecore/poll.h>
 #include <pulsecore/log.h>
+#include <pulsecore/core-util.h>
 #include <pulsecore/rtpoll.h>
 
+#define JITTER_LOOPS 500
+#define JITTER_PERIOD (2 * PA_USEC_PER_MSEC)
+
 static int before(pa_rtpoll_item *i) {
     pa_log("before");
     return 0;
@@ -82,15 +91,208 @@ START_TEST (rtpoll_test) {
 }
 END_TEST
 
+START_TEST (rtpoll_epoll_test) {
+    pa_rtpoll *p;
+    pa_rtpoll_item *i;
+    struct pollfd *pollfd;
+    int fds[2], fds2[2], null_fd;
+    char c = 'x';
+
+    if (!pa_rtpoll_backend_supported(PA_RTPOLL_BACKEND_EPOLL)) {
+        pa_log_info("epoll backend not supported, skipping.");
+        return;
+    }
+
+    p = pa_rtpoll_new_with_backend(PA_RTPOLL_BACKEND_EPOLL);
+    fail_unless(pa_rtpoll_get_backend(p) == PA_RTPOLL_BACKEND_EPOLL);
+
+    fail_unless(pa_pipe_cloexec(fds) == 0);
+
+    /* Two pollfds on the same fd */
+    i = pa_rtpoll_item_new(p, PA_RTPOLL_NORMAL, 2);
+    pollfd = pa_rtpoll_item_get_pollfd(i, NULL);
+    pollfd[0].fd = pollfd[1].fd = fds[0];
+    pollfd[0].events = pollfd[1].events = POLLIN;
+
+    fail_unless(pa_write(fds[1], &c, 1, NULL) == 1);
+
+    pa_rtpoll_set_timer_relative(p, 10 * PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) > 0);
+    fail_unless(!pa_rtpoll_timer_elapsed(p));
+    fail_unless(pollfd[0].revents == POLLIN);
+    fail_unless(pollfd[1].revents == POLLIN);
+
+    /* Nothing to read anymore, only the timer wakes us up */
+    fail_unless(pa_read(fds[0], &c, 1, NULL) == 1);
+    pollfd[1].events = 0;
+
+    pa_rtpoll_set_timer_relative(p, PA_USEC_PER_MSEC);
+    fail_unless(pa_rtpoll_run(p) > 0);
+    fail_unless(pa_rtpoll_timer_elapsed(p));
+    fail_unless(pollfd[0].revents == 0);
+    fail_unless(pollfd[1].revents == 0);
+
+    /* A timer that is not moved elapses again right away */
+    fail_unless(pa_rtpoll_run(p) > 0);
+    fail_unless(pa_rtpoll_timer_elapsed(p));
+
+    /* The fd numbers are most likely reused by the new pipe */
+    pa_rtpoll_item_free(i);
+    pa_close_pipe(fds);
+    fail_unless(pa_pipe_cloexec(fds) == 0);
+
+    i = pa_rtpoll_item_new(p, PA_RTPOLL_NORMAL, 1);
+    pollfd = pa_rtpoll_item_get_pollfd(i, NULL);
+    pollfd->fd = fds[0];
+    pollfd->events = POLLIN;
+
+    fail_unless(pa_write(fds[1], &c, 1, NULL) == 1);
+
+    pa_rtpoll_set_timer_relative(p, 10 * PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) > 0);
+    fail_unless(!pa_rtpoll_timer_elapsed(p));
+    fail_unless(pollfd->revents == POLLIN);
+
+    pa_rtpoll_item_free(i);
+    pa_close_pipe(fds);
+
+    /* An item that stays around but switches its fds. The fd number of the
+     * closed pipe moves to the other pollfd, with the same events. */
+    fail_unless(pa_pipe_cloexec(fds) == 0);
+    fail_unless(pa_pipe_cloexec(fds2) == 0);
+
+    i = pa_rtpoll_item_new(p, PA_RTPOLL_NORMAL, 2);
+    pollfd = pa_rtpoll_item_get_pollfd(i, NULL);
+    pollfd[0].fd = fds[0];
+    pollfd[1].fd = fds2[0];
+    pollfd[0].events = pollfd[1].events = POLLIN;
+
+    pa_rtpoll_set_timer_relative(p, PA_USEC_PER_MSEC);
+    fail_unless(pa_rtpoll_run(p) > 0);
+    fail_unless(pa_rtpoll_timer_elapsed(p));
+
+    pa_close_pipe(fds);
+    fail_unless(pa_pipe_cloexec(fds) == 0);
+    pollfd[0].fd = fds2[0];
+    pollfd[1].fd = fds[0];
+
+    fail_unless(pa_write(fds[1], &c, 1, NULL) == 1);
+
+    pa_rtpoll_set_timer_relative(p, PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) > 0);
+    fail_unless(!pa_rtpoll_timer_elapsed(p));
+    fail_unless(pollfd[0].revents == 0);
+    fail_unless(pollfd[1].revents == POLLIN);
+
+    pa_rtpoll_item_free(i);
+    pa_close_pipe(fds);
+    pa_close_pipe(fds2);
+
+    /* /dev/null cannot be watched with epoll */
+    null_fd = open("/dev/null", O_RDONLY|O_CLOEXEC);
+    fail_unless(null_fd >= 0);
+
+    i = pa_rtpoll_item_new(p, PA_RTPOLL_NORMAL, 1);
+    pollfd = pa_rtpoll_item_get_pollfd(i, NULL);
+    pollfd->fd = null_fd;
+    pollfd->events = POLLIN;
+
+    fail_unless(pa_rtpoll_run(p) > 0);
+    fail_unless(pa_rtpoll_get_backend(p) == PA_RTPOLL_BACKEND_POLL);
+    fail_unless(pollfd->revents == POLLIN);
+
+    pa_rtpoll_item_free(i);
+    pa_close(null_fd);
+
+    pa_rtpoll_free(p);
+}
+END_TEST
+
+static int compare_usec(const void *a, const void *b) {
+    const pa_usec_t *x = a, *y = b;
+
+    return *x < *y ? -1 : (*x > *y ? 1 : 0);
+}
+
+/* Run a periodic absolute timer, like a timer based scheduling sink does,
+ * and look at how late the wakeups are. There is a pipe in the rtpoll as
+ * well, as there always is at least the asyncmsgq in IO threads. */
+static void measure_jitter(pa_rtpoll_backend_t backend) {
+    pa_rtpoll *p;
+    pa_rtpoll_item *i;
+    struct pollfd *pollfd;
+    pa_usec_t next, now, sum = 0, lateness[JITTER_LOOPS];
+    pa_io_stats stats;
+    int fds[2];
+    unsigned k;
+
+    p = pa_rtpoll_new_with_backend(backend);
+    fail_unless(pa_rtpoll_get_backend(p) == backend);
+
+    fail_unless(pa_pipe_cloexec(fds) == 0);
+
+    i = pa_rtpoll_item_new(p, PA_RTPOLL_NEVER, 1);
+    pollfd = pa_rtpoll_item_get_pollfd(i, NULL);
+    pollfd->fd = fds[0];
+    pollfd->events = POLLIN;
+
+    next = pa_rtclock_now();
+
+    for (k = 0; k < JITTER_LOOPS; k++) {
+        next += JITTER_PERIOD;
+        pa_rtpoll_set_timer_absolute(p, next);
+
+        fail_unless(pa_rtpoll_run(p) > 0);
+        now = pa_rtclock_now();
+
+        fail_unless(pa_rtpoll_timer_elapsed(p));
+        fail_unless(now >= next);
+
+        lateness[k] = now - next;
+        sum += lateness[k];
+    }
+
+    pa_rtpoll_get_io_stats(p, &stats);
+    fail_unless(stats.timer_wakeups == JITTER_LOOPS);
+    fail_unless(stats.busy_max <= stats.busy);
+
+    qsort(lateness, JITTER_LOOPS, sizeof(pa_usec_t), compare_usec);
+
+    pa_log_info("%s: %u wakeups every %llu usec, lateness avg %llu usec, median %llu usec, p99 %llu usec, max %llu usec",
+                pa_rtpoll_backend_to_string(backend), JITTER_LOOPS, (unsigned long long) JITTER_PERIOD,
+                (unsigned long long) (sum / JITTER_LOOPS),
+                (unsigned long long) lateness[JITTER_LOOPS / 2],
+                (unsigned long long) lateness[JITTER_LOOPS * 99 / 100],
+                (unsigned long long) lateness[JITTER_LOOPS - 1]);
+
+    pa_rtpoll_item_free(i);
+    pa_close_pipe(fds);
+    pa_rtpoll_free(p);
+}
+
+START_TEST (rtpoll_jitter_test) {
+    pa_rtpoll_backend_t b;
+
+    for (b = 0; b < PA_RTPOLL_BACKEND_MAX; b++)
+        if (pa_rtpoll_backend_supported(b))
+            measure_jitter(b);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
     TCase *tc;
     SRunner *sr;
 
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_INFO);
+
     s = suite_create("RT Poll");
     tc = tcase_create("rtpoll");
     tcase_add_test(tc, rtpoll_test);
+    tcase_add_test(tc, rtpoll_epoll_test);
+    tcase_add_test(tc, rtpoll_jitter_test);
     /* the default timeout is too small,
      * set it to a reasonable large one.
      */
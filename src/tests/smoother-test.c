@@ -19,6 +19,7 @@
 #include <config.h>
 #endif
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -84,6 +85,204 @@ START_TEST (smoother_test) {
 }
 END_TEST
 
+/* A remote clock running at rate with uniform measurement noise of +-jitter
+ * usec, sampled like the ALSA modules do: the update interval starts at 2ms
+ * and doubles up to 200ms. */
+struct clock_sim {
+    double rate;
+    pa_usec_t jitter;
+    pa_usec_t y_offset;
+    pa_usec_t interval;
+    pa_usec_t next_put;
+};
+
+static void clock_sim_init(struct clock_sim *c, double rate, pa_usec_t jitter, pa_usec_t start) {
+    c->rate = rate;
+    c->jitter = jitter;
+    c->y_offset = 0;
+    c->interval = 2 * PA_USEC_PER_MSEC;
+    c->next_put = start;
+}
+
+static pa_usec_t clock_sim_truth(struct clock_sim *c, pa_usec_t x, pa_usec_t start) {
+    return c->y_offset + (pa_usec_t) llrint(c->rate * (double) (x - start));
+}
+
+static void clock_sim_put(struct clock_sim *c, pa_smoother *s, pa_usec_t x, pa_usec_t start) {
+    int64_t y;
+
+    if (x < c->next_put)
+        return;
+
+    y = (int64_t) clock_sim_truth(c, x, start);
+
+    if (c->jitter > 0)
+        y += (int64_t) (rand() % (2 * c->jitter + 1)) - (int64_t) c->jitter;
+
+    pa_smoother_put(s, x, y > 0 ? (pa_usec_t) y : 0);
+
+    c->next_put = x + c->interval;
+    c->interval = PA_MIN(c->interval * 2, 200 * PA_USEC_PER_MSEC);
+}
+
+static pa_smoother *clock_smoother_new(pa_smoother_algorithm_t a) {
+    pa_smoother *s;
+
+    s = pa_smoother_new(PA_USEC_PER_SEC, 10 * PA_USEC_PER_SEC, true, true, 5, 0, true);
+    pa_smoother_set_algorithm(s, a);
+    ck_assert_int_eq(pa_smoother_get_algorithm(s), a);
+
+    return s;
+}
+
+/* Runs the simulation from start to end in 1ms steps and returns the RMS
+ * error of pa_smoother_get() from after settle on */
+static double clock_sim_run(struct clock_sim *c, pa_smoother *s, pa_usec_t start, pa_usec_t settle, pa_usec_t end) {
+    pa_usec_t x;
+    double sum = 0;
+    unsigned n = 0;
+
+    for (x = start; x < end; x += PA_USEC_PER_MSEC) {
+        clock_sim_put(c, s, x, start);
+
+        if (x >= settle) {
+            double d = (double) pa_smoother_get(s, x) - (double) clock_sim_truth(c, x, start);
+
+            sum += d * d;
+            n++;
+        }
+    }
+
+    return n > 0 ? sqrt(sum / n) : 0;
+}
+
+START_TEST (smoother_algorithm_test) {
+    pa_smoother_algorithm_t a;
+
+    for (a = 0; a < PA_SMOOTHER_MAX; a++)
+        ck_assert_int_eq(pa_parse_smoother_algorithm(pa_smoother_algorithm_to_string(a)), a);
+
+    ck_assert_int_eq(pa_parse_smoother_algorithm("kalman"), PA_SMOOTHER_KALMAN);
+    ck_assert_int_eq(pa_parse_smoother_algorithm("spline"), PA_SMOOTHER_INVALID);
+    fail_unless(pa_smoother_algorithm_to_string(PA_SMOOTHER_MAX) == NULL);
+}
+END_TEST
+
+START_TEST (smoother_drift_test) {
+    static const double rates[] = { 1.0, 1.0003, 0.9995 };
+    static const pa_usec_t jitters[] = { 0, 50, 500 };
+    pa_smoother_algorithm_t a;
+    unsigned i, j;
+
+    for (i = 0; i < PA_ELEMENTSOF(rates); i++)
+        for (j = 0; j < PA_ELEMENTSOF(jitters); j++)
+            for (a = 0; a < PA_SMOOTHER_MAX; a++) {
+                struct clock_sim c;
+                pa_smoother *s;
+                pa_smoother_quality q;
+                double rms;
+
+                srand(i * 10 + j);
+
+                s = clock_smoother_new(a);
+                pa_smoother_resume(s, 0, true);
+
+                clock_sim_init(&c, rates[i], jitters[j], 0);
+                rms = clock_sim_run(&c, s, 0, 10 * PA_USEC_PER_SEC, 30 * PA_USEC_PER_SEC);
+
+                pa_smoother_get_quality(s, &q);
+
+                pa_log_info("%s: rate %0.4f, jitter %llu usec: error %0.1f usec, estimated rate %0.6f +- %0.6f, error %llu usec, jitter %llu usec",
+                            pa_smoother_algorithm_to_string(a), rates[i], (unsigned long long) jitters[j], rms,
+                            q.rate, q.rate_error, (unsigned long long) q.error, (unsigned long long) q.jitter);
+
+                fail_unless(q.n_updates > 0);
+
+                if (a == PA_SMOOTHER_KALMAN) {
+                    fail_unless(rms < PA_MAX(jitters[j] / 4.0, 20.0));
+                    fail_unless(fabs(q.rate - rates[i]) < 10e-6);
+                    fail_unless(fabs(q.rate - rates[i]) < 5 * q.rate_error + 1e-6);
+
+                    /* Uniform noise of +-j has a standard deviation of j/sqrt(3) */
+                    fail_unless(q.jitter <= jitters[j] / 1.7 * 1.5 + 1);
+                    fail_unless(q.jitter >= jitters[j] / 1.7 / 1.5);
+                }
+
+                pa_smoother_free(s);
+            }
+}
+END_TEST
+
+START_TEST (smoother_resume_test) {
+    pa_smoother_algorithm_t a;
+
+    srand(0);
+
+    for (a = 0; a < PA_SMOOTHER_MAX; a++) {
+        struct clock_sim c;
+        pa_smoother *s;
+        pa_usec_t start = 20 * PA_USEC_PER_SEC;
+        double rms;
+
+        s = clock_smoother_new(a);
+        pa_smoother_resume(s, 0, true);
+
+        clock_sim_init(&c, 1.0004, 100, 0);
+        clock_sim_run(&c, s, 0, 0, 10 * PA_USEC_PER_SEC);
+
+        /* Suspend and resume the way the ALSA modules do it: the remote
+         * clock restarts from zero */
+        pa_smoother_pause(s, 10 * PA_USEC_PER_SEC);
+        pa_smoother_reset(s, start, true);
+        pa_smoother_resume(s, start, true);
+
+        clock_sim_init(&c, 1.0004, 100, start);
+        rms = clock_sim_run(&c, s, start, start + 500 * PA_USEC_PER_MSEC, start + 2 * PA_USEC_PER_SEC);
+
+        pa_log_info("%s: error in the first 2s after resume %0.1f usec", pa_smoother_algorithm_to_string(a), rms);
+
+        /* The rate is remembered, so only the offset needs to be found again */
+        if (a == PA_SMOOTHER_KALMAN)
+            fail_unless(rms < 100);
+
+        pa_smoother_free(s);
+    }
+}
+END_TEST
+
+START_TEST (smoother_outlier_test) {
+    struct clock_sim c;
+    pa_smoother *s;
+    pa_usec_t x, y;
+
+    srand(0);
+
+    s = clock_smoother_new(PA_SMOOTHER_KALMAN);
+    pa_smoother_resume(s, 0, true);
+
+    clock_sim_init(&c, 1.0, 20, 0);
+    clock_sim_run(&c, s, 0, 0, 5 * PA_USEC_PER_SEC);
+
+    /* A single bogus measurement is ignored */
+    x = 5 * PA_USEC_PER_SEC;
+    pa_smoother_put(s, x, x + 50 * PA_USEC_PER_MSEC);
+    y = pa_smoother_get(s, x + PA_USEC_PER_MSEC);
+    fail_unless(y < x + 2 * PA_USEC_PER_MSEC);
+
+    /* But if the remote clock really jumps, it is followed */
+    c.y_offset = 20 * PA_USEC_PER_MSEC;
+    c.next_put = x + c.interval;
+    clock_sim_run(&c, s, 0, 0, 7 * PA_USEC_PER_SEC);
+
+    x = 7 * PA_USEC_PER_SEC;
+    y = pa_smoother_get(s, x);
+    fail_unless(y > x + 19 * PA_USEC_PER_MSEC);
+    fail_unless(y < x + 21 * PA_USEC_PER_MSEC);
+
+    pa_smoother_free(s);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -93,6 +292,10 @@ int main(int argc, char *argv[]) {
     s = suite_create("Smoother");
     tc = tcase_create("smoother");
     tcase_add_test(tc, smoother_test);
+    tcase_add_test(tc, smoother_algorithm_test);
+    tcase_add_test(tc, smoother_drift_test);
+    tcase_add_test(tc, smoother_resume_test);
+    tcase_add_test(tc, smoother_outlier_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -24,11 +24,18 @@
 #include <unistd.h>
 #include <check.h>
 
+#include <pulsecore/socket.h>
+
 #include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
 #include <pulsecore/packet.h>
 #include <pulsecore/pstream.h>
 #include <pulsecore/iochannel.h>
 #include <pulsecore/memblock.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/atomic.h>
+#include <pulsecore/fdsem.h>
+#include <pulsecore/native-common.h>
 
 static unsigned packets_received;
 static unsigned packets_checksum;
@@ -121,6 +128,423 @@ START_TEST (srbchannel_test) {
 }
 END_TEST
 
+#define BATCH_PACKETS 200
+#define BATCH_FD_PACKET 123
+
+static unsigned batch_received;
+static unsigned batch_fd_packet;
+
+static void batch_packet_received(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    const uint32_t *pdata;
+    size_t plen;
+
+    pdata = (const uint32_t *) pa_packet_data(packet, &plen);
+    fail_unless(plen == sizeof(uint32_t));
+    fail_unless(pdata[0] == batch_received);
+
+#ifdef HAVE_CREDS
+    if (ancil_data->nfd > 0) {
+        fail_unless(ancil_data->nfd == 1);
+        batch_fd_packet = batch_received;
+        pa_cmsg_ancil_data_close_fds(ancil_data);
+    }
+#endif
+
+    batch_received++;
+}
+
+static void batch_test(bool batching, pa_pstream_stats *write_stats, pa_pstream_stats *read_stats) {
+    int fds[2];
+    pa_mainloop *ml = pa_mainloop_new();
+    pa_mempool *mp = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    pa_pstream *p1, *p2;
+    unsigned i;
+
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml), pa_iochannel_new(pa_mainloop_get_api(ml), fds[0], fds[0]), mp);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml), pa_iochannel_new(pa_mainloop_get_api(ml), fds[1], fds[1]), mp);
+    pa_pstream_enable_batching(p1, batching);
+    pa_pstream_enable_batching(p2, batching);
+    pa_pstream_set_receive_packet_callback(p2, batch_packet_received, NULL);
+
+    batch_received = 0;
+    batch_fd_packet = (unsigned) -1;
+
+    /* Queue everything before running the main loop, so that the writer sees
+     * a full send queue */
+    for (i = 0; i < BATCH_PACKETS; i++) {
+        pa_packet *packet = pa_packet_new(sizeof(uint32_t));
+        size_t plen;
+        uint32_t *pdata = (uint32_t *) pa_packet_data(packet, &plen);
+
+        pdata[0] = i;
+
+#ifdef HAVE_CREDS
+        if (i == BATCH_FD_PACKET) {
+            pa_cmsg_ancil_data ancil;
+
+            pa_zero(ancil);
+            ancil.nfd = 1;
+            fail_unless((ancil.fds[0] = dup(fds[0])) >= 0);
+            ancil.close_fds_on_cleanup = true;
+            pa_pstream_send_packet(p1, packet, &ancil);
+        } else
+#endif
+            pa_pstream_send_packet(p1, packet, NULL);
+
+        pa_packet_unref(packet);
+    }
+
+    while (batch_received < BATCH_PACKETS)
+        pa_mainloop_iterate(ml, 1, NULL);
+
+#ifdef HAVE_CREDS
+    fail_unless(batch_fd_packet == BATCH_FD_PACKET);
+#endif
+
+    pa_pstream_get_stats(p1, write_stats);
+    pa_pstream_get_stats(p2, read_stats);
+
+    pa_log_debug("Batching %s: %llu frames written in %llu calls, read in %llu calls", batching ? "on" : "off",
+                 (unsigned long long) write_stats->write_frames,
+                 (unsigned long long) write_stats->write_calls,
+                 (unsigned long long) read_stats->read_calls);
+
+    pa_pstream_unref(p1);
+    pa_pstream_unref(p2);
+    pa_mempool_unref(mp);
+    pa_mainloop_free(ml);
+}
+
+START_TEST (pstream_batching_test) {
+    pa_pstream_stats w1, r1, w2, r2;
+
+    batch_test(false, &w1, &r1);
+    batch_test(true, &w2, &r2);
+
+    fail_unless(w1.write_frames == BATCH_PACKETS);
+    fail_unless(w2.write_frames == BATCH_PACKETS);
+    fail_unless(r1.read_frames == BATCH_PACKETS);
+    fail_unless(r2.read_frames == BATCH_PACKETS);
+    fail_unless(w1.write_bytes == w2.write_bytes);
+
+    fail_unless(w2.write_calls < w1.write_calls);
+    fail_unless(r2.read_calls < r1.read_calls);
+}
+END_TEST
+
+#define RTT_ROUNDS 5000
+#define RTT_QUIT 0xff
+
+struct rtt_peer {
+    pa_mainloop *ml;
+    pa_srbchannel *sr;
+    unsigned rounds;
+};
+
+/* Echoes every byte back, until asked to quit */
+static bool rtt_echo_cb(pa_srbchannel *sr, void *userdata) {
+    struct rtt_peer *peer = userdata;
+    uint8_t b;
+
+    while (pa_srbchannel_read(sr, &b, 1) == 1) {
+        if (b == RTT_QUIT) {
+            pa_mainloop_quit(peer->ml, 0);
+            return true;
+        }
+
+        pa_srbchannel_write(sr, &b, 1);
+    }
+
+    return true;
+}
+
+/* Sends the next ping as soon as the previous one comes back */
+static bool rtt_ping_cb(pa_srbchannel *sr, void *userdata) {
+    struct rtt_peer *peer = userdata;
+    uint8_t b;
+
+    while (pa_srbchannel_read(sr, &b, 1) == 1) {
+        if (++peer->rounds >= RTT_ROUNDS) {
+            b = RTT_QUIT;
+            pa_srbchannel_write(sr, &b, 1);
+            pa_mainloop_quit(peer->ml, 0);
+            return true;
+        }
+
+        b = (uint8_t) (peer->rounds & 0x7f);
+        pa_srbchannel_write(sr, &b, 1);
+    }
+
+    return true;
+}
+
+static void rtt_echo_thread(void *userdata) {
+    struct rtt_peer *peer = userdata;
+
+    pa_mainloop_run(peer->ml, NULL);
+}
+
+/* Returns the average round trip time between two threads in usec */
+static double rtt_test(pa_usec_t spin_usec) {
+    pa_mempool *mp = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    struct rtt_peer pinger, echoer;
+    pa_srbchannel_template srt;
+    pa_thread *thread;
+    pa_usec_t start, elapsed;
+    uint8_t b = 0;
+
+    pinger.ml = pa_mainloop_new();
+    echoer.ml = pa_mainloop_new();
+    pinger.rounds = echoer.rounds = 0;
+
+    fail_unless((pinger.sr = pa_srbchannel_new(pa_mainloop_get_api(pinger.ml), mp)) != NULL);
+    pa_srbchannel_export(pinger.sr, &srt);
+    fail_unless((echoer.sr = pa_srbchannel_new_from_template(pa_mainloop_get_api(echoer.ml), &srt)) != NULL);
+
+    pa_srbchannel_set_spin(pinger.sr, spin_usec);
+    pa_srbchannel_set_spin(echoer.sr, spin_usec);
+    pa_srbchannel_set_callback(pinger.sr, rtt_ping_cb, &pinger);
+    pa_srbchannel_set_callback(echoer.sr, rtt_echo_cb, &echoer);
+
+    fail_unless((thread = pa_thread_new("rtt-echo", rtt_echo_thread, &echoer)) != NULL);
+
+    start = pa_rtclock_now();
+    pa_srbchannel_write(pinger.sr, &b, 1);
+    pa_mainloop_run(pinger.ml, NULL);
+    elapsed = pa_rtclock_now() - start;
+
+    pa_thread_free(thread);
+    fail_unless(pinger.rounds == RTT_ROUNDS);
+
+    pa_srbchannel_free(pinger.sr);
+    pa_srbchannel_free(echoer.sr);
+    pa_mainloop_free(pinger.ml);
+    pa_mainloop_free(echoer.ml);
+    pa_mempool_unref(mp);
+
+    return (double) elapsed / RTT_ROUNDS;
+}
+
+START_TEST (srbchannel_rtt_test) {
+    double sleeping, spinning;
+
+    sleeping = rtt_test(0);
+    spinning = rtt_test(50);
+
+    pa_log_info("Average round trip: %0.2f usec sleeping, %0.2f usec with spin-then-sleep", sleeping, spinning);
+}
+END_TEST
+
+#define THREAD_BLOCKS 2000
+#define THREAD_PACKET_EVERY 7
+
+static pa_atomic_t thread_last_block = PA_ATOMIC_INIT(-1);
+static pa_atomic_t thread_dispatch = PA_ATOMIC_INIT(0);
+static pa_atomic_t thread_quit = PA_ATOMIC_INIT(0);
+static unsigned thread_packets;
+static pa_srbchannel *thread_srb;
+
+/* Called from the reading thread */
+static void thread_memblock_received(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    uint32_t seq;
+
+    fail_unless(chunk->length == sizeof(seq));
+    memcpy(&seq, (uint8_t *) pa_memblock_acquire_chunk(chunk), sizeof(seq));
+    pa_memblock_release(chunk->memblock);
+
+    fail_unless((int) seq == pa_atomic_load(&thread_last_block) + 1);
+    pa_atomic_store(&thread_last_block, (int) seq);
+}
+
+/* Called from the main loop */
+static void thread_packet_received(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    const uint32_t *pdata;
+    size_t plen;
+
+    pdata = (const uint32_t *) pa_packet_data(packet, &plen);
+    fail_unless(plen == sizeof(uint32_t));
+
+    /* Each packet follows the block with the same sequence number, the
+     * reading thread must have stopped right after that block */
+    fail_unless((int) pdata[0] == pa_atomic_load(&thread_last_block));
+    thread_packets++;
+}
+
+static void srb_reading_thread(void *userdata) {
+    pa_pstream *p = userdata;
+    pa_fdsem *sem = pa_srbchannel_get_read_fdsem(thread_srb);
+
+    while (!pa_atomic_load(&thread_quit)) {
+        bool write_ready;
+        int r;
+
+        fail_unless((r = pa_pstream_srb_thread_read(p, &write_ready)) >= 0);
+
+        if (r > 0)
+            pa_atomic_store(&thread_dispatch, 1);
+
+        pa_fdsem_wait(sem);
+    }
+}
+
+START_TEST (srb_thread_test) {
+    int pipefd[4];
+    pa_mainloop *ml = pa_mainloop_new();
+    pa_mempool *mp = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    pa_iochannel *io1, *io2;
+    pa_pstream *p1, *p2;
+    pa_srbchannel *sr1, *sr2;
+    pa_srbchannel_template srt;
+    pa_fdsem *sem;
+    pa_thread *thread;
+    uint32_t seq;
+
+    fail_unless(pipe(pipefd) == 0);
+    fail_unless(pipe(&pipefd[2]) == 0);
+    io1 = pa_iochannel_new(pa_mainloop_get_api(ml), pipefd[2], pipefd[1]);
+    io2 = pa_iochannel_new(pa_mainloop_get_api(ml), pipefd[0], pipefd[3]);
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml), io1, mp);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml), io2, mp);
+
+    sr1 = pa_srbchannel_new(pa_mainloop_get_api(ml), mp);
+    pa_srbchannel_export(sr1, &srt);
+    pa_pstream_set_srbchannel(p1, sr1);
+    sr2 = pa_srbchannel_new_from_template(pa_mainloop_get_api(ml), &srt);
+    pa_pstream_set_srbchannel(p2, sr2);
+    thread_srb = sr2;
+
+    pa_pstream_set_receive_packet_callback(p2, thread_packet_received, NULL);
+    fail_unless((sem = pa_pstream_set_srb_thread(p2, thread_memblock_received, NULL)) != NULL);
+    fail_unless((thread = pa_thread_new("srb-reader", srb_reading_thread, p2)) != NULL);
+
+    for (seq = 0; seq < THREAD_BLOCKS; seq++) {
+        pa_memchunk chunk;
+
+        chunk.memblock = pa_memblock_new(mp, sizeof(seq));
+        chunk.index = 0;
+        chunk.length = sizeof(seq);
+        memcpy(pa_memblock_acquire(chunk.memblock), &seq, sizeof(seq));
+        pa_memblock_release(chunk.memblock);
+
+        pa_pstream_send_memblock(p1, 0, 0, PA_SEEK_RELATIVE, &chunk);
+        pa_memblock_unref(chunk.memblock);
+
+        if (seq % THREAD_PACKET_EVERY == 0) {
+            pa_packet *packet = pa_packet_new(sizeof(seq));
+            size_t plen;
+
+            memcpy((void *) pa_packet_data(packet, &plen), &seq, sizeof(seq));
+            pa_pstream_send_packet(p1, packet, NULL);
+            pa_packet_unref(packet);
+        }
+    }
+
+    while (thread_packets < (THREAD_BLOCKS + THREAD_PACKET_EVERY - 1) / THREAD_PACKET_EVERY ||
+           pa_atomic_load(&thread_last_block) < THREAD_BLOCKS - 1) {
+
+        if (pa_atomic_cmpxchg(&thread_dispatch, 1, 0)) {
+            pa_pstream_srb_thread_dispatch(p2);
+            pa_fdsem_post(sem);
+        }
+
+        pa_mainloop_iterate(ml, 0, NULL);
+    }
+
+    pa_atomic_store(&thread_quit, 1);
+    pa_fdsem_post(sem);
+    pa_thread_free(thread);
+
+    pa_pstream_set_srb_thread(p2, NULL, NULL);
+
+    pa_pstream_unref(p1);
+    pa_pstream_unref(p2);
+    pa_mempool_unref(mp);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+#define TIMING_UPDATES 100000
+
+static pa_atomic_t timing_done;
+
+static void timing_writer_thread(void *userdata) {
+    pa_timing_page_slot *slot = userdata;
+    int seq = 0;
+    int64_t n;
+
+    for (n = 1; n <= TIMING_UPDATES; n++) {
+        pa_atomic_store(&slot->seq, ++seq);
+        pa_atomic_fence();
+        slot->write_index = slot->read_index = n;
+        slot->sink_usec = slot->timestamp = (uint64_t) n;
+        slot->underrun_for = slot->playing_for = (uint64_t) n;
+        pa_atomic_fence();
+        pa_atomic_store(&slot->seq, ++seq);
+    }
+
+    pa_atomic_store(&timing_done, 1);
+}
+
+START_TEST (srbchannel_aux_test) {
+    pa_mainloop *ml = pa_mainloop_new();
+    pa_mempool *mp = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    pa_srbchannel *sr1, *sr2;
+    pa_srbchannel_template srt;
+    pa_timing_page_slot *slot1, *slot2;
+    size_t l1, l2;
+    pa_thread *thread;
+    unsigned consistent = 0;
+
+    sr1 = pa_srbchannel_new(pa_mainloop_get_api(ml), mp);
+    fail_unless(sr1 != NULL);
+    pa_srbchannel_export(sr1, &srt);
+    sr2 = pa_srbchannel_new_from_template(pa_mainloop_get_api(ml), &srt);
+    fail_unless(sr2 != NULL);
+
+    /* Both sides find the same zeroed area */
+    fail_unless((slot1 = pa_srbchannel_get_aux(sr1, &l1)) != NULL);
+    fail_unless((slot2 = pa_srbchannel_get_aux(sr2, &l2)) != NULL);
+    fail_unless(l1 == l2);
+    fail_unless(l1 >= sizeof(pa_timing_page_slot));
+    fail_unless(slot2->timestamp == 0);
+
+    /* Readers never see a half updated slot */
+    pa_atomic_store(&timing_done, 0);
+    fail_unless((thread = pa_thread_new("timing-writer", timing_writer_thread, slot1)) != NULL);
+
+    while (!pa_atomic_load(&timing_done)) {
+        pa_timing_page_slot copy;
+        int seq;
+
+        seq = pa_atomic_load(&slot2->seq);
+        if (seq & 1)
+            continue;
+
+        memcpy(&copy, slot2, sizeof(copy));
+        pa_atomic_fence();
+
+        if (pa_atomic_load(&slot2->seq) != seq)
+            continue;
+
+        fail_unless(copy.write_index == copy.read_index);
+        fail_unless((uint64_t) copy.write_index == copy.sink_usec);
+        fail_unless(copy.sink_usec == copy.timestamp);
+        fail_unless(copy.timestamp == copy.underrun_for);
+        fail_unless(copy.underrun_for == copy.playing_for);
+        consistent++;
+    }
+
+    pa_thread_free(thread);
+    fail_unless(slot2->timestamp == TIMING_UPDATES);
+    pa_log_debug("Read %u consistent timing slots", consistent);
+
+    pa_srbchannel_free(sr2);
+    pa_srbchannel_free(sr1);
+    pa_mempool_unref(mp);
+    pa_mainloop_free(ml);
+}
+END_TEST
 
 int main(int argc, char *argv[]) {
     int failed = 0;
@@ -134,6 +558,10 @@ int main(int argc, char *argv[]) {
     s = suite_create("srbchannel");
     tc = tcase_create("srbchannel");
     tcase_add_test(tc, srbchannel_test);
+    tcase_add_test(tc, pstream_batching_test);
+    tcase_add_test(tc, srbchannel_rtt_test);
+    tcase_add_test(tc, srb_thread_test);
+    tcase_add_test(tc, srbchannel_aux_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
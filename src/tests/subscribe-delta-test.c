@@ -0,0 +1,228 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Subscribes to delta events of a null sink, narrows the subscription to
+ * leave sinks out while the sink is unmuted, and subscribes to sinks again.
+ * The server must not compare the sink against what it cached before the
+ * narrower subscription: the first event afterwards has to carry all
+ * fields again, even though muting the sink once more makes it look just
+ * like in the last event that was sent. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <check.h>
+
+#include <pulse/pulseaudio.h>
+
+#define SINK_NAME "subscribe_delta_test"
+
+enum {
+    STEP_VOLUME,        /* Waiting for the first event, after setting the volume */
+    STEP_MUTE,          /* Waiting for the event after muting */
+    STEP_NARROWING,     /* Waiting for the narrower subscription to apply */
+    STEP_NARROW,        /* Not subscribed to sinks, unmuting */
+    STEP_MUTE_AGAIN,    /* Subscribed again, waiting for the event after muting */
+    STEP_DONE
+};
+
+static pa_mainloop_api *mainloop_api = NULL;
+static pa_context *context = NULL;
+static uint32_t module_index = PA_INVALID_INDEX;
+static uint32_t sink_index = PA_INVALID_INDEX;
+static pa_cvolume sink_volume;
+static unsigned step = STEP_VOLUME;
+static const char *bname = NULL;
+
+static void unload_module_cb(pa_context *c, int success, void *userdata) {
+    fail_unless(success);
+
+    mainloop_api->quit(mainloop_api, 0);
+}
+
+static void success_cb(pa_context *c, int success, void *userdata) {
+    fail_unless(success);
+}
+
+static void resubscribe_cb(pa_context *c, int success, void *userdata) {
+    fail_unless(success);
+
+    step = STEP_MUTE_AGAIN;
+    pa_operation_unref(pa_context_set_sink_mute_by_index(c, sink_index, 1, success_cb, NULL));
+}
+
+static void unmute_cb(pa_context *c, int success, void *userdata) {
+    fail_unless(success);
+
+    pa_operation_unref(pa_context_subscribe_delta(c, PA_SUBSCRIPTION_MASK_SINK, resubscribe_cb, NULL));
+}
+
+static void narrow_cb(pa_context *c, int success, void *userdata) {
+    fail_unless(success);
+
+    step = STEP_NARROW;
+
+    pa_operation_unref(pa_context_set_sink_mute_by_index(c, sink_index, 0, unmute_cb, NULL));
+}
+
+static void subscribe_delta_cb(pa_context *c, pa_subscription_event_type_t t, uint32_t idx, const pa_subscription_delta *d, void *userdata) {
+    if ((t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK) != PA_SUBSCRIPTION_EVENT_SINK ||
+        (t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) != PA_SUBSCRIPTION_EVENT_CHANGE ||
+        idx != sink_index)
+        return;
+
+    fail_unless(d != NULL);
+
+    switch (step) {
+        case STEP_VOLUME:
+            /* There might be state changes first */
+            if (!(d->fields & PA_SUBSCRIPTION_DELTA_VOLUME) || !pa_cvolume_equal(&d->volume, &sink_volume))
+                break;
+
+            step = STEP_MUTE;
+            pa_operation_unref(pa_context_set_sink_mute_by_index(c, sink_index, 1, success_cb, NULL));
+            break;
+
+        case STEP_MUTE:
+            if (!(d->fields & PA_SUBSCRIPTION_DELTA_MUTE))
+                break;
+
+            fail_unless(d->mute);
+            fail_unless(!(d->fields & PA_SUBSCRIPTION_DELTA_VOLUME));
+
+            step = STEP_NARROWING;
+            pa_operation_unref(pa_context_subscribe_delta(c, PA_SUBSCRIPTION_MASK_SERVER, narrow_cb, NULL));
+            break;
+
+        case STEP_NARROW:
+            fprintf(stderr, "Got a sink event without being subscribed to sinks\n");
+            ck_abort();
+            break;
+
+        case STEP_MUTE_AGAIN:
+            /* Whatever the event is about, it is the first one since the
+             * sink was subscribed again */
+            fprintf(stderr, "First event after subscribing again has fields 0x%x\n", d->fields);
+
+            fail_unless(d->fields & PA_SUBSCRIPTION_DELTA_VOLUME);
+            fail_unless(d->fields & PA_SUBSCRIPTION_DELTA_MUTE);
+
+            step = STEP_DONE;
+            pa_operation_unref(pa_context_unload_module(c, module_index, unload_module_cb, NULL));
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void subscribe_cb(pa_context *c, int success, void *userdata) {
+    fail_unless(success);
+
+    pa_operation_unref(pa_context_set_sink_volume_by_index(c, sink_index, &sink_volume, success_cb, NULL));
+}
+
+static void sink_info_cb(pa_context *c, const pa_sink_info *i, int eol, void *userdata) {
+    if (eol) {
+        fail_unless(eol > 0);
+        fail_unless(sink_index != PA_INVALID_INDEX);
+
+        pa_operation_unref(pa_context_subscribe_delta(c, PA_SUBSCRIPTION_MASK_SINK, subscribe_cb, NULL));
+        return;
+    }
+
+    sink_index = i->index;
+    pa_cvolume_set(&sink_volume, i->volume.channels, PA_VOLUME_NORM / 3);
+}
+
+static void load_module_cb(pa_context *c, uint32_t idx, void *userdata) {
+    fail_unless(idx != PA_INVALID_INDEX);
+    module_index = idx;
+
+    pa_operation_unref(pa_context_get_sink_info_by_name(c, SINK_NAME, sink_info_cb, NULL));
+}
+
+static void context_state_cb(pa_context *c, void *userdata) {
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_CONNECTING:
+        case PA_CONTEXT_AUTHORIZING:
+        case PA_CONTEXT_SETTING_NAME:
+            break;
+
+        case PA_CONTEXT_READY:
+            pa_context_set_subscribe_delta_callback(c, subscribe_delta_cb, NULL);
+            pa_operation_unref(pa_context_load_module(c, "module-null-sink", "sink_name=" SINK_NAME, load_module_cb, NULL));
+            break;
+
+        case PA_CONTEXT_TERMINATED:
+            mainloop_api->quit(mainloop_api, 0);
+            break;
+
+        case PA_CONTEXT_FAILED:
+        default:
+            fprintf(stderr, "Context error: %s\n", pa_strerror(pa_context_errno(c)));
+            ck_abort();
+    }
+}
+
+START_TEST (subscribe_delta_test) {
+    pa_mainloop *m;
+    int ret = 1;
+
+    fail_unless((m = pa_mainloop_new()) != NULL);
+    mainloop_api = pa_mainloop_get_api(m);
+
+    fail_unless((context = pa_context_new(mainloop_api, bname)) != NULL);
+    pa_context_set_state_callback(context, context_state_cb, NULL);
+    fail_unless(pa_context_connect(context, NULL, 0, NULL) == 0);
+
+    fail_unless(pa_mainloop_run(m, &ret) >= 0);
+    fail_unless(ret == 0);
+    fail_unless(step == STEP_DONE);
+
+    pa_context_disconnect(context);
+    pa_context_unref(context);
+    pa_mainloop_free(m);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    bname = argv[0];
+
+    s = suite_create("Subscribe Delta");
+    tc = tcase_create("subscribedelta");
+    tcase_add_test(tc, subscribe_delta_test);
+    tcase_set_timeout(tc, 10);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
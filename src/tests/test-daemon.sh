@@ -36,31 +36,69 @@ export PULSE_RUNTIME_PATH=${TEMP_PULSE_DIR}
 
 # this script would be called inside src/ directory, so we need to use the correct path.
 # notice that for tests, we don't load ALSA related modules.
-pulseaudio -n \
-        --log-target=file:${PWD}/pulse-daemon.log \
-        --log-level=debug \
-        --load="module-null-sink" \
-        --load="module-null-source" \
-        --load="module-suspend-on-idle" \
-        --load="module-native-protocol-unix" \
-        --load="module-cli-protocol-unix" \
-        &
-
-# wait a few seconds to let the daemon start!
-sleep 2
+start_daemon()
+{
+    pulseaudio -n \
+            --log-target=file:${PWD}/$1 \
+            --log-level=debug \
+            --load="module-null-sink" \
+            --load="module-null-source" \
+            --load="module-suspend-on-idle" \
+            --load="module-native-protocol-unix" \
+            --load="module-cli-protocol-unix" \
+            &
+
+    DAEMON_PID=$!
+
+    # wait a few seconds to let the daemon start!
+    sleep 2
+}
+
+stop_daemon()
+{
+    # terminate the designated pulseaudio daemon
+    pacmd exit
+
+    wait $DAEMON_PID
+}
 
 unset DISPLAY
 
 EXIT_CODE=0
 
+# Tests that need native protocol connections served from IO worker threads.
+# command-stress connects more clients than the default configuration admits.
+IO_THREAD_TESTS=""
+
+start_daemon pulse-daemon.log
+
 for ONE_TEST in $@; do
-    ${ONE_TEST} || EXIT_CODE=1
+    case `basename ${ONE_TEST}` in
+        command-stress)
+            IO_THREAD_TESTS="${IO_THREAD_TESTS} ${ONE_TEST}"
+            ;;
+        *)
+            ${ONE_TEST} || EXIT_CODE=1
+            ;;
+    esac
 done
 
-# terminate the designated pulseaudio daemon
-pacmd exit
+stop_daemon
+
+if ! test -z "${IO_THREAD_TESTS}" ; then
+    echo "native-io-threads = 4" > ${TEMP_PULSE_DIR}/daemon.conf
+    export PULSE_CONFIG=${TEMP_PULSE_DIR}/daemon.conf
+
+    start_daemon pulse-daemon-io-threads.log
 
-wait
+    for ONE_TEST in ${IO_THREAD_TESTS}; do
+        ${ONE_TEST} || EXIT_CODE=1
+    done
+
+    stop_daemon
+
+    unset PULSE_CONFIG
+fi
 
 kill -TERM $DBUS_SESSION_BUS_PID || die "Message bus vanished! should not have happened" && echo "Killed daemon $DBUS_SESSION_BUS_PID" >&2
 
@@ -0,0 +1,347 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Plays through a write ring (enable-write-ring=yes, see
+ * PA_COMMAND_ENABLE_WRITE_RING) into a null sink and checks that the audio
+ * shows up on its monitor, and that the server gives all ring blocks back
+ * afterwards. Some of the data is passed at an offset that is not frame
+ * aligned, which libpulse has to send as a copy. The sink doesn't rewind,
+ * so it keeps no history that would hold on to the blocks. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <check.h>
+
+#include <pulse/pulseaudio.h>
+#include <pulse/rtclock.h>
+#include <pulse/internal.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/native-common.h>
+
+#define SINK_NAME "write_ring_test"
+#define SAMPLE_HZ 44100
+#define SAMPLE_VALUE 0x1234
+#define TOTAL_USEC (500 * PA_USEC_PER_MSEC)
+#define POLL_USEC (20 * PA_USEC_PER_MSEC)
+
+static const pa_sample_spec sample_spec = {
+    .format = PA_SAMPLE_S16LE,
+    .rate = SAMPLE_HZ,
+    .channels = 2
+};
+
+static pa_mainloop_api *mainloop_api = NULL;
+static pa_context *context = NULL;
+static pa_stream *playback = NULL;
+static pa_stream *record = NULL;
+static uint32_t module_index = PA_INVALID_INDEX;
+static char config_path[256];
+static const char *bname = NULL;
+
+static size_t total_bytes = 0;
+static size_t written_bytes = 0;
+static size_t ring_bytes = 0;
+static size_t unaligned_bytes = 0;
+static unsigned n_writes = 0;
+static size_t received_bytes = 0;
+static bool drained = false;
+static bool checking = false;
+static bool done = false;
+
+static void unload_module_cb(pa_context *c, int success, void *userdata) {
+    fail_unless(success);
+
+    mainloop_api->quit(mainloop_api, 0);
+}
+
+static void finish(void) {
+    done = true;
+
+    pa_stream_disconnect(playback);
+    pa_stream_unref(playback);
+    playback = NULL;
+
+    pa_stream_disconnect(record);
+    pa_stream_unref(record);
+    record = NULL;
+
+    pa_operation_unref(pa_context_unload_module(context, module_index, unload_module_cb, NULL));
+}
+
+static unsigned ring_pending(void) {
+    unsigned i, n = 0;
+
+    for (i = 0; i < playback->n_write_ring; i++) {
+        pa_write_ring_header *h = (pa_write_ring_header*) playback->write_ring_data[i];
+        n += (unsigned) pa_atomic_load(&h->pending);
+    }
+
+    return n;
+}
+
+/* The last chunks are dropped by the server shortly after the monitor saw
+ * them, so poll for that */
+static void check_pending_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    unsigned n;
+
+    if ((n = ring_pending()) > 0) {
+        fprintf(stderr, "%u chunks still pending\n", n);
+        pa_context_rttime_restart(context, e, pa_rtclock_now() + POLL_USEC);
+        return;
+    }
+
+    a->time_free(e);
+
+    fprintf(stderr, "All write ring blocks are free again\n");
+    finish();
+}
+
+static void maybe_check_pending(void) {
+    if (!drained || received_bytes < total_bytes || checking)
+        return;
+
+    checking = true;
+
+    fprintf(stderr, "Received all %lu bytes, %lu of them were written through the ring, %lu not frame aligned\n",
+            (unsigned long) received_bytes, (unsigned long) ring_bytes, (unsigned long) unaligned_bytes);
+
+    pa_context_rttime_new(context, pa_rtclock_now(), check_pending_cb, NULL);
+}
+
+static void drain_cb(pa_stream *s, int success, void *userdata) {
+    fail_unless(success);
+
+    drained = true;
+    maybe_check_pending();
+}
+
+static void write_cb(pa_stream *s, size_t nbytes, void *userdata) {
+    while (nbytes > 0 && written_bytes < total_bytes) {
+        int16_t *data;
+        size_t n, i;
+
+        n = PA_MIN(nbytes, total_bytes - written_bytes);
+        fail_unless(pa_stream_begin_write(s, (void**) &data, &n) == 0);
+
+        for (i = 0; i < n / sizeof(int16_t); i++)
+            data[i] = SAMPLE_VALUE;
+
+        /* Now and then pass data that doesn't start on a frame boundary of
+         * the ring. It must not get lost. */
+        if (s->write_ring_used && ++n_writes % 4 == 0 && n >= 2 * pa_frame_size(&sample_spec)) {
+            n -= pa_frame_size(&sample_spec);
+            unaligned_bytes += n;
+
+            fail_unless(pa_stream_write(s, data + 1, n, NULL, 0, PA_SEEK_RELATIVE) == 0);
+        } else {
+            /* Falling back to client memory is fine once the ring is full */
+            if (s->write_ring_used)
+                ring_bytes += n;
+
+            fail_unless(pa_stream_write(s, data, n, NULL, 0, PA_SEEK_RELATIVE) == 0);
+        }
+
+        written_bytes += n;
+        nbytes -= n;
+    }
+
+    if (written_bytes >= total_bytes) {
+        pa_stream_set_write_callback(s, NULL, NULL);
+        pa_operation_unref(pa_stream_drain(s, drain_cb, NULL));
+    }
+}
+
+static void read_cb(pa_stream *s, size_t nbytes, void *userdata) {
+    const void *data;
+    size_t n;
+
+    while (pa_stream_readable_size(s) > 0) {
+        fail_unless(pa_stream_peek(s, &data, &n) == 0);
+
+        if (data) {
+            const int16_t *d = data;
+            size_t i;
+
+            for (i = 0; i < n / sizeof(int16_t); i++)
+                if (d[i] == SAMPLE_VALUE)
+                    received_bytes += sizeof(int16_t);
+        }
+
+        pa_stream_drop(s);
+    }
+
+    maybe_check_pending();
+}
+
+/* The ENABLE_WRITE_RING reply comes in after the stream is ready */
+static void wait_for_ring_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    if (!playback->write_ring) {
+        pa_context_rttime_restart(context, e, pa_rtclock_now() + POLL_USEC);
+        return;
+    }
+
+    a->time_free(e);
+
+    fprintf(stderr, "Got a write ring of %u blocks\n", playback->n_write_ring);
+
+    pa_stream_set_write_callback(playback, write_cb, NULL);
+    write_cb(playback, (size_t) pa_stream_writable_size(playback), NULL);
+}
+
+static void stream_state_cb(pa_stream *s, void *userdata) {
+    pa_buffer_attr attr;
+
+    switch (pa_stream_get_state(s)) {
+        case PA_STREAM_UNCONNECTED:
+        case PA_STREAM_CREATING:
+        case PA_STREAM_TERMINATED:
+            break;
+
+        case PA_STREAM_READY:
+            if (s == playback) {
+                pa_context_rttime_new(context, pa_rtclock_now(), wait_for_ring_cb, NULL);
+                break;
+            }
+
+            /* Start playing once we are recording */
+            attr.maxlength = (uint32_t) -1;
+            attr.tlength = (uint32_t) pa_usec_to_bytes(100 * PA_USEC_PER_MSEC, &sample_spec);
+            attr.prebuf = (uint32_t) -1;
+            attr.minreq = (uint32_t) -1;
+            attr.fragsize = (uint32_t) -1;
+
+            fail_unless((playback = pa_stream_new(context, "write ring playback", &sample_spec, NULL)) != NULL);
+            pa_stream_set_state_callback(playback, stream_state_cb, NULL);
+            fail_unless(pa_stream_connect_playback(playback, SINK_NAME, &attr, 0, NULL, NULL) == 0);
+            break;
+
+        default:
+        case PA_STREAM_FAILED:
+            fprintf(stderr, "Stream error: %s\n", pa_strerror(pa_context_errno(pa_stream_get_context(s))));
+            ck_abort();
+    }
+}
+
+static void load_module_cb(pa_context *c, uint32_t idx, void *userdata) {
+    pa_buffer_attr attr;
+
+    fail_unless(idx != PA_INVALID_INDEX);
+    module_index = idx;
+
+    attr.maxlength = (uint32_t) -1;
+    attr.tlength = (uint32_t) -1;
+    attr.prebuf = (uint32_t) -1;
+    attr.minreq = (uint32_t) -1;
+    attr.fragsize = (uint32_t) pa_usec_to_bytes(20 * PA_USEC_PER_MSEC, &sample_spec);
+
+    fail_unless((record = pa_stream_new(c, "write ring monitor", &sample_spec, NULL)) != NULL);
+    pa_stream_set_state_callback(record, stream_state_cb, NULL);
+    pa_stream_set_read_callback(record, read_cb, NULL);
+    fail_unless(pa_stream_connect_record(record, SINK_NAME ".monitor", &attr, PA_STREAM_ADJUST_LATENCY) == 0);
+}
+
+static void context_state_cb(pa_context *c, void *userdata) {
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_CONNECTING:
+        case PA_CONTEXT_AUTHORIZING:
+        case PA_CONTEXT_SETTING_NAME:
+            break;
+
+        case PA_CONTEXT_READY:
+            pa_operation_unref(pa_context_load_module(c, "module-null-sink",
+                                                      "sink_name=" SINK_NAME " norewinds=1 format=s16le rate=44100 channels=2",
+                                                      load_module_cb, NULL));
+            break;
+
+        case PA_CONTEXT_TERMINATED:
+            mainloop_api->quit(mainloop_api, 0);
+            break;
+
+        case PA_CONTEXT_FAILED:
+        default:
+            fprintf(stderr, "Context error: %s\n", pa_strerror(pa_context_errno(c)));
+            ck_abort();
+    }
+}
+
+START_TEST (write_ring_test) {
+    pa_mainloop *m;
+    const char *dir;
+    FILE *f;
+    int ret = 1;
+
+    if (!(dir = getenv("PULSE_RUNTIME_PATH")))
+        dir = "/tmp";
+
+    /* The write ring is opt-in */
+    snprintf(config_path, sizeof(config_path), "%s/write-ring-test-%lu.conf", dir, (unsigned long) getpid());
+    fail_unless((f = fopen(config_path, "w")) != NULL);
+    fputs("enable-write-ring = yes\n", f);
+    fclose(f);
+    setenv("PULSE_CLIENTCONFIG", config_path, 1);
+
+    total_bytes = pa_usec_to_bytes(TOTAL_USEC, &sample_spec);
+
+    fail_unless((m = pa_mainloop_new()) != NULL);
+    mainloop_api = pa_mainloop_get_api(m);
+
+    fail_unless((context = pa_context_new(mainloop_api, bname)) != NULL);
+    pa_context_set_state_callback(context, context_state_cb, NULL);
+    fail_unless(pa_context_connect(context, NULL, 0, NULL) == 0);
+
+    fail_unless(pa_mainloop_run(m, &ret) >= 0);
+    fail_unless(ret == 0);
+    fail_unless(done);
+    fail_unless(ring_bytes > 0);
+    fail_unless(unaligned_bytes > 0);
+
+    pa_context_disconnect(context);
+    pa_context_unref(context);
+    pa_mainloop_free(m);
+
+    unlink(config_path);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    bname = argv[0];
+
+    s = suite_create("Write Ring");
+    tc = tcase_create("writering");
+    tcase_add_test(tc, write_ring_test);
+    tcase_set_timeout(tc, 10);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}